@@ -8,6 +8,8 @@ QT       += core gui
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
+CONFIG += c++17
+
 TARGET = NeuralNetworkGUI
 TEMPLATE = app
 
@@ -26,12 +28,57 @@ DEFINES += QT_DEPRECATED_WARNINGS
 SOURCES += \
         main.cpp \
     neuralnetworkgui.cpp \
-    all_class.cpp
+    all_class.cpp \
+    kernels.cpp \
+    gemm.cpp \
+    thread_pool.cpp \
+    parallel_trainer.cpp \
+    dataset.cpp \
+    text_reader.cpp \
+    prefetch_loader.cpp \
+    epoch_trainer.cpp \
+    logger.cpp \
+    training_job.cpp \
+    evaluator.cpp \
+    checkpoint.cpp \
+    quantized_net.cpp \
+    activations.cpp \
+    optimizer.cpp \
+    profiler.cpp \
+    sweep.cpp \
+    normalizer.cpp \
+    stream_source.cpp \
+    snapshots.cpp \
+    online_trainer.cpp
 
 HEADERS += \
         neuralnetworkgui.h \
     neuralnetworkgui.h \
-    all_class.h
+    all_class.h \
+    kernels.h \
+    gemm.h \
+    thread_pool.h \
+    parallel_trainer.h \
+    dataset.h \
+    text_reader.h \
+    prefetch_loader.h \
+    epoch_trainer.h \
+    logger.h \
+    training_job.h \
+    evaluator.h \
+    checkpoint.h \
+    half.h \
+    quantized_net.h \
+    activations.h \
+    static_net.h \
+    optimizer.h \
+    profiler.h \
+    sweep.h \
+    json_line.h \
+    normalizer.h \
+    stream_source.h \
+    snapshots.h \
+    online_trainer.h
 
 FORMS += \
         neuralnetworkgui.ui
@@ -0,0 +1,125 @@
+#include "activations.h"
+#include "kernels.h"
+
+bool validActivations(const std::vector<ActivationKind> &activations, size_t numLayers){
+    if(activations.empty())
+        return true;
+    if(activations.size() != numLayers)
+        return false;
+    for(size_t layerNum = 0; layerNum < numLayers; ++layerNum){
+        if(!isValidActivation(activations[layerNum]))
+            return false;
+        if(activationInfo(activations[layerNum]).outputOnly && layerNum + 1 != numLayers)
+            return false;
+    }
+    return true;
+}
+
+// The kernels take unsigned counts; batched buffers can be longer.
+template<class T>
+static void mapInChunks(void (*kernel)(T *, unsigned), T *values, size_t n){
+    const size_t chunk = 1u << 30;
+    for(size_t first = 0; first < n; first += chunk)
+        kernel(values + first, (unsigned)std::min(chunk, n - first));
+}
+
+template<class T>
+void activate(ActivationKind kind, T *values, size_t n){
+    const KernelTableT<T> &k = kernelsFor<T>();
+    switch(kind){
+    case ACTIVATION_SIGMOID:
+        mapInChunks(k.sigmoid, values, n);
+        break;
+    case ACTIVATION_TANH:
+        mapInChunks(k.tanh, values, n);
+        break;
+    case ACTIVATION_RELU:
+        for(size_t i = 0; i < n; i++)
+            values[i] = values[i] > T(0) ? values[i] : T(0);
+        break;
+    case ACTIVATION_LEAKY_RELU:
+        for(size_t i = 0; i < n; i++)
+            values[i] = values[i] > T(0) ? values[i] : T(LEAKY_RELU_SLOPE) * values[i];
+        break;
+    case ACTIVATION_SOFTMAX: {
+        if(n == 0)
+            break;
+        T largest = *std::max_element(values, values + n);
+        for(size_t i = 0; i < n; i++)
+            values[i] -= largest;
+        mapInChunks(k.exp, values, n);
+        T sum = T(0);
+        for(size_t i = 0; i < n; i++)
+            sum += values[i];
+        T scale = T(1) / sum;
+        for(size_t i = 0; i < n; i++)
+            values[i] *= scale;
+        break;
+    }
+    }
+}
+
+// The derivatives are written in terms of the output y = f(x), which is
+// what the layer buffers hold after the forward pass.
+template<class T>
+void multiplyDerivative(ActivationKind kind, const T *outputs, T *gradients, size_t n){
+    switch(kind){
+    case ACTIVATION_SIGMOID:
+        for(size_t i = 0; i < n; i++)
+            gradients[i] = gradients[i] * (outputs[i] * (T(1) - outputs[i]));
+        break;
+    case ACTIVATION_TANH:
+        for(size_t i = 0; i < n; i++)
+            gradients[i] = gradients[i] * (T(1) - outputs[i] * outputs[i]);
+        break;
+    case ACTIVATION_RELU:
+        for(size_t i = 0; i < n; i++)
+            gradients[i] = outputs[i] > T(0) ? gradients[i] : T(0);
+        break;
+    case ACTIVATION_LEAKY_RELU:
+        for(size_t i = 0; i < n; i++)
+            gradients[i] = outputs[i] > T(0) ? gradients[i] : T(LEAKY_RELU_SLOPE) * gradients[i];
+        break;
+    case ACTIVATION_SOFTMAX:
+        // Not element-wise; validActivations() keeps it off hidden layers.
+        assert(false);
+        break;
+    }
+}
+
+template<class T>
+void outputGradients(ActivationKind kind, const T *outputs, const double *targets, T *gradients, unsigned n){
+    if(kind != ACTIVATION_SOFTMAX){
+        for(unsigned i = 0; i < n; i++)
+            gradients[i] = T(targets[i]) - outputs[i];
+        multiplyDerivative(kind, outputs, gradients, n);
+        return;
+    }
+    // d = targets - y; the softmax Jacobian diag(y) - y y^T applied to d.
+    T weighted = T(0);
+    for(unsigned i = 0; i < n; i++)
+        weighted += (T(targets[i]) - outputs[i]) * outputs[i];
+    for(unsigned i = 0; i < n; i++)
+        gradients[i] = outputs[i] * ((T(targets[i]) - outputs[i]) - weighted);
+}
+
+double initialWeight(ActivationKind kind, double u, unsigned fanIn, unsigned fanOut){
+    switch(kind){
+    case ACTIVATION_SIGMOID:
+        return u;
+    case ACTIVATION_RELU:
+    case ACTIVATION_LEAKY_RELU:
+        return (2.0 * u - 1.0) * sqrt(6.0 / std::max(1u, fanIn));
+    case ACTIVATION_TANH:
+    case ACTIVATION_SOFTMAX:
+        break;
+    }
+    return (2.0 * u - 1.0) * sqrt(6.0 / std::max(1u, fanIn + fanOut));
+}
+
+template void activate<double>(ActivationKind, double *, size_t);
+template void activate<float>(ActivationKind, float *, size_t);
+template void multiplyDerivative<double>(ActivationKind, const double *, double *, size_t);
+template void multiplyDerivative<float>(ActivationKind, const float *, float *, size_t);
+template void outputGradients<double>(ActivationKind, const double *, const double *, double *, unsigned);
+template void outputGradients<float>(ActivationKind, const float *, const double *, float *, unsigned);
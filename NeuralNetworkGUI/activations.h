@@ -0,0 +1,75 @@
+#ifndef ACTIVATIONS_H
+#define ACTIVATIONS_H
+
+
+#include<bits/stdc++.h>
+
+// Transfer functions a layer can use, picked per layer on the topology line
+// ("topology: 2 8:relu 1:sigmoid"; a bare size means sigmoid). The values
+// are stored in checkpoints and binary datasets, so only ever append.
+enum ActivationKind {
+    ACTIVATION_SIGMOID = 0,
+    ACTIVATION_TANH = 1,
+    ACTIVATION_RELU = 2,
+    ACTIVATION_LEAKY_RELU = 3,
+    ACTIVATION_SOFTMAX = 4
+};
+#define ACTIVATION_COUNT 5
+#define LEAKY_RELU_SLOPE 0.01
+
+struct ActivationInfo {
+    ActivationKind kind;
+    const char *name;
+    bool outputOnly;     // normalises across the layer; not allowed on hidden layers
+};
+
+inline const ActivationInfo &activationInfo(ActivationKind kind){
+    static const ActivationInfo registry[ACTIVATION_COUNT] = {
+        {ACTIVATION_SIGMOID,    "sigmoid",    false},
+        {ACTIVATION_TANH,       "tanh",       false},
+        {ACTIVATION_RELU,       "relu",       false},
+        {ACTIVATION_LEAKY_RELU, "leaky_relu", false},
+        {ACTIVATION_SOFTMAX,    "softmax",    true},
+    };
+    return registry[kind];
+}
+
+inline bool isValidActivation(uint32_t value){ return value < ACTIVATION_COUNT; }
+
+// Looks up the name in [name, name + length). False if there is no such
+// activation.
+inline bool activationFromName(const char *name, size_t length, ActivationKind &kind){
+    for(unsigned i = 0; i < ACTIVATION_COUNT; i++){
+        const char *candidate = activationInfo((ActivationKind)i).name;
+        if(strlen(candidate) == length && memcmp(candidate, name, length) == 0){
+            kind = (ActivationKind)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// One entry per layer, the input layer's ignored. An empty list means
+// sigmoid everywhere; a list is usable for a topology if it is empty or has
+// one valid entry per layer with output-only kinds on the last layer alone.
+bool validActivations(const std::vector<ActivationKind> &activations, size_t numLayers);
+
+// The layer-wide passes Net runs. The transcendental ones go through
+// kernelsFor<T>(): vectorised polynomial approximations on AVX2/AVX-512
+// (see kernels.h for their error bounds), libm under NN_KERNEL=scalar.
+
+// values[i] = f(values[i]) in place; softmax treats all n as one layer.
+template<class T> void activate(ActivationKind kind, T *values, size_t n);
+// gradients[i] *= f'(x) where outputs[i] = f(x), for the element-wise kinds.
+template<class T> void multiplyDerivative(ActivationKind kind, const T *outputs, T *gradients, size_t n);
+// Output-layer gradients for the squared error: (targets - outputs) times
+// f'(x), or the full Jacobian product for softmax.
+template<class T> void outputGradients(ActivationKind kind, const T *outputs, const double *targets,
+                                       T *gradients, unsigned n);
+// Initial weight for a layer of this kind from u, uniform in [0, 1].
+// Sigmoid keeps the original u itself; the others draw symmetrically,
+// scaled by fan-in (ReLU family) or fan-in + fan-out.
+double initialWeight(ActivationKind kind, double u, unsigned fanIn, unsigned fanOut);
+
+
+#endif // ACTIVATIONS_H
@@ -1,205 +1,647 @@
 #include "all_class.h"
+#include "kernels.h"
+#include "gemm.h"
+#include "half.h"
+#include "profiler.h"
 
 void TrainingData::getTopology(std::vector<unsigned> &topology){
-    std::string line, label;
-
-    getline(m_trainingDataFile, line);
-    std::stringstream ss(line);
-    ss >> label;
-    if(this->isEof() || label.compare("topology:") != 0)
-        abort();
-    while(!ss.eof()){
-        unsigned n;
-        ss >> n;
-        topology.push_back(n);
+    if(m_binary){
+        m_binary->getTopology(topology);
+        m_binary->getActivations(m_activations);
+        if(topology.empty() || !validActivations(m_activations, topology.size()))
+            abort();
+        return;
     }
+    if(!m_text->readTopology(topology, m_activations) || this->isEof()
+       || !validActivations(m_activations, topology.size()))
+        abort();
     return;
 }
 
-TrainingData::TrainingData(const std::string filename){
-    m_trainingDataFile.open(filename.c_str());
+TrainingData::TrainingData(const std::string filename) : m_nextSample(0){
+    if(MappedDataset::isBinary(filename)){
+        m_binary.reset(new MappedDataset(filename));
+        if(!m_binary->isOpen())
+            abort();
+        return;
+    }
+    m_text.reset(new FastTextReader(filename));
 }
 
 
 unsigned TrainingData::getNextInputs(std::vector<double> &inputVals){
+    NN_PROFILE_SCOPE(PROFILE_PARSE);
     inputVals.clear();
-    std::string line, label;
-    getline(m_trainingDataFile, line);
-    std::stringstream ss(line);
-    ss >> label;
-    if (label.compare("in:") == 0) {
-        double oneValue;
-        while (ss >> oneValue)
-            inputVals.push_back(oneValue);
+    if(m_binary){
+        if(m_nextSample < m_binary->size())
+            m_binary->getInputs(m_nextSample, inputVals);
+        return inputVals.size();
     }
-    return inputVals.size();
+    return m_text->readValues("in:", inputVals);
 }
 
 unsigned TrainingData::getTargetOutputs(std::vector<double> &targetOutputVals){
+    NN_PROFILE_SCOPE(PROFILE_PARSE);
+    NN_PROFILE_COUNT(PROFILE_PARSED, 1);
     targetOutputVals.clear();
-    std::string line, label;
-    getline(m_trainingDataFile, line);
-    std::stringstream ss(line);
-    ss>> label;
-    if (label.compare("out:") == 0) {
-        double oneValue;
-        while (ss >> oneValue)
-            targetOutputVals.push_back(oneValue);
+    if(m_binary){
+        if(m_nextSample < m_binary->size())
+            m_binary->getTargets(m_nextSample++, targetOutputVals);
+        return targetOutputVals.size();
     }
-    return targetOutputVals.size();
+    return m_text->readValues("out:", targetOutputVals);
+}
+
+template<class T> double BasicNet<T>::m_recentAverageSmoothingFactor = 100.0;
+template<class T>
+void BasicNet<T>::getResults(std::vector<double> &resultVals) const{
+    const Layer &outputLayer = m_layers.back();
+    resultVals.assign(outputLayer.outputVals, outputLayer.outputVals + outputLayer.numNeurons);
+}
+
+template<class T>
+void BasicNet<T>::getTopology(std::vector<unsigned> &topology) const{
+    topology.clear();
+    for(unsigned layerNum = 0; layerNum < m_layers.size(); ++layerNum)
+        topology.push_back(m_layers[layerNum].numNeurons);
+}
+
+template<class T>
+void BasicNet<T>::getActivations(std::vector<ActivationKind> &activations) const{
+    activations.clear();
+    for(unsigned layerNum = 0; layerNum < m_layers.size(); ++layerNum)
+        activations.push_back(m_layers[layerNum].activation);
 }
 
-void Neuron::updateInputWeights(Layer &prevLayer){
-    unsigned size = prevLayer.size();
+template<class T>
+double BasicNet<T>::sampleLoss(const T *outputs, const double *targets) const{
+    unsigned size = m_layers.back().numNeurons;
+    double loss = 0.0;
     for(unsigned i = 0; i < size; i++){
-        Neuron &neuron = prevLayer[i];
-        double oldDeltaWeight = neuron.m_outputWeights[m_myIndex].deltaWeight;
-        double newDeltaWeight = eta * neuron.getOutputVal() * m_gradient + alpha * oldDeltaWeight;
-        neuron.m_outputWeights[m_myIndex].deltaWeight = newDeltaWeight;
-        neuron.m_outputWeights[m_myIndex].weight += newDeltaWeight;
+        double delta = targets[i] - outputs[i];
+        loss += delta *delta;
     }
+    loss /= size;
+    return sqrt(loss);
 }
 
-double Neuron::sumDOW(const Layer &nextLayer) const{
-    double sum = 0.0;
-    unsigned size = nextLayer.size();
-    for (unsigned i = 0; i < size - 1; i++)
-        sum += m_outputWeights[i].weight * nextLayer[i].m_gradient;
-    return sum;
+// Rounds count activations through the 16-bit storage format, if any.
+template<class T>
+void BasicNet<T>::storeActivations(T *values, size_t count) const{
+    switch(m_activationStorage){
+    case ACTIVATIONS_BF16:
+        for(size_t i = 0; i < count; i++)
+            values[i] = bf16ToFloat(floatToBf16((float)values[i]));
+        break;
+    case ACTIVATIONS_FP16:
+        for(size_t i = 0; i < count; i++)
+            values[i] = halfToFloat(floatToHalf((float)values[i]));
+        break;
+    case ACTIVATIONS_NATIVE:
+        break;
+    }
 }
 
-void Neuron::calcHiddenGradients(const Layer &nextLayer){
-    double dow = sumDOW(nextLayer);
-    m_gradient = dow * Neuron::transferFunctionDerivative(m_outputVal);
+template<class T>
+void BasicNet<T>::setInputScaling(const InputScaling &scaling){
+    assert(scaling.empty() || (scaling.numInputs() == m_layers[0].numNeurons && scaling.scale.size() == scaling.numInputs()));
+    m_inputScaling = scaling;
+    m_inputOffset.assign(scaling.offset.begin(), scaling.offset.end());
+    m_inputScale.assign(scaling.scale.begin(), scaling.scale.end());
 }
 
-double Neuron::sigmoid(double x){return 1.0 / (1.0 + exp(-x));}
-double Neuron::sigmoidDerivative(double x){return x * (1.0 - x);}
+template<class T>
+void BasicNet<T>::loadInputs(T *row, const double *inputs) const{
+    unsigned n = m_layers[0].numNeurons;
+    if(m_inputScaling.empty())
+        std::copy(inputs, inputs + n, row);
+    else
+        kernelsFor<T>().scaleInputs(row, inputs, m_inputOffset.data(), m_inputScale.data(), n);
+    storeActivations(row, n);
+}
+
+template<class T>
+void BasicNet<T>::loadInputs(T *row, const float *inputs) const{
+    unsigned n = m_layers[0].numNeurons;
+    if(m_inputScaling.empty())
+        std::copy(inputs, inputs + n, row);
+    else
+        kernelsFor<T>().scaleInputsFloat(row, inputs, m_inputOffset.data(), m_inputScale.data(), n);
+    storeActivations(row, n);
+}
 
-void Neuron::calcOutputGradients(double targetVals){
-    double delta = targetVals - m_outputVal;
-    m_gradient = delta * Neuron::transferFunctionDerivative(m_outputVal);
+template<class T>
+void BasicNet<T>::recordLosses(const double *losses, unsigned count){
+    for(unsigned i = 0; i < count; i++){
+        m_loss = losses[i];
+        m_recentAverageloss =
+                (m_recentAverageloss * m_recentAverageSmoothingFactor + m_loss)
+                / (m_recentAverageSmoothingFactor + 1.0);
+    }
 }
 
-double Neuron::transferFunction(double x){return sigmoid(x);}
-double Neuron::transferFunctionDerivative(double x){return sigmoidDerivative(x);}
+template<class T>
+void BasicNet<T>::outputLayerGradients(const std::vector<double> &targetVals){
+    Layer &outputLayer = m_layers.back();
+    unsigned size = outputLayer.numNeurons;
+    double loss = sampleLoss(outputLayer.outputVals, targetVals.data());
+    recordLosses(&loss, 1);
+    outputGradients(outputLayer.activation, outputLayer.outputVals, targetVals.data(),
+                    outputLayer.gradients, size);
+}
 
-void Neuron::feedForward(const Layer &prevLayer, int layernum, int totalLayer){
-    double sum = 0.0;
-    for(unsigned i = 0 ; i < prevLayer.size(); i++){
-        sum += prevLayer[i].getOutputVal() *
-                 prevLayer[i].m_outputWeights[m_myIndex].weight;
+// Layer by layer from the output down, every weight row goes through one
+// fused kernel call: it adds the row's share of sumDOW to the layer below
+// (from the weights before the update) and applies the optimizer step to
+// the same row while it is in cache. The layer below then only needs its
+// derivative, and is updated the same way on the next iteration.
+template<class T>
+void BasicNet<T>::backProp(const std::vector<double> &targetVals){
+    NN_PROFILE_SCOPE(PROFILE_BACK_PROP);
+    NN_PROFILE_COUNT(PROFILE_TRAINED, 1);
+    outputLayerGradients(targetVals);
+    OptimizerStepT<T> step = optimizerStep<T>(m_optimizer, ++m_optimizerSteps);
+    for(unsigned layerNum = m_layers.size() - 1; layerNum > 0; --layerNum){
+        NN_PROFILE_LAYER(PROFILE_BACK_PROP, layerNum);
+        Layer &layer = m_layers[layerNum];
+        Layer &prevLayer = m_layers[layerNum - 1];
+        unsigned size = layer.numInputs;
+        T *dow = layerNum > 1 ? prevLayer.gradients : NULL;
+        if(dow != NULL)
+            std::fill(dow, dow + size, T(0));
+        updateLayer(layer, step, prevLayer.outputVals, 0, layer.gradients, 1, dow);
+        if(dow != NULL)
+            multiplyDerivative(prevLayer.activation, prevLayer.outputVals, dow, size);
     }
-    m_outputVal = Neuron::transferFunction(sum);
 }
 
-Neuron::Neuron(unsigned numOutputs, unsigned myIndex)
-{
-    for(unsigned c = 0; c < numOutputs; ++c){
-        m_outputWeights.push_back(Connection());
-        m_outputWeights.back().weight = randomWeight();
+template<class T>
+void BasicNet<T>::backPropUnfused(const std::vector<double> &targetVals){
+    const KernelTableT<T> &k = kernelsFor<T>();
+    NN_PROFILE_COUNT(PROFILE_TRAINED, 1);
+    outputLayerGradients(targetVals);
+
+    // sumDOW as a row-wise accumulation: every row of nextLayer's weights is
+    // read once, front to back, instead of striding down a column per neuron.
+    for(unsigned layerNum = m_layers.size() - 2; layerNum > 0; layerNum--){
+        NN_PROFILE_LAYER(PROFILE_BACK_PROP, layerNum);
+        Layer &hiddenLayer = m_layers[layerNum];
+        const Layer &nextLayer = m_layers[layerNum + 1];
+        unsigned size = nextLayer.numInputs;
+        T *dow = hiddenLayer.gradients;
+        std::fill(dow, dow + size, T(0));
+        for(unsigned j = 0; j < nextLayer.numNeurons; j++)
+            k.axpy(dow, &nextLayer.weights[j * size], nextLayer.gradients[j], size);
+        multiplyDerivative(hiddenLayer.activation, hiddenLayer.outputVals, dow, size);
     }
 
-    m_myIndex = myIndex;
+    NN_PROFILE_SCOPE(PROFILE_UPDATE);
+    OptimizerStepT<T> step = optimizerStep<T>(m_optimizer, ++m_optimizerSteps);
+    for(unsigned layerNum = m_layers.size() - 1; layerNum > 0; --layerNum){
+        NN_PROFILE_LAYER(PROFILE_UPDATE, layerNum);
+        updateLayer(m_layers[layerNum], step, m_layers[layerNum - 1].outputVals, 0,
+                    m_layers[layerNum].gradients, 1, NULL);
+    }
 }
 
-double Net::m_recentAverageSmoothingFactor = 100.0;
-void Net::getResults(std::vector<double> &resultVals) const{
-    resultVals.clear();
-    unsigned size = m_layers.back().size();
-    for(unsigned i = 0; i < size - 1; i++)
-        resultVals.push_back(m_layers.back()[i].getOutputVal());
+template<class T>
+void BasicNet<T>::prepareWorkspace(BatchWorkspace &ws, unsigned batchSize) const{
+    if(batchSize <= ws.capacity)
+        return;
+    unsigned numLayers = m_layers.size();
+    size_t size = numParameters();
+    for(unsigned layerNum = 0; layerNum < numLayers; ++layerNum)
+        size += 2 * (size_t)batchSize * (m_layers[layerNum].numNeurons + 1);
+    ws.storage.assign(size, T(0));
+    ws.outputs.resize(numLayers);
+    ws.gradients.resize(numLayers);
+    ws.weightGradients.resize(numLayers);
+    T *next = ws.storage.data();
+    for(unsigned layerNum = 0; layerNum < numLayers; ++layerNum){
+        ws.weightGradients[layerNum] = next;
+        next += m_layers[layerNum].numWeights();
+    }
+    for(unsigned layerNum = 0; layerNum < numLayers; ++layerNum){
+        size_t values = (size_t)batchSize * (m_layers[layerNum].numNeurons + 1);
+        ws.outputs[layerNum] = next;
+        std::fill(next, next + values, T(1));
+        ws.gradients[layerNum] = next + values;
+        next += 2 * values;
+    }
+    ws.losses.assign(batchSize, 0.0);
+    ws.capacity = batchSize;
 }
 
-void Net::backProp(const std::vector<double> &targetVals){
-    Layer &outputLayer = m_layers.back();
-    m_loss = 0.0;
-    unsigned size = outputLayer.size();
-    for(unsigned i = 0; i < size - 1; i++){
-        double delta = targetVals[i] - outputLayer[i].getOutputVal();
-        m_loss += delta *delta;
-    }
-    m_loss /= outputLayer.size() - 1;
-    m_loss = sqrt(m_loss);
-    m_recentAverageloss =
-            (m_recentAverageloss * m_recentAverageSmoothingFactor + m_loss)
-            / (m_recentAverageSmoothingFactor + 1.0);
-    for(unsigned i = 0; i < size - 1; i++)
-        outputLayer[i].calcOutputGradients(targetVals[i]);
-    for(unsigned layerNum = m_layers.size() - 2; layerNum > 0; layerNum--){
-        Layer &hiddenLayer = m_layers[layerNum];
-        Layer &nextLayer = m_layers[layerNum + 1];
-        unsigned size = hiddenLayer.size();
-        for(unsigned i = 0; i < size; i++)
-            hiddenLayer[i].calcHiddenGradients(nextLayer);
+template<class T>
+void BasicNet<T>::trainBatch(const std::vector<double> &inputs, const std::vector<double> &targets,
+                             unsigned batchSize){
+    assert(inputs.size() == (size_t)batchSize * m_layers[0].numNeurons);
+    assert(targets.size() == (size_t)batchSize * m_layers.back().numNeurons);
+    trainBatch(inputs.data(), targets.data(), batchSize);
+}
+
+template<class T>
+void BasicNet<T>::trainBatch(const double *inputs, const double *targets, unsigned batchSize){
+    if(batchSize == 0)
+        return;
+    computeGradients(inputs, targets, batchSize, m_workspace);
+    recordLosses(m_workspace.losses.data(), batchSize);
+    applyGradients(m_workspace, 1.0 / batchSize);
+}
+
+// Same maths as feedForward + backProp, but every layer is one GEMM over the
+// whole batch:
+//   forward  Out[l]   = f(Out[l-1] * W[l]^T)        (bias is the last column of Out)
+//   backward G[l]     = (G[l+1] * W[l+1]) .* f'(Out[l])
+//   gradient dW[l]    = G[l]^T * Out[l-1], summed over the batch
+template<class T>
+void BasicNet<T>::computeGradients(const double *inputs, const double *targets, unsigned batchSize,
+                                   BatchWorkspace &ws) const{
+    NN_PROFILE_COUNT(PROFILE_TRAINED, batchSize);
+    prepareWorkspace(ws, batchSize);
+    unsigned numLayers = m_layers.size();
+
+    const Layer &inputLayer = m_layers[0];
+    unsigned inputWidth = inputLayer.numNeurons + 1;
+    for(unsigned b = 0; b < batchSize; b++)
+        loadInputs(&ws.outputs[0][(size_t)b * inputWidth], inputs + (size_t)b * inputLayer.numNeurons);
+
+    for(unsigned layerNum = 1; layerNum < numLayers; ++layerNum){
+        NN_PROFILE_LAYER(PROFILE_BATCH_FORWARD, layerNum);
+        const Layer &layer = m_layers[layerNum];
+        unsigned width = layer.numNeurons + 1;
+        gemm(false, true, batchSize, layer.numNeurons, layer.numInputs,
+             ws.outputs[layerNum - 1], layer.numInputs,
+             layer.weights, layer.numInputs,
+             ws.outputs[layerNum], width, false);
+        activateRows(layer, ws.outputs[layerNum], batchSize, width);
+        storeActivations(ws.outputs[layerNum], (size_t)batchSize * width);
     }
 
+    const Layer &outputLayer = m_layers.back();
+    unsigned outputWidth = outputLayer.numNeurons + 1;
+    for(unsigned b = 0; b < batchSize; b++){
+        const T *out = &ws.outputs[numLayers - 1][(size_t)b * outputWidth];
+        const double *target = targets + (size_t)b * outputLayer.numNeurons;
+        T *gradient = &ws.gradients[numLayers - 1][(size_t)b * outputWidth];
+        ws.losses[b] = sampleLoss(out, target);
+        outputGradients(outputLayer.activation, out, target, gradient, outputLayer.numNeurons);
+    }
+
+    for(unsigned layerNum = numLayers - 2; layerNum > 0; layerNum--){
+        NN_PROFILE_LAYER(PROFILE_BATCH_BACKWARD, layerNum);
+        const Layer &hiddenLayer = m_layers[layerNum];
+        const Layer &nextLayer = m_layers[layerNum + 1];
+        unsigned width = hiddenLayer.numNeurons + 1;
+        T *gradients = ws.gradients[layerNum];
+        const T *outputs = ws.outputs[layerNum];
+        gemm(false, false, batchSize, width, nextLayer.numNeurons,
+             ws.gradients[layerNum + 1], nextLayer.numNeurons + 1,
+             nextLayer.weights, nextLayer.numInputs,
+             gradients, width, false);
+        multiplyDerivative(hiddenLayer.activation, outputs, gradients, (size_t)batchSize * width);
+    }
+
+    for(unsigned layerNum = numLayers - 1; layerNum > 0; --layerNum){
+        NN_PROFILE_LAYER(PROFILE_BATCH_BACKWARD, layerNum);
+        const Layer &layer = m_layers[layerNum];
+        unsigned size = layer.numInputs;
+        gemm(true, false, layer.numNeurons, size, batchSize,
+             ws.gradients[layerNum], layer.numNeurons + 1,
+             ws.outputs[layerNum - 1], size,
+             ws.weightGradients[layerNum], size, false);
+    }
+}
+
+// One optimizer step with g = scale * dW, dW taken from ws.weightGradients
+// (a sum over samples; scale turns it into a mean).
+template<class T>
+void BasicNet<T>::applyGradients(const BatchWorkspace &ws, double scale){
+    NN_PROFILE_SCOPE(PROFILE_UPDATE);
+    OptimizerStepT<T> step = optimizerStep<T>(m_optimizer, ++m_optimizerSteps);
+    T gradient = T(scale);
     for(unsigned layerNum = m_layers.size() - 1; layerNum > 0; --layerNum){
+        NN_PROFILE_LAYER(PROFILE_UPDATE, layerNum);
         Layer &layer = m_layers[layerNum];
-        Layer &prevLayer = m_layers[layerNum - 1];
-        unsigned size = layer.size();
-        for(unsigned i = 0; i < size - 1; i++)
-            layer[i].updateInputWeights(prevLayer);
+        updateLayer(layer, step, ws.weightGradients[layerNum], layer.numInputs, &gradient, 0, NULL);
     }
 }
 
-void Net::feedForward(const std::vector<double> &inputVals){
-    assert(inputVals.size() == m_layers[0].size() - 1);
-    unsigned size = inputVals.size();
-    for(unsigned i = 0; i < size; i++)
-        m_layers[0][i].setOutputVal(inputVals[i]);
-    for(unsigned layerNum = 1; layerNum < m_layers.size(); ++layerNum){
-        Layer &prevLayer = m_layers[layerNum - 1];
-        unsigned size = m_layers[layerNum].size();
-        for(unsigned i = 0; i < size - 1; i++){
-            m_layers[layerNum][i].feedForward(prevLayer, layerNum, m_layers.size() - 1);
+// Every row is one fused kernel call over its weights and optimizer state.
+template<class T>
+void BasicNet<T>::updateLayer(Layer &layer, const OptimizerStepT<T> &step, const T *input, size_t inputStride,
+                              const T *gradients, unsigned gradientStride, T *upstream){
+    const KernelTableT<T> &k = kernelsFor<T>();
+    unsigned size = layer.numInputs;
+    for(unsigned j = 0; j < layer.numNeurons; j++){
+        size_t row = (size_t)j * size;
+        updateRow(k, m_optimizer.kind, step, &layer.weights[row], &layer.deltaWeights[row],
+                  layer.secondMoment != NULL ? &layer.secondMoment[row] : NULL, upstream,
+                  input + j * inputStride, gradients[j * gradientStride], size);
+    }
+}
+
+template<class T>
+void BasicNet<T>::setOptimizer(const OptimizerConfig &config, bool keepState){
+    assert(isValidOptimizer(config.kind));
+    bool changed = config.kind != m_optimizer.kind;
+    m_optimizer = config;
+    if(!changed)
+        return;
+    if(!keepState){
+        std::fill(m_momentum, m_momentum + numParameters(), T(0));
+        m_optimizerSteps = 0;
+    }
+    bool secondMoment = optimizerInfo(config.kind).secondMoment;
+    if(secondMoment != (m_secondMoment != NULL))
+        layoutSecondMoment(secondMoment);
+    else if(secondMoment)
+        std::fill(m_secondMoment, m_secondMoment + numParameters(), T(0));
+}
+
+template<class T>
+void BasicNet<T>::setSecondMoment(const T *values){
+    assert(m_secondMoment != NULL);
+    std::copy(values, values + numParameters(), m_secondMoment);
+}
+
+template<class T>
+void BasicNet<T>::copyWeights(const BasicNet &other){
+    assert(other.m_layers.size() == m_layers.size() && other.numParameters() == numParameters());
+    std::copy(other.m_parameters, other.m_parameters + numParameters(), m_parameters);
+}
+
+template<class T>
+void BasicNet<T>::predictBatch(const float *inputs, size_t count, float *outputs) const{
+    static thread_local PredictWorkspace ws;
+    predictBatch(inputs, count, outputs, ws);
+}
+
+template<class T>
+void BasicNet<T>::predictBatch(const float *inputs, size_t count, float *outputs, PredictWorkspace &ws) const{
+    NN_PROFILE_SCOPE(PROFILE_PREDICT);
+    NN_PROFILE_COUNT(PROFILE_PREDICTED, count);
+    unsigned numLayers = m_layers.size();
+    unsigned numInputs = m_layers[0].numNeurons;
+    unsigned numOutputs = m_layers.back().numNeurons;
+    // The workspace may have been sized for another Net; only ever grow it.
+    size_t size = 0;
+    for(unsigned layerNum = 0; layerNum < numLayers; ++layerNum)
+        size += (size_t)PREDICT_BLOCK * (m_layers[layerNum].numNeurons + 1);
+    if(ws.storage.size() < size)
+        ws.storage.resize(size);
+
+    for(size_t first = 0; first < count; first += PREDICT_BLOCK){
+        unsigned rows = std::min<size_t>(PREDICT_BLOCK, count - first);
+        T *in = ws.storage.data();
+        for(unsigned b = 0; b < rows; b++){
+            loadInputs(&in[(size_t)b * (numInputs + 1)], inputs + (first + b) * numInputs);
+            in[(size_t)b * (numInputs + 1) + numInputs] = T(1);
         }
+        for(unsigned layerNum = 1; layerNum < numLayers; ++layerNum){
+            NN_PROFILE_LAYER(PROFILE_PREDICT, layerNum);
+            const Layer &layer = m_layers[layerNum];
+            unsigned width = layer.numNeurons + 1;
+            T *out = in + (size_t)PREDICT_BLOCK * layer.numInputs;
+            gemm(false, true, rows, layer.numNeurons, layer.numInputs,
+                 in, layer.numInputs,
+                 layer.weights, layer.numInputs,
+                 out, width, false);
+            activateRows(layer, out, rows, width);
+            storeActivations(out, (size_t)rows * width);
+            in = out;
+        }
+        const T *out = in;
+        for(unsigned b = 0; b < rows; b++)
+            for(unsigned j = 0; j < numOutputs; j++)
+                outputs[(first + b) * numOutputs + j] = (float)out[(size_t)b * (numOutputs + 1) + j];
     }
 }
 
-Net::Net(const std::vector<unsigned> &topology){
+template<class T>
+void BasicNet<T>::feedForward(const std::vector<double> &inputVals){
+    NN_PROFILE_SCOPE(PROFILE_FEED_FORWARD);
+    const KernelTableT<T> &k = kernelsFor<T>();
+    assert(inputVals.size() == m_layers[0].numNeurons);
+    loadInputs(m_layers[0].outputVals, inputVals.data());
+    for(unsigned layerNum = 1; layerNum < m_layers.size(); ++layerNum){
+        NN_PROFILE_LAYER(PROFILE_FEED_FORWARD, layerNum);
+        Layer &layer = m_layers[layerNum];
+        const T *prevOut = m_layers[layerNum - 1].outputVals;
+        unsigned size = layer.numInputs;
+        for(unsigned j = 0; j < layer.numNeurons; j++)
+            layer.outputVals[j] = k.dot(prevOut, &layer.weights[j * size], size);
+        activate(layer.activation, layer.outputVals, layer.numNeurons);
+        storeActivations(layer.outputVals, layer.numNeurons);
+    }
+}
+
+template<class T>
+void BasicNet<T>::activateRows(const Layer &layer, T *values, size_t rows, unsigned width) const{
+    if(activationInfo(layer.activation).outputOnly){
+        for(size_t b = 0; b < rows; b++)
+            activate(layer.activation, values + b * width, layer.numNeurons);
+    } else {
+        // One pass over the whole block is cheaper than a call per row.
+        activate(layer.activation, values, rows * width);
+    }
+    for(size_t b = 0; b < rows; b++)
+        values[b * width + layer.numNeurons] = T(1);
+}
+
+template<class T>
+void BasicNet<T>::initLayers(const std::vector<unsigned> &topology, const std::vector<ActivationKind> &activations){
+    assert(validActivations(activations, topology.size()));
     unsigned numLayers = topology.size();
+    m_layers.resize(numLayers);
     for(unsigned layerNum = 0; layerNum < numLayers; ++layerNum){
-        m_layers.push_back(Layer());
-        unsigned numOutputs = layerNum == topology.size() - 1 ? 0 :topology[layerNum + 1];
-        for(unsigned neuronNum = 0; neuronNum <= topology[layerNum]; ++neuronNum){
-            m_layers.back().push_back(Neuron(numOutputs, neuronNum));
-            std::cout << "Mad a Neuron!" << '\n';
+        Layer &layer = m_layers[layerNum];
+        layer.numNeurons = topology[layerNum];
+        layer.activation = activations.empty() ? ACTIVATION_SIGMOID : activations[layerNum];
+        layer.numInputs = layerNum == 0 ? 0 : topology[layerNum - 1] + 1;
+        layer.weights = NULL;
+        layer.deltaWeights = NULL;
+        layer.secondMoment = NULL;
+        layer.outputVals = NULL;
+        layer.gradients = NULL;
+    }
+    m_loss = 0.0;
+    m_recentAverageloss = 0.0;
+}
+
+template<class T>
+T *BasicNet<T>::allocateArena(unsigned parameterBlocks, bool secondMoment){
+    size_t count = numParameters();
+    size_t size = (parameterBlocks + secondMoment) * count;
+    for(unsigned layerNum = 0; layerNum < m_layers.size(); ++layerNum)
+        size += 2 * (size_t)(m_layers[layerNum].numNeurons + 1);
+    m_arena.assign(size, T(0));
+    m_secondMoment = secondMoment ? m_arena.data() + parameterBlocks * count : NULL;
+    T *moment = m_secondMoment;
+    T *state = m_arena.data() + (parameterBlocks + secondMoment) * count;
+    for(unsigned layerNum = 0; layerNum < m_layers.size(); ++layerNum){
+        Layer &layer = m_layers[layerNum];
+        layer.secondMoment = moment;
+        if(moment != NULL)
+            moment += layer.numWeights();
+        layer.outputVals = state;
+        layer.gradients = state + layer.numNeurons + 1;
+        layer.outputVals[layer.numNeurons] = T(1);
+        state += 2 * (size_t)(layer.numNeurons + 1);
+    }
+    return m_arena.data();
+}
+
+template<class T>
+size_t BasicNet<T>::numParameters(void) const{
+    size_t count = 0;
+    for(unsigned layerNum = 0; layerNum < m_layers.size(); ++layerNum)
+        count += m_layers[layerNum].numWeights();
+    return count;
+}
+
+template<class T>
+void BasicNet<T>::bindParameters(T *weights, T *deltaWeights){
+    m_parameters = weights;
+    m_momentum = deltaWeights;
+    for(unsigned layerNum = 0; layerNum < m_layers.size(); ++layerNum){
+        Layer &layer = m_layers[layerNum];
+        layer.weights = weights;
+        layer.deltaWeights = deltaWeights;
+        weights += layer.numWeights();
+        deltaWeights += layer.numWeights();
+    }
+}
+
+// The owned parameter blocks lead the arena, weights before momentum, so
+// which ones there are shows from where the parameters point. The new
+// second moment starts at zero.
+template<class T>
+void BasicNet<T>::layoutSecondMoment(bool secondMoment){
+    size_t count = numParameters();
+    bool ownsWeights = m_parameters == m_arena.data();
+    bool ownsMomentum = m_momentum == m_arena.data() + (ownsWeights ? count : 0);
+    unsigned blocks = ownsWeights + ownsMomentum;
+    size_t stateOffset = (blocks + (m_secondMoment != NULL)) * count;
+    std::vector<T> old;
+    old.swap(m_arena);
+    T *parameters = allocateArena(blocks, secondMoment);
+    std::copy(old.data(), old.data() + blocks * count, parameters);
+    std::copy(old.begin() + stateOffset, old.end(), m_arena.begin() + (blocks + secondMoment) * count);
+    bindParameters(ownsWeights ? parameters : m_parameters,
+                   ownsMomentum ? parameters + (ownsWeights ? count : 0) : m_momentum);
+}
+
+// Draws the initial weights in the order the per-neuron version did: source
+// neuron major, target neuron minor.
+template<class T>
+void BasicNet<T>::initWeights(unsigned seed){
+    std::mt19937 rng(seed);
+    unsigned numLayers = m_layers.size();
+    for(unsigned layerNum = 0; layerNum + 1 < numLayers; ++layerNum){
+        Layer &nextLayer = m_layers[layerNum + 1];
+        for(unsigned neuronNum = 0; neuronNum <= m_layers[layerNum].numNeurons; ++neuronNum){
+            for(unsigned c = 0; c < nextLayer.numNeurons; ++c){
+                double weight = initialWeight(nextLayer.activation, randomWeight(rng),
+                                              nextLayer.numInputs, nextLayer.numNeurons);
+                nextLayer.weights[c * nextLayer.numInputs + neuronNum] = T(weight);
+            }
         }
-        m_layers.back().back().setOutputVal(1.0);
     }
 }
 
+template<class T>
+BasicNet<T>::BasicNet(const std::vector<unsigned> &topology, unsigned seed)
+    : BasicNet(topology, std::vector<ActivationKind>(), seed)
+{
+}
 
+template<class T>
+BasicNet<T>::BasicNet(const std::vector<unsigned> &topology, const std::vector<ActivationKind> &activations,
+                      unsigned seed)
+    : m_optimizerSteps(0), m_activationStorage(ACTIVATIONS_NATIVE)
+{
+    initLayers(topology, activations);
+    size_t count = numParameters();
+    T *parameters = allocateArena(2);
+    bindParameters(parameters, parameters + count);
+    initWeights(seed);
+}
 
-TestData::TestData(const std::string filename){
-    testfile.open(filename.c_str());
+template<class T>
+BasicNet<T>::BasicNet(const std::vector<unsigned> &topology, T *weights, T *deltaWeights,
+                      std::shared_ptr<void> owner, const std::vector<ActivationKind> &activations)
+    : m_owner(owner), m_optimizerSteps(0), m_activationStorage(ACTIVATIONS_NATIVE)
+{
+    initLayers(topology, activations);
+    T *arena = allocateArena(deltaWeights == NULL ? 1 : 0);
+    if(deltaWeights == NULL)
+        deltaWeights = arena;
+    bindParameters(weights, deltaWeights);
+}
+
+template<class T>
+BasicNet<T>::BasicNet(const BasicNet &other)
+    : m_layers(other.m_layers), m_optimizer(other.m_optimizer),
+      m_optimizerSteps(other.m_optimizerSteps), m_activationStorage(other.m_activationStorage),
+      m_inputScaling(other.m_inputScaling), m_inputOffset(other.m_inputOffset), m_inputScale(other.m_inputScale),
+      m_loss(other.m_loss), m_recentAverageloss(other.m_recentAverageloss)
+{
+    size_t count = other.numParameters();
+    T *parameters = allocateArena(2, other.m_secondMoment != NULL);
+    std::copy(other.parameters(), other.parameters() + count, parameters);
+    std::copy(other.momentum(), other.momentum() + count, parameters + count);
+    bindParameters(parameters, parameters + count);
+    if(other.m_secondMoment != NULL)
+        std::copy(other.m_secondMoment, other.m_secondMoment + count, m_secondMoment);
+    for(unsigned layerNum = 0; layerNum < m_layers.size(); ++layerNum){
+        const Layer &from = other.m_layers[layerNum];
+        std::copy(from.outputVals, from.outputVals + from.numNeurons + 1, m_layers[layerNum].outputVals);
+        std::copy(from.gradients, from.gradients + from.numNeurons + 1, m_layers[layerNum].gradients);
+    }
+}
+
+template<class T>
+BasicNet<T> &BasicNet<T>::operator=(const BasicNet &other){
+    if(this != &other)
+        *this = BasicNet(other);
+    return *this;
+}
+
+template class BasicNet<double>;
+template class BasicNet<float>;
+
+
+
+TestData::TestData(const std::string filename) : m_nextSample(0){
+    if(MappedDataset::isBinary(filename)){
+        m_binary.reset(new MappedDataset(filename));
+        if(!m_binary->isOpen())
+            abort();
+        return;
+    }
+    m_text.reset(new FastTextReader(filename));
 }
 
 unsigned TestData::getNextInputs(std::vector<double> &inputVals){
+    NN_PROFILE_SCOPE(PROFILE_PARSE);
     inputVals.clear();
-    std::string line, label;
-    getline(testfile, line);
-    std::stringstream ss(line);
-    ss >> label;
-    if(label.compare("in:") == 0){
-        double oneValue;
-        while(ss >> oneValue)
-            inputVals.push_back(oneValue);
+    if(m_binary){
+        if(m_nextSample < m_binary->size())
+            m_binary->getInputs(m_nextSample, inputVals);
+        return inputVals.size();
     }
-    return inputVals.size();
+    return m_text->readValues("in:", inputVals);
 }
 
 unsigned TestData::getTargetOutputs(std::vector<double> &targetOutputVals){
+    NN_PROFILE_SCOPE(PROFILE_PARSE);
+    NN_PROFILE_COUNT(PROFILE_PARSED, 1);
     targetOutputVals.clear();
-    std::string line, label;
-    getline(testfile, line);
-    std::stringstream ss(line);
-    ss >> label;
-    if(label.compare("out:") == 0){
-        double oneValue;
-        while(ss >> oneValue)
-            targetOutputVals.push_back(oneValue);
-    }
-    return targetOutputVals.size();
+    if(m_binary){
+        if(m_nextSample < m_binary->size())
+            m_binary->getTargets(m_nextSample++, targetOutputVals);
+        return targetOutputVals.size();
+    }
+    return m_text->readValues("out:", targetOutputVals);
 }
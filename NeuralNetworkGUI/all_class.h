@@ -3,75 +3,317 @@
 
 
 #include<bits/stdc++.h>
+#include "dataset.h"
+#include "text_reader.h"
+#include "activations.h"
+#include "optimizer.h"
+#include "normalizer.h"
 
-class TrainingData{
+// Anything the training and test loops can pull in:/out: pairs from.
+class SampleSource{
+public:
+    virtual ~SampleSource() {}
+    virtual bool isEof(void) = 0;
+    virtual unsigned getNextInputs(std::vector<double> &inputVals) = 0;
+    virtual unsigned getTargetOutputs(std::vector<double> &targetOutputVals) = 0;
+};
+
+// Reads the topology:/in:/out: text format, or a binary dataset written by
+// tools/convert_dataset when the file starts with DATASET_MAGIC.
+class TrainingData : public SampleSource{
 public:
     TrainingData(const std::string filename);
     bool isEof(void) {
-        return m_trainingDataFile.eof();
+        if(m_binary)
+            return m_nextSample >= m_binary->size();
+        return m_text->isEof();
     }
     void getTopology(std::vector<unsigned> &topology);
+    // Per-layer activations from the topology line; valid after getTopology.
+    void getActivations(std::vector<ActivationKind> &activations) const { activations = m_activations; }
     unsigned getNextInputs(std::vector<double> &inputVals);
     unsigned getTargetOutputs(std::vector<double> &targetOutputVals);
+    // The mapping behind a binary file, NULL for text input.
+    const MappedDataset *binaryData(void) const { return m_binary.get(); }
 private:
-    std::ifstream m_trainingDataFile;
+    std::unique_ptr<FastTextReader> m_text;
+    std::unique_ptr<MappedDataset> m_binary;
+    std::vector<ActivationKind> m_activations;
+    size_t m_nextSample;
 };
 
 
 
-struct Connection {double weight, deltaWeight;};
-class Neuron;
-typedef std::vector<Neuron> Layer;
-class Neuron {
-public:
-    Neuron(unsigned numOutputs, unsigned myIndex);
-    void setOutputVal(double val) { m_outputVal = val; }
-    double getOutputVal(void) const { return m_outputVal; }
-    void feedForward(const Layer &prevLayer, int layernum, int totalLayer);
-    void calcOutputGradients(double targetVals);
-    void calcHiddenGradients(const Layer &nextLayer);
-    void updateInputWeights(Layer &prevLayer);
+// Each layer keeps its parameters and per-sample state in contiguous
+// row-major buffers. Row j of weights/deltaWeights holds every input weight
+// of neuron j (bias input last), so the forward dot product and the
+// row-wise gradient back-projection both walk memory sequentially.
+//
+// weights and deltaWeights point into one parameter block owned by the Net
+// (or a checkpoint mapping it keeps alive): every layer's weights back to
+// back, then every layer's deltaWeights in the same order. outputVals and
+// gradients point into the same arena, after the parameters.
+//
+// T is the compute type of the whole net, double or float (see BasicNet).
+template<class T>
+struct BasicLayer {
+    unsigned numInputs;  // neurons in the previous layer, bias included
+    unsigned numNeurons; // neurons in this layer, bias excluded
+    ActivationKind activation; // unused for the input layer
+    T *weights;      // numNeurons x numInputs
+    T *deltaWeights; // numNeurons x numInputs
+    T *secondMoment; // numNeurons x numInputs, Adam/AdamW only, else NULL
+    size_t numWeights(void) const { return (size_t)numNeurons * numInputs; }
+    T *outputVals;   // numNeurons + 1, bias output last
+    T *gradients;    // numNeurons + 1
+};
 
-private:
-    static double sigmoid(double x);
-    static double sigmoidDerivative(double x);
-    static double transferFunction(double x);
-    static double transferFunctionDerivative(double x);
-    static double randomWeight(void) { return rand() / double(RAND_MAX); }
-    double sumDOW(const Layer &nextLayer) const;
-    double m_outputVal;
-    std::vector<Connection> m_outputWeights;
-    unsigned m_myIndex;
-    double m_gradient;
+// Scratch for the batched passes, one entry per layer. Net::trainBatch keeps
+// its own; every shard of a ParallelTrainer has one, so workers never share
+// mutable state while computing gradients.
+//
+// The per-layer pointers lead into storage, one block sized on first use
+// and only regrown for a larger batch: every layer's weightGradients back to
+// back in the parameters() layout (so the shards' sums reduce as one
+// array), then the outputs and gradients. Moving keeps the pointers valid;
+// copying would not, so workspaces are move-only.
+template<class T>
+struct BasicBatchWorkspace {
+    unsigned capacity;
+    std::vector<T> storage;
+    std::vector<T *> outputs;         // batchSize x (numNeurons + 1), bias column last
+    std::vector<T *> gradients;       // batchSize x (numNeurons + 1)
+    std::vector<T *> weightGradients; // numNeurons x numInputs, summed over the batch
+    std::vector<double> losses;       // RMS loss of every sample
+    BasicBatchWorkspace() : capacity(0) {}
+    BasicBatchWorkspace(BasicBatchWorkspace &&) = default;
+    BasicBatchWorkspace &operator=(BasicBatchWorkspace &&) = default;
+};
+
+// Activations for Net::predictBatch, one block of PREDICT_BLOCK x
+// (numNeurons + 1) values per layer, back to back in one buffer. Owned by
+// the caller (or thread-local), so a const Net can be shared by any number
+// of predicting threads; it only ever grows, so after the first call with
+// the largest Net it is reused without allocating.
+template<class T>
+struct BasicPredictWorkspace {
+    std::vector<T> storage;
 };
 
-#define eta 0.15
-#define alpha 0.5
+// Samples predictBatch pushes through the layers at a time; its activations
+// stay in cache between the layer GEMMs.
+#define PREDICT_BLOCK 256
+
+// How activations are kept between layers. The 16-bit modes round every
+// layer's outputs to bf16 or IEEE half as they are written, so the next
+// layer (and the backward pass) sees exactly what 16-bit activation storage
+// would give it, while the weights and their updates stay in T.
+enum ActivationStorage {
+    ACTIVATIONS_NATIVE,
+    ACTIVATIONS_BF16,
+    ACTIVATIONS_FP16
+};
 
 
 // ****************** class Net ******************
-class Net{
+// Net is BasicNet<double>; FloatNet does the same work in single precision,
+// with twice the SIMD lanes and half the weight and momentum traffic. Both
+// take and return samples as double (float for predictBatch) and keep the
+// loss statistics in double, so they plug into the same loops.
+//
+// A Net makes two allocations however large it is: the layer table and one
+// zeroed arena holding the parameters it owns, Adam's second moment when the
+// optimizer needs one, and every layer's per-sample state. Switching
+// setOptimizer to or from such a rule replaces the arena with one laid out
+// for it (a single allocation, still two live). feedForward, backProp and
+// getResults (into a vector that already has room) then never allocate;
+// trainBatch and predictBatch only do so the first time they see a larger
+// batch or Net. tools/alloc_check counts it.
+template<class T>
+class BasicNet{
 public:
-    Net(const std::vector<unsigned> &topology);
+    typedef T Scalar;
+    typedef BasicLayer<T> Layer;
+    typedef BasicBatchWorkspace<T> BatchWorkspace;
+    typedef BasicPredictWorkspace<T> PredictWorkspace;
+    // Initial weights come from a generator owned by this constructor, so a
+    // given seed builds the same network on any thread. activations has one
+    // entry per layer (see validActivations); empty means all sigmoid.
+    BasicNet(const std::vector<unsigned> &topology, unsigned seed = 1);
+    BasicNet(const std::vector<unsigned> &topology, const std::vector<ActivationKind> &activations,
+             unsigned seed = 1);
+    // A net whose weights (and deltaWeights, unless NULL) live in memory the
+    // caller provides, laid out as parameters() describes. owner keeps that
+    // memory alive for as long as this Net or anything sharing it exists.
+    BasicNet(const std::vector<unsigned> &topology, T *weights, T *deltaWeights,
+             std::shared_ptr<void> owner,
+             const std::vector<ActivationKind> &activations = std::vector<ActivationKind>());
+    // Copies always own their parameters.
+    BasicNet(const BasicNet &other);
+    BasicNet &operator=(const BasicNet &other);
+    BasicNet(BasicNet &&) = default;
+    BasicNet &operator=(BasicNet &&) = default;
+    // Converts another precision's weights, momentum and loss state.
+    template<class U> explicit BasicNet(const BasicNet<U> &other);
     void feedForward(const std::vector<double> &inputVals);
+    // One sweep from the output layer down: each layer's weights are read
+    // once, back-projecting the gradient and applying the update together.
     void backProp(const std::vector<double> &targetVals);
+    // The three-pass backProp the fused sweep replaced (output gradients,
+    // every hidden gradient, then every update), bit for bit the same
+    // results. The reference for tools/gradient_check and bench/backprop_bench.
+    void backPropUnfused(const std::vector<double> &targetVals);
+    // One forward/backward pass over batchSize samples stored row after row,
+    // then a single optimizer update with the batch-averaged gradient.
+    void trainBatch(const std::vector<double> &inputs, const std::vector<double> &targets,
+                    unsigned batchSize);
+    void trainBatch(const double *inputs, const double *targets, unsigned batchSize);
+    // The two halves of trainBatch. computeGradients only reads the weights,
+    // so any number of threads may run it at once on separate workspaces.
+    void prepareWorkspace(BatchWorkspace &ws, unsigned batchSize) const;
+    void computeGradients(const double *inputs, const double *targets, unsigned batchSize,
+                          BatchWorkspace &ws) const;
+    void applyGradients(const BatchWorkspace &ws, double scale);
+    void recordLosses(const double *losses, unsigned count);
+    // Forward pass over count samples stored row after row; writes
+    // count x outputs results. Reads nothing but the weights and ws, so it may
+    // run on many threads at once. The overload without a workspace uses a
+    // thread-local one.
+    void predictBatch(const float *inputs, size_t count, float *outputs, PredictWorkspace &ws) const;
+    void predictBatch(const float *inputs, size_t count, float *outputs) const;
     void getResults(std::vector<double> &resultVals) const;
+    void getTopology(std::vector<unsigned> &topology) const;
+    void getActivations(std::vector<ActivationKind> &activations) const;
     double getRecentAverageloss(void) const { return m_recentAverageloss; }
+    // The parameter block: numParameters() weights, layer 1 first, and the
+    // matching deltaWeights.
+    size_t numParameters(void) const;
+    const T *parameters(void) const { return m_parameters; }
+    const T *momentum(void) const { return m_momentum; }
+    // Loss state for resuming training exactly where a checkpoint left off.
+    double getLoss(void) const { return m_loss; }
+    void setLossState(double loss, double recentAverageloss) { m_loss = loss; m_recentAverageloss = recentAverageloss; }
+    ActivationStorage activationStorage(void) const { return m_activationStorage; }
+    void setActivationStorage(ActivationStorage storage) { m_activationStorage = storage; }
+    // Applied to every sample as it is copied into the first layer
+    // (feedForward, computeGradients and predictBatch), in the same pass as
+    // the conversion to T, and saved with checkpoints; callers always pass
+    // raw inputs. None until set.
+    void setInputScaling(const InputScaling &scaling);
+    const InputScaling &inputScaling(void) const { return m_inputScaling; }
+    // The update rule backProp and applyGradients use (see optimizer.h);
+    // momentum SGD with eta and alpha until set. Changing only the
+    // hyperparameters keeps the optimizer state. Changing the kind clears it
+    // unless keepState (a checkpoint restoring its own state), and sizes the
+    // second-moment buffer for the new kind either way.
+    void setOptimizer(const OptimizerConfig &config, bool keepState = false);
+    const OptimizerConfig &optimizer(void) const { return m_optimizer; }
+    // Updates applied so far: the t of the schedule and of Adam's bias
+    // correction, saved with checkpoints.
+    unsigned long long optimizerSteps(void) const { return m_optimizerSteps; }
+    void setOptimizerSteps(unsigned long long steps) { m_optimizerSteps = steps; }
+    // Adam's second-moment estimates, laid out as parameters(); NULL for
+    // the other rules. setSecondMoment copies numParameters() values in.
+    const T *secondMoment(void) const { return m_secondMoment; }
+    void setSecondMoment(const T *values);
+    // Overwrites the weights with those of other, which has the same
+    // topology, without allocating. Momentum, optimizer, scaling and loss
+    // state stay as they are: enough to refresh a copy that only predicts.
+    void copyWeights(const BasicNet &other);
 private:
+    void initLayers(const std::vector<unsigned> &topology, const std::vector<ActivationKind> &activations);
+    // Sizes the arena for parameterBlocks copies of the parameters, then the
+    // second moment if secondMoment, then every layer's outputVals and
+    // gradients, all zero but the bias outputs, and points the layers at
+    // their state. Returns the start of the parameter blocks.
+    T *allocateArena(unsigned parameterBlocks, bool secondMoment = false);
+    // Moves into a new arena with or without the second-moment block,
+    // keeping the owned parameters and the per-layer state.
+    void layoutSecondMoment(bool secondMoment);
+    void initWeights(unsigned seed);
+    void bindParameters(T *weights, T *deltaWeights);
+    // One optimizer step over layer: row j moves along input row j (input
+    // itself when inputStride is 0) times gradients[j * gradientStride].
+    // Unless upstream is NULL, also accumulates the rows' back-projected
+    // gradient into it, from the weights as they were before the step.
+    void updateLayer(Layer &layer, const OptimizerStepT<T> &step, const T *input, size_t inputStride,
+                     const T *gradients, unsigned gradientStride, T *upstream);
+    // Loss statistics and output-layer gradients, the start of both backProps.
+    void outputLayerGradients(const std::vector<double> &targetVals);
+    void storeActivations(T *values, size_t count) const;
+    // One sample into the first layer's row, through the input scaling.
+    void loadInputs(T *row, const double *inputs) const;
+    void loadInputs(T *row, const float *inputs) const;
+    // Applies layer's transfer function to rows of width values (numNeurons
+    // outputs, then the bias column, which is reset to 1).
+    void activateRows(const Layer &layer, T *values, size_t rows, unsigned width) const;
+    static double randomWeight(std::mt19937 &rng) { return rng() / double(std::mt19937::max()); }
+    double sampleLoss(const T *outputs, const double *targets) const;
     std::vector<Layer> m_layers;
+    std::vector<T> m_arena;          // owned parameters, if any, the second moment, then per-layer state
+    std::shared_ptr<void> m_owner;   // keeps external parameters alive
+    T *m_parameters;
+    T *m_momentum;
+    T *m_secondMoment;               // Adam/AdamW state in the arena, parameters() layout, else NULL
+    OptimizerConfig m_optimizer;
+    unsigned long long m_optimizerSteps;
+    BatchWorkspace m_workspace;
+    ActivationStorage m_activationStorage;
+    InputScaling m_inputScaling;
+    std::vector<T> m_inputOffset;    // m_inputScaling in T, for the kernels
+    std::vector<T> m_inputScale;
     double m_loss;
     double m_recentAverageloss;
     static double m_recentAverageSmoothingFactor;
 };
 
+template<class T> template<class U>
+BasicNet<T>::BasicNet(const BasicNet<U> &other)
+    : m_optimizer(other.optimizer()), m_optimizerSteps(other.optimizerSteps()),
+      m_activationStorage(other.activationStorage())
+{
+    std::vector<unsigned> topology;
+    std::vector<ActivationKind> activations;
+    other.getTopology(topology);
+    other.getActivations(activations);
+    initLayers(topology, activations);
+    size_t count = numParameters();
+    T *parameters = allocateArena(2, other.secondMoment() != NULL);
+    std::copy(other.parameters(), other.parameters() + count, parameters);
+    std::copy(other.momentum(), other.momentum() + count, parameters + count);
+    bindParameters(parameters, parameters + count);
+    if(other.secondMoment() != NULL)
+        std::copy(other.secondMoment(), other.secondMoment() + count, m_secondMoment);
+    setInputScaling(other.inputScaling());
+    setLossState(other.getLoss(), other.getRecentAverageloss());
+}
+
+typedef BasicNet<double> Net;
+typedef BasicNet<float> FloatNet;
+typedef Net::Layer Layer;
+typedef Net::BatchWorkspace BatchWorkspace;
+typedef Net::PredictWorkspace PredictWorkspace;
+
+// Both precisions are compiled once, in all_class.cpp.
+extern template class BasicNet<double>;
+extern template class BasicNet<float>;
 
-class TestData{
+
+class TestData : public SampleSource{
 public:
     TestData(const std::string filename);
-    bool isEof(void) { return testfile.eof(); }
+    bool isEof(void) {
+        if(m_binary)
+            return m_nextSample >= m_binary->size();
+        return m_text->isEof();
+    }
     unsigned getNextInputs(std::vector<double> &inputVals);
     unsigned getTargetOutputs(std::vector<double> &targetOutputVals);
-    std::ifstream testfile;
+    const MappedDataset *binaryData(void) const { return m_binary.get(); }
+private:
+    std::unique_ptr<FastTextReader> m_text;
+    std::unique_ptr<MappedDataset> m_binary;
+    size_t m_nextSample;
 };
 
 
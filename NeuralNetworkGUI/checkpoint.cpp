@@ -0,0 +1,354 @@
+#include "checkpoint.h"
+#include "profiler.h"
+
+#ifdef _WIN32
+#include<windows.h>
+#else
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<unistd.h>
+#endif
+
+// The header up to the fields versions 2, 3 and 4 added.
+#define CHECKPOINT_V1_HEADER_SIZE offsetof(CheckpointHeader, activations)
+#define CHECKPOINT_V2_HEADER_SIZE offsetof(CheckpointHeader, optimizer)
+#define CHECKPOINT_V3_HEADER_SIZE offsetof(CheckpointHeader, scaling)
+
+static size_t headerSize(uint32_t version){
+    switch(version){
+    case 1: return CHECKPOINT_V1_HEADER_SIZE;
+    case 2: return CHECKPOINT_V2_HEADER_SIZE;
+    case 3: return CHECKPOINT_V3_HEADER_SIZE;
+    default: return sizeof(CheckpointHeader);
+    }
+}
+
+// Whether count doubles at offset lie aligned inside a mapping of length
+// bytes, without letting a crafted offset or count wrap around.
+static bool blockFits(uint64_t offset, uint64_t count, uint64_t length){
+    uint64_t bytes, end;
+    return offset % sizeof(double) == 0 && !__builtin_mul_overflow(count, sizeof(double), &bytes)
+           && !__builtin_add_overflow(offset, bytes, &end) && end <= length;
+}
+
+static uint64_t alignUp(uint64_t offset){
+    return (offset + 63) & ~(uint64_t)63;
+}
+
+static bool writeCheckpointFile(const std::string &filename, const std::vector<unsigned> &topology,
+                                const std::vector<ActivationKind> &activations, const double *weights, const double *deltaWeights,
+                                const double *secondMoment, size_t count, const InputScaling &scaling,
+                                const OptimizerConfig &optimizer, unsigned long long optimizerSteps, double loss, double recentAverageLoss,
+                                unsigned long long samplesSeen){
+    NN_PROFILE_SCOPE(PROFILE_CHECKPOINT);
+    if(topology.size() > CHECKPOINT_MAX_LAYERS)
+        return false;
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.flags = (deltaWeights != NULL ? CHECKPOINT_MOMENTUM : 0) | (secondMoment != NULL ? CHECKPOINT_SECOND_MOMENT : 0);
+    header.numLayers = topology.size();
+    std::copy(topology.begin(), topology.end(), header.topology);
+    std::copy(activations.begin(), activations.end(), header.activations);
+    header.learningRate = optimizer.learningRate;
+    header.momentumRate = optimizer.momentum;
+    header.optimizer = optimizer.kind;
+    header.schedule = optimizer.schedule;
+    header.optimizerSteps = optimizerSteps;
+    header.beta1 = optimizer.beta1;
+    header.beta2 = optimizer.beta2;
+    header.rmsDecay = optimizer.rmsDecay;
+    header.epsilon = optimizer.epsilon;
+    header.weightDecay = optimizer.weightDecay;
+    header.decayRate = optimizer.decayRate;
+    header.minLearningRate = optimizer.minLearningRate;
+    header.decaySteps = optimizer.decaySteps;
+    header.warmupSteps = optimizer.warmupSteps;
+    header.loss = loss;
+    header.recentAverageLoss = recentAverageLoss;
+    header.samplesSeen = samplesSeen;
+    header.numParameters = count;
+    header.weightsOffset = alignUp(sizeof(header));
+    header.momentumOffset = deltaWeights != NULL ? alignUp(header.weightsOffset + count * sizeof(double)) : 0;
+    header.secondMomentOffset = secondMoment != NULL ? alignUp(header.momentumOffset + count * sizeof(double)) : 0;
+    uint64_t end = (secondMoment != NULL ? header.secondMomentOffset : deltaWeights != NULL ? header.momentumOffset
+                                                                                            : header.weightsOffset)
+                   + count * sizeof(double);
+    header.scaling = scaling.kind;
+    header.scalingOffset = scaling.empty() ? 0 : alignUp(end);
+
+    std::string temporary = filename + ".tmp";
+    FILE *out = fopen(temporary.c_str(), "wb");
+    if(out == NULL)
+        return false;
+    static const char zeros[64] = {};
+    bool failed = fwrite(&header, sizeof(header), 1, out) != 1;
+    size_t padding = header.weightsOffset - sizeof(header);
+    failed |= fwrite(zeros, 1, padding, out) != padding;
+    failed |= fwrite(weights, sizeof(double), count, out) != count;
+    if(deltaWeights != NULL){
+        padding = header.momentumOffset - (header.weightsOffset + count * sizeof(double));
+        failed |= fwrite(zeros, 1, padding, out) != padding;
+        failed |= fwrite(deltaWeights, sizeof(double), count, out) != count;
+    }
+    if(secondMoment != NULL){
+        padding = header.secondMomentOffset - (header.momentumOffset + count * sizeof(double));
+        failed |= fwrite(zeros, 1, padding, out) != padding;
+        failed |= fwrite(secondMoment, sizeof(double), count, out) != count;
+    }
+    if(!scaling.empty()){
+        size_t n = scaling.numInputs();
+        padding = header.scalingOffset - end;
+        failed |= fwrite(zeros, 1, padding, out) != padding;
+        failed |= fwrite(scaling.offset.data(), sizeof(double), n, out) != n;
+        failed |= fwrite(scaling.scale.data(), sizeof(double), n, out) != n;
+    }
+    failed |= fclose(out) != 0;
+    if(failed){
+        remove(temporary.c_str());
+        return false;
+    }
+#ifdef _WIN32
+    // rename() does not replace an existing file on Windows.
+    return MoveFileExA(temporary.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(temporary.c_str(), filename.c_str()) == 0;
+#endif
+}
+
+bool saveCheckpoint(const Net &net, const std::string &filename, unsigned long long samplesSeen, bool momentum){
+    std::vector<unsigned> topology;
+    std::vector<ActivationKind> activations;
+    net.getTopology(topology);
+    net.getActivations(activations);
+    return writeCheckpointFile(filename, topology, activations, net.parameters(), momentum ? net.momentum() : NULL,
+                               momentum ? net.secondMoment() : NULL, net.numParameters(), net.inputScaling(), net.optimizer(),
+                               net.optimizerSteps(), net.getLoss(), net.getRecentAverageloss(), samplesSeen);
+}
+
+// A private (copy-on-write) mapping of a whole file.
+struct CheckpointMapping {
+    char *data;
+    size_t length;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+    CheckpointMapping() : data(NULL), length(0), file(INVALID_HANDLE_VALUE), mapping(NULL) {}
+#else
+    CheckpointMapping() : data(NULL), length(0) {}
+#endif
+    ~CheckpointMapping(){
+#ifdef _WIN32
+        if(data != NULL)
+            UnmapViewOfFile(data);
+        if(mapping != NULL)
+            CloseHandle(mapping);
+        if(file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+#else
+        if(data != NULL)
+            munmap(data, length);
+#endif
+    }
+    bool open(const std::string &filename){
+#ifdef _WIN32
+        file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if(file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER size;
+        if(!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)CHECKPOINT_V1_HEADER_SIZE)
+            return false;
+        mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+        if(mapping == NULL)
+            return false;
+        data = (char *)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+        if(data == NULL)
+            return false;
+        length = size.QuadPart;
+#else
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if(fd < 0)
+            return false;
+        struct stat st;
+        if(fstat(fd, &st) != 0 || st.st_size < (off_t)CHECKPOINT_V1_HEADER_SIZE){
+            ::close(fd);
+            return false;
+        }
+        void *p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if(p == MAP_FAILED)
+            return false;
+        data = (char *)p;
+        length = st.st_size;
+#endif
+        return true;
+    }
+};
+
+std::unique_ptr<Net> loadCheckpoint(const std::string &filename, CheckpointHeader *header){
+    std::shared_ptr<CheckpointMapping> mapping(new CheckpointMapping);
+    if(!mapping->open(filename))
+        return std::unique_ptr<Net>();
+    const CheckpointHeader *h = (const CheckpointHeader *)mapping->data;
+    if(memcmp(h->magic, CHECKPOINT_MAGIC, sizeof(h->magic)) != 0
+       || h->version < 1 || h->version > CHECKPOINT_VERSION
+       || (h->version == 1 && h->activation != ACTIVATION_SIGMOID)
+       || mapping->length < headerSize(h->version)
+       || (h->version >= 3 && (!isValidOptimizer(h->optimizer) || h->schedule > SCHEDULE_COSINE))
+       || h->numLayers < 2 || h->numLayers > CHECKPOINT_MAX_LAYERS)
+        return std::unique_ptr<Net>();
+    std::vector<unsigned> topology(h->topology, h->topology + h->numLayers);
+    std::vector<ActivationKind> activations;
+    if(h->version >= 2){
+        for(unsigned layerNum = 0; layerNum < h->numLayers; ++layerNum){
+            if(!isValidActivation(h->activations[layerNum]))
+                return std::unique_ptr<Net>();
+            activations.push_back((ActivationKind)h->activations[layerNum]);
+        }
+        if(!validActivations(activations, topology.size()))
+            return std::unique_ptr<Net>();
+    }
+    uint64_t count = 0;
+    for(unsigned layerNum = 0; layerNum < topology.size(); layerNum++){
+        uint64_t layerCount;
+        if(topology[layerNum] == 0)
+            return std::unique_ptr<Net>();
+        if(layerNum == 0)
+            continue;
+        if(__builtin_mul_overflow((uint64_t)topology[layerNum], (uint64_t)topology[layerNum - 1] + 1, &layerCount)
+           || __builtin_add_overflow(count, layerCount, &count))
+            return std::unique_ptr<Net>();
+    }
+    bool momentum = (h->flags & CHECKPOINT_MOMENTUM) != 0;
+    bool secondMoment = h->version >= 3 && (h->flags & CHECKPOINT_SECOND_MOMENT) != 0;
+    if(count != h->numParameters
+       || !blockFits(h->weightsOffset, count, mapping->length)
+       || (momentum && !blockFits(h->momentumOffset, count, mapping->length))
+       || (secondMoment && (!blockFits(h->secondMomentOffset, count, mapping->length)
+                            || !optimizerInfo((OptimizerKind)h->optimizer).secondMoment)))
+        return std::unique_ptr<Net>();
+    InputScaling scaling;
+    if(h->version >= 4 && h->scaling != SCALING_NONE){
+        if(h->scaling >= SCALING_COUNT || !blockFits(h->scalingOffset, 2 * (uint64_t)topology[0], mapping->length))
+            return std::unique_ptr<Net>();
+        const double *values = (const double *)(mapping->data + h->scalingOffset);
+        scaling.kind = (ScalingKind)h->scaling;
+        scaling.offset.assign(values, values + topology[0]);
+        scaling.scale.assign(values + topology[0], values + 2 * topology[0]);
+    }
+
+    double *weights = (double *)(mapping->data + h->weightsOffset);
+    double *deltaWeights = momentum ? (double *)(mapping->data + h->momentumOffset) : NULL;
+    std::unique_ptr<Net> net(new Net(topology, weights, deltaWeights, mapping, activations));
+    net->setLossState(h->loss, h->recentAverageLoss);
+    net->setInputScaling(scaling);
+    OptimizerConfig optimizer;
+    optimizer.learningRate = h->learningRate;
+    optimizer.momentum = h->momentumRate;
+    if(h->version >= 3){
+        optimizer.kind = (OptimizerKind)h->optimizer;
+        optimizer.schedule = (ScheduleKind)h->schedule;
+        optimizer.beta1 = h->beta1;
+        optimizer.beta2 = h->beta2;
+        optimizer.rmsDecay = h->rmsDecay;
+        optimizer.epsilon = h->epsilon;
+        optimizer.weightDecay = h->weightDecay;
+        optimizer.decayRate = h->decayRate;
+        optimizer.minLearningRate = h->minLearningRate;
+        optimizer.decaySteps = h->decaySteps;
+        optimizer.warmupSteps = h->warmupSteps;
+    }
+    net->setOptimizer(optimizer, true);
+    if(h->version >= 3)
+        net->setOptimizerSteps(h->optimizerSteps);
+    // Adam's second moment is copied rather than mapped; it is only
+    // training state.
+    if(secondMoment)
+        net->setSecondMoment((const double *)(mapping->data + h->secondMomentOffset));
+    if(header != NULL){
+        memset(header, 0, sizeof(*header));
+        memcpy(header, h, headerSize(h->version));
+    }
+    return net;
+}
+
+CheckpointWriter::CheckpointWriter(const std::string &filename, bool momentum)
+    : m_filename(filename), m_momentum(momentum), m_hasPending(false), m_busy(false),
+      m_failed(false), m_stop(false), m_written(0)
+{
+    m_writer = std::thread(&CheckpointWriter::writerLoop, this);
+}
+
+CheckpointWriter::~CheckpointWriter(){
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_one();
+    m_writer.join();
+}
+
+void CheckpointWriter::save(const Net &net, unsigned long long samplesSeen){
+    NN_PROFILE_SCOPE(PROFILE_CHECKPOINT);
+    size_t count = net.numParameters();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        net.getTopology(m_pending.topology);
+        net.getActivations(m_pending.activations);
+        m_pending.weights.assign(net.parameters(), net.parameters() + count);
+        if(m_momentum){
+            m_pending.deltaWeights.assign(net.momentum(), net.momentum() + count);
+            if(net.secondMoment() != NULL)
+                m_pending.secondMoment.assign(net.secondMoment(), net.secondMoment() + count);
+            else
+                m_pending.secondMoment.clear();
+        }
+        m_pending.scaling = net.inputScaling();
+        m_pending.optimizer = net.optimizer();
+        m_pending.optimizerSteps = net.optimizerSteps();
+        m_pending.loss = net.getLoss();
+        m_pending.recentAverageLoss = net.getRecentAverageloss();
+        m_pending.samplesSeen = samplesSeen;
+        m_hasPending = true;
+    }
+    m_wake.notify_one();
+}
+
+bool CheckpointWriter::wait(void){
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]{ return !m_hasPending && !m_busy; });
+    return !m_failed;
+}
+
+unsigned long long CheckpointWriter::written(void) const{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_written;
+}
+
+void CheckpointWriter::writerLoop(void){
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(true){
+        m_wake.wait(lock, [this]{ return m_hasPending || m_stop; });
+        if(!m_hasPending)
+            break;
+        // Swap rather than copy, so save() can fill the other buffer while
+        // this one is written.
+        std::swap(m_pending, m_writing);
+        m_hasPending = false;
+        m_busy = true;
+        lock.unlock();
+        bool ok = writeCheckpointFile(m_filename, m_writing.topology, m_writing.activations, m_writing.weights.data(),
+                                      m_momentum ? m_writing.deltaWeights.data() : NULL,
+                                      m_momentum && !m_writing.secondMoment.empty() ? m_writing.secondMoment.data() : NULL,
+                                      m_writing.weights.size(), m_writing.scaling, m_writing.optimizer, m_writing.optimizerSteps,
+                                      m_writing.loss, m_writing.recentAverageLoss, m_writing.samplesSeen);
+        lock.lock();
+        m_busy = false;
+        m_failed |= !ok;
+        m_written++;
+        m_idle.notify_all();
+    }
+}
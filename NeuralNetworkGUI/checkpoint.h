@@ -0,0 +1,124 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+
+#include "all_class.h"
+
+// Binary model checkpoint, little-endian:
+//
+//   CheckpointHeader
+//   weights       numParameters doubles at weightsOffset, laid out as
+//                 Net::parameters() (layer 1 first, row-major)
+//   deltaWeights  the same again at momentumOffset, if CHECKPOINT_MOMENTUM
+//                 (the optimizer's first state buffer)
+//   secondMoment  the same again at secondMomentOffset, if
+//                 CHECKPOINT_SECOND_MOMENT (Adam/AdamW)
+//   scaling       the input scaling's offsets, then its scales, one double
+//                 per input each, at scalingOffset unless scaling is
+//                 SCALING_NONE
+//
+// Every block starts on a 64-byte boundary so the loader can map the file and
+// point the layers straight at it.
+#define CHECKPOINT_MAGIC "NNMODEL\n"
+#define CHECKPOINT_VERSION 4
+#define CHECKPOINT_MAX_LAYERS 32
+
+enum CheckpointFlags { CHECKPOINT_MOMENTUM = 1, CHECKPOINT_SECOND_MOMENT = 2 };
+
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;               // CheckpointFlags
+    uint32_t activation;          // version 1 only: always ACTIVATION_SIGMOID
+    uint32_t numLayers;
+    uint32_t topology[CHECKPOINT_MAX_LAYERS];
+    double learningRate;          // OptimizerConfig learningRate and momentum
+    double momentumRate;          // (eta and alpha before version 3)
+    double loss;                  // Net loss state, restored on load
+    double recentAverageLoss;
+    uint64_t samplesSeen;         // training samples consumed when saved
+    uint64_t numParameters;
+    uint64_t weightsOffset;
+    uint64_t momentumOffset;      // 0 without CHECKPOINT_MOMENTUM
+    // Version 2 on. Version 1 files end the header here and are all sigmoid.
+    uint32_t activations[CHECKPOINT_MAX_LAYERS]; // ActivationKind per layer
+    // Version 3 on. Older files were all trained with momentum SGD.
+    uint32_t optimizer;           // OptimizerKind
+    uint32_t schedule;            // ScheduleKind
+    uint64_t optimizerSteps;
+    double beta1;
+    double beta2;
+    double rmsDecay;
+    double epsilon;
+    double weightDecay;
+    double decayRate;
+    double minLearningRate;
+    uint64_t decaySteps;
+    uint64_t warmupSteps;
+    uint64_t secondMomentOffset;  // 0 without CHECKPOINT_SECOND_MOMENT
+    // Version 4 on. Older files have no input scaling.
+    uint32_t scaling;             // ScalingKind
+    uint32_t reserved;
+    uint64_t scalingOffset;       // 0 without scaling
+};
+
+// Writes net to filename. The file is written beside it and renamed into
+// place, so a reader never sees half a checkpoint. momentum saves the
+// optimizer state along with the weights. Returns false on error.
+bool saveCheckpoint(const Net &net, const std::string &filename,
+                    unsigned long long samplesSeen = 0, bool momentum = true);
+
+// Maps a checkpoint and returns a Net whose layers point into the mapping.
+// Pages are copy-on-write: serving reads them in place, and training a
+// loaded Net changes only this process's copy, never the file. NULL if the
+// file is missing or not a valid checkpoint. The Net comes back with the
+// optimizer, step count and state it was saved with.
+std::unique_ptr<Net> loadCheckpoint(const std::string &filename, CheckpointHeader *header = NULL);
+
+// Periodic checkpoints without pausing training. save() copies the
+// parameters into a pending snapshot (a memcpy) and returns; a background
+// thread does the file I/O. If a snapshot is still waiting when the next
+// save() comes, the newer one replaces it.
+class CheckpointWriter{
+public:
+    CheckpointWriter(const std::string &filename, bool momentum = true);
+    // Writes any pending snapshot before returning.
+    ~CheckpointWriter();
+    CheckpointWriter(const CheckpointWriter &) = delete;
+    CheckpointWriter &operator=(const CheckpointWriter &) = delete;
+    void save(const Net &net, unsigned long long samplesSeen);
+    // Blocks until every snapshot so far is on disk; false if a write failed.
+    bool wait(void);
+    unsigned long long written(void) const;
+private:
+    struct Snapshot {
+        std::vector<unsigned> topology;
+        std::vector<ActivationKind> activations;
+        std::vector<double> weights;
+        std::vector<double> deltaWeights;
+        std::vector<double> secondMoment;
+        InputScaling scaling;
+        OptimizerConfig optimizer;
+        unsigned long long optimizerSteps;
+        double loss;
+        double recentAverageLoss;
+        unsigned long long samplesSeen;
+    };
+    void writerLoop(void);
+    std::string m_filename;
+    bool m_momentum;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+    Snapshot m_pending;
+    Snapshot m_writing;
+    bool m_hasPending;
+    bool m_busy;
+    bool m_failed;
+    bool m_stop;
+    unsigned long long m_written;
+    std::thread m_writer;
+};
+
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,270 @@
+#include "dataset.h"
+
+#ifdef _WIN32
+#include<windows.h>
+#else
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<unistd.h>
+#endif
+
+static size_t valueSize(uint32_t dtype){
+    return dtype == DATASET_FLOAT32 ? sizeof(float) : sizeof(double);
+}
+
+// Whether rows x cols values of width bytes starting at offset lie within
+// length bytes and are aligned to width, without the products wrapping.
+static bool blockFits(uint64_t offset, uint64_t rows, uint64_t cols, uint64_t width, uint64_t length){
+    uint64_t bytes, end;
+    return offset % width == 0 && !__builtin_mul_overflow(rows, cols, &bytes)
+           && !__builtin_mul_overflow(bytes, width, &bytes) && !__builtin_add_overflow(offset, bytes, &end)
+           && end <= length;
+}
+
+static uint64_t alignUp(uint64_t offset){
+    return (offset + 63) & ~(uint64_t)63;
+}
+
+bool MappedDataset::isBinary(const std::string &filename){
+    char magic[8];
+    FILE *file = fopen(filename.c_str(), "rb");
+    if(file == NULL)
+        return false;
+    bool binary = fread(magic, 1, sizeof(magic), file) == sizeof(magic)
+                  && memcmp(magic, DATASET_MAGIC, sizeof(magic)) == 0;
+    fclose(file);
+    return binary;
+}
+
+// A test set converted without a topology line has numLayers 0 and only
+// needs non-empty samples; otherwise the net the header describes has to
+// be one TrainingData can build and its ends have to match the samples.
+static bool topologyFits(const DatasetHeader &header){
+    if(header.numLayers == 0)
+        return header.numInputs > 0 && header.numOutputs > 0;
+    if(header.numLayers < 2
+       || (header.topology[0] & DATASET_LAYER_SIZE_MASK) != header.numInputs
+       || (header.topology[header.numLayers - 1] & DATASET_LAYER_SIZE_MASK) != header.numOutputs)
+        return false;
+    std::vector<ActivationKind> activations;
+    for(unsigned layerNum = 0; layerNum < header.numLayers; ++layerNum){
+        if((header.topology[layerNum] & DATASET_LAYER_SIZE_MASK) == 0)
+            return false;
+        activations.push_back((ActivationKind)(header.topology[layerNum] >> DATASET_ACTIVATION_SHIFT));
+    }
+    return validActivations(activations, header.numLayers);
+}
+
+MappedDataset::MappedDataset(const std::string &filename)
+    : m_data(NULL), m_length(0), m_header(NULL)
+{
+#ifdef _WIN32
+    m_file = NULL;
+    m_mapping = NULL;
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if(file == INVALID_HANDLE_VALUE)
+        return;
+    m_file = file;
+    LARGE_INTEGER length;
+    if(!GetFileSizeEx(file, &length) || length.QuadPart < (LONGLONG)sizeof(DatasetHeader))
+        return;
+    m_mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(m_mapping == NULL)
+        return;
+    m_data = (const char *)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+    if(m_data == NULL)
+        return;
+    m_length = length.QuadPart;
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0)
+        return;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(DatasetHeader)){
+        ::close(fd);
+        return;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(data == MAP_FAILED)
+        return;
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    m_data = (const char *)data;
+    m_length = st.st_size;
+#endif
+
+    // The header decides where every later access lands, so nothing in it
+    // is trusted: a corrupt or crafted file must fail here, not read outside
+    // the mapping.
+    const DatasetHeader *header = (const DatasetHeader *)m_data;
+    size_t width = valueSize(header->dtype);
+    if(memcmp(header->magic, DATASET_MAGIC, sizeof(header->magic)) != 0
+       || header->version != DATASET_VERSION
+       || (header->dtype != DATASET_FLOAT64 && header->dtype != DATASET_FLOAT32)
+       || header->numSamples == DATASET_STREAMING
+       || header->numLayers > DATASET_MAX_LAYERS
+       || !blockFits(header->inputsOffset, header->numSamples, header->numInputs, width, m_length)
+       || !blockFits(header->targetsOffset, header->numSamples, header->numOutputs, width, m_length)
+       || !topologyFits(*header))
+        return;
+    m_header = header;
+}
+
+MappedDataset::~MappedDataset(){
+#ifdef _WIN32
+    if(m_data != NULL)
+        UnmapViewOfFile(m_data);
+    if(m_mapping != NULL)
+        CloseHandle(m_mapping);
+    if(m_file != NULL)
+        CloseHandle(m_file);
+#else
+    if(m_data != NULL)
+        munmap((void *)m_data, m_length);
+#endif
+}
+
+void MappedDataset::getTopology(std::vector<unsigned> &topology) const{
+    topology.clear();
+    for(unsigned layerNum = 0; layerNum < m_header->numLayers; ++layerNum)
+        topology.push_back(m_header->topology[layerNum] & DATASET_LAYER_SIZE_MASK);
+}
+
+void MappedDataset::getActivations(std::vector<ActivationKind> &activations) const{
+    activations.clear();
+    for(unsigned layerNum = 0; layerNum < m_header->numLayers; ++layerNum){
+        uint32_t kind = m_header->topology[layerNum] >> DATASET_ACTIVATION_SHIFT;
+        activations.push_back(isValidActivation(kind) ? (ActivationKind)kind : ACTIVATION_SIGMOID);
+    }
+}
+
+const double *MappedDataset::inputs(size_t first) const{
+    assert(m_header->dtype == DATASET_FLOAT64);
+    return (const double *)(m_data + m_header->inputsOffset) + first * m_header->numInputs;
+}
+
+const double *MappedDataset::targets(size_t first) const{
+    assert(m_header->dtype == DATASET_FLOAT64);
+    return (const double *)(m_data + m_header->targetsOffset) + first * m_header->numOutputs;
+}
+
+const float *MappedDataset::inputsFloat(size_t first) const{
+    assert(m_header->dtype == DATASET_FLOAT32);
+    return (const float *)(m_data + m_header->inputsOffset) + first * m_header->numInputs;
+}
+
+const float *MappedDataset::targetsFloat(size_t first) const{
+    assert(m_header->dtype == DATASET_FLOAT32);
+    return (const float *)(m_data + m_header->targetsOffset) + first * m_header->numOutputs;
+}
+
+void MappedDataset::getInputs(size_t index, std::vector<double> &inputVals) const{
+    if(m_header->dtype == DATASET_FLOAT32)
+        inputVals.assign(inputsFloat(index), inputsFloat(index) + numInputs());
+    else
+        inputVals.assign(inputs(index), inputs(index) + numInputs());
+}
+
+void MappedDataset::getTargets(size_t index, std::vector<double> &targetVals) const{
+    if(m_header->dtype == DATASET_FLOAT32)
+        targetVals.assign(targetsFloat(index), targetsFloat(index) + numOutputs());
+    else
+        targetVals.assign(targets(index), targets(index) + numOutputs());
+}
+
+DatasetWriter::DatasetWriter(const std::string &filename, const std::vector<unsigned> &topology,
+                             unsigned numInputs, unsigned numOutputs, DatasetType dtype,
+                             const std::vector<ActivationKind> &activations, bool stream)
+    : m_out(NULL), m_targets(NULL), m_failed(false), m_stream(stream)
+{
+    memset(&m_header, 0, sizeof(m_header));
+    memcpy(m_header.magic, DATASET_MAGIC, sizeof(m_header.magic));
+    m_header.version = DATASET_VERSION;
+    m_header.dtype = dtype;
+    m_header.numInputs = numInputs;
+    m_header.numOutputs = numOutputs;
+    if(topology.size() > DATASET_MAX_LAYERS)
+        return;
+    m_header.numLayers = topology.size();
+    for(unsigned layerNum = 0; layerNum < topology.size(); ++layerNum){
+        uint32_t kind = layerNum < activations.size() ? activations[layerNum] : ACTIVATION_SIGMOID;
+        m_header.topology[layerNum] = (topology[layerNum] & DATASET_LAYER_SIZE_MASK) | kind << DATASET_ACTIVATION_SHIFT;
+    }
+    m_header.inputsOffset = alignUp(sizeof(DatasetHeader));
+
+    if(!stream && (m_targets = tmpfile()) == NULL)
+        return;
+    m_out = fopen(filename.c_str(), "wb");
+    if(m_out == NULL)
+        return;
+    // Header is rewritten with the final counts by close(), except for a
+    // stream, which says so once and for all.
+    static const char zeros[64] = {};
+    size_t padding = m_header.inputsOffset - sizeof(m_header);
+    DatasetHeader header = m_header;
+    if(stream)
+        header.numSamples = DATASET_STREAMING;
+    m_failed |= fwrite(&header, sizeof(header), 1, m_out) != 1;
+    m_failed |= fwrite(zeros, 1, padding, m_out) != padding;
+}
+
+DatasetWriter::~DatasetWriter(){
+    if(m_out != NULL)
+        fclose(m_out);
+    if(m_targets != NULL)
+        fclose(m_targets);
+}
+
+void DatasetWriter::writeValues(FILE *file, const double *vals, unsigned count){
+    if(m_header.dtype == DATASET_FLOAT32){
+        for(unsigned i = 0; i < count; i++){
+            float v = (float)vals[i];
+            m_failed |= fwrite(&v, sizeof(v), 1, file) != 1;
+        }
+    } else {
+        m_failed |= fwrite(vals, sizeof(double), count, file) != count;
+    }
+}
+
+void DatasetWriter::append(const double *inputVals, const double *targetVals){
+    writeValues(m_out, inputVals, m_header.numInputs);
+    writeValues(m_stream ? m_out : m_targets, targetVals, m_header.numOutputs);
+    m_header.numSamples++;
+}
+
+bool DatasetWriter::flush(void){
+    m_failed |= m_out == NULL || fflush(m_out) != 0;
+    return !m_failed;
+}
+
+bool DatasetWriter::close(void){
+    if(m_out == NULL)
+        return false;
+    if(m_stream){
+        m_failed |= fclose(m_out) != 0;
+        m_out = NULL;
+        return !m_failed;
+    }
+    size_t width = valueSize(m_header.dtype);
+    uint64_t inputsEnd = m_header.inputsOffset + m_header.numSamples * m_header.numInputs * width;
+    m_header.targetsOffset = alignUp(inputsEnd);
+    static const char zeros[64] = {};
+    size_t padding = m_header.targetsOffset - inputsEnd;
+    m_failed |= fwrite(zeros, 1, padding, m_out) != padding;
+
+    rewind(m_targets);
+    char buffer[1 << 16];
+    size_t n;
+    while((n = fread(buffer, 1, sizeof(buffer), m_targets)) > 0)
+        m_failed |= fwrite(buffer, 1, n, m_out) != n;
+
+    m_failed |= fseek(m_out, 0, SEEK_SET) != 0;
+    m_failed |= fwrite(&m_header, sizeof(m_header), 1, m_out) != 1;
+    m_failed |= fclose(m_out) != 0;
+    m_out = NULL;
+    fclose(m_targets);
+    m_targets = NULL;
+    return !m_failed;
+}
@@ -0,0 +1,117 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+
+#include<bits/stdc++.h>
+#include "activations.h"
+
+// Binary dataset file, little-endian:
+//
+//   DatasetHeader
+//   inputs   numSamples x numInputs values, row-major, at inputsOffset
+//   targets  numSamples x numOutputs values, row-major, at targetsOffset
+//
+// Both blocks start on a 64-byte boundary. Inputs and targets are stored as
+// two blocks rather than interleaved so that any run of consecutive samples
+// can be handed to Net::trainBatch straight out of the mapping.
+//
+// A stream (numSamples DATASET_STREAMING) cannot know its length, so its
+// samples follow the header interleaved instead, from inputsOffset on: the
+// inputs of a sample, then its targets, then the next sample, for as long as
+// the writer keeps appending. StreamSource reads these; MappedDataset does
+// not open them.
+#define DATASET_MAGIC "NNDATA\r\n"
+#define DATASET_VERSION 1
+#define DATASET_MAX_LAYERS 32
+#define DATASET_LAYER_SIZE_MASK 0xffffffu
+#define DATASET_ACTIVATION_SHIFT 24
+#define DATASET_STREAMING UINT64_MAX
+
+enum DatasetType { DATASET_FLOAT64 = 0, DATASET_FLOAT32 = 1 };
+
+struct DatasetHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t dtype;               // DatasetType
+    uint64_t numSamples;
+    uint32_t numInputs;
+    uint32_t numOutputs;
+    uint32_t numLayers;           // 0 when the source had no topology line, else >= 2
+    uint32_t topology[DATASET_MAX_LAYERS]; // layer size in the low 24 bits, ActivationKind in the top 8
+    uint64_t inputsOffset;
+    uint64_t targetsOffset;
+};
+
+// Read-only memory mapping of a binary dataset file.
+class MappedDataset{
+public:
+    explicit MappedDataset(const std::string &filename);
+    ~MappedDataset();
+    MappedDataset(const MappedDataset &) = delete;
+    MappedDataset &operator=(const MappedDataset &) = delete;
+    // True when the file exists and starts with DATASET_MAGIC.
+    static bool isBinary(const std::string &filename);
+    bool isOpen(void) const { return m_header != NULL; }
+    const DatasetHeader &header(void) const { return *m_header; }
+    size_t size(void) const { return m_header->numSamples; }
+    unsigned numInputs(void) const { return m_header->numInputs; }
+    unsigned numOutputs(void) const { return m_header->numOutputs; }
+    void getTopology(std::vector<unsigned> &topology) const;
+    // One entry per layer; files written before activations existed read as
+    // all sigmoid.
+    void getActivations(std::vector<ActivationKind> &activations) const;
+    // Zero-copy views starting at sample first; consecutive samples follow
+    // row after row. Only valid for DATASET_FLOAT64 files.
+    const double *inputs(size_t first) const;
+    const double *targets(size_t first) const;
+    // Same for DATASET_FLOAT32 files.
+    const float *inputsFloat(size_t first) const;
+    const float *targetsFloat(size_t first) const;
+    // Copy one sample whatever the stored type.
+    void getInputs(size_t index, std::vector<double> &inputVals) const;
+    void getTargets(size_t index, std::vector<double> &targetVals) const;
+private:
+    const char *m_data;
+    size_t m_length;
+    const DatasetHeader *m_header;
+#ifdef _WIN32
+    void *m_file;
+    void *m_mapping;
+#endif
+};
+
+// Writes a binary dataset one sample at a time. Targets are spooled to a
+// temporary file and appended by close(), so inputs can stream straight to
+// disk without knowing the sample count up front.
+//
+// With stream set it writes the interleaved stream layout instead: nothing
+// is spooled or rewritten, so filename may be a pipe or FIFO, and flush()
+// hands what was appended so far to a reader following it.
+class DatasetWriter{
+public:
+    DatasetWriter(const std::string &filename, const std::vector<unsigned> &topology,
+                  unsigned numInputs, unsigned numOutputs, DatasetType dtype,
+                  const std::vector<ActivationKind> &activations = std::vector<ActivationKind>(),
+                  bool stream = false);
+    ~DatasetWriter();
+    DatasetWriter(const DatasetWriter &) = delete;
+    DatasetWriter &operator=(const DatasetWriter &) = delete;
+    bool isOpen(void) const { return m_out != NULL; }
+    unsigned numInputs(void) const { return m_header.numInputs; }
+    unsigned numOutputs(void) const { return m_header.numOutputs; }
+    size_t size(void) const { return m_header.numSamples; }
+    void append(const double *inputVals, const double *targetVals);
+    bool flush(void);
+    // Finishes the file; returns false on any write error.
+    bool close(void);
+private:
+    void writeValues(FILE *file, const double *vals, unsigned count);
+    FILE *m_out;
+    FILE *m_targets;
+    DatasetHeader m_header;
+    bool m_failed;
+    bool m_stream;
+};
+
+
+#endif // DATASET_H
@@ -0,0 +1,217 @@
+#include "epoch_trainer.h"
+
+bool DatasetCache::load(const std::string &filename, size_t memoryBudget){
+    m_mapped.reset();
+    m_inputs.clear();
+    m_targets.clear();
+    m_size = 0;
+
+    if(MappedDataset::isBinary(filename)){
+        std::unique_ptr<MappedDataset> mapped(new MappedDataset(filename));
+        if(!mapped->isOpen())
+            return false;
+        size_t bytes = mapped->size() * (mapped->numInputs() + mapped->numOutputs()) * sizeof(double);
+        if(bytes > memoryBudget)
+            return false;
+        m_numInputs = mapped->numInputs();
+        m_numOutputs = mapped->numOutputs();
+        m_size = mapped->size();
+        if(mapped->header().dtype == DATASET_FLOAT64){
+            m_mapped.swap(mapped);
+            m_in = m_mapped->inputs(0);
+            m_out = m_mapped->targets(0);
+            return true;
+        }
+        const float *in = mapped->inputsFloat(0), *out = mapped->targetsFloat(0);
+        m_inputs.assign(in, in + m_size * m_numInputs);
+        m_targets.assign(out, out + m_size * m_numOutputs);
+    } else {
+        TrainingData data(filename);
+        std::vector<unsigned> topology;
+        std::vector<double> inputVals, targetVals;
+        data.getTopology(topology);
+        m_numInputs = topology.front();
+        m_numOutputs = topology.back();
+        size_t perSample = (m_numInputs + m_numOutputs) * sizeof(double);
+        while(!data.isEof()){
+            if(data.getNextInputs(inputVals) != m_numInputs)
+                break;
+            if(data.getTargetOutputs(targetVals) != m_numOutputs)
+                break;
+            if((m_size + 1) * perSample > memoryBudget){
+                std::vector<double>().swap(m_inputs);
+                std::vector<double>().swap(m_targets);
+                m_size = 0;
+                return false;
+            }
+            m_inputs.insert(m_inputs.end(), inputVals.begin(), inputVals.end());
+            m_targets.insert(m_targets.end(), targetVals.begin(), targetVals.end());
+            m_size++;
+        }
+    }
+    m_in = m_inputs.data();
+    m_out = m_targets.data();
+    return true;
+}
+
+EpochTrainer::EpochTrainer(Net &net, ParallelTrainer &trainer, const EpochOptions &options)
+    : m_net(net), m_trainer(trainer), m_options(options), m_rng(options.seed), m_inBatch(0)
+{
+    std::vector<unsigned> topology;
+    net.getTopology(topology);
+    m_numInputs = topology.front();
+    m_numOutputs = topology.back();
+    m_options.batchSize = std::max(1u, m_options.batchSize);
+    m_options.shuffleBuffer = std::max(1u, m_options.shuffleBuffer);
+    m_batchInputs.resize((size_t)m_options.batchSize * m_numInputs);
+    m_batchTargets.resize((size_t)m_options.batchSize * m_numOutputs);
+}
+
+bool EpochTrainer::isHoldout(size_t index) const{
+    double f = m_options.holdoutFraction;
+    return f > 0.0 && floor((index + 1) * f) > floor(index * f);
+}
+
+void EpochTrainer::addToBatch(const double *inputs, const double *targets){
+    std::copy(inputs, inputs + m_numInputs, &m_batchInputs[(size_t)m_inBatch * m_numInputs]);
+    std::copy(targets, targets + m_numOutputs, &m_batchTargets[(size_t)m_inBatch * m_numOutputs]);
+    if(++m_inBatch == m_options.batchSize)
+        flushBatch();
+}
+
+void EpochTrainer::flushBatch(void){
+    if(m_inBatch == 0)
+        return;
+    m_trainer.trainBatch(m_batchInputs.data(), m_batchTargets.data(), m_inBatch);
+    m_inBatch = 0;
+}
+
+void EpochTrainer::trainCachedEpoch(const DatasetCache &cache){
+    // Fisher-Yates with our own generator so a seed gives the same order on
+    // every standard library.
+    for(size_t i = m_trainIndices.size(); i > 1; i--)
+        std::swap(m_trainIndices[i - 1], m_trainIndices[m_rng() % i]);
+    for(size_t i = 0; i < m_trainIndices.size(); i++)
+        addToBatch(cache.inputs(m_trainIndices[i]), cache.targets(m_trainIndices[i]));
+    flushBatch();
+}
+
+// One pass over the file through a shuffle buffer: the buffer is filled
+// first, then every new sample replaces a random slot whose old occupant is
+// trained on; the remainder is shuffled and drained at the end.
+void EpochTrainer::trainStreamingEpoch(const std::string &filename){
+    TrainingData data(filename);
+    std::vector<unsigned> topology;
+    std::vector<double> inputVals, targetVals;
+    data.getTopology(topology);
+
+    unsigned width = m_numInputs + m_numOutputs;
+    std::vector<double> buffer((size_t)m_options.shuffleBuffer * width);
+    size_t filled = 0;
+    for(size_t index = 0; !data.isEof(); index++){
+        if(data.getNextInputs(inputVals) != m_numInputs || data.getTargetOutputs(targetVals) != m_numOutputs)
+            break;
+        if(isHoldout(index))
+            continue;
+        double *slot;
+        if(filled < m_options.shuffleBuffer){
+            slot = &buffer[filled++ * width];
+        } else {
+            slot = &buffer[(m_rng() % filled) * width];
+            addToBatch(slot, slot + m_numInputs);
+        }
+        std::copy(inputVals.begin(), inputVals.end(), slot);
+        std::copy(targetVals.begin(), targetVals.end(), slot + m_numInputs);
+    }
+    std::vector<size_t> order(filled);
+    for(size_t i = 0; i < filled; i++)
+        order[i] = i;
+    for(size_t i = filled; i > 1; i--)
+        std::swap(order[i - 1], order[m_rng() % i]);
+    for(size_t i = 0; i < filled; i++)
+        addToBatch(&buffer[order[i] * width], &buffer[order[i] * width + m_numInputs]);
+    flushBatch();
+}
+
+void EpochTrainer::evaluate(const double *inputs, const double *targets, double &loss, double &correct){
+    m_inputVals.assign(inputs, inputs + m_numInputs);
+    m_net.feedForward(m_inputVals);
+    m_net.getResults(m_resultVals);
+    double sum = 0.0;
+    bool right = true;
+    for(unsigned i = 0; i < m_numOutputs; i++){
+        double delta = targets[i] - m_resultVals[i];
+        sum += delta * delta;
+        right = right && (m_resultVals[i] > 0.5) == (targets[i] > 0.5);
+    }
+    loss += sqrt(sum / m_numOutputs);
+    correct += right ? 1.0 : 0.0;
+}
+
+unsigned EpochTrainer::train(const std::string &filename, const std::function<void(const EpochReport &)> &report){
+    DatasetCache cache;
+    bool cached = cache.load(filename, m_options.memoryBudget);
+    m_trainIndices.clear();
+    m_holdoutIndices.clear();
+    for(size_t i = 0; i < cache.size(); i++)
+        (isHoldout(i) ? m_holdoutIndices : m_trainIndices).push_back(i);
+
+    Net best = m_net;
+    double bestAccuracy = -1.0;
+    bool haveHoldout = false;
+    unsigned sinceBest = 0, epoch = 0;
+    while(epoch < m_options.maxEpochs){
+        epoch++;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if(cached)
+            trainCachedEpoch(cache);
+        else
+            trainStreamingEpoch(filename);
+
+        double loss = 0.0, correct = 0.0;
+        size_t count = 0;
+        if(cached){
+            for(size_t i = 0; i < m_holdoutIndices.size(); i++)
+                evaluate(cache.inputs(m_holdoutIndices[i]), cache.targets(m_holdoutIndices[i]), loss, correct);
+            count = m_holdoutIndices.size();
+        } else if(m_options.holdoutFraction > 0.0){
+            TrainingData data(filename);
+            std::vector<unsigned> topology;
+            std::vector<double> inputVals, targetVals;
+            data.getTopology(topology);
+            for(size_t index = 0; !data.isEof(); index++){
+                if(data.getNextInputs(inputVals) != m_numInputs || data.getTargetOutputs(targetVals) != m_numOutputs)
+                    break;
+                if(isHoldout(index)){
+                    evaluate(inputVals.data(), targetVals.data(), loss, correct);
+                    count++;
+                }
+            }
+        }
+
+        EpochReport r;
+        r.epoch = epoch;
+        r.recentAverageLoss = m_net.getRecentAverageloss();
+        r.validationLoss = count > 0 ? loss / count : 0.0;
+        r.validationAccuracy = count > 0 ? correct / count : 0.0;
+        r.improved = count == 0 || r.validationAccuracy > bestAccuracy;
+        r.streaming = !cached;
+        if(count > 0){
+            haveHoldout = true;
+            if(r.improved){
+                best = m_net;
+                bestAccuracy = r.validationAccuracy;
+                sinceBest = 0;
+            } else {
+                sinceBest++;
+            }
+        }
+        r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        report(r);
+        if(haveHoldout && sinceBest >= m_options.patience)
+            break;
+    }
+    if(haveHoldout)
+        m_net = best;
+    return epoch;
+}
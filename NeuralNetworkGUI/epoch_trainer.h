@@ -0,0 +1,92 @@
+#ifndef EPOCH_TRAINER_H
+#define EPOCH_TRAINER_H
+
+
+#include "all_class.h"
+#include "parallel_trainer.h"
+
+// Every sample of a dataset in two flat arrays (inputs, targets), parsed
+// once. A float64 binary file is used in place through its mapping.
+class DatasetCache{
+public:
+    DatasetCache() : m_numInputs(0), m_numOutputs(0), m_size(0) {}
+    // Loads a training file. Returns false, leaving the cache empty, if the
+    // samples would take more than memoryBudget bytes.
+    bool load(const std::string &filename, size_t memoryBudget);
+    size_t size(void) const { return m_size; }
+    unsigned numInputs(void) const { return m_numInputs; }
+    unsigned numOutputs(void) const { return m_numOutputs; }
+    const double *inputs(size_t index) const { return m_in + index * m_numInputs; }
+    const double *targets(size_t index) const { return m_out + index * m_numOutputs; }
+private:
+    std::unique_ptr<MappedDataset> m_mapped;
+    std::vector<double> m_inputs;
+    std::vector<double> m_targets;
+    const double *m_in;
+    const double *m_out;
+    unsigned m_numInputs;
+    unsigned m_numOutputs;
+    size_t m_size;
+};
+
+struct EpochOptions {
+    unsigned maxEpochs;
+    unsigned batchSize;
+    double holdoutFraction;   // share of samples kept out for validation, 0 = none
+    unsigned patience;        // epochs without a better validation accuracy before stopping
+    size_t memoryBudget;      // bytes the in-memory cache may use
+    unsigned shuffleBuffer;   // samples in the streaming shuffle buffer
+    unsigned seed;
+    EpochOptions() : maxEpochs(10), batchSize(32), holdoutFraction(0.1), patience(3),
+                     memoryBudget((size_t)1 << 30), shuffleBuffer(1 << 16), seed(1) {}
+};
+
+struct EpochReport {
+    unsigned epoch;
+    double recentAverageLoss;
+    double validationLoss;
+    double validationAccuracy;
+    double seconds;
+    bool improved;
+    bool streaming;           // dataset did not fit the memory budget
+};
+
+// Trains for several epochs over one file. The file is parsed once into a
+// DatasetCache and every epoch visits it through a fresh index permutation.
+// Datasets over the memory budget are re-read each epoch and shuffled
+// through a bounded buffer instead.
+//
+// Validation samples are picked by position (evenly spread, holdoutFraction
+// of them), so the split is the same in both modes. Training stops after
+// `patience` epochs without a better validation accuracy, and the Net is
+// left with the weights of the best epoch.
+class EpochTrainer{
+public:
+    EpochTrainer(Net &net, ParallelTrainer &trainer, const EpochOptions &options);
+    // Runs the epochs; report is called after each one. Returns the number
+    // of epochs run.
+    unsigned train(const std::string &filename, const std::function<void(const EpochReport &)> &report);
+private:
+    bool isHoldout(size_t index) const;
+    void trainCachedEpoch(const DatasetCache &cache);
+    void trainStreamingEpoch(const std::string &filename);
+    void evaluate(const double *inputs, const double *targets, double &loss, double &correct);
+    void flushBatch(void);
+    void addToBatch(const double *inputs, const double *targets);
+    Net &m_net;
+    ParallelTrainer &m_trainer;
+    EpochOptions m_options;
+    unsigned m_numInputs;
+    unsigned m_numOutputs;
+    std::mt19937 m_rng;
+    std::vector<size_t> m_trainIndices;
+    std::vector<size_t> m_holdoutIndices;
+    std::vector<double> m_batchInputs;
+    std::vector<double> m_batchTargets;
+    unsigned m_inBatch;
+    std::vector<double> m_inputVals;
+    std::vector<double> m_resultVals;
+};
+
+
+#endif // EPOCH_TRAINER_H
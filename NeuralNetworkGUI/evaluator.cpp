@@ -0,0 +1,94 @@
+#include "evaluator.h"
+
+unsigned long long ConfusionMatrix::total(void) const{
+    unsigned long long sum = 0;
+    for(size_t i = 0; i < counts.size(); i++)
+        sum += counts[i];
+    return sum;
+}
+
+unsigned long long ConfusionMatrix::correct(void) const{
+    unsigned long long sum = 0;
+    for(unsigned i = 0; i < numClasses; i++)
+        sum += at(i, i);
+    return sum;
+}
+
+void ConfusionMatrix::merge(const ConfusionMatrix &other){
+    assert(other.numClasses == numClasses);
+    for(size_t i = 0; i < counts.size(); i++)
+        counts[i] += other.counts[i];
+}
+
+Evaluator::Evaluator(const Net &net, ThreadPool &pool, unsigned chunkSize)
+    : m_net(net), m_pool(pool), m_chunkSize(std::max(1u, chunkSize)), m_scratch(pool.size())
+{
+    std::vector<unsigned> topology;
+    net.getTopology(topology);
+    m_numInputs = topology.front();
+    m_numOutputs = topology.back();
+    reset();
+}
+
+unsigned Evaluator::classOf(const float *values) const{
+    if(m_numOutputs == 1)
+        return values[0] > 0.5f ? 1 : 0;
+    return std::max_element(values, values + m_numOutputs) - values;
+}
+
+void Evaluator::evaluate(const float *inputs, const float *targets, size_t count, float *predictions){
+    if(count == 0)
+        return;
+    size_t numChunks = (count + m_chunkSize - 1) / m_chunkSize;
+    if(m_chunks.size() < numChunks)
+        m_chunks.resize(numChunks, EvalMetrics(numClasses()));
+    for(size_t c = 0; c < numChunks; c++)
+        m_chunks[c].clear();
+    m_pool.parallelFor(numChunks, [&](unsigned c, unsigned thread){
+        size_t first = (size_t)c * m_chunkSize;
+        size_t rows = std::min<size_t>(m_chunkSize, count - first);
+        float *out;
+        if(predictions != NULL){
+            out = predictions + first * m_numOutputs;
+        } else {
+            m_scratch[thread].resize(rows * m_numOutputs);
+            out = m_scratch[thread].data();
+        }
+        m_net.predictBatch(inputs + first * m_numInputs, rows, out);
+
+        EvalMetrics &chunk = m_chunks[c];
+        for(size_t b = 0; b < rows; b++){
+            const float *result = out + b * m_numOutputs;
+            const float *target = targets + (first + b) * m_numOutputs;
+            double loss = 0.0;
+            for(unsigned j = 0; j < m_numOutputs; j++){
+                double delta = (double)target[j] - result[j];
+                loss += delta * delta;
+            }
+            chunk.lossSum += sqrt(loss / m_numOutputs);
+            chunk.confusion.counts[classOf(target) * chunk.confusion.numClasses + classOf(result)]++;
+        }
+        chunk.samples = rows;
+    });
+    for(size_t c = 0; c < numChunks; c++){
+        m_metrics.samples += m_chunks[c].samples;
+        m_metrics.lossSum += m_chunks[c].lossSum;
+        m_metrics.confusion.merge(m_chunks[c].confusion);
+    }
+}
+
+unsigned readSamples(SampleSource &source, unsigned numInputs, unsigned numOutputs,
+                     unsigned maxSamples, float *inputs, float *targets){
+    std::vector<double> inputVals, targetVals;
+    unsigned count = 0;
+    while(count < maxSamples && !source.isEof()){
+        if(source.getNextInputs(inputVals) != numInputs)
+            break;
+        if(source.getTargetOutputs(targetVals) != numOutputs)
+            break;
+        std::copy(inputVals.begin(), inputVals.end(), inputs + (size_t)count * numInputs);
+        std::copy(targetVals.begin(), targetVals.end(), targets + (size_t)count * numOutputs);
+        count++;
+    }
+    return count;
+}
@@ -0,0 +1,71 @@
+#ifndef EVALUATOR_H
+#define EVALUATOR_H
+
+
+#include "all_class.h"
+#include "thread_pool.h"
+
+// counts[target * numClasses + predicted]. A single-output net is a binary
+// classifier thresholded at 0.5; with several outputs the class is the index
+// of the largest one, for targets and predictions alike.
+struct ConfusionMatrix {
+    unsigned numClasses;
+    std::vector<unsigned long long> counts;
+    explicit ConfusionMatrix(unsigned classes = 2) : numClasses(classes), counts(classes * classes, 0) {}
+    unsigned long long at(unsigned target, unsigned predicted) const { return counts[target * numClasses + predicted]; }
+    unsigned long long total(void) const;
+    unsigned long long correct(void) const;
+    void merge(const ConfusionMatrix &other);
+};
+
+struct EvalMetrics {
+    unsigned long long samples;
+    double lossSum;            // sum of the per-sample RMS loss
+    ConfusionMatrix confusion;
+    explicit EvalMetrics(unsigned classes = 2) : samples(0), lossSum(0.0), confusion(classes) {}
+    double accuracy(void) const { return samples > 0 ? (double)confusion.correct() / samples : 0.0; }
+    double meanLoss(void) const { return samples > 0 ? lossSum / samples : 0.0; }
+    // Back to no samples, keeping the storage of the counts.
+    void clear(void) {
+        samples = 0;
+        lossSum = 0.0;
+        std::fill(confusion.counts.begin(), confusion.counts.end(), 0ULL);
+    }
+};
+
+// Scores samples with Net::predictBatch across a ThreadPool, accumulating
+// loss and the confusion matrix in the same pass.
+//
+// Work is cut into chunks of chunkSize samples. Each chunk's loss is summed
+// on its own and the chunk sums are added in order, so the metrics do not
+// depend on the thread count. The Net is only read; do not train it while
+// evaluate() runs.
+class Evaluator{
+public:
+    Evaluator(const Net &net, ThreadPool &pool, unsigned chunkSize = 4096);
+    unsigned numClasses(void) const { return m_numOutputs == 1 ? 2 : m_numOutputs; }
+    // Scores count samples and adds them to metrics(). If predictions is not
+    // NULL the raw outputs (count x numOutputs) are stored there.
+    void evaluate(const float *inputs, const float *targets, size_t count, float *predictions = NULL);
+    const EvalMetrics &metrics(void) const { return m_metrics; }
+    void reset(void) { m_metrics = EvalMetrics(numClasses()); }
+private:
+    unsigned classOf(const float *values) const;
+    const Net &m_net;
+    ThreadPool &m_pool;
+    unsigned m_chunkSize;
+    unsigned m_numInputs;
+    unsigned m_numOutputs;
+    EvalMetrics m_metrics;
+    std::vector<EvalMetrics> m_chunks;
+    std::vector<std::vector<float> > m_scratch; // predictions per thread when the caller wants none
+};
+
+// Reads up to maxSamples in:/out: pairs from source into float rows. Stops
+// early at the end of the data or at a sample whose width is wrong, as the
+// loops in main() do. Returns the number of samples read.
+unsigned readSamples(SampleSource &source, unsigned numInputs, unsigned numOutputs,
+                     unsigned maxSamples, float *inputs, float *targets);
+
+
+#endif // EVALUATOR_H
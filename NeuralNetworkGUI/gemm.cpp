@@ -0,0 +1,106 @@
+#include "gemm.h"
+#include "kernels.h"
+
+#include<bits/stdc++.h>
+
+// Block sizes: an MC x KC panel of A and a KC x NR sliver of B fit in L2/L1.
+#define GEMM_MC 96
+#define GEMM_KC 256
+#define GEMM_NC 2048
+
+// Copies op(A)[i0.., p0..] into MR-row panels, p-major inside a panel,
+// zero-padding the last panel.
+template<class T>
+static void packA(bool transA, const T *A, unsigned lda, unsigned i0, unsigned mc,
+                  unsigned p0, unsigned kc, T *dst){
+    for(unsigned ir = 0; ir < mc; ir += GEMM_MR){
+        unsigned mr = std::min((unsigned)GEMM_MR, mc - ir);
+        for(unsigned p = 0; p < kc; p++){
+            for(unsigned i = 0; i < mr; i++){
+                unsigned row = i0 + ir + i, col = p0 + p;
+                dst[i] = transA ? A[(size_t)col * lda + row] : A[(size_t)row * lda + col];
+            }
+            for(unsigned i = mr; i < GEMM_MR; i++)
+                dst[i] = 0.0;
+            dst += GEMM_MR;
+        }
+    }
+}
+
+// Copies op(B)[p0.., j0..] into NR-column panels, p-major inside a panel.
+template<class T>
+static void packB(bool transB, const T *B, unsigned ldb, unsigned p0, unsigned kc,
+                  unsigned j0, unsigned nc, T *dst){
+    for(unsigned jr = 0; jr < nc; jr += GEMM_NR){
+        unsigned nr = std::min((unsigned)GEMM_NR, nc - jr);
+        for(unsigned p = 0; p < kc; p++){
+            unsigned row = p0 + p;
+            if(!transB && nr == GEMM_NR){
+                memcpy(dst, &B[(size_t)row * ldb + j0 + jr], GEMM_NR * sizeof(T));
+            } else {
+                for(unsigned j = 0; j < nr; j++){
+                    unsigned col = j0 + jr + j;
+                    dst[j] = transB ? B[(size_t)col * ldb + row] : B[(size_t)row * ldb + col];
+                }
+                for(unsigned j = nr; j < GEMM_NR; j++)
+                    dst[j] = 0.0;
+            }
+            dst += GEMM_NR;
+        }
+    }
+}
+
+template<class T>
+static void gemmBlocked(bool transA, bool transB, unsigned M, unsigned N, unsigned K,
+                        const T *A, unsigned lda, const T *B, unsigned ldb,
+                        T *C, unsigned ldc, bool accumulate){
+    if(!accumulate)
+        for(unsigned i = 0; i < M; i++)
+            std::fill(C + (size_t)i * ldc, C + (size_t)i * ldc + N, 0.0);
+    if(K == 0)
+        return;
+
+    const KernelTableT<T> &k = kernelsFor<T>();
+    // Packing buffers are per thread so concurrent trainers can share this.
+    thread_local std::vector<T> packedA, packedB;
+    packedA.resize((size_t)(GEMM_MC + GEMM_MR) * GEMM_KC);
+    packedB.resize((size_t)(GEMM_NC + GEMM_NR) * GEMM_KC);
+    T tile[GEMM_MR * GEMM_NR];
+
+    for(unsigned jc = 0; jc < N; jc += GEMM_NC){
+        unsigned nc = std::min((unsigned)GEMM_NC, N - jc);
+        for(unsigned pc = 0; pc < K; pc += GEMM_KC){
+            unsigned kc = std::min((unsigned)GEMM_KC, K - pc);
+            packB(transB, B, ldb, pc, kc, jc, nc, packedB.data());
+            for(unsigned ic = 0; ic < M; ic += GEMM_MC){
+                unsigned mc = std::min((unsigned)GEMM_MC, M - ic);
+                packA(transA, A, lda, ic, mc, pc, kc, packedA.data());
+                for(unsigned jr = 0; jr < nc; jr += GEMM_NR){
+                    unsigned nr = std::min((unsigned)GEMM_NR, nc - jr);
+                    const T *b = &packedB[(size_t)jr * kc];
+                    for(unsigned ir = 0; ir < mc; ir += GEMM_MR){
+                        unsigned mr = std::min((unsigned)GEMM_MR, mc - ir);
+                        k.gemmTile(kc, &packedA[(size_t)ir * kc], b, tile);
+                        for(unsigned i = 0; i < mr; i++){
+                            T *c = C + (size_t)(ic + ir + i) * ldc + jc + jr;
+                            for(unsigned j = 0; j < nr; j++)
+                                c[j] += tile[i * GEMM_NR + j];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+void gemm(bool transA, bool transB, unsigned M, unsigned N, unsigned K,
+          const double *A, unsigned lda, const double *B, unsigned ldb,
+          double *C, unsigned ldc, bool accumulate){
+    gemmBlocked(transA, transB, M, N, K, A, lda, B, ldb, C, ldc, accumulate);
+}
+
+void gemm(bool transA, bool transB, unsigned M, unsigned N, unsigned K,
+          const float *A, unsigned lda, const float *B, unsigned ldb,
+          float *C, unsigned ldc, bool accumulate){
+    gemmBlocked(transA, transB, M, N, K, A, lda, B, ldb, C, ldc, accumulate);
+}
@@ -0,0 +1,19 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+
+// C = op(A) * op(B), or C += op(A) * op(B) when accumulate is set.
+// op(A) is M x K, op(B) is K x N, all matrices row-major with the given
+// leading dimensions; transA/transB read A/B as their transposes.
+// The product is cache-blocked (panels of A and B are packed so a KC-deep
+// slice stays in L1/L2) and register-tiled through kernels().gemmTile.
+void gemm(bool transA, bool transB, unsigned M, unsigned N, unsigned K,
+          const double *A, unsigned lda, const double *B, unsigned ldb,
+          double *C, unsigned ldc, bool accumulate);
+// The same in single precision, through floatKernels().
+void gemm(bool transA, bool transB, unsigned M, unsigned N, unsigned K,
+          const float *A, unsigned lda, const float *B, unsigned ldb,
+          float *C, unsigned ldc, bool accumulate);
+
+
+#endif // GEMM_H
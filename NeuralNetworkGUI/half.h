@@ -0,0 +1,78 @@
+#ifndef HALF_H
+#define HALF_H
+
+
+#include<bits/stdc++.h>
+
+// 16-bit float formats for activation storage. Both conversions round to
+// nearest even; NaN stays NaN.
+
+// bfloat16: the top half of a float32 (8-bit exponent, 7-bit mantissa).
+inline uint16_t floatToBf16(float value){
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if((bits & 0x7fffffffu) > 0x7f800000u)
+        return (uint16_t)((bits >> 16) | 0x40);
+    bits += 0x7fffu + ((bits >> 16) & 1);
+    return (uint16_t)(bits >> 16);
+}
+
+inline float bf16ToFloat(uint16_t value){
+    uint32_t bits = (uint32_t)value << 16;
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+// IEEE binary16 (5-bit exponent, 10-bit mantissa, max 65504).
+inline uint16_t floatToHalf(float value){
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    uint32_t magnitude = bits & 0x7fffffffu;
+    if(magnitude > 0x7f800000u)
+        return sign | 0x7e00;
+    if(magnitude >= 0x477ff000u)    // rounds to 65520 or more: infinity
+        return sign | 0x7c00;
+    if(magnitude < 0x38800000u){    // below 2^-14: subnormal or zero
+        if(magnitude < 0x33000000u) // below half the smallest subnormal
+            return sign;
+        unsigned exponent = magnitude >> 23;
+        uint32_t mantissa = (magnitude & 0x7fffff) | 0x800000;
+        unsigned shift = 126 - exponent;
+        uint32_t result = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+        if(rest > halfway || (rest == halfway && (result & 1)))
+            result++;
+        return sign | (uint16_t)result;
+    }
+    magnitude += 0xfffu + ((magnitude >> 13) & 1);
+    return sign | (uint16_t)((magnitude - 0x38000000u) >> 13);
+}
+
+inline float halfToFloat(uint16_t value){
+    uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f, mantissa = value & 0x3ff;
+    uint32_t bits;
+    if(exponent == 0x1f){
+        bits = sign | 0x7f800000u | (mantissa << 13);
+    } else if(exponent != 0){
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    } else if(mantissa == 0){
+        bits = sign;
+    } else {
+        // Subnormal: normalise into a float exponent.
+        exponent = 113;
+        while((mantissa & 0x400) == 0){
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+
+#endif // HALF_H
@@ -0,0 +1,538 @@
+#include "inference_server.h"
+#include<poll.h>
+#include<sys/socket.h>
+#include<sys/uio.h>
+#include<sys/un.h>
+#include<unistd.h>
+
+// Reads exactly bytes; false on EOF or error.
+static bool readAll(int fd, void *data, size_t bytes){
+    char *p = (char *)data;
+    while(bytes > 0){
+        ssize_t n = recv(fd, p, bytes, 0);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            return false;
+        p += n;
+        bytes -= n;
+    }
+    return true;
+}
+
+// A header and its payload, in one sendmsg where possible. MSG_NOSIGNAL
+// turns a peer that has gone away into an error instead of a SIGPIPE.
+static bool writeAll(int fd, const ServeHeader &header, const void *payload, size_t bytes){
+    struct iovec parts[2] = {{(void *)&header, sizeof(header)}, {(void *)payload, bytes}};
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = parts;
+    message.msg_iovlen = bytes > 0 ? 2 : 1;
+    while(message.msg_iovlen > 0){
+        ssize_t n = sendmsg(fd, &message, MSG_NOSIGNAL);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            return false;
+        while(message.msg_iovlen > 0 && (size_t)n >= message.msg_iov->iov_len){
+            n -= message.msg_iov->iov_len;
+            message.msg_iov++;
+            message.msg_iovlen--;
+        }
+        if(message.msg_iovlen > 0){
+            message.msg_iov->iov_base = (char *)message.msg_iov->iov_base + n;
+            message.msg_iov->iov_len -= n;
+        }
+    }
+    return true;
+}
+
+// As much of a header and its payload as the socket takes without
+// blocking: the number of bytes sent, or -1 if the peer has gone.
+static ssize_t sendSome(int fd, const ServeHeader &header, const void *payload, size_t bytes){
+    struct iovec parts[2] = {{(void *)&header, sizeof(header)}, {(void *)payload, bytes}};
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = parts;
+    message.msg_iovlen = bytes > 0 ? 2 : 1;
+    ssize_t n;
+    do
+        n = sendmsg(fd, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+    while(n < 0 && errno == EINTR);
+    if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return 0;
+    return n;
+}
+
+static bool sendAll(int fd, const char *data, size_t bytes){
+    while(bytes > 0){
+        ssize_t n = send(fd, data, bytes, MSG_NOSIGNAL);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            return false;
+        data += n;
+        bytes -= n;
+    }
+    return true;
+}
+
+static bool socketAddress(const std::string &path, struct sockaddr_un &address){
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(address.sun_path))
+        return false;
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+void LatencyHistogram::record(double seconds){
+    double ns = seconds * 1e9;
+    unsigned bucket = 0;
+    if(ns > 100.0)
+        bucket = std::min<double>(BUCKETS - 1, floor(PER_OCTAVE * log2(ns / 100.0)) + 1);
+    m_buckets[bucket]++;
+    m_count++;
+    m_sum += seconds;
+    m_max = std::max(m_max, seconds);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other){
+    for(unsigned bucket = 0; bucket < BUCKETS; bucket++)
+        m_buckets[bucket] += other.m_buckets[bucket];
+    m_count += other.m_count;
+    m_sum += other.m_sum;
+    m_max = std::max(m_max, other.m_max);
+}
+
+double LatencyHistogram::quantile(double q) const{
+    if(m_count == 0)
+        return 0.0;
+    unsigned long long rank = std::max(1.0, ceil(q * m_count)), seen = 0;
+    for(unsigned bucket = 0; bucket < BUCKETS; bucket++){
+        seen += m_buckets[bucket];
+        if(seen >= rank)
+            return std::min(m_max, 100e-9 * exp2((double)bucket / PER_OCTAVE));
+    }
+    return m_max;
+}
+
+InferenceServer::InferenceServer(const Net &net, const ServeOptions &options)
+    : m_net(&net), m_snapshots(NULL), m_options(options), m_pool(options.threads), m_listenFd(-1), m_stop(false),
+      m_queuedSamples(0)
+{
+    init(net);
+}
+
+InferenceServer::InferenceServer(const NetSnapshots &snapshots, const ServeOptions &options)
+    : m_net(NULL), m_snapshots(&snapshots), m_options(options), m_pool(options.threads), m_listenFd(-1),
+      m_stop(false), m_queuedSamples(0)
+{
+    init(snapshots.current()->net);
+}
+
+void InferenceServer::init(const Net &net){
+    m_options.maxBatch = std::max(1u, m_options.maxBatch);
+    net.getTopology(m_topology);
+    m_numInputs = m_topology.front();
+    m_numOutputs = m_topology.back();
+    m_workspaces.resize(m_pool.size());
+    m_total.start = m_interval.start = Clock::now();
+    m_total.requests = m_total.samples = m_total.batches = m_total.rejected = 0;
+    m_interval = m_total;
+}
+
+InferenceServer::~InferenceServer(){
+    stop();
+}
+
+bool InferenceServer::listen(const std::string &path){
+    struct sockaddr_un address;
+    if(m_listenFd >= 0 || !socketAddress(path, address))
+        return false;
+    m_listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(m_listenFd < 0)
+        return false;
+    unlink(path.c_str());
+    if(bind(m_listenFd, (struct sockaddr *)&address, sizeof(address)) != 0 || ::listen(m_listenFd, 64) != 0){
+        close(m_listenFd);
+        m_listenFd = -1;
+        return false;
+    }
+    m_path = path;
+    m_stop = false;
+    m_acceptor = std::thread(&InferenceServer::acceptLoop, this);
+    m_dispatcher = std::thread(&InferenceServer::dispatchLoop, this);
+    return true;
+}
+
+void InferenceServer::stop(void){
+    if(m_listenFd < 0)
+        return;
+    m_stop = true;
+    m_acceptor.join();
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+    }
+    m_queueReady.notify_all();
+    m_dispatcher.join();
+    std::vector<std::shared_ptr<Connection> > connections;
+    {
+        std::lock_guard<std::mutex> lock(m_connectionMutex);
+        connections.swap(m_connections);
+    }
+    for(size_t i = 0; i < connections.size(); i++){
+        shutdown(connections[i]->fd, SHUT_RDWR);
+        connections[i]->reader.join();
+    }
+    m_queue.clear();
+    m_queuedSamples = 0;
+    close(m_listenFd);
+    m_listenFd = -1;
+    unlink(m_path.c_str());
+}
+
+// Polls rather than blocking in accept so stop() is noticed; finished
+// connections are joined here too.
+void InferenceServer::acceptLoop(void){
+    while(!m_stop){
+        struct pollfd ready = {m_listenFd, POLLIN, 0};
+        int n = poll(&ready, 1, 100);
+        std::lock_guard<std::mutex> lock(m_connectionMutex);
+        for(size_t i = 0; i < m_connections.size(); ){
+            if(m_connections[i]->done){
+                m_connections[i]->reader.join();
+                m_connections[i] = m_connections.back();
+                m_connections.pop_back();
+            } else {
+                i++;
+            }
+        }
+        if(n <= 0)
+            continue;
+        int fd = accept(m_listenFd, NULL, NULL);
+        if(fd < 0)
+            continue;
+        std::shared_ptr<Connection> connection(new Connection(fd), [](Connection *c){
+            close(c->fd);
+            delete c;
+        });
+        connection->writer = std::thread(&InferenceServer::writeLoop, this, connection);
+        connection->reader = std::thread(&InferenceServer::readLoop, this, connection);
+        m_connections.push_back(connection);
+    }
+}
+
+// Called with writeMutex held. The reader sees EOF and winds the
+// connection up.
+void InferenceServer::disconnect(Connection &connection){
+    connection.broken = true;
+    connection.unsent.clear();
+    shutdown(connection.fd, SHUT_RDWR);
+    connection.writeReady.notify_one();
+}
+
+// Never blocks: a reply goes straight to the socket when nothing is queued
+// ahead of it, and whatever the socket does not take is left to writeLoop.
+bool InferenceServer::reply(Connection &connection, uint32_t status, uint32_t id, uint32_t count,
+                            const void *payload, size_t bytes){
+    ServeHeader header = {SERVE_MAGIC, status, id, count};
+    std::lock_guard<std::mutex> lock(connection.writeMutex);
+    if(connection.broken)
+        return false;
+    size_t sent = 0, total = sizeof(header) + bytes;
+    if(!connection.writing && connection.unsent.empty()){
+        ssize_t n = sendSome(connection.fd, header, payload, bytes);
+        if(n < 0){
+            disconnect(connection);
+            return false;
+        }
+        sent = n;
+    }
+    if(sent == total)
+        return true;
+    // One reply is always queued however large it is; a client that lets
+    // them pile up beyond maxUnsentBytes is dropped.
+    if(!connection.unsent.empty() && connection.unsent.size() + (total - sent) > m_options.maxUnsentBytes){
+        disconnect(connection);
+        return false;
+    }
+    if(sent < sizeof(header)){
+        connection.unsent.insert(connection.unsent.end(), (const char *)&header + sent, (const char *)(&header + 1));
+        sent = sizeof(header);
+    }
+    const char *rest = (const char *)payload + (sent - sizeof(header));
+    connection.unsent.insert(connection.unsent.end(), rest, (const char *)payload + bytes);
+    connection.writeReady.notify_one();
+    return true;
+}
+
+// Sends what reply() left queued, blocking only this connection, until the
+// reader is done and the queue is empty or the peer has gone.
+void InferenceServer::writeLoop(std::shared_ptr<Connection> connection){
+    std::vector<char> sending;
+    std::unique_lock<std::mutex> lock(connection->writeMutex);
+    while(true){
+        connection->writeReady.wait(lock, [&connection]{
+            return connection->closing || connection->broken || !connection->unsent.empty();
+        });
+        if(connection->broken || connection->unsent.empty())
+            break;
+        sending.swap(connection->unsent);
+        connection->writing = true;
+        lock.unlock();
+        bool sent = sendAll(connection->fd, sending.data(), sending.size());
+        sending.clear();
+        lock.lock();
+        connection->writing = false;
+        if(!sent)
+            disconnect(*connection);
+    }
+}
+
+void InferenceServer::readLoop(std::shared_ptr<Connection> connection){
+    ServeHeader header;
+    while(!m_stop && readAll(connection->fd, &header, sizeof(header))){
+        if(header.magic != SERVE_MAGIC){
+            reply(*connection, SERVE_BAD_REQUEST, header.id, 0, NULL, 0);
+            break;
+        }
+        if(header.type == SERVE_INFO){
+            reply(*connection, SERVE_OK, header.id, m_topology.size(), m_topology.data(),
+                  m_topology.size() * sizeof(unsigned));
+            continue;
+        }
+        if(header.type == SERVE_STATS){
+            std::string json = statsJson();
+            reply(*connection, SERVE_OK, header.id, json.size(), json.data(), json.size());
+            continue;
+        }
+        if(header.type != SERVE_PREDICT || header.count == 0 || header.count > SERVE_MAX_SAMPLES){
+            reply(*connection, SERVE_BAD_REQUEST, header.id, 0, NULL, 0);
+            break;
+        }
+        Request request;
+        request.connection = connection;
+        request.id = header.id;
+        request.count = header.count;
+        request.inputs.resize((size_t)header.count * m_numInputs);
+        if(!readAll(connection->fd, request.inputs.data(), request.inputs.size() * sizeof(float)))
+            break;
+        request.arrived = Clock::now();
+        bool accepted;
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            accepted = m_queuedSamples + header.count <= m_options.maxQueued;
+            if(accepted){
+                m_queuedSamples += header.count;
+                m_queue.push_back(std::move(request));
+            }
+        }
+        if(accepted){
+            m_queueReady.notify_one();
+        } else {
+            // Answered at once, so it may overtake earlier replies.
+            {
+                std::lock_guard<std::mutex> lock(m_statsMutex);
+                m_total.rejected++;
+                m_interval.rejected++;
+            }
+            reply(*connection, SERVE_OVERLOADED, header.id, 0, NULL, 0);
+        }
+    }
+    // Lets the writer flush a final SERVE_BAD_REQUEST before the shutdown.
+    {
+        std::lock_guard<std::mutex> lock(connection->writeMutex);
+        connection->closing = true;
+    }
+    connection->writeReady.notify_one();
+    connection->writer.join();
+    shutdown(connection->fd, SHUT_RDWR);
+    connection->done = true;
+}
+
+void InferenceServer::dispatchLoop(void){
+    std::vector<Request> batch;
+    std::unique_lock<std::mutex> lock(m_queueMutex);
+    while(true){
+        m_queueReady.wait(lock, [this]{ return m_stop || !m_queue.empty(); });
+        if(m_stop)
+            break;
+        Clock::time_point deadline = m_queue.front().arrived + std::chrono::microseconds(m_options.latencyBudgetUs);
+        while(!m_stop && m_queuedSamples < m_options.maxBatch
+              && m_queueReady.wait_until(lock, deadline) != std::cv_status::timeout){
+        }
+        if(m_stop)
+            break;
+        // Whole requests up to maxBatch samples, and always at least one.
+        size_t samples = 0;
+        while(!m_queue.empty() && (batch.empty() || samples + m_queue.front().count <= m_options.maxBatch)){
+            samples += m_queue.front().count;
+            batch.push_back(std::move(m_queue.front()));
+            m_queue.pop_front();
+        }
+        m_queuedSamples -= samples;
+        lock.unlock();
+        runBatch(batch);
+        batch.clear();
+        lock.lock();
+    }
+}
+
+void InferenceServer::runBatch(std::vector<Request> &batch){
+    size_t rows = 0;
+    for(size_t r = 0; r < batch.size(); r++)
+        rows += batch[r].count;
+    const float *inputs = batch[0].inputs.data();
+    if(batch.size() > 1){
+        m_batchInputs.resize(rows * m_numInputs);
+        size_t offset = 0;
+        for(size_t r = 0; r < batch.size(); r++){
+            std::copy(batch[r].inputs.begin(), batch[r].inputs.end(), m_batchInputs.begin() + offset);
+            offset += batch[r].inputs.size();
+        }
+        inputs = m_batchInputs.data();
+    }
+    m_batchOutputs.resize(rows * m_numOutputs);
+    // Held until the batch is done, so a publish cannot recycle it meanwhile.
+    std::shared_ptr<const NetSnapshot> snapshot;
+    if(m_snapshots != NULL)
+        snapshot = m_snapshots->current();
+    const Net &net = snapshot ? snapshot->net : *m_net;
+    // One chunk per thread, but not so small that the GEMM tiles go empty.
+    size_t chunk = std::max<size_t>(32, (rows + m_pool.size() - 1) / m_pool.size());
+    unsigned numChunks = (rows + chunk - 1) / chunk;
+    if(numChunks == 1){
+        net.predictBatch(inputs, rows, m_batchOutputs.data(), m_workspaces[0]);
+    } else {
+        m_pool.parallelFor(numChunks, [&](unsigned c, unsigned thread){
+            size_t first = c * chunk;
+            net.predictBatch(inputs + first * m_numInputs, std::min(chunk, rows - first),
+                               m_batchOutputs.data() + first * m_numOutputs, m_workspaces[thread]);
+        });
+    }
+
+    size_t first = 0;
+    std::vector<double> latencies(batch.size());
+    for(size_t r = 0; r < batch.size(); r++){
+        Request &request = batch[r];
+        reply(*request.connection, SERVE_OK, request.id, request.count, &m_batchOutputs[first * m_numOutputs],
+              (size_t)request.count * m_numOutputs * sizeof(float));
+        latencies[r] = std::chrono::duration<double>(Clock::now() - request.arrived).count();
+        first += request.count;
+    }
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    Counters *counters[] = {&m_total, &m_interval};
+    for(Counters *c : counters){
+        c->requests += batch.size();
+        c->samples += rows;
+        c->batches++;
+        for(double latency : latencies)
+            c->latency.record(latency);
+    }
+}
+
+ServeStats InferenceServer::summarize(const Counters &counters) const{
+    ServeStats s;
+    s.seconds = std::chrono::duration<double>(Clock::now() - counters.start).count();
+    s.requests = counters.requests;
+    s.samples = counters.samples;
+    s.batches = counters.batches;
+    s.rejected = counters.rejected;
+    s.qps = s.seconds > 0 ? s.requests / s.seconds : 0.0;
+    s.p50 = counters.latency.quantile(0.5);
+    s.p99 = counters.latency.quantile(0.99);
+    s.maxLatency = counters.latency.max();
+    s.meanBatch = s.batches > 0 ? (double)s.samples / s.batches : 0.0;
+    return s;
+}
+
+ServeStats InferenceServer::stats(void) const{
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    return summarize(m_total);
+}
+
+ServeStats InferenceServer::intervalStats(void){
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    ServeStats s = summarize(m_interval);
+    m_interval = Counters();
+    m_interval.start = Clock::now();
+    m_interval.requests = m_interval.samples = m_interval.batches = m_interval.rejected = 0;
+    return s;
+}
+
+std::string InferenceServer::statsJson(void) const{
+    ServeStats s = stats();
+    std::ostringstream json;
+    json << "{\"seconds\":" << s.seconds << ",\"requests\":" << s.requests << ",\"samples\":" << s.samples
+         << ",\"batches\":" << s.batches << ",\"rejected\":" << s.rejected << ",\"qps\":" << s.qps
+         << ",\"p50_us\":" << s.p50 * 1e6 << ",\"p99_us\":" << s.p99 * 1e6
+         << ",\"max_us\":" << s.maxLatency * 1e6 << ",\"mean_batch\":" << s.meanBatch << "}";
+    return json.str();
+}
+
+bool InferenceClient::connect(const std::string &path){
+    struct sockaddr_un address;
+    close();
+    if(!socketAddress(path, address))
+        return false;
+    m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(m_fd < 0)
+        return false;
+    ServeHeader header;
+    std::vector<char> payload;
+    if(::connect(m_fd, (struct sockaddr *)&address, sizeof(address)) != 0
+       || !request(SERVE_INFO, header, payload) || header.count < 2){
+        close();
+        return false;
+    }
+    m_topology.resize(header.count);
+    memcpy(m_topology.data(), payload.data(), header.count * sizeof(unsigned));
+    m_numInputs = m_topology.front();
+    m_numOutputs = m_topology.back();
+    return true;
+}
+
+void InferenceClient::close(void){
+    if(m_fd >= 0)
+        ::close(m_fd);
+    m_fd = -1;
+}
+
+bool InferenceClient::request(uint32_t type, ServeHeader &header, std::vector<char> &payload){
+    ServeHeader sent = {SERVE_MAGIC, type, 0, 0};
+    if(!writeAll(m_fd, sent, NULL, 0) || !readAll(m_fd, &header, sizeof(header))
+       || header.magic != SERVE_MAGIC || header.type != SERVE_OK)
+        return false;
+    payload.resize(type == SERVE_INFO ? header.count * sizeof(unsigned) : header.count);
+    return readAll(m_fd, payload.data(), payload.size());
+}
+
+bool InferenceClient::send(uint32_t id, const float *inputs, uint32_t count){
+    ServeHeader header = {SERVE_MAGIC, SERVE_PREDICT, id, count};
+    return m_fd >= 0 && writeAll(m_fd, header, inputs, (size_t)count * m_numInputs * sizeof(float));
+}
+
+bool InferenceClient::receive(ServeHeader &header, std::vector<float> &outputs){
+    if(m_fd < 0 || !readAll(m_fd, &header, sizeof(header)) || header.magic != SERVE_MAGIC)
+        return false;
+    outputs.resize(header.type == SERVE_OK ? (size_t)header.count * m_numOutputs : 0);
+    return readAll(m_fd, outputs.data(), outputs.size() * sizeof(float));
+}
+
+bool InferenceClient::predict(const float *inputs, uint32_t count, float *outputs){
+    ServeHeader header;
+    if(!send(0, inputs, count) || !receive(header, m_scratch) || header.type != SERVE_OK)
+        return false;
+    std::copy(m_scratch.begin(), m_scratch.end(), outputs);
+    return true;
+}
+
+bool InferenceClient::stats(std::string &json){
+    ServeHeader header;
+    std::vector<char> payload;
+    if(m_fd < 0 || !request(SERVE_STATS, header, payload))
+        return false;
+    json.assign(payload.begin(), payload.end());
+    return true;
+}
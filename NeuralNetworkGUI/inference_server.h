@@ -0,0 +1,202 @@
+#ifndef INFERENCE_SERVER_H
+#define INFERENCE_SERVER_H
+
+
+#include "all_class.h"
+#include "thread_pool.h"
+#include "snapshots.h"
+
+// Wire format over a Unix domain socket, host byte order (both ends are on
+// the same machine). Every message is a ServeHeader and a payload:
+//
+//   request  SERVE_PREDICT  count samples, count * numInputs float32
+//            SERVE_INFO     count 0; the reply's count is the number of
+//                           layers and its payload the topology as uint32
+//            SERVE_STATS    count 0; the reply's payload is count bytes of
+//                           JSON (see InferenceServer::statsJson)
+//   reply    same id as the request, type holds a ServeStatus; a
+//            SERVE_PREDICT reply has count * numOutputs float32
+//
+// A connection may send several SERVE_PREDICT requests without waiting;
+// their replies come back in order. SERVE_INFO, SERVE_STATS and
+// SERVE_OVERLOADED replies are sent at once and may overtake them. A
+// malformed request gets SERVE_BAD_REQUEST and the connection is closed,
+// as is one that leaves more than maxUnsentBytes of replies unread.
+#define SERVE_MAGIC 0x314e4e53u // "SNN1"
+#define SERVE_MAX_SAMPLES 65536 // per request
+
+enum ServeRequestType {
+    SERVE_PREDICT = 1,
+    SERVE_INFO = 2,
+    SERVE_STATS = 3
+};
+
+enum ServeStatus {
+    SERVE_OK = 0,
+    SERVE_BAD_REQUEST = 1,
+    SERVE_OVERLOADED = 2  // more than maxQueued samples waiting; nothing was run
+};
+
+struct ServeHeader {
+    uint32_t magic;
+    uint32_t type;   // ServeRequestType, or ServeStatus in a reply
+    uint32_t id;     // chosen by the client, echoed in the reply
+    uint32_t count;
+};
+
+struct ServeOptions {
+    unsigned threads;          // pool running each batch, 0 = all cores
+    unsigned maxBatch;         // samples per forward pass
+    unsigned latencyBudgetUs;  // how long the oldest request may wait for a batch to fill
+    unsigned maxQueued;        // queued samples beyond which requests are refused
+    size_t maxUnsentBytes;     // replies a client may leave unread before it is dropped
+    ServeOptions() : threads(1), maxBatch(256), latencyBudgetUs(500), maxQueued(1 << 16), maxUnsentBytes(64 << 20) {}
+};
+
+// Request latencies in logarithmic buckets, eight per power of two from
+// 100ns up, so quantiles are within ~9% at any scale.
+class LatencyHistogram{
+public:
+    LatencyHistogram() : m_buckets(BUCKETS, 0), m_count(0), m_sum(0.0), m_max(0.0) {}
+    void record(double seconds);
+    void merge(const LatencyHistogram &other);
+    // Upper edge of the bucket holding quantile q (0..1), in seconds.
+    double quantile(double q) const;
+    unsigned long long count(void) const { return m_count; }
+    double mean(void) const { return m_count > 0 ? m_sum / m_count : 0.0; }
+    double max(void) const { return m_max; }
+private:
+    enum { PER_OCTAVE = 8, BUCKETS = PER_OCTAVE * 40 };
+    std::vector<unsigned long long> m_buckets;
+    unsigned long long m_count;
+    double m_sum;
+    double m_max;
+};
+
+struct ServeStats {
+    double seconds;            // since the server started, or since the last interval
+    unsigned long long requests, samples, batches, rejected;
+    double qps;                // requests per second over seconds
+    double p50, p99, maxLatency; // request latency in seconds, arrival to reply sent or queued
+    double meanBatch;          // samples per forward pass
+};
+
+// Serves one Net to local processes. A thread per connection reads
+// requests into a queue; a dispatcher thread waits until maxBatch samples
+// are queued or the oldest request has waited latencyBudgetUs, runs the
+// batch through Net::predictBatch split across the pool, and writes the
+// replies. While one batch runs the next one fills, so batches grow with
+// the load. The Net is only read and must outlive the server.
+//
+// Replies never block the dispatcher: what a socket will not take at once
+// is queued on the connection and sent by its own writer thread, so a
+// client that stops reading only delays itself.
+//
+// Given NetSnapshots instead, every batch runs on the current snapshot, so
+// a Net being trained elsewhere is served as it improves; a batch never
+// mixes two snapshots. Their topology must not change.
+class InferenceServer{
+public:
+    InferenceServer(const Net &net, const ServeOptions &options = ServeOptions());
+    InferenceServer(const NetSnapshots &snapshots, const ServeOptions &options = ServeOptions());
+    ~InferenceServer();
+    InferenceServer(const InferenceServer &) = delete;
+    InferenceServer &operator=(const InferenceServer &) = delete;
+    // Binds path (replacing a stale socket file) and starts serving. False
+    // if the socket cannot be created.
+    bool listen(const std::string &path);
+    // Closes every connection and the socket; queued requests are dropped.
+    void stop(void);
+    ServeStats stats(void) const;
+    // Counters since the previous call (or since the start).
+    ServeStats intervalStats(void);
+    std::string statsJson(void) const;
+private:
+    typedef std::chrono::steady_clock Clock;
+    struct Connection {
+        int fd;
+        std::mutex writeMutex;        // guards the fields up to broken
+        std::condition_variable writeReady;
+        std::vector<char> unsent;     // reply bytes the socket has not taken yet
+        bool writing;                 // the writer is sending bytes taken from unsent
+        bool closing;                 // the reader is done; flush unsent and stop
+        bool broken;                  // shut down; replies are dropped
+        std::atomic<bool> done;
+        std::thread reader, writer;
+        Connection(int f) : fd(f), writing(false), closing(false), broken(false), done(false) {}
+    };
+    struct Request {
+        std::shared_ptr<Connection> connection;
+        uint32_t id;
+        uint32_t count;
+        std::vector<float> inputs;
+        Clock::time_point arrived;
+    };
+    struct Counters {
+        Clock::time_point start;
+        unsigned long long requests, samples, batches, rejected;
+        LatencyHistogram latency;
+    };
+    void acceptLoop(void);
+    void readLoop(std::shared_ptr<Connection> connection);
+    void writeLoop(std::shared_ptr<Connection> connection);
+    static void disconnect(Connection &connection);
+    void dispatchLoop(void);
+    void runBatch(std::vector<Request> &batch);
+    bool reply(Connection &connection, uint32_t status, uint32_t id, uint32_t count,
+               const void *payload, size_t bytes);
+    ServeStats summarize(const Counters &counters) const;
+    void init(const Net &net);
+    const Net *m_net;                  // NULL when serving snapshots
+    const NetSnapshots *m_snapshots;
+    ServeOptions m_options;
+    unsigned m_numInputs, m_numOutputs;
+    std::vector<unsigned> m_topology;
+    ThreadPool m_pool;
+    std::vector<PredictWorkspace> m_workspaces;
+    std::vector<float> m_batchInputs, m_batchOutputs;
+    std::string m_path;
+    int m_listenFd;
+    std::atomic<bool> m_stop;
+    std::thread m_acceptor, m_dispatcher;
+    std::mutex m_connectionMutex;
+    std::vector<std::shared_ptr<Connection> > m_connections;
+    std::mutex m_queueMutex;
+    std::condition_variable m_queueReady;
+    std::deque<Request> m_queue;
+    size_t m_queuedSamples;
+    mutable std::mutex m_statsMutex;
+    Counters m_total, m_interval;
+};
+
+// Blocking client for InferenceServer. send() and receive() may be
+// interleaved to keep several requests in flight on one connection; call
+// stats() only with none outstanding.
+class InferenceClient{
+public:
+    InferenceClient() : m_fd(-1), m_numInputs(0), m_numOutputs(0) {}
+    ~InferenceClient() { close(); }
+    InferenceClient(const InferenceClient &) = delete;
+    InferenceClient &operator=(const InferenceClient &) = delete;
+    // Connects and asks for the topology.
+    bool connect(const std::string &path);
+    void close(void);
+    unsigned numInputs(void) const { return m_numInputs; }
+    unsigned numOutputs(void) const { return m_numOutputs; }
+    const std::vector<unsigned> &topology(void) const { return m_topology; }
+    bool send(uint32_t id, const float *inputs, uint32_t count);
+    // The next reply; outputs gets its payload as float32.
+    bool receive(ServeHeader &header, std::vector<float> &outputs);
+    // send + receive; false unless the reply is SERVE_OK.
+    bool predict(const float *inputs, uint32_t count, float *outputs);
+    bool stats(std::string &json);
+private:
+    bool request(uint32_t type, ServeHeader &header, std::vector<char> &payload);
+    int m_fd;
+    unsigned m_numInputs, m_numOutputs;
+    std::vector<unsigned> m_topology;
+    std::vector<float> m_scratch;
+};
+
+
+#endif // INFERENCE_SERVER_H
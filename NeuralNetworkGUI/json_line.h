@@ -0,0 +1,33 @@
+#ifndef JSON_LINE_H
+#define JSON_LINE_H
+
+
+#include<bits/stdc++.h>
+
+// Reading back the flat one-object-per-line JSON this project writes itself
+// (the sweep journal, bench_suite results), not JSON in general: no nesting,
+// no escapes inside strings.
+
+// The text after "key": on line, up to the next , or }; quotes stripped.
+// False if the key is missing or its value is cut short, as in the last line
+// of a file whose writer was interrupted.
+inline bool jsonField(const std::string &line, const std::string &key, std::string &value){
+    size_t at = line.find("\"" + key + "\":");
+    if(at == std::string::npos)
+        return false;
+    size_t begin = line.find_first_not_of(' ', at + key.size() + 3);
+    if(begin == std::string::npos)
+        return false;
+    size_t end;
+    if(line[begin] == '"')
+        end = line.find('"', ++begin);
+    else
+        end = line.find_first_of(",}", begin);
+    if(end == std::string::npos)
+        return false;
+    value = line.substr(begin, end - begin);
+    return true;
+}
+
+
+#endif // JSON_LINE_H
@@ -0,0 +1,1048 @@
+#include "kernels.h"
+
+#include<bits/stdc++.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include<immintrin.h>
+#define NN_X86 1
+#endif
+
+// ****************** scalar ******************
+// These are the loops Net used before the kernels existed, kept in the same
+// evaluation order so NN_KERNEL=scalar reproduces those results exactly.
+
+template<class T>
+static T dotScalar(const T *a, const T *b, unsigned n){
+    T sum = 0.0;
+    for(unsigned i = 0; i < n; i++)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+template<class T>
+static void axpyScalar(T *y, const T *x, T a, unsigned n){
+    for(unsigned i = 0; i < n; i++)
+        y[i] += x[i] * a;
+}
+
+template<class T>
+static void momentumUpdateScalar(T *weight, T *deltaWeight, const T *input,
+                                 T gradient, T rate, T momentum, unsigned n){
+    for(unsigned i = 0; i < n; i++){
+        T newDeltaWeight = rate * input[i] * gradient + momentum * deltaWeight[i];
+        deltaWeight[i] = newDeltaWeight;
+        weight[i] += newDeltaWeight;
+    }
+}
+
+// axpyScalar(upstream, weight, gradient) and momentumUpdateScalar in one
+// pass; upstream sees each weight before its update.
+template<class T>
+static void momentumBackwardScalar(T *weight, T *deltaWeight, T *upstream, const T *input,
+                                   T gradient, T rate, T momentum, unsigned n){
+    for(unsigned i = 0; i < n; i++){
+        upstream[i] += weight[i] * gradient;
+        T newDeltaWeight = rate * input[i] * gradient + momentum * deltaWeight[i];
+        deltaWeight[i] = newDeltaWeight;
+        weight[i] += newDeltaWeight;
+    }
+}
+
+template<class T>
+static void gemmTileScalar(unsigned k, const T *a, const T *b, T *c){
+    T acc[GEMM_MR][GEMM_NR] = {};
+    for(unsigned p = 0; p < k; p++, a += GEMM_MR, b += GEMM_NR)
+        for(unsigned i = 0; i < GEMM_MR; i++)
+            for(unsigned j = 0; j < GEMM_NR; j++)
+                acc[i][j] += a[i] * b[j];
+    memcpy(c, acc, sizeof(acc));
+}
+
+template<class T>
+static void expScalar(T *x, unsigned n){
+    for(unsigned i = 0; i < n; i++)
+        x[i] = std::exp(x[i]);
+}
+
+template<class T>
+static void sigmoidScalar(T *x, unsigned n){
+    for(unsigned i = 0; i < n; i++)
+        x[i] = T(1) / (T(1) + std::exp(-x[i]));
+}
+
+template<class T>
+static void tanhScalar(T *x, unsigned n){
+    for(unsigned i = 0; i < n; i++)
+        x[i] = std::tanh(x[i]);
+}
+
+enum { RULE_NESTEROV, RULE_RMSPROP, RULE_ADAM };
+
+// One element of an update rule: the scalar kernels, and the SIMD tails.
+template<int rule, class T>
+static inline void updateElement(T &weight, T &first, T *second, T *upstream, T input, T gradient,
+                                 const OptimizerStepT<T> &s){
+    if(upstream != NULL)
+        *upstream += weight * gradient;
+    T g = input * gradient - s.l2 * weight;
+    if(rule == RULE_NESTEROV){
+        T step = s.rate * g;
+        first = s.momentum * first + step;
+        weight += s.momentum * first + step;
+    } else if(rule == RULE_RMSPROP){
+        first = s.decay * first + (T(1) - s.decay) * (g * g);
+        weight += s.rate * (g / (std::sqrt(first) + s.epsilon));
+    } else {
+        first = s.momentum * first + (T(1) - s.momentum) * g;
+        *second = s.decay * *second + (T(1) - s.decay) * (g * g);
+        weight += s.rate * (first / (std::sqrt(*second) + s.epsilon)) - s.shrink * weight;
+    }
+}
+
+template<int rule, class T>
+static void optimizerUpdateScalar(T *weight, T *first, T *second, T *upstream, const T *input, T gradient,
+                                  const OptimizerStepT<T> &step, unsigned n){
+    for(unsigned i = 0; i < n; i++)
+        updateElement<rule>(weight[i], first[i], rule == RULE_ADAM ? second + i : NULL,
+                            upstream != NULL ? upstream + i : NULL, input[i], gradient, step);
+}
+
+template<class T, class In>
+static void scaleInputsScalar(T *out, const In *in, const T *offset, const T *scale, unsigned n){
+    for(unsigned i = 0; i < n; i++)
+        out[i] = (T(in[i]) - offset[i]) * scale[i];
+}
+
+static int32_t dotU8S8Scalar(const uint8_t *a, const int8_t *b, unsigned n){
+    int32_t sum = 0;
+    for(unsigned i = 0; i < n; i++)
+        sum += (int32_t)a[i] * b[i];
+    return sum;
+}
+
+#ifdef NN_X86
+// ****************** AVX2 ******************
+
+__attribute__((target("avx2,fma")))
+static double dotAvx2(const double *a, const double *b, unsigned n){
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    __m256d acc2 = _mm256_setzero_pd(), acc3 = _mm256_setzero_pd();
+    unsigned i = 0;
+    for(; i + 16 <= n; i += 16){
+        acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i),      _mm256_loadu_pd(b + i),      acc0);
+        acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4),  _mm256_loadu_pd(b + i + 4),  acc1);
+        acc2 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 8),  _mm256_loadu_pd(b + i + 8),  acc2);
+        acc3 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 12), _mm256_loadu_pd(b + i + 12), acc3);
+    }
+    for(; i + 4 <= n; i += 4)
+        acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), acc0);
+    __m256d acc = _mm256_add_pd(_mm256_add_pd(acc0, acc1), _mm256_add_pd(acc2, acc3));
+    __m128d half = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+    double sum = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+    for(; i < n; i++)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+__attribute__((target("avx2,fma")))
+static void axpyAvx2(double *y, const double *x, double a, unsigned n){
+    __m256d va = _mm256_set1_pd(a);
+    unsigned i = 0;
+    for(; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(y + i, _mm256_fmadd_pd(_mm256_loadu_pd(x + i), va, _mm256_loadu_pd(y + i)));
+    for(; i < n; i++)
+        y[i] += x[i] * a;
+}
+
+__attribute__((target("avx2,fma")))
+static void momentumUpdateAvx2(double *weight, double *deltaWeight, const double *input,
+                               double gradient, double rate, double momentum, unsigned n){
+    __m256d vrg = _mm256_set1_pd(rate * gradient);
+    __m256d vm = _mm256_set1_pd(momentum);
+    unsigned i = 0;
+    for(; i + 4 <= n; i += 4){
+        __m256d d = _mm256_fmadd_pd(vm, _mm256_loadu_pd(deltaWeight + i),
+                                    _mm256_mul_pd(vrg, _mm256_loadu_pd(input + i)));
+        _mm256_storeu_pd(deltaWeight + i, d);
+        _mm256_storeu_pd(weight + i, _mm256_add_pd(_mm256_loadu_pd(weight + i), d));
+    }
+    for(; i < n; i++){
+        double newDeltaWeight = rate * input[i] * gradient + momentum * deltaWeight[i];
+        deltaWeight[i] = newDeltaWeight;
+        weight[i] += newDeltaWeight;
+    }
+}
+
+// axpyAvx2(upstream, weight, gradient) and momentumUpdateAvx2 in one pass,
+// with the same arithmetic, so the results match the two calls bit for bit.
+__attribute__((target("avx2,fma")))
+static void momentumBackwardAvx2(double *weight, double *deltaWeight, double *upstream, const double *input,
+                                 double gradient, double rate, double momentum, unsigned n){
+    __m256d vg = _mm256_set1_pd(gradient);
+    __m256d vrg = _mm256_set1_pd(rate * gradient);
+    __m256d vm = _mm256_set1_pd(momentum);
+    unsigned i = 0;
+    for(; i + 4 <= n; i += 4){
+        __m256d w = _mm256_loadu_pd(weight + i);
+        _mm256_storeu_pd(upstream + i, _mm256_fmadd_pd(w, vg, _mm256_loadu_pd(upstream + i)));
+        __m256d d = _mm256_fmadd_pd(vm, _mm256_loadu_pd(deltaWeight + i),
+                                    _mm256_mul_pd(vrg, _mm256_loadu_pd(input + i)));
+        _mm256_storeu_pd(deltaWeight + i, d);
+        _mm256_storeu_pd(weight + i, _mm256_add_pd(w, d));
+    }
+    for(; i < n; i++){
+        upstream[i] += weight[i] * gradient;
+        double newDeltaWeight = rate * input[i] * gradient + momentum * deltaWeight[i];
+        deltaWeight[i] = newDeltaWeight;
+        weight[i] += newDeltaWeight;
+    }
+}
+
+template<int rule>
+__attribute__((target("avx2,fma")))
+static void optimizerUpdateAvx2(double *weight, double *first, double *second, double *upstream,
+                                const double *input, double gradient, const OptimizerStepT<double> &s, unsigned n){
+    __m256d vgrad = _mm256_set1_pd(gradient), vl2 = _mm256_set1_pd(s.l2);
+    __m256d vrate = _mm256_set1_pd(s.rate), vmom = _mm256_set1_pd(s.momentum), vdecay = _mm256_set1_pd(s.decay);
+    __m256d veps = _mm256_set1_pd(s.epsilon), vshrink = _mm256_set1_pd(s.shrink);
+    __m256d vmom1 = _mm256_set1_pd(1.0 - s.momentum), vdecay1 = _mm256_set1_pd(1.0 - s.decay);
+    unsigned i = 0;
+    for(; i + 4 <= n; i += 4){
+        __m256d w = _mm256_loadu_pd(weight + i), f = _mm256_loadu_pd(first + i);
+        if(upstream != NULL)
+            _mm256_storeu_pd(upstream + i, _mm256_fmadd_pd(w, vgrad, _mm256_loadu_pd(upstream + i)));
+        __m256d g = _mm256_fnmadd_pd(vl2, w, _mm256_mul_pd(_mm256_loadu_pd(input + i), vgrad));
+        if(rule == RULE_NESTEROV){
+            __m256d step = _mm256_mul_pd(vrate, g);
+            f = _mm256_fmadd_pd(vmom, f, step);
+            w = _mm256_add_pd(w, _mm256_fmadd_pd(vmom, f, step));
+        } else if(rule == RULE_RMSPROP){
+            f = _mm256_fmadd_pd(vdecay, f, _mm256_mul_pd(vdecay1, _mm256_mul_pd(g, g)));
+            w = _mm256_fmadd_pd(vrate, _mm256_div_pd(g, _mm256_add_pd(_mm256_sqrt_pd(f), veps)), w);
+        } else {
+            __m256d v = _mm256_loadu_pd(second + i);
+            f = _mm256_fmadd_pd(vmom, f, _mm256_mul_pd(vmom1, g));
+            v = _mm256_fmadd_pd(vdecay, v, _mm256_mul_pd(vdecay1, _mm256_mul_pd(g, g)));
+            _mm256_storeu_pd(second + i, v);
+            w = _mm256_fmadd_pd(vrate, _mm256_div_pd(f, _mm256_add_pd(_mm256_sqrt_pd(v), veps)),
+                                _mm256_fnmadd_pd(vshrink, w, w));
+        }
+        _mm256_storeu_pd(first + i, f);
+        _mm256_storeu_pd(weight + i, w);
+    }
+    for(; i < n; i++)
+        updateElement<rule>(weight[i], first[i], rule == RULE_ADAM ? second + i : NULL,
+                            upstream != NULL ? upstream + i : NULL, input[i], gradient, s);
+}
+
+__attribute__((target("avx2,fma")))
+static void gemmTileAvx2(unsigned k, const double *a, const double *b, double *c){
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+    __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+    __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+    __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+    for(unsigned p = 0; p < k; p++, a += GEMM_MR, b += GEMM_NR){
+        __m256d b0 = _mm256_loadu_pd(b), b1 = _mm256_loadu_pd(b + 4);
+        __m256d a0 = _mm256_broadcast_sd(a), a1 = _mm256_broadcast_sd(a + 1);
+        c00 = _mm256_fmadd_pd(a0, b0, c00); c01 = _mm256_fmadd_pd(a0, b1, c01);
+        c10 = _mm256_fmadd_pd(a1, b0, c10); c11 = _mm256_fmadd_pd(a1, b1, c11);
+        __m256d a2 = _mm256_broadcast_sd(a + 2), a3 = _mm256_broadcast_sd(a + 3);
+        c20 = _mm256_fmadd_pd(a2, b0, c20); c21 = _mm256_fmadd_pd(a2, b1, c21);
+        c30 = _mm256_fmadd_pd(a3, b0, c30); c31 = _mm256_fmadd_pd(a3, b1, c31);
+    }
+    _mm256_storeu_pd(c,      c00); _mm256_storeu_pd(c + 4,  c01);
+    _mm256_storeu_pd(c + 8,  c10); _mm256_storeu_pd(c + 12, c11);
+    _mm256_storeu_pd(c + 16, c20); _mm256_storeu_pd(c + 20, c21);
+    _mm256_storeu_pd(c + 24, c30); _mm256_storeu_pd(c + 28, c31);
+}
+
+// ****************** AVX-512 ******************
+
+__attribute__((target("avx512f")))
+static double dotAvx512(const double *a, const double *b, unsigned n){
+    __m512d acc0 = _mm512_setzero_pd(), acc1 = _mm512_setzero_pd();
+    unsigned i = 0;
+    for(; i + 16 <= n; i += 16){
+        acc0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i),     _mm512_loadu_pd(b + i),     acc0);
+        acc1 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8), acc1);
+    }
+    if(i + 8 <= n){
+        acc0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), acc0);
+        i += 8;
+    }
+    if(i < n){
+        __mmask8 m = (__mmask8)((1u << (n - i)) - 1);
+        acc1 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(m, a + i), _mm512_maskz_loadu_pd(m, b + i), acc1);
+    }
+    alignas(64) double lanes[8];
+    _mm512_store_pd(lanes, _mm512_add_pd(acc0, acc1));
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+}
+
+__attribute__((target("avx512f")))
+static void axpyAvx512(double *y, const double *x, double a, unsigned n){
+    __m512d va = _mm512_set1_pd(a);
+    unsigned i = 0;
+    for(; i + 8 <= n; i += 8)
+        _mm512_storeu_pd(y + i, _mm512_fmadd_pd(_mm512_loadu_pd(x + i), va, _mm512_loadu_pd(y + i)));
+    if(i < n){
+        __mmask8 m = (__mmask8)((1u << (n - i)) - 1);
+        __m512d r = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(m, x + i), va, _mm512_maskz_loadu_pd(m, y + i));
+        _mm512_mask_storeu_pd(y + i, m, r);
+    }
+}
+
+__attribute__((target("avx512f")))
+static void momentumUpdateAvx512(double *weight, double *deltaWeight, const double *input,
+                                 double gradient, double rate, double momentum, unsigned n){
+    __m512d vrg = _mm512_set1_pd(rate * gradient);
+    __m512d vm = _mm512_set1_pd(momentum);
+    unsigned i = 0;
+    for(; i + 8 <= n; i += 8){
+        __m512d d = _mm512_fmadd_pd(vm, _mm512_loadu_pd(deltaWeight + i),
+                                    _mm512_mul_pd(vrg, _mm512_loadu_pd(input + i)));
+        _mm512_storeu_pd(deltaWeight + i, d);
+        _mm512_storeu_pd(weight + i, _mm512_add_pd(_mm512_loadu_pd(weight + i), d));
+    }
+    if(i < n){
+        __mmask8 m = (__mmask8)((1u << (n - i)) - 1);
+        __m512d d = _mm512_fmadd_pd(vm, _mm512_maskz_loadu_pd(m, deltaWeight + i),
+                                    _mm512_mul_pd(vrg, _mm512_maskz_loadu_pd(m, input + i)));
+        _mm512_mask_storeu_pd(deltaWeight + i, m, d);
+        _mm512_mask_storeu_pd(weight + i, m, _mm512_add_pd(_mm512_maskz_loadu_pd(m, weight + i), d));
+    }
+}
+
+__attribute__((target("avx512f")))
+static void momentumBackwardAvx512(double *weight, double *deltaWeight, double *upstream, const double *input,
+                                   double gradient, double rate, double momentum, unsigned n){
+    __m512d vg = _mm512_set1_pd(gradient);
+    __m512d vrg = _mm512_set1_pd(rate * gradient);
+    __m512d vm = _mm512_set1_pd(momentum);
+    unsigned i = 0;
+    for(; i + 8 <= n; i += 8){
+        __m512d w = _mm512_loadu_pd(weight + i);
+        _mm512_storeu_pd(upstream + i, _mm512_fmadd_pd(w, vg, _mm512_loadu_pd(upstream + i)));
+        __m512d d = _mm512_fmadd_pd(vm, _mm512_loadu_pd(deltaWeight + i),
+                                    _mm512_mul_pd(vrg, _mm512_loadu_pd(input + i)));
+        _mm512_storeu_pd(deltaWeight + i, d);
+        _mm512_storeu_pd(weight + i, _mm512_add_pd(w, d));
+    }
+    if(i < n){
+        __mmask8 m = (__mmask8)((1u << (n - i)) - 1);
+        __m512d w = _mm512_maskz_loadu_pd(m, weight + i);
+        _mm512_mask_storeu_pd(upstream + i, m, _mm512_fmadd_pd(w, vg, _mm512_maskz_loadu_pd(m, upstream + i)));
+        __m512d d = _mm512_fmadd_pd(vm, _mm512_maskz_loadu_pd(m, deltaWeight + i),
+                                    _mm512_mul_pd(vrg, _mm512_maskz_loadu_pd(m, input + i)));
+        _mm512_mask_storeu_pd(deltaWeight + i, m, d);
+        _mm512_mask_storeu_pd(weight + i, m, _mm512_add_pd(w, d));
+    }
+}
+// _mm512_sqrt_* seeds its result with _mm512_undefined_*() too; see expAvx512.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+template<int rule>
+__attribute__((target("avx512f")))
+static void optimizerUpdateAvx512(double *weight, double *first, double *second, double *upstream,
+                                  const double *input, double gradient, const OptimizerStepT<double> &s, unsigned n){
+    __m512d vgrad = _mm512_set1_pd(gradient), vl2 = _mm512_set1_pd(s.l2);
+    __m512d vrate = _mm512_set1_pd(s.rate), vmom = _mm512_set1_pd(s.momentum), vdecay = _mm512_set1_pd(s.decay);
+    __m512d veps = _mm512_set1_pd(s.epsilon), vshrink = _mm512_set1_pd(s.shrink);
+    __m512d vmom1 = _mm512_set1_pd(1.0 - s.momentum), vdecay1 = _mm512_set1_pd(1.0 - s.decay);
+    unsigned i = 0;
+    for(; i + 8 <= n; i += 8){
+        __m512d w = _mm512_loadu_pd(weight + i), f = _mm512_loadu_pd(first + i);
+        if(upstream != NULL)
+            _mm512_storeu_pd(upstream + i, _mm512_fmadd_pd(w, vgrad, _mm512_loadu_pd(upstream + i)));
+        __m512d g = _mm512_fnmadd_pd(vl2, w, _mm512_mul_pd(_mm512_loadu_pd(input + i), vgrad));
+        if(rule == RULE_NESTEROV){
+            __m512d step = _mm512_mul_pd(vrate, g);
+            f = _mm512_fmadd_pd(vmom, f, step);
+            w = _mm512_add_pd(w, _mm512_fmadd_pd(vmom, f, step));
+        } else if(rule == RULE_RMSPROP){
+            f = _mm512_fmadd_pd(vdecay, f, _mm512_mul_pd(vdecay1, _mm512_mul_pd(g, g)));
+            w = _mm512_fmadd_pd(vrate, _mm512_div_pd(g, _mm512_add_pd(_mm512_sqrt_pd(f), veps)), w);
+        } else {
+            __m512d v = _mm512_loadu_pd(second + i);
+            f = _mm512_fmadd_pd(vmom, f, _mm512_mul_pd(vmom1, g));
+            v = _mm512_fmadd_pd(vdecay, v, _mm512_mul_pd(vdecay1, _mm512_mul_pd(g, g)));
+            _mm512_storeu_pd(second + i, v);
+            w = _mm512_fmadd_pd(vrate, _mm512_div_pd(f, _mm512_add_pd(_mm512_sqrt_pd(v), veps)),
+                                _mm512_fnmadd_pd(vshrink, w, w));
+        }
+        _mm512_storeu_pd(first + i, f);
+        _mm512_storeu_pd(weight + i, w);
+    }
+    for(; i < n; i++)
+        updateElement<rule>(weight[i], first[i], rule == RULE_ADAM ? second + i : NULL,
+                            upstream != NULL ? upstream + i : NULL, input[i], gradient, s);
+}
+#pragma GCC diagnostic pop
+
+__attribute__((target("avx512f")))
+static void gemmTileAvx512(unsigned k, const double *a, const double *b, double *c){
+    __m512d c0 = _mm512_setzero_pd(), c1 = _mm512_setzero_pd();
+    __m512d c2 = _mm512_setzero_pd(), c3 = _mm512_setzero_pd();
+    for(unsigned p = 0; p < k; p++, a += GEMM_MR, b += GEMM_NR){
+        __m512d bv = _mm512_loadu_pd(b);
+        c0 = _mm512_fmadd_pd(_mm512_set1_pd(a[0]), bv, c0);
+        c1 = _mm512_fmadd_pd(_mm512_set1_pd(a[1]), bv, c1);
+        c2 = _mm512_fmadd_pd(_mm512_set1_pd(a[2]), bv, c2);
+        c3 = _mm512_fmadd_pd(_mm512_set1_pd(a[3]), bv, c3);
+    }
+    _mm512_storeu_pd(c, c0);      _mm512_storeu_pd(c + 8, c1);
+    _mm512_storeu_pd(c + 16, c2); _mm512_storeu_pd(c + 24, c3);
+}
+
+__attribute__((target("avx2,fma")))
+static void scaleInputsAvx2(double *out, const double *in, const double *offset, const double *scale, unsigned n){
+    unsigned i = 0;
+    for(; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(in + i), _mm256_loadu_pd(offset + i)),
+                                                _mm256_loadu_pd(scale + i)));
+    for(; i < n; i++)
+        out[i] = (in[i] - offset[i]) * scale[i];
+}
+
+__attribute__((target("avx2,fma")))
+static void scaleInputsFloatAvx2(double *out, const float *in, const double *offset, const double *scale, unsigned n){
+    unsigned i = 0;
+    for(; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_sub_pd(_mm256_cvtps_pd(_mm_loadu_ps(in + i)),
+                                                              _mm256_loadu_pd(offset + i)),
+                                                _mm256_loadu_pd(scale + i)));
+    for(; i < n; i++)
+        out[i] = ((double)in[i] - offset[i]) * scale[i];
+}
+
+// ****************** float, AVX2 ******************
+
+__attribute__((target("avx2,fma")))
+static float dotAvx2f(const float *a, const float *b, unsigned n){
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+    unsigned i = 0;
+    for(; i + 32 <= n; i += 32){
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i),      _mm256_loadu_ps(b + i),      acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8),  _mm256_loadu_ps(b + i + 8),  acc1);
+        acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16), acc2);
+        acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24), acc3);
+    }
+    for(; i + 8 <= n; i += 8)
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    __m256 acc = _mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3));
+    __m128 quad = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    __m128 pair = _mm_add_ps(quad, _mm_movehl_ps(quad, quad));
+    float sum = _mm_cvtss_f32(_mm_add_ss(pair, _mm_movehdup_ps(pair)));
+    for(; i < n; i++)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+__attribute__((target("avx2,fma")))
+static void axpyAvx2f(float *y, const float *x, float a, unsigned n){
+    __m256 va = _mm256_set1_ps(a);
+    unsigned i = 0;
+    for(; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(y + i, _mm256_fmadd_ps(_mm256_loadu_ps(x + i), va, _mm256_loadu_ps(y + i)));
+    for(; i < n; i++)
+        y[i] += x[i] * a;
+}
+
+__attribute__((target("avx2,fma")))
+static void momentumUpdateAvx2f(float *weight, float *deltaWeight, const float *input,
+                                float gradient, float rate, float momentum, unsigned n){
+    __m256 vrg = _mm256_set1_ps(rate * gradient);
+    __m256 vm = _mm256_set1_ps(momentum);
+    unsigned i = 0;
+    for(; i + 8 <= n; i += 8){
+        __m256 d = _mm256_fmadd_ps(vm, _mm256_loadu_ps(deltaWeight + i),
+                                   _mm256_mul_ps(vrg, _mm256_loadu_ps(input + i)));
+        _mm256_storeu_ps(deltaWeight + i, d);
+        _mm256_storeu_ps(weight + i, _mm256_add_ps(_mm256_loadu_ps(weight + i), d));
+    }
+    for(; i < n; i++){
+        float newDeltaWeight = rate * input[i] * gradient + momentum * deltaWeight[i];
+        deltaWeight[i] = newDeltaWeight;
+        weight[i] += newDeltaWeight;
+    }
+}
+
+// axpyAvx2f(upstream, weight, gradient) and momentumUpdateAvx2f in one pass,
+// with the same arithmetic, so the results match the two calls bit for bit.
+__attribute__((target("avx2,fma")))
+static void momentumBackwardAvx2f(float *weight, float *deltaWeight, float *upstream, const float *input,
+                                  float gradient, float rate, float momentum, unsigned n){
+    __m256 vg = _mm256_set1_ps(gradient);
+    __m256 vrg = _mm256_set1_ps(rate * gradient);
+    __m256 vm = _mm256_set1_ps(momentum);
+    unsigned i = 0;
+    for(; i + 8 <= n; i += 8){
+        __m256 w = _mm256_loadu_ps(weight + i);
+        _mm256_storeu_ps(upstream + i, _mm256_fmadd_ps(w, vg, _mm256_loadu_ps(upstream + i)));
+        __m256 d = _mm256_fmadd_ps(vm, _mm256_loadu_ps(deltaWeight + i),
+                                    _mm256_mul_ps(vrg, _mm256_loadu_ps(input + i)));
+        _mm256_storeu_ps(deltaWeight + i, d);
+        _mm256_storeu_ps(weight + i, _mm256_add_ps(w, d));
+    }
+    for(; i < n; i++){
+        upstream[i] += weight[i] * gradient;
+        float newDeltaWeight = rate * input[i] * gradient + momentum * deltaWeight[i];
+        deltaWeight[i] = newDeltaWeight;
+        weight[i] += newDeltaWeight;
+    }
+}
+
+template<int rule>
+__attribute__((target("avx2,fma")))
+static void optimizerUpdateAvx2f(float *weight, float *first, float *second, float *upstream,
+                                 const float *input, float gradient, const OptimizerStepT<float> &s, unsigned n){
+    __m256 vgrad = _mm256_set1_ps(gradient), vl2 = _mm256_set1_ps(s.l2);
+    __m256 vrate = _mm256_set1_ps(s.rate), vmom = _mm256_set1_ps(s.momentum), vdecay = _mm256_set1_ps(s.decay);
+    __m256 veps = _mm256_set1_ps(s.epsilon), vshrink = _mm256_set1_ps(s.shrink);
+    __m256 vmom1 = _mm256_set1_ps(1.0f - s.momentum), vdecay1 = _mm256_set1_ps(1.0f - s.decay);
+    unsigned i = 0;
+    for(; i + 8 <= n; i += 8){
+        __m256 w = _mm256_loadu_ps(weight + i), f = _mm256_loadu_ps(first + i);
+        if(upstream != NULL)
+            _mm256_storeu_ps(upstream + i, _mm256_fmadd_ps(w, vgrad, _mm256_loadu_ps(upstream + i)));
+        __m256 g = _mm256_fnmadd_ps(vl2, w, _mm256_mul_ps(_mm256_loadu_ps(input + i), vgrad));
+        if(rule == RULE_NESTEROV){
+            __m256 step = _mm256_mul_ps(vrate, g);
+            f = _mm256_fmadd_ps(vmom, f, step);
+            w = _mm256_add_ps(w, _mm256_fmadd_ps(vmom, f, step));
+        } else if(rule == RULE_RMSPROP){
+            f = _mm256_fmadd_ps(vdecay, f, _mm256_mul_ps(vdecay1, _mm256_mul_ps(g, g)));
+            w = _mm256_fmadd_ps(vrate, _mm256_div_ps(g, _mm256_add_ps(_mm256_sqrt_ps(f), veps)), w);
+        } else {
+            __m256 v = _mm256_loadu_ps(second + i);
+            f = _mm256_fmadd_ps(vmom, f, _mm256_mul_ps(vmom1, g));
+            v = _mm256_fmadd_ps(vdecay, v, _mm256_mul_ps(vdecay1, _mm256_mul_ps(g, g)));
+            _mm256_storeu_ps(second + i, v);
+            w = _mm256_fmadd_ps(vrate, _mm256_div_ps(f, _mm256_add_ps(_mm256_sqrt_ps(v), veps)),
+                                _mm256_fnmadd_ps(vshrink, w, w));
+        }
+        _mm256_storeu_ps(first + i, f);
+        _mm256_storeu_ps(weight + i, w);
+    }
+    for(; i < n; i++)
+        updateElement<rule>(weight[i], first[i], rule == RULE_ADAM ? second + i : NULL,
+                            upstream != NULL ? upstream + i : NULL, input[i], gradient, s);
+}
+
+// GEMM_NR floats are one register, so a row of the tile is one accumulator.
+__attribute__((target("avx2,fma")))
+static void gemmTileAvx2f(unsigned k, const float *a, const float *b, float *c){
+    __m256 c0 = _mm256_setzero_ps(), c1 = _mm256_setzero_ps();
+    __m256 c2 = _mm256_setzero_ps(), c3 = _mm256_setzero_ps();
+    for(unsigned p = 0; p < k; p++, a += GEMM_MR, b += GEMM_NR){
+        __m256 bv = _mm256_loadu_ps(b);
+        c0 = _mm256_fmadd_ps(_mm256_broadcast_ss(a),     bv, c0);
+        c1 = _mm256_fmadd_ps(_mm256_broadcast_ss(a + 1), bv, c1);
+        c2 = _mm256_fmadd_ps(_mm256_broadcast_ss(a + 2), bv, c2);
+        c3 = _mm256_fmadd_ps(_mm256_broadcast_ss(a + 3), bv, c3);
+    }
+    _mm256_storeu_ps(c, c0);      _mm256_storeu_ps(c + 8, c1);
+    _mm256_storeu_ps(c + 16, c2); _mm256_storeu_ps(c + 24, c3);
+}
+
+__attribute__((target("avx2,fma")))
+static void scaleInputsAvx2f(float *out, const double *in, const float *offset, const float *scale, unsigned n){
+    unsigned i = 0;
+    for(; i + 8 <= n; i += 8){
+        __m256 x = _mm256_set_m128(_mm256_cvtpd_ps(_mm256_loadu_pd(in + i + 4)), _mm256_cvtpd_ps(_mm256_loadu_pd(in + i)));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_sub_ps(x, _mm256_loadu_ps(offset + i)), _mm256_loadu_ps(scale + i)));
+    }
+    for(; i < n; i++)
+        out[i] = ((float)in[i] - offset[i]) * scale[i];
+}
+
+__attribute__((target("avx2,fma")))
+static void scaleInputsFloatAvx2f(float *out, const float *in, const float *offset, const float *scale, unsigned n){
+    unsigned i = 0;
+    for(; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(in + i), _mm256_loadu_ps(offset + i)),
+                                                _mm256_loadu_ps(scale + i)));
+    for(; i < n; i++)
+        out[i] = (in[i] - offset[i]) * scale[i];
+}
+
+// ****************** float, AVX-512 ******************
+
+__attribute__((target("avx512f")))
+static float dotAvx512f(const float *a, const float *b, unsigned n){
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    unsigned i = 0;
+    for(; i + 32 <= n; i += 32){
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i),      _mm512_loadu_ps(b + i),      acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+    }
+    if(i + 16 <= n){
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+        i += 16;
+    }
+    if(i < n){
+        __mmask16 m = (__mmask16)((1u << (n - i)) - 1);
+        acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, a + i), _mm512_maskz_loadu_ps(m, b + i), acc1);
+    }
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, _mm512_add_ps(acc0, acc1));
+    float sum = 0.0f;
+    for(unsigned l = 0; l < 16; l++)
+        sum += lanes[l];
+    return sum;
+}
+
+__attribute__((target("avx512f")))
+static void axpyAvx512f(float *y, const float *x, float a, unsigned n){
+    __m512 va = _mm512_set1_ps(a);
+    unsigned i = 0;
+    for(; i + 16 <= n; i += 16)
+        _mm512_storeu_ps(y + i, _mm512_fmadd_ps(_mm512_loadu_ps(x + i), va, _mm512_loadu_ps(y + i)));
+    if(i < n){
+        __mmask16 m = (__mmask16)((1u << (n - i)) - 1);
+        __m512 r = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, x + i), va, _mm512_maskz_loadu_ps(m, y + i));
+        _mm512_mask_storeu_ps(y + i, m, r);
+    }
+}
+
+__attribute__((target("avx512f")))
+static void momentumUpdateAvx512f(float *weight, float *deltaWeight, const float *input,
+                                  float gradient, float rate, float momentum, unsigned n){
+    __m512 vrg = _mm512_set1_ps(rate * gradient);
+    __m512 vm = _mm512_set1_ps(momentum);
+    unsigned i = 0;
+    for(; i + 16 <= n; i += 16){
+        __m512 d = _mm512_fmadd_ps(vm, _mm512_loadu_ps(deltaWeight + i),
+                                   _mm512_mul_ps(vrg, _mm512_loadu_ps(input + i)));
+        _mm512_storeu_ps(deltaWeight + i, d);
+        _mm512_storeu_ps(weight + i, _mm512_add_ps(_mm512_loadu_ps(weight + i), d));
+    }
+    if(i < n){
+        __mmask16 m = (__mmask16)((1u << (n - i)) - 1);
+        __m512 d = _mm512_fmadd_ps(vm, _mm512_maskz_loadu_ps(m, deltaWeight + i),
+                                   _mm512_mul_ps(vrg, _mm512_maskz_loadu_ps(m, input + i)));
+        _mm512_mask_storeu_ps(deltaWeight + i, m, d);
+        _mm512_mask_storeu_ps(weight + i, m, _mm512_add_ps(_mm512_maskz_loadu_ps(m, weight + i), d));
+    }
+}
+
+__attribute__((target("avx512f")))
+static void momentumBackwardAvx512f(float *weight, float *deltaWeight, float *upstream, const float *input,
+                                    float gradient, float rate, float momentum, unsigned n){
+    __m512 vg = _mm512_set1_ps(gradient);
+    __m512 vrg = _mm512_set1_ps(rate * gradient);
+    __m512 vm = _mm512_set1_ps(momentum);
+    unsigned i = 0;
+    for(; i + 16 <= n; i += 16){
+        __m512 w = _mm512_loadu_ps(weight + i);
+        _mm512_storeu_ps(upstream + i, _mm512_fmadd_ps(w, vg, _mm512_loadu_ps(upstream + i)));
+        __m512 d = _mm512_fmadd_ps(vm, _mm512_loadu_ps(deltaWeight + i),
+                                    _mm512_mul_ps(vrg, _mm512_loadu_ps(input + i)));
+        _mm512_storeu_ps(deltaWeight + i, d);
+        _mm512_storeu_ps(weight + i, _mm512_add_ps(w, d));
+    }
+    if(i < n){
+        __mmask16 m = (__mmask16)((1u << (n - i)) - 1);
+        __m512 w = _mm512_maskz_loadu_ps(m, weight + i);
+        _mm512_mask_storeu_ps(upstream + i, m, _mm512_fmadd_ps(w, vg, _mm512_maskz_loadu_ps(m, upstream + i)));
+        __m512 d = _mm512_fmadd_ps(vm, _mm512_maskz_loadu_ps(m, deltaWeight + i),
+                                    _mm512_mul_ps(vrg, _mm512_maskz_loadu_ps(m, input + i)));
+        _mm512_mask_storeu_ps(deltaWeight + i, m, d);
+        _mm512_mask_storeu_ps(weight + i, m, _mm512_add_ps(w, d));
+    }
+}
+
+// _mm512_sqrt_* seeds its result with _mm512_undefined_*() too; see expAvx512.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+template<int rule>
+__attribute__((target("avx512f")))
+static void optimizerUpdateAvx512f(float *weight, float *first, float *second, float *upstream,
+                                   const float *input, float gradient, const OptimizerStepT<float> &s, unsigned n){
+    __m512 vgrad = _mm512_set1_ps(gradient), vl2 = _mm512_set1_ps(s.l2);
+    __m512 vrate = _mm512_set1_ps(s.rate), vmom = _mm512_set1_ps(s.momentum), vdecay = _mm512_set1_ps(s.decay);
+    __m512 veps = _mm512_set1_ps(s.epsilon), vshrink = _mm512_set1_ps(s.shrink);
+    __m512 vmom1 = _mm512_set1_ps(1.0f - s.momentum), vdecay1 = _mm512_set1_ps(1.0f - s.decay);
+    unsigned i = 0;
+    for(; i + 16 <= n; i += 16){
+        __m512 w = _mm512_loadu_ps(weight + i), f = _mm512_loadu_ps(first + i);
+        if(upstream != NULL)
+            _mm512_storeu_ps(upstream + i, _mm512_fmadd_ps(w, vgrad, _mm512_loadu_ps(upstream + i)));
+        __m512 g = _mm512_fnmadd_ps(vl2, w, _mm512_mul_ps(_mm512_loadu_ps(input + i), vgrad));
+        if(rule == RULE_NESTEROV){
+            __m512 step = _mm512_mul_ps(vrate, g);
+            f = _mm512_fmadd_ps(vmom, f, step);
+            w = _mm512_add_ps(w, _mm512_fmadd_ps(vmom, f, step));
+        } else if(rule == RULE_RMSPROP){
+            f = _mm512_fmadd_ps(vdecay, f, _mm512_mul_ps(vdecay1, _mm512_mul_ps(g, g)));
+            w = _mm512_fmadd_ps(vrate, _mm512_div_ps(g, _mm512_add_ps(_mm512_sqrt_ps(f), veps)), w);
+        } else {
+            __m512 v = _mm512_loadu_ps(second + i);
+            f = _mm512_fmadd_ps(vmom, f, _mm512_mul_ps(vmom1, g));
+            v = _mm512_fmadd_ps(vdecay, v, _mm512_mul_ps(vdecay1, _mm512_mul_ps(g, g)));
+            _mm512_storeu_ps(second + i, v);
+            w = _mm512_fmadd_ps(vrate, _mm512_div_ps(f, _mm512_add_ps(_mm512_sqrt_ps(v), veps)),
+                                _mm512_fnmadd_ps(vshrink, w, w));
+        }
+        _mm512_storeu_ps(first + i, f);
+        _mm512_storeu_ps(weight + i, w);
+    }
+    for(; i < n; i++)
+        updateElement<rule>(weight[i], first[i], rule == RULE_ADAM ? second + i : NULL,
+                            upstream != NULL ? upstream + i : NULL, input[i], gradient, s);
+}
+#pragma GCC diagnostic pop
+
+// ****************** exp, sigmoid, tanh ******************
+// exp(x) = 2^k * exp(r) with k = round(x / ln2) and r = x - k ln2 (ln2 split
+// in two for an exact reduction); exp(r) is its Taylor series, to r^12 for
+// double and r^7 for float. x is clamped so 2^k stays a normal number.
+// sigmoid and tanh are built on it: tanh(x) = 2 sigmoid(2x) - 1.
+enum { OP_EXP, OP_SIGMOID, OP_TANH };
+
+static const double expTaylor[13] = {
+    1.0, 1.0, 1.0 / 2, 1.0 / 6, 1.0 / 24, 1.0 / 120, 1.0 / 720, 1.0 / 5040, 1.0 / 40320,
+    1.0 / 362880, 1.0 / 3628800, 1.0 / 39916800, 1.0 / 479001600
+};
+
+__attribute__((target("avx2,fma")))
+static inline __m256d expAvx2(__m256d x){
+    x = _mm256_min_pd(_mm256_max_pd(x, _mm256_set1_pd(-708.0)), _mm256_set1_pd(708.0));
+    __m256d k = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(1.4426950408889634)),
+                                _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256d r = _mm256_fnmadd_pd(k, _mm256_set1_pd(6.93147180369123816490e-01), x);
+    r = _mm256_fnmadd_pd(k, _mm256_set1_pd(1.90821492927058770002e-10), r);
+    __m256d p = _mm256_set1_pd(expTaylor[12]);
+    for(int i = 11; i >= 0; i--)
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(expTaylor[i]));
+    __m256i e = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(k));
+    e = _mm256_slli_epi64(_mm256_add_epi64(e, _mm256_set1_epi64x(1023)), 52);
+    return _mm256_mul_pd(p, _mm256_castsi256_pd(e));
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256 expAvx2f(__m256 x){
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-87.0f)), _mm256_set1_ps(87.0f));
+    __m256 k = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504f)),
+                               _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 r = _mm256_fnmadd_ps(k, _mm256_set1_ps(0.693359375f), x);
+    r = _mm256_fnmadd_ps(k, _mm256_set1_ps(-2.12194440e-4f), r);
+    __m256 p = _mm256_set1_ps((float)expTaylor[7]);
+    for(int i = 6; i >= 0; i--)
+        p = _mm256_fmadd_ps(p, r, _mm256_set1_ps((float)expTaylor[i]));
+    __m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(k), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(e));
+}
+
+template<int op>
+__attribute__((target("avx2,fma")))
+static inline __m256d transcendentalAvx2(__m256d x){
+    if(op == OP_EXP)
+        return expAvx2(x);
+    __m256d one = _mm256_set1_pd(1.0);
+    if(op == OP_SIGMOID)
+        return _mm256_div_pd(one, _mm256_add_pd(one, expAvx2(_mm256_sub_pd(_mm256_setzero_pd(), x))));
+    __m256d two = _mm256_set1_pd(2.0);
+    __m256d s = _mm256_div_pd(two, _mm256_add_pd(one, expAvx2(_mm256_mul_pd(_mm256_set1_pd(-2.0), x))));
+    return _mm256_sub_pd(s, one);
+}
+
+template<int op>
+__attribute__((target("avx2,fma")))
+static inline __m256 transcendentalAvx2f(__m256 x){
+    if(op == OP_EXP)
+        return expAvx2f(x);
+    __m256 one = _mm256_set1_ps(1.0f);
+    if(op == OP_SIGMOID)
+        return _mm256_div_ps(one, _mm256_add_ps(one, expAvx2f(_mm256_sub_ps(_mm256_setzero_ps(), x))));
+    __m256 two = _mm256_set1_ps(2.0f);
+    __m256 s = _mm256_div_ps(two, _mm256_add_ps(one, expAvx2f(_mm256_mul_ps(_mm256_set1_ps(-2.0f), x))));
+    return _mm256_sub_ps(s, one);
+}
+
+// The tail goes through a padded copy; AVX2 has no cheap masked store.
+template<int op>
+__attribute__((target("avx2,fma")))
+static void transcendentalMapAvx2(double *x, unsigned n){
+    unsigned i = 0;
+    for(; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(x + i, transcendentalAvx2<op>(_mm256_loadu_pd(x + i)));
+    if(i < n){
+        alignas(32) double tail[4] = {};
+        std::copy(x + i, x + n, tail);
+        _mm256_store_pd(tail, transcendentalAvx2<op>(_mm256_load_pd(tail)));
+        std::copy(tail, tail + (n - i), x + i);
+    }
+}
+
+template<int op>
+__attribute__((target("avx2,fma")))
+static void transcendentalMapAvx2f(float *x, unsigned n){
+    unsigned i = 0;
+    for(; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(x + i, transcendentalAvx2f<op>(_mm256_loadu_ps(x + i)));
+    if(i < n){
+        alignas(32) float tail[8] = {};
+        std::copy(x + i, x + n, tail);
+        _mm256_store_ps(tail, transcendentalAvx2f<op>(_mm256_load_ps(tail)));
+        std::copy(tail, tail + (n - i), x + i);
+    }
+}
+
+// AVX-512 rounds with roundscale and applies 2^k with scalef. GCC 12's
+// headers seed these intrinsics with _mm512_undefined_*(), which trips
+// -Wmaybe-uninitialized once they are inlined.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+__attribute__((target("avx512f")))
+static inline __m512d expAvx512(__m512d x){
+    x = _mm512_min_pd(_mm512_max_pd(x, _mm512_set1_pd(-708.0)), _mm512_set1_pd(708.0));
+    __m512d k = _mm512_roundscale_pd(_mm512_mul_pd(x, _mm512_set1_pd(1.4426950408889634)),
+                                     _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m512d r = _mm512_fnmadd_pd(k, _mm512_set1_pd(6.93147180369123816490e-01), x);
+    r = _mm512_fnmadd_pd(k, _mm512_set1_pd(1.90821492927058770002e-10), r);
+    __m512d p = _mm512_set1_pd(expTaylor[12]);
+    for(int i = 11; i >= 0; i--)
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(expTaylor[i]));
+    return _mm512_scalef_pd(p, k);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512 expAvx512f(__m512 x){
+    x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(-87.0f)), _mm512_set1_ps(87.0f));
+    __m512 k = _mm512_roundscale_ps(_mm512_mul_ps(x, _mm512_set1_ps(1.44269504f)),
+                                    _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m512 r = _mm512_fnmadd_ps(k, _mm512_set1_ps(0.693359375f), x);
+    r = _mm512_fnmadd_ps(k, _mm512_set1_ps(-2.12194440e-4f), r);
+    __m512 p = _mm512_set1_ps((float)expTaylor[7]);
+    for(int i = 6; i >= 0; i--)
+        p = _mm512_fmadd_ps(p, r, _mm512_set1_ps((float)expTaylor[i]));
+    return _mm512_scalef_ps(p, k);
+}
+#pragma GCC diagnostic pop
+
+template<int op>
+__attribute__((target("avx512f")))
+static inline __m512d transcendentalAvx512(__m512d x){
+    if(op == OP_EXP)
+        return expAvx512(x);
+    __m512d one = _mm512_set1_pd(1.0);
+    if(op == OP_SIGMOID)
+        return _mm512_div_pd(one, _mm512_add_pd(one, expAvx512(_mm512_sub_pd(_mm512_setzero_pd(), x))));
+    __m512d two = _mm512_set1_pd(2.0);
+    __m512d s = _mm512_div_pd(two, _mm512_add_pd(one, expAvx512(_mm512_mul_pd(_mm512_set1_pd(-2.0), x))));
+    return _mm512_sub_pd(s, one);
+}
+
+template<int op>
+__attribute__((target("avx512f")))
+static inline __m512 transcendentalAvx512f(__m512 x){
+    if(op == OP_EXP)
+        return expAvx512f(x);
+    __m512 one = _mm512_set1_ps(1.0f);
+    if(op == OP_SIGMOID)
+        return _mm512_div_ps(one, _mm512_add_ps(one, expAvx512f(_mm512_sub_ps(_mm512_setzero_ps(), x))));
+    __m512 two = _mm512_set1_ps(2.0f);
+    __m512 s = _mm512_div_ps(two, _mm512_add_ps(one, expAvx512f(_mm512_mul_ps(_mm512_set1_ps(-2.0f), x))));
+    return _mm512_sub_ps(s, one);
+}
+
+template<int op>
+__attribute__((target("avx512f")))
+static void transcendentalMapAvx512(double *x, unsigned n){
+    unsigned i = 0;
+    for(; i + 8 <= n; i += 8)
+        _mm512_storeu_pd(x + i, transcendentalAvx512<op>(_mm512_loadu_pd(x + i)));
+    if(i < n){
+        __mmask8 m = (__mmask8)((1u << (n - i)) - 1);
+        _mm512_mask_storeu_pd(x + i, m, transcendentalAvx512<op>(_mm512_maskz_loadu_pd(m, x + i)));
+    }
+}
+
+template<int op>
+__attribute__((target("avx512f")))
+static void transcendentalMapAvx512f(float *x, unsigned n){
+    unsigned i = 0;
+    for(; i + 16 <= n; i += 16)
+        _mm512_storeu_ps(x + i, transcendentalAvx512f<op>(_mm512_loadu_ps(x + i)));
+    if(i < n){
+        __mmask16 m = (__mmask16)((1u << (n - i)) - 1);
+        _mm512_mask_storeu_ps(x + i, m, transcendentalAvx512f<op>(_mm512_maskz_loadu_ps(m, x + i)));
+    }
+}
+
+// ****************** int8 ******************
+// Widening to 16 bits before vpmaddwd: the 8-bit vpmaddubsw would saturate
+// once two 255 * 127 products meet in one lane.
+__attribute__((target("avx2")))
+static int32_t dotU8S8Avx2(const uint8_t *a, const int8_t *b, unsigned n){
+    __m256i acc = _mm256_setzero_si256();
+    unsigned i = 0;
+    for(; i + 16 <= n; i += 16){
+        __m256i x = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(a + i)));
+        __m256i w = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(b + i)));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(x, w));
+    }
+    __m128i sum4 = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    sum4 = _mm_hadd_epi32(sum4, sum4);
+    sum4 = _mm_hadd_epi32(sum4, sum4);
+    int32_t sum = _mm_cvtsi128_si32(sum4);
+    for(; i < n; i++)
+        sum += (int32_t)a[i] * b[i];
+    return sum;
+}
+
+// vpdpbusd multiplies u8 by s8 and adds groups of four straight into int32
+// lanes, with no intermediate saturation. The tail is a masked load, so a
+// short row is a single instruction.
+__attribute__((target("avx512f,avx512bw,avx512vnni")))
+static int32_t dotU8S8Vnni(const uint8_t *a, const int8_t *b, unsigned n){
+    __m512i acc = _mm512_setzero_si512();
+    unsigned i = 0;
+    for(; i + 64 <= n; i += 64)
+        acc = _mm512_dpbusd_epi32(acc, _mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i));
+    if(i < n){
+        __mmask64 m = ((__mmask64)1 << (n - i)) - 1;
+        acc = _mm512_dpbusd_epi32(acc, _mm512_maskz_loadu_epi8(m, a + i), _mm512_maskz_loadu_epi8(m, b + i));
+    }
+    alignas(64) int32_t lanes[16];
+    _mm512_store_si512(lanes, acc);
+    int32_t sum = 0;
+    for(unsigned l = 0; l < 16; l++)
+        sum += lanes[l];
+    return sum;
+}
+#endif // NN_X86
+
+static const KernelTable scalarTable = {"scalar", dotScalar<double>, axpyScalar<double>,
+                                        momentumUpdateScalar<double>, momentumBackwardScalar<double>, gemmTileScalar<double>,
+                                        expScalar<double>, sigmoidScalar<double>, tanhScalar<double>,
+                                        optimizerUpdateScalar<RULE_NESTEROV, double>,
+                                        optimizerUpdateScalar<RULE_RMSPROP, double>,
+                                        optimizerUpdateScalar<RULE_ADAM, double>,
+                                        scaleInputsScalar<double, double>, scaleInputsScalar<double, float>};
+static const FloatKernelTable scalarFloatTable = {"scalar", dotScalar<float>, axpyScalar<float>,
+                                                  momentumUpdateScalar<float>, momentumBackwardScalar<float>, gemmTileScalar<float>,
+                                                  expScalar<float>, sigmoidScalar<float>, tanhScalar<float>,
+                                                  optimizerUpdateScalar<RULE_NESTEROV, float>,
+                                                  optimizerUpdateScalar<RULE_RMSPROP, float>,
+                                                  optimizerUpdateScalar<RULE_ADAM, float>,
+                                                  scaleInputsScalar<float, double>, scaleInputsScalar<float, float>};
+#ifdef NN_X86
+static const KernelTable avx2Table = {"avx2", dotAvx2, axpyAvx2, momentumUpdateAvx2, momentumBackwardAvx2,
+                                     gemmTileAvx2, transcendentalMapAvx2<OP_EXP>, transcendentalMapAvx2<OP_SIGMOID>,
+                                     transcendentalMapAvx2<OP_TANH>, optimizerUpdateAvx2<RULE_NESTEROV>,
+                                     optimizerUpdateAvx2<RULE_RMSPROP>, optimizerUpdateAvx2<RULE_ADAM>,
+                                     scaleInputsAvx2, scaleInputsFloatAvx2};
+static const KernelTable avx512Table = {"avx512", dotAvx512, axpyAvx512, momentumUpdateAvx512, momentumBackwardAvx512,
+                                       gemmTileAvx512, transcendentalMapAvx512<OP_EXP>, transcendentalMapAvx512<OP_SIGMOID>,
+                                       transcendentalMapAvx512<OP_TANH>, optimizerUpdateAvx512<RULE_NESTEROV>,
+                                       optimizerUpdateAvx512<RULE_RMSPROP>, optimizerUpdateAvx512<RULE_ADAM>,
+                                       scaleInputsAvx2, scaleInputsFloatAvx2};
+static const FloatKernelTable avx2FloatTable = {"avx2", dotAvx2f, axpyAvx2f, momentumUpdateAvx2f, momentumBackwardAvx2f,
+                                                gemmTileAvx2f, transcendentalMapAvx2f<OP_EXP>, transcendentalMapAvx2f<OP_SIGMOID>,
+                                                transcendentalMapAvx2f<OP_TANH>, optimizerUpdateAvx2f<RULE_NESTEROV>,
+                                                optimizerUpdateAvx2f<RULE_RMSPROP>, optimizerUpdateAvx2f<RULE_ADAM>,
+                                                scaleInputsAvx2f, scaleInputsFloatAvx2f};
+// A float tile row already fills a 256-bit register; the AVX-512 table
+// keeps the AVX2 tile (every AVX-512 CPU has AVX2 and FMA). Input rows are
+// short, so both AVX-512 tables scale inputs with the AVX2 kernels.
+static const FloatKernelTable avx512FloatTable = {"avx512", dotAvx512f, axpyAvx512f, momentumUpdateAvx512f, momentumBackwardAvx512f,
+                                                  gemmTileAvx2f, transcendentalMapAvx512f<OP_EXP>, transcendentalMapAvx512f<OP_SIGMOID>,
+                                                  transcendentalMapAvx512f<OP_TANH>, optimizerUpdateAvx512f<RULE_NESTEROV>,
+                                                  optimizerUpdateAvx512f<RULE_RMSPROP>, optimizerUpdateAvx512f<RULE_ADAM>,
+                                                  scaleInputsAvx2f, scaleInputsFloatAvx2f};
+#endif
+static const Int8KernelTable scalarInt8Table = {"scalar", dotU8S8Scalar};
+#ifdef NN_X86
+static const Int8KernelTable avx2Int8Table = {"avx2", dotU8S8Avx2};
+static const Int8KernelTable vnniInt8Table = {"avx512", dotU8S8Vnni};
+#endif
+
+template<class T>
+static unsigned detectKernels(const KernelTableT<T> **tables, const KernelTableT<T> *scalar,
+                              const KernelTableT<T> *avx2, const KernelTableT<T> *avx512){
+    unsigned n = 0;
+    tables[n++] = scalar;
+#ifdef NN_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        tables[n++] = avx2;
+    if(__builtin_cpu_supports("avx512f"))
+        tables[n++] = avx512;
+#else
+    (void)avx2;
+    (void)avx512;
+#endif
+    return n;
+}
+
+#ifdef NN_X86
+#define NN_TABLES(scalar, avx2, avx512) &scalar, &avx2, &avx512
+#else
+#define NN_TABLES(scalar, avx2, avx512) &scalar, NULL, NULL
+#endif
+
+const KernelTable *const *supportedKernels(unsigned &count){
+    static const KernelTable *tables[3];
+    static const unsigned n = detectKernels(tables, NN_TABLES(scalarTable, avx2Table, avx512Table));
+    count = n;
+    return tables;
+}
+
+const FloatKernelTable *const *supportedFloatKernels(unsigned &count){
+    static const FloatKernelTable *tables[3];
+    static const unsigned n = detectKernels(tables, NN_TABLES(scalarFloatTable, avx2FloatTable, avx512FloatTable));
+    count = n;
+    return tables;
+}
+
+template<class Table>
+static const Table *selectKernels(const Table *const *(*supported)(unsigned &)){
+    unsigned count;
+    const Table *const *tables = supported(count);
+    const char *forced = getenv("NN_KERNEL");
+    if(forced != NULL){
+        for(unsigned i = 0; i < count; i++)
+            if(strcmp(tables[i]->name, forced) == 0)
+                return tables[i];
+    }
+    return tables[count - 1];
+}
+
+const KernelTable &kernels(void){
+    static const KernelTable *selected = selectKernels(supportedKernels);
+    return *selected;
+}
+
+const FloatKernelTable &floatKernels(void){
+    static const FloatKernelTable *selected = selectKernels(supportedFloatKernels);
+    return *selected;
+}
+
+const Int8KernelTable *const *supportedInt8Kernels(unsigned &count){
+    static const Int8KernelTable *tables[3];
+    static const unsigned n = [](){
+        unsigned n = 0;
+        tables[n++] = &scalarInt8Table;
+#ifdef NN_X86
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2"))
+            tables[n++] = &avx2Int8Table;
+        if(__builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vnni"))
+            tables[n++] = &vnniInt8Table;
+#endif
+        return n;
+    }();
+    count = n;
+    return tables;
+}
+
+const Int8KernelTable &int8Kernels(void){
+    static const Int8KernelTable *selected = selectKernels(supportedInt8Kernels);
+    return *selected;
+}
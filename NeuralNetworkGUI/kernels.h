@@ -0,0 +1,106 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+
+#include<cstdint>
+
+// Dense-layer inner loops. Each table holds one implementation of every
+// kernel; kernels() picks the widest one the CPU supports the first time it
+// is called, so a single binary runs on every host. Setting NN_KERNEL to
+// "scalar", "avx2" or "avx512" overrides the choice.
+// Register tile of the blocked GEMM: GEMM_MR rows by GEMM_NR columns.
+#define GEMM_MR 4
+#define GEMM_NR 8
+
+// Per-step constants of the optimizer kernels, filled in by optimizerStep()
+// (see optimizer.h). In every rule g[i] = input[i] * gradient - l2 * weight[i]
+// is the descent direction, as in momentumUpdate.
+template<class T>
+struct OptimizerStepT {
+    T rate;         // scheduled learning rate; Adam's carries the bias correction
+    T momentum;     // Nesterov momentum, Adam beta1
+    T decay;        // RMSProp mean-square decay, Adam beta2
+    T epsilon;      // Adam's carries the bias correction
+    T l2;           // weight decay added to the gradient
+    T shrink;       // decoupled weight decay: weight[i] -= shrink * weight[i] first (AdamW)
+};
+
+// One table per element type: KernelTable for double, FloatKernelTable for
+// float. The float tables do twice the lanes per instruction.
+template<class T>
+struct KernelTableT {
+    const char *name;
+    // sum of a[i] * b[i]
+    T (*dot)(const T *a, const T *b, unsigned n);
+    // y[i] += x[i] * a, the row-wise form of sumDOW
+    void (*axpy)(T *y, const T *x, T a, unsigned n);
+    // deltaWeight[i] = rate * input[i] * gradient + momentum * deltaWeight[i]
+    // weight[i] += deltaWeight[i]
+    void (*momentumUpdate)(T *weight, T *deltaWeight, const T *input,
+                           T gradient, T rate, T momentum, unsigned n);
+    // The fused backward step: upstream[i] += weight[i] * gradient with the
+    // weight as read, then momentumUpdate, in one pass over the row. Bit for
+    // bit the same as axpy followed by momentumUpdate.
+    void (*momentumBackward)(T *weight, T *deltaWeight, T *upstream, const T *input,
+                             T gradient, T rate, T momentum, unsigned n);
+    // c[i * GEMM_NR + j] = sum over p of a[p * GEMM_MR + i] * b[p * GEMM_NR + j],
+    // a and b being packed panels of the GEMM driver (see gemm.h)
+    void (*gemmTile)(unsigned k, const T *a, const T *b, T *c);
+    // x[i] = exp(x[i]), 1 / (1 + exp(-x[i])) and tanh(x[i]), in place. The
+    // SIMD versions evaluate exp as 2^k * p(r) with a Taylor polynomial on
+    // |r| <= ln2/2. Measured error: exp and sigmoid within 4e-16 (double) /
+    // 1.5e-7 (float) relative, tanh within 4e-16 / 2e-7 absolute. The scalar
+    // table calls libm.
+    void (*exp)(T *x, unsigned n);
+    void (*sigmoid)(T *x, unsigned n);
+    void (*tanh)(T *x, unsigned n);
+    // The other update rules, one fused pass over weight and state per row.
+    // Nesterov: first = momentum * first + rate * g
+    //           weight += momentum * first + rate * g
+    // RMSProp:  first = decay * first + (1 - decay) * g^2
+    //           weight += rate * g / (sqrt(first) + epsilon)
+    // Adam:     first = momentum * first + (1 - momentum) * g
+    //           second = decay * second + (1 - decay) * g^2
+    //           weight += rate * first / (sqrt(second) + epsilon)
+    // second is only touched by Adam. Unless upstream is NULL, each also
+    // does the fused backward step of momentumBackward first.
+    void (*nesterovUpdate)(T *weight, T *first, T *second, T *upstream, const T *input, T gradient,
+                           const OptimizerStepT<T> &step, unsigned n);
+    void (*rmspropUpdate)(T *weight, T *first, T *second, T *upstream, const T *input, T gradient,
+                          const OptimizerStepT<T> &step, unsigned n);
+    void (*adamUpdate)(T *weight, T *first, T *second, T *upstream, const T *input, T gradient,
+                       const OptimizerStepT<T> &step, unsigned n);
+    // out[i] = (T(in[i]) - offset[i]) * scale[i]: a sample entering the
+    // first layer through the Net's input scaling, converted to T on the
+    // way. No FMA, so every table gives the same bits.
+    void (*scaleInputs)(T *out, const double *in, const T *offset, const T *scale, unsigned n);
+    void (*scaleInputsFloat)(T *out, const float *in, const T *offset, const T *scale, unsigned n);
+};
+typedef KernelTableT<double> KernelTable;
+typedef KernelTableT<float> FloatKernelTable;
+
+const KernelTable &kernels(void);
+const FloatKernelTable &floatKernels(void);
+// Every table this CPU can run, scalar first. Used by the benchmarks.
+const KernelTable *const *supportedKernels(unsigned &count);
+const FloatKernelTable *const *supportedFloatKernels(unsigned &count);
+
+// Integer kernels for QuantizedNet. Activations are unsigned and weights
+// signed 8-bit; the sum is exact in int32 for n up to 2^16. The AVX-512
+// table uses VNNI (vpdpbusd) and is only offered where the CPU has it.
+struct Int8KernelTable {
+    const char *name;
+    // sum of a[i] * b[i]
+    int32_t (*dot)(const uint8_t *a, const int8_t *b, unsigned n);
+};
+
+const Int8KernelTable &int8Kernels(void);
+const Int8KernelTable *const *supportedInt8Kernels(unsigned &count);
+
+// kernels() or floatKernels(), for code templated on the element type.
+template<class T> const KernelTableT<T> &kernelsFor(void);
+template<> inline const KernelTable &kernelsFor<double>(void) { return kernels(); }
+template<> inline const FloatKernelTable &kernelsFor<float>(void) { return floatKernels(); }
+
+
+#endif // KERNELS_H
@@ -0,0 +1,203 @@
+#include "logger.h"
+#include "profiler.h"
+
+enum { RECORD_VALUES, RECORD_TEXT, RECORD_TEXT_PART, RECORD_METRIC };
+
+Logger::Logger(LogLevel level, unsigned sampleEvery, FILE *console, unsigned capacity)
+    : m_level(level), m_sampleEvery(std::max(1u, sampleEvery)), m_console(console),
+      m_metrics(NULL), m_csv(false), m_enqueue(0), m_written(0), m_dropped(0), m_stop(false)
+{
+    size_t size = 1;
+    while(size < capacity)
+        size <<= 1;
+    m_slots.reset(new Slot[size]);
+    m_mask = size - 1;
+    for(size_t i = 0; i < size; i++)
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    m_writer = std::thread(&Logger::writerLoop, this);
+}
+
+Logger::~Logger(){
+    m_stop.store(true, std::memory_order_release);
+    m_writer.join();
+    if(m_metrics != NULL)
+        fclose(m_metrics);
+    if(m_dropped > 0)
+        fprintf(stderr, "%llu log lines dropped\n", m_dropped.load());
+}
+
+bool Logger::openMetrics(const std::string &filename){
+    flush();
+    if(m_metrics != NULL)
+        fclose(m_metrics);
+    m_metrics = fopen(filename.c_str(), "w");
+    m_csv = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".csv") == 0;
+    if(m_metrics != NULL && m_csv)
+        fputs("phase,step,loss,accuracy\n", m_metrics);
+    return m_metrics != NULL;
+}
+
+// Claims the next slot (Vyukov's bounded queue). A slot is free when its
+// sequence equals the position being claimed and ready for the writer once
+// it is position + 1. Returns NULL when the ring is full and wait is false.
+LogRecord *Logger::acquire(bool wait, size_t &position){
+    size_t pos = m_enqueue.load(std::memory_order_relaxed);
+    unsigned spins = 0;
+    while(true){
+        Slot &slot = m_slots[pos & m_mask];
+        intptr_t diff = (intptr_t)slot.sequence.load(std::memory_order_acquire) - (intptr_t)pos;
+        if(diff == 0){
+            if(m_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                position = pos;
+                return &slot.record;
+            }
+        } else if(diff < 0){
+            if(!wait){
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return NULL;
+            }
+            if(++spins > 64)
+                std::this_thread::yield();
+            pos = m_enqueue.load(std::memory_order_relaxed);
+        } else {
+            pos = m_enqueue.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void Logger::publish(size_t position){
+    m_slots[position & m_mask].sequence.store(position + 1, std::memory_order_release);
+}
+
+void Logger::values(LogLevel level, const char *format, unsigned long long step, const double *vals, unsigned count){
+    if(!enabled(level))
+        return;
+    NN_PROFILE_SCOPE(PROFILE_OUTPUT);
+    size_t position;
+    LogRecord *r = acquire(level == LOG_QUIET, position);
+    if(r == NULL)
+        return;
+    r->kind = RECORD_VALUES;
+    r->format = format;
+    r->step = step;
+    r->total = count;
+    r->count = std::min(count, (unsigned)LOG_MAX_VALUES);
+    std::copy(vals, vals + r->count, r->values);
+    publish(position);
+}
+
+void Logger::text(LogLevel level, const std::string &line){
+    if(!enabled(level))
+        return;
+    NN_PROFILE_SCOPE(PROFILE_OUTPUT);
+    // A line longer than one record continues in the following ones, which
+    // the writer joins without a newline. Only the first part may be
+    // dropped, so a line comes out whole or not at all.
+    size_t first = 0;
+    do {
+        size_t position;
+        LogRecord *r = acquire(level == LOG_QUIET || first > 0, position);
+        if(r == NULL)
+            return;
+        size_t length = std::min(line.size() - first, (size_t)LOG_TEXT_SIZE - 1);
+        r->kind = first + length < line.size() ? RECORD_TEXT_PART : RECORD_TEXT;
+        memcpy(r->text, line.data() + first, length);
+        r->text[length] = '\0';
+        publish(position);
+        first += length;
+    } while(first < line.size());
+}
+
+void Logger::metric(const char *phase, unsigned long long step, double loss, double accuracy){
+    if(m_metrics == NULL)
+        return;
+    NN_PROFILE_SCOPE(PROFILE_OUTPUT);
+    size_t position;
+    LogRecord *r = acquire(true, position);
+    r->kind = RECORD_METRIC;
+    r->format = phase;
+    r->step = step;
+    r->count = r->total = 2;
+    r->values[0] = loss;
+    r->values[1] = accuracy;
+    publish(position);
+}
+
+void Logger::flush(void){
+    size_t target = m_enqueue.load(std::memory_order_acquire);
+    while(m_written.load(std::memory_order_acquire) < target)
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+}
+
+static void writeNumber(FILE *out, double value, bool csv){
+    if(std::isnan(value))
+        fputs(csv ? "" : "null", out);
+    else
+        fprintf(out, "%.9g", value);
+}
+
+void Logger::write(const LogRecord &r){
+    NN_PROFILE_SCOPE(PROFILE_OUTPUT);
+    switch(r.kind){
+    case RECORD_VALUES:
+        // %g prints what std::cout does with its default precision.
+        fprintf(m_console, r.format, r.step);
+        fputc(':', m_console);
+        for(unsigned i = 0; i < r.count; i++)
+            fprintf(m_console, " %g", r.values[i]);
+        if(r.total > r.count)
+            fputs(" ...", m_console);
+        fputc('\n', m_console);
+        break;
+    case RECORD_TEXT:
+        fputs(r.text, m_console);
+        fputc('\n', m_console);
+        break;
+    case RECORD_TEXT_PART:
+        fputs(r.text, m_console);
+        break;
+    case RECORD_METRIC:
+        if(m_csv){
+            fprintf(m_metrics, "%s,%llu,", r.format, r.step);
+            writeNumber(m_metrics, r.values[0], true);
+            fputc(',', m_metrics);
+            writeNumber(m_metrics, r.values[1], true);
+            fputc('\n', m_metrics);
+        } else {
+            fprintf(m_metrics, "{\"phase\":\"%s\",\"step\":%llu,\"loss\":", r.format, r.step);
+            writeNumber(m_metrics, r.values[0], false);
+            fputs(",\"accuracy\":", m_metrics);
+            writeNumber(m_metrics, r.values[1], false);
+            fputs("}\n", m_metrics);
+        }
+        break;
+    }
+}
+
+void Logger::writerLoop(void){
+    size_t position = 0;
+    bool pending = false;
+    while(true){
+        // Read stop before looking at the ring: once it is set nothing more
+        // is queued, so an empty ring after that means we are done.
+        bool stop = m_stop.load(std::memory_order_acquire);
+        Slot &slot = m_slots[position & m_mask];
+        if(slot.sequence.load(std::memory_order_acquire) == position + 1){
+            write(slot.record);
+            slot.sequence.store(position + m_mask + 1, std::memory_order_release);
+            position++;
+            pending = true;
+            continue;
+        }
+        if(pending){
+            fflush(m_console);
+            if(m_metrics != NULL)
+                fflush(m_metrics);
+            pending = false;
+        }
+        m_written.store(position, std::memory_order_release);
+        if(stop)
+            break;
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+
+#include<bits/stdc++.h>
+
+enum LogLevel {
+    LOG_QUIET = 0, // results only
+    LOG_INFO = 1,  // sampled progress, epoch and summary lines
+    LOG_DEBUG = 2  // sampled per-sample inputs, outputs and targets
+};
+
+#define LOG_MAX_VALUES 16
+#define LOG_TEXT_SIZE 192
+
+// One queued line. Records are formatted by the writer thread, so the
+// producer only copies a few numbers.
+struct LogRecord {
+    unsigned kind;
+    const char *format;   // string literal, may hold one %llu for step
+    unsigned long long step;
+    unsigned count;       // values stored
+    unsigned total;       // values the caller had; more than count is shown as "..."
+    double values[LOG_MAX_VALUES];
+    char text[LOG_TEXT_SIZE];
+};
+
+// Console and metrics output that never blocks training on stdout.
+//
+// Records go into a bounded lock-free ring (multi-producer, the writer
+// thread is the single consumer) and are formatted and written in the
+// background. Progress lines are dropped, not waited for, when the ring is
+// full; results and metrics wait for a free slot. The number of dropped
+// lines is reported when the logger is destroyed.
+//
+// Console lines are filtered by level; sampled() thins per-sample and
+// per-batch progress to one line every sampleEvery samples. Metrics go to a
+// separate file as JSON lines, or CSV if its name ends in ".csv".
+class Logger{
+public:
+    Logger(LogLevel level, unsigned sampleEvery, FILE *console = stdout, unsigned capacity = 4096);
+    ~Logger();
+    Logger(const Logger &) = delete;
+    Logger &operator=(const Logger &) = delete;
+    bool openMetrics(const std::string &filename);
+    bool enabled(LogLevel level) const { return level <= m_level; }
+    bool hasMetrics(void) const { return m_metrics != NULL; }
+    // True if a sampled line is due for the count samples ending at sample
+    // (1-based): whether a multiple of sampleEvery lies in that range.
+    bool sampled(unsigned long long sample, unsigned count = 1) const {
+        return sample / m_sampleEvery != (sample - count) / m_sampleEvery;
+    }
+    // "<format with step>: v v v"
+    void values(LogLevel level, const char *format, unsigned long long step, const double *vals, unsigned count);
+    void values(LogLevel level, const char *format, unsigned long long step, const std::vector<double> &vals){
+        values(level, format, step, vals.data(), vals.size());
+    }
+    // A line formatted by the caller, for rare summary output. Text longer
+    // than one record takes several; another thread's line may then land
+    // between the parts.
+    void text(LogLevel level, const std::string &line);
+    // One metrics row; pass NAN for a value that was not measured.
+    void metric(const char *phase, unsigned long long step, double loss, double accuracy);
+    // Waits until everything queued so far has been written out.
+    void flush(void);
+    unsigned long long dropped(void) const { return m_dropped.load(std::memory_order_relaxed); }
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        LogRecord record;
+    };
+    LogRecord *acquire(bool wait, size_t &position);
+    void publish(size_t position);
+    void writerLoop(void);
+    void write(const LogRecord &record);
+    LogLevel m_level;
+    unsigned m_sampleEvery;
+    FILE *m_console;
+    FILE *m_metrics;
+    bool m_csv;
+    std::unique_ptr<Slot[]> m_slots;
+    size_t m_mask;
+    alignas(64) std::atomic<size_t> m_enqueue;
+    alignas(64) std::atomic<size_t> m_written;
+    std::atomic<unsigned long long> m_dropped;
+    std::atomic<bool> m_stop;
+    std::thread m_writer;
+};
+
+
+#endif // LOGGER_H
@@ -1,17 +1,9 @@
 #include "neuralnetworkgui.h"
 #include "ui_neuralnetworkgui.h"
-#include "all_class.h"
+#include <QStatusBar>
 
-
-
-void showVectorVals(std::string label, std::vector<double> &v, QTextEdit *output_text){
-    QString output = QString::fromStdString(label) + " ";
-    unsigned size = v.size();
-    for(unsigned i = 0; i < size; i++)
-    output += QString::number(v[i]) + " ";
-    output += "\n";
-    output_text->append(output);
-}
+// 进度最多每秒刷新 1000 / PROGRESS_INTERVAL_MS 次
+#define PROGRESS_INTERVAL_MS 100
 
 NeuralNetworkGUI::NeuralNetworkGUI(QWidget *parent) :
     QMainWindow(parent),
@@ -26,6 +18,11 @@ NeuralNetworkGUI::NeuralNetworkGUI(QWidget *parent) :
     output_text = new QTextEdit(this);
     open_file_button = new QPushButton("打开训练文件", this);
     clear_button = new QPushButton("清空输出",this);
+    cancel_button = new QPushButton("取消", this);
+    cancel_button->setEnabled(false);
+    progress_timer = new QTimer(this);
+    progress_timer->setInterval(PROGRESS_INTERVAL_MS);
+    shown_phase = PHASE_IDLE;
 
 
 
@@ -37,6 +34,7 @@ NeuralNetworkGUI::NeuralNetworkGUI(QWidget *parent) :
     output_text->setGeometry(20, 140, 920, 360);
     open_file_button->setGeometry(480, 20, 100, 40);
     clear_button->setGeometry(240,80,200,40);
+    cancel_button->setGeometry(460, 80, 200, 40);
 
 
 
@@ -46,6 +44,8 @@ NeuralNetworkGUI::NeuralNetworkGUI(QWidget *parent) :
     //connect(test_button, &QPushButton::clicked, this, &NeuralNetworkGUI::test);
     connect(open_file_button, &QPushButton::clicked, this, &NeuralNetworkGUI::openFile);
     connect(clear_button, &QPushButton::clicked, this, &NeuralNetworkGUI::clearOut);
+    connect(cancel_button, &QPushButton::clicked, this, &NeuralNetworkGUI::cancelTraining);
+    connect(progress_timer, &QTimer::timeout, this, &NeuralNetworkGUI::showProgress);
 
     // 设置窗口大小和标题
     resize(960, 540);
@@ -55,94 +55,75 @@ NeuralNetworkGUI::NeuralNetworkGUI(QWidget *parent) :
     show();
 }
 void NeuralNetworkGUI:: train() {
-    // 这里是训练函数的代码，将训练输出信息写入到 QTextEdit 对象中
+    // 训练和测试在 TrainingJob 的后台线程里进行，界面线程只负责定时取进度
     QString filename = filename_edit->text();
+    QFileInfo trainingInfo(filename);
+    test_filename = trainingInfo.path() + "/testData.txt";
+    if(!job.start(filename.toStdString(), test_filename.toStdString()))
+        return;
+    shown_phase = PHASE_TRAINING;
 
     // 在文本框中追加训练信息
     output_text->append("训练文件：");
     output_text->append(filename);
     output_text->append("开始训练...\n");
 
-    // ...
-
-    std::string s_filename = filename.toStdString();
-    TrainingData trainData(s_filename);
-    std::vector<unsigned> topology;
-
-    trainData.getTopology(topology);
-    Net myNet(topology);
-
-    std::vector<double> inputVals, targetVals, resultVals;
-
-    int trainingPass = 0;
-    while(!trainData.isEof()){
-        ++trainingPass;
-        QString pass = "Pass " + QString::number(trainingPass) + "\n";
-        output_text->append(pass);
-        if(trainData.getNextInputs(inputVals) != topology[0])
-            break;
-        showVectorVals(": Inputs :", inputVals,output_text);
-        myNet.feedForward(inputVals);
-        myNet.getResults(resultVals);
-        showVectorVals("Outputs:", resultVals,output_text);
+    train_button->setEnabled(false);
+    cancel_button->setEnabled(true);
+    progress_timer->start();
+}
 
-        trainData.getTargetOutputs(targetVals);
-        showVectorVals("Targets:", targetVals,output_text);
-        assert(targetVals.size() == topology.back());
+void NeuralNetworkGUI::cancelTraining() {
+    job.cancel();
+    cancel_button->setEnabled(false);
+}
 
-        myNet.backProp(targetVals);
+void NeuralNetworkGUI::showProgress() {
+    TrainingProgress p;
+    if(!job.poll(p))
+        return;
 
-        QString loss = "Net recent average loss: " + QString::number(myNet.getRecentAverageloss()) + "\n";
-        output_text->append(loss);
+    if(p.phase == PHASE_TRAINING){
+        statusBar()->showMessage("训练中：" + QString::number(p.trained) + " 个样本，Net recent average loss: "
+                                 + QString::number(p.recentAverageLoss));
+        return;
     }
-
-    output_text->append("Done\n");
-    output_text->append("训练完成后将进行测试，请耐心等待\n");
-
-    // 训练结束后弹出消息框
-    QMessageBox::information(this, "训练成功", "神经网络训练成功！");
-
-    // 这里是测试函数的代码，获取测试文件名字并计算准确率
-    filename = filename_edit->text();
-    QFileInfo trainingInfo(filename);
-    filename = trainingInfo.path() + "/testData.txt";
-
-    // 在文本框中追加测试信息
-    output_text->append("****************\n测试文件：");
-    output_text->append(filename);
-    output_text->append("开始测试...\n");
-
-    // ...
-    s_filename = filename.toStdString();
-    TestData testData(s_filename);
-    int cnt = 0;
-    double totac = 0;
-    while(!testData.isEof()){
-        cnt++;
-        QString pass = "Pass " + QString::number(cnt) + "\n";
-        output_text->append(pass);
-        if(testData.getNextInputs(inputVals) != topology[0])
-            break;
-        myNet.feedForward(inputVals);
-
-        myNet.getResults(resultVals);
-
-        testData.getTargetOutputs(targetVals);
-        if(resultVals[0] > 0.5)
-            resultVals[0] = 1;
-        else
-            resultVals[0] = 0;
-        showVectorVals("Target", targetVals,output_text);
-        showVectorVals("Results:", resultVals,output_text);
-        if(resultVals[0] == targetVals[0])
-            totac++;
+    // 中间的快照可能被合并掉了，所以按阶段补齐输出
+    if(shown_phase == PHASE_TRAINING && p.phase != PHASE_FAILED){
+        output_text->append("Done，共训练 " + QString::number(p.trained) + " 个样本，Net recent average loss: "
+                            + QString::number(p.recentAverageLoss) + "\n");
+        if(p.phase != PHASE_CANCELLED || p.tested > 0){
+            output_text->append("****************\n测试文件：");
+            output_text->append(test_filename);
+            output_text->append("开始测试...\n");
+        }
+        shown_phase = PHASE_TESTING;
+    }
+    double accuracy = p.tested > 0 ? (double)p.correct / p.tested * 100 : 0.0;
+    if(p.phase == PHASE_TESTING){
+        statusBar()->showMessage("测试中：" + QString::number(p.tested) + " 个样本，准确率 "
+                                 + QString::number(accuracy) + "%");
+        return;
     }
-    QString output = QString::fromStdString("") + "测试准确率为 ";
-    output += QString::number((totac / cnt)*100) + "%";
-    output_text->append(output);
-    // 显示测试结果
-    QMessageBox::information(this, "测试结果", output);
 
+    // 结束：完成、取消或出错
+    progress_timer->stop();
+    train_button->setEnabled(true);
+    cancel_button->setEnabled(false);
+    shown_phase = p.phase;
+    statusBar()->showMessage("用时 " + QString::number(p.seconds) + " 秒");
+    if(p.phase == PHASE_FAILED){
+        output_text->append(QString::fromStdString(p.error));
+        QMessageBox::warning(this, "训练失败", QString::fromStdString(p.error));
+    } else if(p.phase == PHASE_CANCELLED){
+        output_text->append("已取消\n");
+    } else {
+        QString output = QString::fromStdString("") + "测试准确率为 ";
+        output += QString::number(accuracy) + "%";
+        output_text->append(output);
+        // 显示测试结果
+        QMessageBox::information(this, "测试结果", output);
+    }
 }
 
 void NeuralNetworkGUI:: test() {
@@ -8,6 +8,8 @@
 #include <QMessageBox>
 #include<qtextedit.h>
 #include<qfiledialog.h>
+#include <QTimer>
+#include "training_job.h"
 
 namespace Ui {
 class NeuralNetworkGUI;
@@ -27,6 +29,8 @@ private:
     void openFolder();
     void openFile();
     void clearOut();
+    void cancelTraining();
+    void showProgress();
     Ui::NeuralNetworkGUI *ui;
     QLabel *filename_label;   // 文件名标签
     QLineEdit *filename_edit; // 文件名输入框
@@ -34,8 +38,13 @@ private:
     QPushButton *test_button; // 测试按钮
     QPushButton *open_file_button; //输入文件按钮
     QPushButton *clear_button; //清空按钮
+    QPushButton *cancel_button; //取消按钮
     QTextEdit *output_text;   // 输出文本框
     QString filename;
+    QString test_filename;
+    TrainingJob job;          // 后台训练线程
+    QTimer *progress_timer;   // 定时取最新进度，限制界面刷新频率
+    TrainingPhase shown_phase; // 文本框里已经输出到的阶段
 
 };
 
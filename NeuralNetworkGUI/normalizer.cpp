@@ -0,0 +1,125 @@
+#include "normalizer.h"
+#include "all_class.h"
+#include "thread_pool.h"
+
+// Rows per partial result. Partials are merged in order, so the statistics
+// do not depend on the thread count.
+#define STATS_CHUNK 4096
+// Samples a text file is parsed in at a time.
+#define STATS_BLOCK 65536
+
+static const char *const scalingNames[SCALING_COUNT] = {"none", "standard", "minmax"};
+
+const char *scalingName(ScalingKind kind){
+    return kind < SCALING_COUNT ? scalingNames[kind] : "unknown";
+}
+
+bool scalingFromName(const std::string &name, ScalingKind &kind){
+    for(unsigned i = 0; i < SCALING_COUNT; i++)
+        if(name == scalingNames[i]){
+            kind = (ScalingKind)i;
+            return true;
+        }
+    return false;
+}
+
+void FeatureStats::merge(const FeatureStats &other){
+    if(other.count == 0)
+        return;
+    if(count == 0){
+        *this = other;
+        return;
+    }
+    double total = (double)count + other.count;
+    double weight = other.count / total;
+    double cross = (double)count * other.count / total;
+    for(size_t i = 0; i < mean.size(); i++){
+        double delta = other.mean[i] - mean[i];
+        mean[i] += delta * weight;
+        m2[i] += other.m2[i] + delta * delta * cross;
+        min[i] = std::min(min[i], other.min[i]);
+        max[i] = std::max(max[i], other.max[i]);
+    }
+    count += other.count;
+}
+
+InputScaling inputScaling(const FeatureStats &stats, ScalingKind kind){
+    InputScaling scaling;
+    if(kind == SCALING_NONE || stats.count == 0)
+        return scaling;
+    scaling.kind = kind;
+    unsigned n = stats.numFeatures();
+    scaling.offset.resize(n);
+    scaling.scale.resize(n);
+    for(unsigned i = 0; i < n; i++){
+        double spread = kind == SCALING_STANDARD ? sqrt(stats.variance(i)) : stats.max[i] - stats.min[i];
+        scaling.offset[i] = kind == SCALING_STANDARD ? stats.mean[i] : stats.min[i];
+        scaling.scale[i] = spread > 0.0 ? 1.0 / spread : 1.0;
+    }
+    return scaling;
+}
+
+template<class V>
+static void accumulateRows(const V *inputs, size_t count, unsigned numInputs, ThreadPool &pool, FeatureStats &stats){
+    size_t chunks = (count + STATS_CHUNK - 1) / STATS_CHUNK;
+    std::vector<FeatureStats> partials(chunks, FeatureStats(numInputs));
+    pool.parallelFor(chunks, [&](unsigned chunk, unsigned){
+        size_t first = (size_t)chunk * STATS_CHUNK, last = std::min(count, first + STATS_CHUNK);
+        for(size_t s = first; s < last; s++)
+            partials[chunk].add(inputs + s * numInputs);
+    });
+    for(size_t chunk = 0; chunk < chunks; chunk++)
+        stats.merge(partials[chunk]);
+}
+
+void computeFeatureStats(const double *inputs, size_t count, unsigned numInputs, ThreadPool &pool,
+                         FeatureStats &stats){
+    stats = FeatureStats(numInputs);
+    accumulateRows(inputs, count, numInputs, pool, stats);
+}
+
+bool computeFeatureStats(const std::string &filename, ThreadPool &pool, FeatureStats &stats){
+    if(!std::ifstream(filename.c_str()))
+        return false;
+    TrainingData data(filename);
+    std::vector<unsigned> topology;
+    data.getTopology(topology);
+    unsigned numInputs = topology.front(), numOutputs = topology.back();
+    stats = FeatureStats(numInputs);
+
+    if(const MappedDataset *mapped = data.binaryData()){
+        if(mapped->header().dtype == DATASET_FLOAT64)
+            accumulateRows(mapped->inputs(0), mapped->size(), numInputs, pool, stats);
+        else
+            accumulateRows(mapped->inputsFloat(0), mapped->size(), numInputs, pool, stats);
+        return true;
+    }
+
+    // Stops at the end of the data or at a sample of the wrong width, as
+    // the training loops do.
+    std::vector<double> inputVals, targetVals;
+    auto parse = [&](std::vector<double> &block) -> size_t {
+        block.resize((size_t)STATS_BLOCK * numInputs);
+        size_t n = 0;
+        while(n < STATS_BLOCK && !data.isEof()){
+            if(data.getNextInputs(inputVals) != numInputs || data.getTargetOutputs(targetVals) != numOutputs)
+                break;
+            std::copy(inputVals.begin(), inputVals.end(), &block[n * numInputs]);
+            n++;
+        }
+        return n;
+    };
+    std::vector<double> blocks[2];
+    size_t counts[2];
+    unsigned current = 0;
+    counts[current] = parse(blocks[current]);
+    while(counts[current] > 0){
+        std::future<size_t> next;
+        if(counts[current] == STATS_BLOCK)
+            next = std::async(std::launch::async, parse, std::ref(blocks[1 - current]));
+        accumulateRows(blocks[current].data(), counts[current], numInputs, pool, stats);
+        counts[1 - current] = next.valid() ? next.get() : 0;
+        current = 1 - current;
+    }
+    return true;
+}
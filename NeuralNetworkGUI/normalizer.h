@@ -0,0 +1,76 @@
+#ifndef NORMALIZER_H
+#define NORMALIZER_H
+
+
+#include<bits/stdc++.h>
+
+class ThreadPool;
+
+// How a Net rescales its inputs before the first layer. The values are
+// stored in checkpoints, so only ever append.
+enum ScalingKind {
+    SCALING_NONE = 0,
+    SCALING_STANDARD = 1,  // (x - mean) / standard deviation
+    SCALING_MINMAX = 2     // (x - min) / (max - min), the training range onto [0, 1]
+};
+#define SCALING_COUNT 3
+
+const char *scalingName(ScalingKind kind);
+bool scalingFromName(const std::string &name, ScalingKind &kind);
+
+// Per-feature count, mean, sum of squared deviations (Welford) and range.
+// Partial results from different threads or blocks combine with merge()
+// (Chan et al.), which gives the same mean and variance as one pass over
+// all the samples up to rounding.
+struct FeatureStats {
+    unsigned long long count;
+    std::vector<double> mean;
+    std::vector<double> m2;
+    std::vector<double> min;
+    std::vector<double> max;
+    explicit FeatureStats(unsigned numFeatures = 0)
+        : count(0), mean(numFeatures, 0.0), m2(numFeatures, 0.0),
+          min(numFeatures, HUGE_VAL), max(numFeatures, -HUGE_VAL) {}
+    unsigned numFeatures(void) const { return mean.size(); }
+    template<class V> void add(const V *values){
+        count++;
+        double inverse = 1.0 / count;
+        for(size_t i = 0; i < mean.size(); i++){
+            double x = values[i];
+            double delta = x - mean[i];
+            mean[i] += delta * inverse;
+            m2[i] += delta * (x - mean[i]);
+            min[i] = std::min(min[i], x);
+            max[i] = std::max(max[i], x);
+        }
+    }
+    void merge(const FeatureStats &other);
+    // Population variance of feature i.
+    double variance(unsigned i) const { return count > 0 ? m2[i] / count : 0.0; }
+};
+
+// x' = (x[i] - offset[i]) * scale[i] for every input i. A feature without
+// spread keeps scale 1, so it only moves.
+struct InputScaling {
+    ScalingKind kind;
+    std::vector<double> offset;
+    std::vector<double> scale;
+    InputScaling() : kind(SCALING_NONE) {}
+    bool empty(void) const { return kind == SCALING_NONE; }
+    unsigned numInputs(void) const { return offset.size(); }
+};
+
+InputScaling inputScaling(const FeatureStats &stats, ScalingKind kind);
+
+// Input statistics of count samples of numInputs values, row after row,
+// with the rows split across the pool and the partial results merged.
+void computeFeatureStats(const double *inputs, size_t count, unsigned numInputs, ThreadPool &pool,
+                         FeatureStats &stats);
+// The same over a training file in one pass. A binary file is read in
+// place through its mapping; a text file is parsed a block at a time on a
+// background thread while the pool accumulates the previous block. False
+// if the file cannot be read.
+bool computeFeatureStats(const std::string &filename, ThreadPool &pool, FeatureStats &stats);
+
+
+#endif // NORMALIZER_H
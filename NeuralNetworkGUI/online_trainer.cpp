@@ -0,0 +1,154 @@
+#include "online_trainer.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start){
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+OnlineTrainer::OnlineTrainer(Net &net, SampleSource &source, NetSnapshots &snapshots, const OnlineOptions &options)
+    : m_net(net), m_source(source), m_snapshots(snapshots), m_options(options), m_pool(options.threads),
+      m_trainer(net, m_pool), m_sourceDone(false), m_stalenessSum(0.0), m_stalenessCount(0)
+{
+    m_options.batchSize = std::max(1u, m_options.batchSize);
+    m_options.maxPending = std::max<size_t>(m_options.maxPending, m_options.batchSize);
+    std::vector<unsigned> topology;
+    net.getTopology(topology);
+    m_numInputs = topology.front();
+    m_numOutputs = topology.back();
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_stats.recentAverageLoss = net.getRecentAverageloss();
+    m_start = Clock::now();
+    m_ingest = std::thread(&OnlineTrainer::ingestLoop, this);
+    m_training = std::thread(&OnlineTrainer::trainLoop, this);
+}
+
+OnlineTrainer::~OnlineTrainer(){
+    wait();
+}
+
+void OnlineTrainer::wait(void){
+    if(m_ingest.joinable())
+        m_ingest.join();
+    if(m_training.joinable())
+        m_training.join();
+}
+
+void OnlineTrainer::ingestLoop(void){
+    std::vector<double> inputVals, targetVals;
+    while(!m_source.isEof() && m_source.getNextInputs(inputVals) == m_numInputs){
+        if(m_source.getTargetOutputs(targetVals) != m_numOutputs)
+            break;
+        Clock::time_point arrived = Clock::now();
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if(m_pending.size() >= m_options.maxPending){
+            m_taken.wait(lock, [this]{ return m_pending.size() < m_options.maxPending; });
+            m_stats.ingestWaitSeconds += secondsSince(arrived);
+        }
+        m_pending.inputs.insert(m_pending.inputs.end(), inputVals.begin(), inputVals.end());
+        m_pending.targets.insert(m_pending.targets.end(), targetVals.begin(), targetVals.end());
+        m_pending.arrived.push_back(arrived);
+        m_stats.ingested++;
+        // The first sample sets the trainer's deadline, a whole batch starts a round.
+        bool wake = m_pending.size() == 1 || m_pending.size() == m_options.batchSize;
+        lock.unlock();
+        if(wake)
+            m_arrived.notify_one();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_sourceDone = true;
+    }
+    m_arrived.notify_one();
+}
+
+void OnlineTrainer::trainLoop(void){
+    Pending taken;
+    double lastRound = 0.0;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(true){
+        m_arrived.wait(lock, [this]{ return m_sourceDone || m_pending.size() > 0; });
+        if(m_pending.size() == 0)
+            break;
+        // Wait for a whole batch, but leave the round time (and a tenth of
+        // the bound for waking up) to train what is here before the oldest
+        // sample goes stale.
+        Clock::time_point deadline = m_pending.arrived.front()
+            + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(
+                  std::max(0.0, m_options.maxStaleness * 0.9 - lastRound)));
+        while(!m_sourceDone && m_pending.size() < m_options.batchSize
+              && m_arrived.wait_until(lock, deadline) != std::cv_status::timeout){
+        }
+        taken.clear();
+        std::swap(taken, m_pending);
+        lock.unlock();
+        m_taken.notify_one();
+
+        Clock::time_point start = Clock::now(), lastPublish = start;
+        size_t published = 0;
+        for(size_t first = 0; first < taken.size(); first += m_options.batchSize){
+            size_t count = std::min<size_t>(m_options.batchSize, taken.size() - first);
+            trainRange(taken, first, count);
+            if(first + count < taken.size() && secondsSince(lastPublish) >= m_options.maxStaleness / 2){
+                publish(taken, published, first + count - published);
+                published = first + count;
+                lastPublish = Clock::now();
+            }
+        }
+        publish(taken, published, taken.size() - published);
+        lastRound = secondsSince(start);
+        lock.lock();
+    }
+}
+
+void OnlineTrainer::trainRange(const Pending &samples, size_t first, size_t count){
+    const double *inputs = &samples.inputs[first * m_numInputs];
+    const double *targets = &samples.targets[first * m_numOutputs];
+    if(m_options.batchSize == 1){
+        for(size_t s = 0; s < count; s++){
+            m_inputVals.assign(inputs + s * m_numInputs, inputs + (s + 1) * m_numInputs);
+            m_targetVals.assign(targets + s * m_numOutputs, targets + (s + 1) * m_numOutputs);
+            m_net.feedForward(m_inputVals);
+            m_net.backProp(m_targetVals);
+        }
+    } else {
+        m_trainer.trainBatch(inputs, targets, count);
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.trained += count;
+}
+
+void OnlineTrainer::publish(const Pending &samples, size_t first, size_t count){
+    unsigned long long trained;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        trained = m_stats.trained;
+    }
+    m_snapshots.publish(m_net, trained);
+    Clock::time_point now = Clock::now();
+    double sum = 0.0, worst = 0.0;
+    unsigned long long late = 0;
+    for(size_t s = first; s < first + count; s++){
+        double staleness = std::chrono::duration<double>(now - samples.arrived[s]).count();
+        sum += staleness;
+        worst = std::max(worst, staleness);
+        if(staleness > m_options.maxStaleness)
+            late++;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.published++;
+    m_stats.maxStaleness = std::max(m_stats.maxStaleness, worst);
+    m_stats.lateSamples += late;
+    m_stalenessSum += sum;
+    m_stalenessCount += count;
+    m_stats.recentAverageLoss = m_net.getRecentAverageloss();
+}
+
+OnlineStats OnlineTrainer::stats(void) const{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    OnlineStats stats = m_stats;
+    stats.seconds = secondsSince(m_start);
+    stats.pending = m_pending.size();
+    stats.meanStaleness = m_stalenessCount > 0 ? m_stalenessSum / m_stalenessCount : 0.0;
+    return stats;
+}
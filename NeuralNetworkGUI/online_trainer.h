@@ -0,0 +1,93 @@
+#ifndef ONLINE_TRAINER_H
+#define ONLINE_TRAINER_H
+
+
+#include "all_class.h"
+#include "parallel_trainer.h"
+#include "snapshots.h"
+
+struct OnlineOptions {
+    unsigned batchSize;       // samples per update; 1 = the per-sample loop of the command line
+    double maxStaleness;      // seconds from reading a sample to publishing weights trained on it
+    size_t maxPending;        // samples read but not yet trained beyond which reading waits
+    unsigned threads;         // pool for ParallelTrainer, 0 = all cores
+    OnlineOptions() : batchSize(32), maxStaleness(1.0), maxPending(1 << 16), threads(1) {}
+};
+
+struct OnlineStats {
+    double seconds;                   // since the trainer started
+    unsigned long long ingested;      // samples read from the source
+    unsigned long long trained;
+    unsigned long long published;     // snapshots
+    size_t pending;                   // read, not trained yet
+    double maxStaleness, meanStaleness; // seconds, over the published samples
+    unsigned long long lateSamples;   // published later than maxStaleness
+    double recentAverageLoss;
+    double ingestWaitSeconds;         // reading held back because maxPending were waiting
+};
+
+// Trains a Net on samples as they arrive and keeps publishing it.
+//
+// An ingest thread reads the source into a pending buffer and stamps each
+// sample with its arrival time. A trainer thread swaps that buffer for an
+// empty one (the two alternate, so reading never waits for training), trains
+// what it took in mini-batches of batchSize, and publishes the weights to
+// snapshots. It starts a round once a whole batch is pending, or, with
+// fewer, when the oldest pending sample would otherwise miss maxStaleness
+// given how long the last round took; a long round also publishes part way
+// through. Staleness thus stays under maxStaleness while the trainer keeps
+// up with the stream; when it cannot, samples arrive late (counted in
+// lateSamples) and, once maxPending are waiting, reading slows down to the
+// training rate instead of buffering without bound.
+//
+// Samples whose widths do not match the Net end the stream, as in main().
+// The Net, source and snapshots must outlive the trainer; the Net must not
+// be touched until wait() has returned.
+class OnlineTrainer{
+public:
+    OnlineTrainer(Net &net, SampleSource &source, NetSnapshots &snapshots,
+                  const OnlineOptions &options = OnlineOptions());
+    ~OnlineTrainer();
+    OnlineTrainer(const OnlineTrainer &) = delete;
+    OnlineTrainer &operator=(const OnlineTrainer &) = delete;
+    // Returns once the source has ended and every sample read from it is
+    // trained and published.
+    void wait(void);
+    OnlineStats stats(void) const;
+private:
+    typedef std::chrono::steady_clock Clock;
+    // Samples row after row, with their arrival times.
+    struct Pending {
+        std::vector<double> inputs;
+        std::vector<double> targets;
+        std::vector<Clock::time_point> arrived;
+        size_t size(void) const { return arrived.size(); }
+        void clear(void) { inputs.clear(); targets.clear(); arrived.clear(); }
+    };
+    void ingestLoop(void);
+    void trainLoop(void);
+    void trainRange(const Pending &samples, size_t first, size_t count);
+    void publish(const Pending &samples, size_t first, size_t count);
+    Net &m_net;
+    SampleSource &m_source;
+    NetSnapshots &m_snapshots;
+    OnlineOptions m_options;
+    unsigned m_numInputs;
+    unsigned m_numOutputs;
+    ThreadPool m_pool;
+    ParallelTrainer m_trainer;
+    std::vector<double> m_resultVals, m_inputVals, m_targetVals;
+    mutable std::mutex m_mutex;       // guards m_pending, m_sourceDone and m_stats
+    std::condition_variable m_arrived; // a sample was read, or the source ended
+    std::condition_variable m_taken;   // the trainer emptied m_pending
+    Pending m_pending;
+    bool m_sourceDone;
+    Clock::time_point m_start;
+    OnlineStats m_stats;
+    double m_stalenessSum;            // over the m_stalenessCount published samples
+    unsigned long long m_stalenessCount;
+    std::thread m_ingest, m_training;
+};
+
+
+#endif // ONLINE_TRAINER_H
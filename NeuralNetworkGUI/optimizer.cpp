@@ -0,0 +1,72 @@
+#include "optimizer.h"
+
+bool optimizerFromName(const std::string &name, OptimizerKind &kind){
+    for(unsigned i = 0; i < OPTIMIZER_COUNT; i++){
+        if(name == optimizerInfo((OptimizerKind)i).name){
+            kind = (OptimizerKind)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool scheduleFromName(const std::string &name, ScheduleKind &kind){
+    static const char *const names[] = {"constant", "step", "exponential", "cosine"};
+    for(unsigned i = 0; i < sizeof(names) / sizeof(names[0]); i++){
+        if(name == names[i]){
+            kind = (ScheduleKind)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+double scheduledRate(const OptimizerConfig &config, unsigned long long t){
+    double rate = config.learningRate;
+    unsigned long long period = std::max(1ULL, config.decaySteps);
+    unsigned long long done = t > 0 ? t - 1 : 0;
+    switch(config.schedule){
+    case SCHEDULE_CONSTANT:
+        break;
+    case SCHEDULE_STEP:
+        rate *= pow(config.decayRate, (double)(done / period));
+        break;
+    case SCHEDULE_EXPONENTIAL:
+        rate *= pow(config.decayRate, (double)done / period);
+        break;
+    case SCHEDULE_COSINE: {
+        double progress = std::min(1.0, (double)done / period);
+        rate = config.minLearningRate
+               + (config.learningRate - config.minLearningRate) * 0.5 * (1.0 + cos(M_PI * progress));
+        break;
+    }
+    }
+    if(config.warmupSteps > 0 && t < config.warmupSteps)
+        rate *= (double)t / config.warmupSteps;
+    return rate;
+}
+
+template<class T>
+OptimizerStepT<T> optimizerStep(const OptimizerConfig &config, unsigned long long t){
+    double rate = scheduledRate(config, t);
+    OptimizerStepT<T> step;
+    step.rate = T(rate);
+    step.momentum = T(config.momentum);
+    step.decay = T(config.kind == OPTIMIZER_RMSPROP ? config.rmsDecay : config.beta2);
+    step.epsilon = T(config.epsilon);
+    step.l2 = T(config.kind == OPTIMIZER_ADAMW || config.kind == OPTIMIZER_SGD ? 0.0 : config.weightDecay);
+    step.shrink = T(config.kind == OPTIMIZER_ADAMW ? rate * config.weightDecay : 0.0);
+    if(config.kind == OPTIMIZER_ADAM || config.kind == OPTIMIZER_ADAMW){
+        // rate * mHat / (sqrt(vHat) + eps) with mHat = m / (1 - beta1^t) and
+        // vHat = v / (1 - beta2^t), rewritten so the kernels use m and v as is.
+        double c1 = 1.0 - pow(config.beta1, (double)std::max(1ULL, t));
+        double c2 = sqrt(1.0 - pow(config.beta2, (double)std::max(1ULL, t)));
+        step.rate = T(rate * c2 / c1);
+        step.momentum = T(config.beta1);
+        step.epsilon = T(config.epsilon * c2);
+    }
+    return step;
+}
+
+template OptimizerStepT<double> optimizerStep<double>(const OptimizerConfig &, unsigned long long);
+template OptimizerStepT<float> optimizerStep<float>(const OptimizerConfig &, unsigned long long);
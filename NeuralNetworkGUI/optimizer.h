@@ -0,0 +1,113 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+
+#include<bits/stdc++.h>
+#include "kernels.h"
+
+// The original momentum SGD's learning rate and momentum, now the defaults
+// of OptimizerConfig.
+#define eta 0.15
+#define alpha 0.5
+
+// Weight update rules. The values are stored in checkpoints, so only ever
+// append. Every rule keeps its first state buffer in Net's momentum block;
+// Adam/AdamW also keep a second-moment buffer.
+enum OptimizerKind {
+    OPTIMIZER_SGD = 0,      // momentum SGD, the original rule
+    OPTIMIZER_NESTEROV = 1,
+    OPTIMIZER_ADAM = 2,     // weight decay as an L2 term in the gradient
+    OPTIMIZER_ADAMW = 3,    // weight decay decoupled from the gradient
+    OPTIMIZER_RMSPROP = 4
+};
+#define OPTIMIZER_COUNT 5
+
+struct OptimizerInfo {
+    OptimizerKind kind;
+    const char *name;
+    double defaultRate;     // learning rate when none is given
+    bool secondMoment;      // needs the extra state buffer
+};
+
+inline const OptimizerInfo &optimizerInfo(OptimizerKind kind){
+    static const OptimizerInfo registry[OPTIMIZER_COUNT] = {
+        {OPTIMIZER_SGD,      "sgd",      eta,   false},
+        {OPTIMIZER_NESTEROV, "nesterov", eta,   false},
+        {OPTIMIZER_ADAM,     "adam",     0.001, true},
+        {OPTIMIZER_ADAMW,    "adamw",    0.001, true},
+        {OPTIMIZER_RMSPROP,  "rmsprop",  0.001, false},
+    };
+    return registry[kind];
+}
+
+inline bool isValidOptimizer(uint32_t value){ return value < OPTIMIZER_COUNT; }
+bool optimizerFromName(const std::string &name, OptimizerKind &kind);
+
+// How the learning rate moves with the step count t (1 for the first
+// update), before warm-up scales it by min(1, t / warmupSteps).
+enum ScheduleKind {
+    SCHEDULE_CONSTANT,
+    SCHEDULE_STEP,          // times decayRate every decaySteps steps
+    SCHEDULE_EXPONENTIAL,   // times decayRate^(t / decaySteps), smoothly
+    SCHEDULE_COSINE         // cosine from learningRate to minLearningRate over decaySteps
+};
+bool scheduleFromName(const std::string &name, ScheduleKind &kind);
+
+// The rule and every hyperparameter, all settable at run time. The
+// defaults are the original eta/alpha momentum SGD.
+struct OptimizerConfig {
+    OptimizerKind kind;
+    double learningRate;
+    double momentum;        // SGD and Nesterov
+    double beta1, beta2;    // Adam moment decays
+    double rmsDecay;        // RMSProp's mean-square decay
+    double epsilon;         // Adam and RMSProp
+    double weightDecay;     // L2 for Nesterov, RMSProp and Adam, decoupled for AdamW; SGD ignores it
+    ScheduleKind schedule;
+    unsigned long long decaySteps;
+    double decayRate;
+    double minLearningRate;
+    unsigned long long warmupSteps;
+
+    OptimizerConfig()
+        : kind(OPTIMIZER_SGD), learningRate(eta), momentum(alpha), beta1(0.9), beta2(0.999),
+          rmsDecay(0.9), epsilon(1e-8), weightDecay(0.0), schedule(SCHEDULE_CONSTANT),
+          decaySteps(1000), decayRate(0.5), minLearningRate(0.0), warmupSteps(0) {}
+};
+
+// The scheduled learning rate for step t.
+double scheduledRate(const OptimizerConfig &config, unsigned long long t);
+// The constants the update kernels need for step t, with Adam's bias
+// correction folded into rate and epsilon.
+template<class T> OptimizerStepT<T> optimizerStep(const OptimizerConfig &config, unsigned long long t);
+
+// One row of an update: g[i] = input[i] * gradient is the descent
+// direction, first/second the row's state. Unless upstream is NULL, the
+// same pass adds weight[i] * gradient (from the weights before the update)
+// to upstream, the row's share of the previous layer's gradient. SGD runs
+// the original momentumUpdate arithmetic, so its results do not change.
+template<class T>
+inline void updateRow(const KernelTableT<T> &k, OptimizerKind kind, const OptimizerStepT<T> &step,
+                      T *weight, T *first, T *second, T *upstream, const T *input, T gradient, unsigned n){
+    switch(kind){
+    case OPTIMIZER_SGD:
+        if(upstream != NULL)
+            k.momentumBackward(weight, first, upstream, input, gradient, step.rate, step.momentum, n);
+        else
+            k.momentumUpdate(weight, first, input, gradient, step.rate, step.momentum, n);
+        break;
+    case OPTIMIZER_NESTEROV:
+        k.nesterovUpdate(weight, first, second, upstream, input, gradient, step, n);
+        break;
+    case OPTIMIZER_ADAM:
+    case OPTIMIZER_ADAMW:
+        k.adamUpdate(weight, first, second, upstream, input, gradient, step, n);
+        break;
+    case OPTIMIZER_RMSPROP:
+        k.rmspropUpdate(weight, first, second, upstream, input, gradient, step, n);
+        break;
+    }
+}
+
+
+#endif // OPTIMIZER_H
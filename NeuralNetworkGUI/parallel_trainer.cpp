@@ -0,0 +1,79 @@
+#include "parallel_trainer.h"
+
+ParallelTrainer::ParallelTrainer(Net &net, ThreadPool &pool, unsigned shardSize)
+    : m_net(net), m_pool(pool), m_shardSize(std::max(1u, shardSize)), m_hogwild(false)
+{
+    std::vector<unsigned> topology;
+    net.getTopology(topology);
+    m_numInputs = topology.front();
+    m_numOutputs = topology.back();
+}
+
+void ParallelTrainer::trainBatch(const std::vector<double> &inputs, const std::vector<double> &targets,
+                                 unsigned batchSize){
+    assert(inputs.size() == (size_t)batchSize * m_numInputs);
+    assert(targets.size() == (size_t)batchSize * m_numOutputs);
+    trainBatch(inputs.data(), targets.data(), batchSize);
+}
+
+void ParallelTrainer::trainBatch(const double *inputs, const double *targets, unsigned batchSize){
+    if(batchSize == 0)
+        return;
+    unsigned numShards = (batchSize + m_shardSize - 1) / m_shardSize;
+    if(m_shards.size() < numShards)
+        m_shards.resize(numShards);
+    if(m_hogwild)
+        trainHogwild(inputs, targets, batchSize);
+    else
+        trainSynchronous(inputs, targets, batchSize);
+}
+
+void ParallelTrainer::trainSynchronous(const double *inputs, const double *targets, unsigned batchSize){
+    unsigned numShards = (batchSize + m_shardSize - 1) / m_shardSize;
+    m_pool.parallelFor(numShards, [&](unsigned s, unsigned){
+        unsigned first = s * m_shardSize;
+        unsigned count = std::min(m_shardSize, batchSize - first);
+        m_net.computeGradients(inputs + (size_t)first * m_numInputs,
+                               targets + (size_t)first * m_numOutputs,
+                               count, m_shards[s]);
+    });
+
+    // Every workspace keeps its weight gradients as one array in the
+    // parameters() layout, so each pair reduces in a single loop.
+    size_t numGradients = m_net.numParameters();
+    for(unsigned stride = 1; stride < numShards; stride *= 2){
+        unsigned numPairs = (numShards + 2 * stride - 1) / (2 * stride);
+        m_pool.parallelFor(numPairs, [&](unsigned pair, unsigned){
+            unsigned dst = pair * 2 * stride, src = dst + stride;
+            if(src >= numShards)
+                return;
+            double *a = m_shards[dst].weightGradients[0];
+            const double *b = m_shards[src].weightGradients[0];
+            for(size_t i = 0; i < numGradients; i++)
+                a[i] += b[i];
+        });
+    }
+
+    for(unsigned s = 0; s < numShards; s++){
+        unsigned first = s * m_shardSize;
+        m_net.recordLosses(m_shards[s].losses.data(), std::min(m_shardSize, batchSize - first));
+    }
+    m_net.applyGradients(m_shards[0], 1.0 / batchSize);
+}
+
+void ParallelTrainer::trainHogwild(const double *inputs, const double *targets, unsigned batchSize){
+    unsigned numShards = (batchSize + m_shardSize - 1) / m_shardSize;
+    m_losses.resize(batchSize);
+    m_pool.parallelFor(numShards, [&](unsigned s, unsigned){
+        unsigned first = s * m_shardSize;
+        unsigned last = std::min(first + m_shardSize, batchSize);
+        BatchWorkspace &ws = m_shards[s];
+        for(unsigned b = first; b < last; b++){
+            m_net.computeGradients(inputs + (size_t)b * m_numInputs,
+                                   targets + (size_t)b * m_numOutputs, 1, ws);
+            m_net.applyGradients(ws, 1.0);
+            m_losses[b] = ws.losses[0];
+        }
+    });
+    m_net.recordLosses(m_losses.data(), batchSize);
+}
@@ -0,0 +1,41 @@
+#ifndef PARALLEL_TRAINER_H
+#define PARALLEL_TRAINER_H
+
+
+#include "all_class.h"
+#include "thread_pool.h"
+
+// Data-parallel mini-batch training for a Net.
+//
+// Each batch is cut into shards of shardSize samples. Workers compute the
+// gradient of a shard into that shard's private BatchWorkspace, then the
+// shard gradients are summed by a pairwise tree (0+1, 2+3, ..., then 0+2, ...)
+// and applied once. Shard boundaries and the reduction order depend only on
+// shardSize, so the result is bit-identical for any thread count.
+//
+// In hogwild mode every worker instead runs the Net's optimizer over its
+// shard, one sample at a time, updating the shared weights and optimizer
+// state without any locking. Updates (and the optimizer's step count) from
+// different threads may overwrite each other; runs are not reproducible.
+class ParallelTrainer{
+public:
+    ParallelTrainer(Net &net, ThreadPool &pool, unsigned shardSize = 64);
+    void setHogwild(bool hogwild) { m_hogwild = hogwild; }
+    void trainBatch(const double *inputs, const double *targets, unsigned batchSize);
+    void trainBatch(const std::vector<double> &inputs, const std::vector<double> &targets,
+                    unsigned batchSize);
+private:
+    void trainSynchronous(const double *inputs, const double *targets, unsigned batchSize);
+    void trainHogwild(const double *inputs, const double *targets, unsigned batchSize);
+    Net &m_net;
+    ThreadPool &m_pool;
+    unsigned m_shardSize;
+    unsigned m_numInputs;
+    unsigned m_numOutputs;
+    bool m_hogwild;
+    std::vector<BatchWorkspace> m_shards;
+    std::vector<double> m_losses;
+};
+
+
+#endif // PARALLEL_TRAINER_H
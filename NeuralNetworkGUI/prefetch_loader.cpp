@@ -0,0 +1,144 @@
+#include "prefetch_loader.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start){
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Spin briefly, then yield, then sleep: cheap when the other side is about to
+// catch up, and does not burn a core the other side may need.
+static void backoff(unsigned &spins){
+    if(++spins < 64)
+        return;
+    if(spins < 256)
+        std::this_thread::yield();
+    else
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+}
+
+PrefetchLoader::PrefetchLoader(SampleSource &source, unsigned numInputs, unsigned numOutputs,
+                               unsigned batchSize, unsigned depth)
+    : m_source(source), m_numInputs(numInputs), m_numOutputs(numOutputs),
+      m_batchSize(std::max(1u, batchSize)), m_ring(std::max(1u, depth)),
+      m_head(0), m_tail(0), m_producerDone(false), m_stop(false),
+      m_current(NULL), m_cursor(0), m_producerBusy(0.0), m_producerStall(0.0)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+    for(unsigned i = 0; i < m_ring.size(); i++){
+        m_ring[i].inputs.resize((size_t)m_batchSize * numInputs);
+        m_ring[i].targets.resize((size_t)m_batchSize * numOutputs);
+        m_ring[i].size = 0;
+    }
+    m_producer = std::thread(&PrefetchLoader::produce, this);
+}
+
+PrefetchLoader::~PrefetchLoader(){
+    m_stop = true;
+    m_producer.join();
+}
+
+void PrefetchLoader::produce(void){
+    std::vector<double> inputVals, targetVals;
+    double busy = 0.0, stall = 0.0;
+    bool more = true;
+    while(more && !m_stop){
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if(tail - m_head.load(std::memory_order_acquire) == m_ring.size()){
+            Clock::time_point start = Clock::now();
+            unsigned spins = 0;
+            while(tail - m_head.load(std::memory_order_acquire) == m_ring.size() && !m_stop)
+                backoff(spins);
+            stall += secondsSince(start);
+            m_producerStall.store(stall, std::memory_order_relaxed);
+            if(m_stop)
+                break;
+        }
+
+        Clock::time_point start = Clock::now();
+        MiniBatch &batch = m_ring[tail % m_ring.size()];
+        batch.size = 0;
+        while(batch.size < m_batchSize){
+            if(m_source.isEof() || m_source.getNextInputs(inputVals) != m_numInputs){
+                more = false;
+                break;
+            }
+            m_source.getTargetOutputs(targetVals);
+            if(targetVals.size() != m_numOutputs){
+                more = false;
+                break;
+            }
+            std::copy(inputVals.begin(), inputVals.end(), &batch.inputs[(size_t)batch.size * m_numInputs]);
+            std::copy(targetVals.begin(), targetVals.end(), &batch.targets[(size_t)batch.size * m_numOutputs]);
+            batch.size++;
+        }
+        busy += secondsSince(start);
+        m_producerBusy.store(busy, std::memory_order_relaxed);
+        if(batch.size > 0)
+            m_tail.store(tail + 1, std::memory_order_release);
+    }
+    m_producerDone.store(true, std::memory_order_release);
+}
+
+void PrefetchLoader::releaseCurrent(void){
+    if(m_current == NULL)
+        return;
+    m_current = NULL;
+    m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+const MiniBatch *PrefetchLoader::nextBatch(void){
+    releaseCurrent();
+    size_t head = m_head.load(std::memory_order_relaxed);
+    if(head == m_tail.load(std::memory_order_acquire)){
+        Clock::time_point start = Clock::now();
+        unsigned spins = 0;
+        while(head == m_tail.load(std::memory_order_acquire)){
+            // Check done before re-reading tail so a last batch is never missed.
+            if(m_producerDone.load(std::memory_order_acquire)
+               && head == m_tail.load(std::memory_order_acquire)){
+                m_stats.consumerStallSeconds += secondsSince(start);
+                return NULL;
+            }
+            backoff(spins);
+        }
+        m_stats.consumerStallSeconds += secondsSince(start);
+    }
+    m_current = &m_ring[head % m_ring.size()];
+    m_cursor = 0;
+    m_stats.batches++;
+    m_stats.samples += m_current->size;
+    return m_current;
+}
+
+bool PrefetchLoader::isEof(void){
+    if(m_current != NULL && m_cursor < m_current->size)
+        return false;
+    return nextBatch() == NULL;
+}
+
+unsigned PrefetchLoader::getNextInputs(std::vector<double> &inputVals){
+    inputVals.clear();
+    if(isEof())
+        return 0;
+    const double *in = &m_current->inputs[(size_t)m_cursor * m_numInputs];
+    inputVals.assign(in, in + m_numInputs);
+    return inputVals.size();
+}
+
+unsigned PrefetchLoader::getTargetOutputs(std::vector<double> &targetOutputVals){
+    targetOutputVals.clear();
+    if(m_current == NULL || m_cursor >= m_current->size)
+        return 0;
+    const double *out = &m_current->targets[(size_t)m_cursor * m_numOutputs];
+    targetOutputVals.assign(out, out + m_numOutputs);
+    m_cursor++;
+    return targetOutputVals.size();
+}
+
+PipelineStats PrefetchLoader::stats(void) const{
+    PipelineStats stats = m_stats;
+    stats.producerBusySeconds = m_producerBusy.load(std::memory_order_relaxed);
+    stats.producerStallSeconds = m_producerStall.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,67 @@
+#ifndef PREFETCH_LOADER_H
+#define PREFETCH_LOADER_H
+
+
+#include "all_class.h"
+
+struct MiniBatch {
+    std::vector<double> inputs;  // size x numInputs
+    std::vector<double> targets; // size x numOutputs
+    unsigned size;
+};
+
+struct PipelineStats {
+    unsigned long long batches;
+    unsigned long long samples;
+    double producerBusySeconds;  // reading and parsing
+    double producerStallSeconds; // waiting for a free slot: the trainer is the bottleneck
+    double consumerStallSeconds; // waiting for a ready batch: input is the bottleneck
+};
+
+// Reads a SampleSource on a background thread into a bounded ring of
+// preallocated mini-batches, so I/O and parsing overlap with training.
+//
+// The ring is single-producer/single-consumer and lock-free: the producer
+// only advances m_tail, the consumer only advances m_head. When the ring is
+// full the producer waits (backpressure); when it is empty the consumer
+// waits. Both waits are timed and reported by stats().
+//
+// The loader is itself a SampleSource, so the per-sample loops can read from
+// it unchanged; batch loops call nextBatch() instead. A sample whose input
+// width is not numInputs ends the stream, like the loops in main() do.
+class PrefetchLoader : public SampleSource{
+public:
+    PrefetchLoader(SampleSource &source, unsigned numInputs, unsigned numOutputs,
+                   unsigned batchSize, unsigned depth = 4);
+    ~PrefetchLoader();
+    PrefetchLoader(const PrefetchLoader &) = delete;
+    PrefetchLoader &operator=(const PrefetchLoader &) = delete;
+    // Next ready batch, or NULL at the end of the data. The batch stays valid
+    // until the following call to nextBatch() or isEof().
+    const MiniBatch *nextBatch(void);
+    bool isEof(void);
+    unsigned getNextInputs(std::vector<double> &inputVals);
+    unsigned getTargetOutputs(std::vector<double> &targetOutputVals);
+    PipelineStats stats(void) const;
+private:
+    void produce(void);
+    void releaseCurrent(void);
+    SampleSource &m_source;
+    unsigned m_numInputs;
+    unsigned m_numOutputs;
+    unsigned m_batchSize;
+    std::vector<MiniBatch> m_ring;
+    alignas(64) std::atomic<size_t> m_head;
+    alignas(64) std::atomic<size_t> m_tail;
+    std::atomic<bool> m_producerDone;
+    std::atomic<bool> m_stop;
+    const MiniBatch *m_current;
+    unsigned m_cursor;
+    PipelineStats m_stats;
+    std::atomic<double> m_producerBusy;
+    std::atomic<double> m_producerStall;
+    std::thread m_producer;
+};
+
+
+#endif // PREFETCH_LOADER_H
@@ -0,0 +1,271 @@
+#include "profiler.h"
+
+static const char *const phaseNames[PROFILE_PHASE_COUNT] = {
+    "parse", "feedForward", "backProp", "update", "batchForward", "batchBackward",
+    "predict", "output", "checkpoint",
+};
+
+const char *profilePhaseName(ProfilePhase phase){
+    return phase < PROFILE_PHASE_COUNT ? phaseNames[phase] : "?";
+}
+
+#ifndef NN_PROFILE
+
+bool profileEnabled(void){
+    return false;
+}
+
+void profileStartTrace(size_t){
+}
+
+uint64_t profileTotal(ProfileCounter){
+    return 0;
+}
+
+void profileReset(void){
+}
+
+void writeProfileSummary(std::ostream &out){
+    out << "profiling is not compiled in (build with -DNN_PROFILE, make PROFILE=1)\n";
+}
+
+bool writeProfileTrace(const std::string &){
+    return false;
+}
+
+#else
+
+// Threads beyond this share the last slot, and may lose increments there.
+#define PROFILE_MAX_THREADS 256
+
+thread_local ProfileThread *t_profileThread = NULL;
+
+static std::atomic<ProfileThread *> s_threads[PROFILE_MAX_THREADS];
+static std::atomic<unsigned> s_numThreads(0);
+static std::atomic<size_t> s_traceCapacity(0);
+static std::mutex s_traceMutex;
+static uint64_t s_startTicks = profileTicks();
+static std::chrono::steady_clock::time_point s_startTime = std::chrono::steady_clock::now();
+
+// Event buffers come from malloc, so they do not count as allocations.
+static void attachEvents(ProfileThread &thread, size_t capacity){
+    if(thread.events.load(std::memory_order_acquire) != NULL || capacity == 0)
+        return;
+    thread.eventCapacity = capacity;
+    thread.events.store((ProfileEvent *)malloc(capacity * sizeof(ProfileEvent)), std::memory_order_release);
+}
+
+// calloc and placement new rather than operator new: this runs from inside
+// the counting operator new below.
+ProfileThread &profileThreadSlow(void){
+    unsigned id = s_numThreads.fetch_add(1);
+    ProfileThread *thread;
+    if(id < PROFILE_MAX_THREADS){
+        thread = new(calloc(1, sizeof(ProfileThread))) ProfileThread();
+        thread->id = id;
+        std::lock_guard<std::mutex> lock(s_traceMutex);
+        attachEvents(*thread, s_traceCapacity.load());
+        s_threads[id].store(thread, std::memory_order_release);
+    } else {
+        thread = s_threads[PROFILE_MAX_THREADS - 1].load(std::memory_order_acquire);
+        while(thread == NULL)
+            thread = s_threads[PROFILE_MAX_THREADS - 1].load(std::memory_order_acquire);
+    }
+    t_profileThread = thread;
+    return *thread;
+}
+
+template<class F>
+static void forEachThread(F f){
+    unsigned count = std::min<unsigned>(s_numThreads.load(), PROFILE_MAX_THREADS);
+    for(unsigned i = 0; i < count; i++){
+        ProfileThread *thread = s_threads[i].load(std::memory_order_acquire);
+        if(thread != NULL)
+            f(*thread);
+    }
+}
+
+bool profileEnabled(void){
+    return true;
+}
+
+void profileStartTrace(size_t maxEvents){
+    std::lock_guard<std::mutex> lock(s_traceMutex);
+    s_traceCapacity.store(maxEvents);
+    forEachThread([maxEvents](ProfileThread &thread){ attachEvents(thread, maxEvents); });
+}
+
+uint64_t profileTotal(ProfileCounter counter){
+    uint64_t total = 0;
+    forEachThread([&](ProfileThread &thread){ total += thread.counters[counter].load(std::memory_order_relaxed); });
+    return total;
+}
+
+void profileReset(void){
+    forEachThread([](ProfileThread &thread){
+        for(unsigned p = 0; p < PROFILE_PHASE_COUNT; p++)
+            for(unsigned l = 0; l < PROFILE_MAX_LAYERS; l++){
+                thread.calls[p][l].store(0, std::memory_order_relaxed);
+                thread.ticks[p][l].store(0, std::memory_order_relaxed);
+            }
+        for(unsigned c = 0; c < PROFILE_COUNTER_COUNT; c++)
+            thread.counters[c].store(0, std::memory_order_relaxed);
+        thread.numEvents.store(0, std::memory_order_relaxed);
+        thread.droppedEvents.store(0, std::memory_order_relaxed);
+    });
+    s_startTicks = profileTicks();
+    s_startTime = std::chrono::steady_clock::now();
+}
+
+// Wall seconds since the last reset, and the tick rate measured over them.
+static void elapsed(double &seconds, double &ticksPerSecond){
+    uint64_t ticks = profileTicks() - s_startTicks;
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - s_startTime).count();
+    ticksPerSecond = seconds > 0 ? ticks / seconds : 1e9;
+}
+
+void writeProfileSummary(std::ostream &out){
+    uint64_t calls[PROFILE_PHASE_COUNT][PROFILE_MAX_LAYERS] = {};
+    uint64_t ticks[PROFILE_PHASE_COUNT][PROFILE_MAX_LAYERS] = {};
+    uint64_t counters[PROFILE_COUNTER_COUNT] = {};
+    uint64_t dropped = 0;
+    unsigned threads = 0;
+    forEachThread([&](ProfileThread &thread){
+        threads++;
+        for(unsigned p = 0; p < PROFILE_PHASE_COUNT; p++)
+            for(unsigned l = 0; l < PROFILE_MAX_LAYERS; l++){
+                calls[p][l] += thread.calls[p][l].load(std::memory_order_relaxed);
+                ticks[p][l] += thread.ticks[p][l].load(std::memory_order_relaxed);
+            }
+        for(unsigned c = 0; c < PROFILE_COUNTER_COUNT; c++)
+            counters[c] += thread.counters[c].load(std::memory_order_relaxed);
+        dropped += thread.droppedEvents.load(std::memory_order_relaxed);
+    });
+    double seconds, ticksPerSecond;
+    elapsed(seconds, ticksPerSecond);
+
+    std::ios_base::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(3);
+    out << "profile: " << seconds << "s wall, " << threads << " threads, "
+        << ticksPerSecond / 1e9 << "G ticks/s; times are summed over threads and inclusive\n";
+    out << std::setprecision(1);
+    out << std::left << std::setw(16) << "phase" << std::setw(8) << "layer" << std::right
+        << std::setw(14) << "calls" << std::setw(14) << "total ms" << std::setw(10) << "% wall"
+        << std::setw(14) << "ns/call" << '\n';
+    for(unsigned p = 0; p < PROFILE_PHASE_COUNT; p++){
+        // Some phases only have layer scopes; their name goes on the first.
+        bool named = false;
+        for(unsigned l = 0; l < PROFILE_MAX_LAYERS; l++){
+            if(calls[p][l] == 0)
+                continue;
+            double ms = ticks[p][l] / ticksPerSecond * 1e3;
+            std::string layer = l == PROFILE_NO_LAYER ? "" : l == PROFILE_MAX_LAYERS - 1
+                                ? std::to_string(l) + "+" : std::to_string(l);
+            out << std::left << std::setw(16) << (named ? "" : phaseNames[p])
+                << std::setw(8) << layer << std::right << std::setw(14) << calls[p][l]
+                << std::setw(14) << ms << std::setw(10) << (seconds > 0 ? ms / 10 / seconds : 0.0)
+                << std::setw(14) << ms * 1e6 / calls[p][l] << '\n';
+            named = true;
+        }
+    }
+    const char *counted[] = {"trained", "predicted", "parsed"};
+    for(unsigned c = PROFILE_TRAINED; c <= PROFILE_PARSED; c++)
+        out << counted[c] << ' ' << counters[c] << " samples ("
+            << (seconds > 0 ? counters[c] / seconds : 0.0) << "/s)" << (c < PROFILE_PARSED ? ", " : "\n");
+    out << "allocations " << counters[PROFILE_ALLOCATIONS] << " ("
+        << counters[PROFILE_ALLOCATED_BYTES] / 1024.0 << " KB)";
+    if(counters[PROFILE_TRAINED] > 0)
+        out << ", " << std::setprecision(3)
+            << (double)counters[PROFILE_ALLOCATIONS] / counters[PROFILE_TRAINED] << " per trained sample";
+    out << '\n';
+    if(dropped > 0)
+        out << "trace: " << dropped << " events dropped, buffers full\n";
+    out.flags(flags);
+}
+
+bool writeProfileTrace(const std::string &filename){
+    FILE *file = fopen(filename.c_str(), "w");
+    if(file == NULL)
+        return false;
+    double seconds, ticksPerSecond;
+    elapsed(seconds, ticksPerSecond);
+    double ticksPerUs = ticksPerSecond / 1e6;
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    bool first = true;
+    forEachThread([&](ProfileThread &thread){
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}",
+                first ? "" : ",\n", thread.id, thread.id);
+        first = false;
+        const ProfileEvent *events = thread.events.load(std::memory_order_acquire);
+        size_t count = thread.numEvents.load(std::memory_order_acquire);
+        for(size_t i = 0; events != NULL && i < count; i++){
+            const ProfileEvent &e = events[i];
+            // Events from before a reset are dropped.
+            if(e.begin < s_startTicks)
+                continue;
+            char name[32];
+            if(e.layer == PROFILE_NO_LAYER)
+                snprintf(name, sizeof(name), "%s", phaseNames[e.phase]);
+            else
+                snprintf(name, sizeof(name), "%s L%u", phaseNames[e.phase], e.layer);
+            fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                    "\"ts\":%.3f,\"dur\":%.3f}", name, phaseNames[e.phase], thread.id,
+                    (e.begin - s_startTicks) / ticksPerUs, (e.end - e.begin) / ticksPerUs);
+        }
+    });
+    fprintf(file, "\n]}\n");
+    return fclose(file) == 0;
+}
+
+// Counting allocator: every form of operator new goes through here.
+
+static void *countedAlloc(size_t size, size_t alignment){
+    profileCount(PROFILE_ALLOCATIONS, 1);
+    profileCount(PROFILE_ALLOCATED_BYTES, size);
+    if(size == 0)
+        size = 1;
+    if(alignment <= alignof(std::max_align_t))
+        return malloc(size);
+    return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+void *operator new(size_t size){
+    void *p = countedAlloc(size, 0);
+    if(p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size){
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept{
+    return countedAlloc(size, 0);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept{
+    return countedAlloc(size, 0);
+}
+
+void *operator new(size_t size, std::align_val_t alignment){
+    void *p = countedAlloc(size, (size_t)alignment);
+    if(p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size, std::align_val_t alignment){
+    return operator new(size, alignment);
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { free(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { free(p); }
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { free(p); }
+
+#endif // NN_PROFILE
@@ -0,0 +1,172 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+
+#include<bits/stdc++.h>
+
+// Hot-path instrumentation, compiled in only with -DNN_PROFILE (make
+// PROFILE=1). Without it the NN_PROFILE_* macros expand to nothing, operator
+// new is left alone, and the functions below report that profiling is off.
+//
+// A scope timer reads the TSC (steady_clock off x86) on entry and exit and
+// adds the difference to its phase, and to its layer for per-layer scopes.
+// Every thread keeps its own counters, registered once on first use, so the
+// hot path never takes a lock or shares a cache line: counters are atomics
+// that only their own thread writes, read by the summary with relaxed
+// loads. Phases nest (a layer scope sits inside its phase), so times are
+// inclusive.
+//
+// Phases:
+//   parse          TrainingData / TestData reading one sample
+//   feedForward    Net::feedForward, per layer
+//   backProp       Net::backProp, per layer; the fused sweep applies the
+//                  optimizer update in here, so "update" only sees the
+//                  unfused and batched paths
+//   update         optimizer step (applyGradients, backPropUnfused)
+//   batchForward / batchBackward
+//                  the GEMM passes of computeGradients, per layer
+//   predict        Net::predictBatch
+//   output         Logger calls on the training thread and the writer
+//                  thread's formatting
+//   checkpoint     saving and snapshotting checkpoints
+enum ProfilePhase {
+    PROFILE_PARSE = 0,
+    PROFILE_FEED_FORWARD,
+    PROFILE_BACK_PROP,
+    PROFILE_UPDATE,
+    PROFILE_BATCH_FORWARD,
+    PROFILE_BATCH_BACKWARD,
+    PROFILE_PREDICT,
+    PROFILE_OUTPUT,
+    PROFILE_CHECKPOINT,
+    PROFILE_PHASE_COUNT
+};
+
+enum ProfileCounter {
+    PROFILE_TRAINED = 0,   // samples through backProp / trainBatch
+    PROFILE_PREDICTED,     // samples through predictBatch
+    PROFILE_PARSED,        // samples read from a data file
+    PROFILE_ALLOCATIONS,   // operator new calls
+    PROFILE_ALLOCATED_BYTES,
+    PROFILE_COUNTER_COUNT
+};
+
+// Layer 0 is the whole phase; layers from PROFILE_MAX_LAYERS up share the
+// last slot.
+#define PROFILE_NO_LAYER 0
+#define PROFILE_MAX_LAYERS 16
+
+const char *profilePhaseName(ProfilePhase phase);
+
+// True if this build was compiled with NN_PROFILE.
+bool profileEnabled(void);
+// Starts recording one event per scope for writeProfileTrace, at most
+// maxEvents per thread (later ones are counted as dropped). Call before the
+// threads being traced start work.
+void profileStartTrace(size_t maxEvents = 1 << 20);
+// counter summed over every thread so far (0 without NN_PROFILE).
+uint64_t profileTotal(ProfileCounter counter);
+// Zeroes every counter and restarts the wall clock; only while no other
+// thread is inside a scope.
+void profileReset(void);
+// Per-phase and per-layer table, sample rates and allocation counts.
+void writeProfileSummary(std::ostream &out);
+// The recorded events as Chrome trace JSON (chrome://tracing, Perfetto).
+bool writeProfileTrace(const std::string &filename);
+
+#ifdef NN_PROFILE
+
+#if defined(__x86_64__) || defined(__i386__)
+#include<x86intrin.h>
+inline uint64_t profileTicks(void) { return __rdtsc(); }
+#else
+inline uint64_t profileTicks(void) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+struct ProfileEvent {
+    uint64_t begin, end;
+    unsigned short phase, layer;
+};
+
+// One thread's counters. Only the owning thread writes them.
+struct ProfileThread {
+    unsigned id;
+    std::atomic<uint64_t> calls[PROFILE_PHASE_COUNT][PROFILE_MAX_LAYERS];
+    std::atomic<uint64_t> ticks[PROFILE_PHASE_COUNT][PROFILE_MAX_LAYERS];
+    std::atomic<uint64_t> counters[PROFILE_COUNTER_COUNT];
+    std::atomic<ProfileEvent *> events;
+    size_t eventCapacity;
+    std::atomic<size_t> numEvents;
+    std::atomic<uint64_t> droppedEvents;
+};
+
+// Registers the calling thread on first use.
+ProfileThread &profileThreadSlow(void);
+extern thread_local ProfileThread *t_profileThread;
+
+inline ProfileThread &profileThread(void) {
+    ProfileThread *thread = t_profileThread;
+    return thread != NULL ? *thread : profileThreadSlow();
+}
+
+// Single-writer increment: a plain load and store, no locked instruction.
+inline void profileAdd(std::atomic<uint64_t> &counter, uint64_t amount) {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+inline void profileCount(ProfileCounter counter, uint64_t amount) {
+    profileAdd(profileThread().counters[counter], amount);
+}
+
+inline void profileRecord(ProfilePhase phase, unsigned layer, uint64_t begin, uint64_t end) {
+    ProfileThread &thread = profileThread();
+    layer = std::min(layer, (unsigned)PROFILE_MAX_LAYERS - 1);
+    profileAdd(thread.calls[phase][layer], 1);
+    profileAdd(thread.ticks[phase][layer], end - begin);
+    ProfileEvent *events = thread.events.load(std::memory_order_relaxed);
+    if(events == NULL)
+        return;
+    size_t n = thread.numEvents.load(std::memory_order_relaxed);
+    if(n < thread.eventCapacity){
+        ProfileEvent event = {begin, end, (unsigned short)phase, (unsigned short)layer};
+        events[n] = event;
+        thread.numEvents.store(n + 1, std::memory_order_release);
+    } else {
+        profileAdd(thread.droppedEvents, 1);
+    }
+}
+
+class ProfileScope{
+public:
+    explicit ProfileScope(ProfilePhase phase, unsigned layer = PROFILE_NO_LAYER)
+        : m_phase(phase), m_layer(layer), m_begin(profileTicks()) {}
+    ~ProfileScope() { profileRecord(m_phase, m_layer, m_begin, profileTicks()); }
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+private:
+    ProfilePhase m_phase;
+    unsigned m_layer;
+    uint64_t m_begin;
+};
+
+#define NN_PROFILE_CONCAT2(a, b) a##b
+#define NN_PROFILE_CONCAT(a, b) NN_PROFILE_CONCAT2(a, b)
+// Times the rest of the enclosing block.
+#define NN_PROFILE_SCOPE(phase) ProfileScope NN_PROFILE_CONCAT(profileScope, __LINE__)(phase)
+// Times the rest of the enclosing block as one layer of phase.
+#define NN_PROFILE_LAYER(phase, layer) ProfileScope NN_PROFILE_CONCAT(profileScope, __LINE__)(phase, layer)
+#define NN_PROFILE_COUNT(counter, amount) profileCount(counter, amount)
+
+#else
+
+#define NN_PROFILE_SCOPE(phase)
+#define NN_PROFILE_LAYER(phase, layer)
+#define NN_PROFILE_COUNT(counter, amount)
+
+#endif // NN_PROFILE
+
+
+#endif // PROFILER_H
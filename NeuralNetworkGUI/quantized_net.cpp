@@ -0,0 +1,208 @@
+#include "quantized_net.h"
+#include "kernels.h"
+
+// Sigmoid or tanh at the centre of a bucket.
+static float activationAt(ActivationKind kind, unsigned bucket){
+    float step = 2.0f * ACTIVATION_TABLE_RANGE / ACTIVATION_TABLE_SIZE;
+    float x = -ACTIVATION_TABLE_RANGE + (bucket + 0.5f) * step;
+    if(kind == ACTIVATION_TANH)
+        return std::tanh(x);
+    return 1.0f / (1.0f + std::exp(-x));
+}
+
+static bool usesTable(ActivationKind kind){
+    return kind == ACTIVATION_SIGMOID || kind == ACTIVATION_TANH;
+}
+
+static const std::vector<float> &sigmoidTable(void){
+    static const std::vector<float> table = [](){
+        std::vector<float> values(ACTIVATION_TABLE_SIZE);
+        for(unsigned b = 0; b < ACTIVATION_TABLE_SIZE; b++)
+            values[b] = activationAt(ACTIVATION_SIGMOID, b);
+        return values;
+    }();
+    return table;
+}
+
+unsigned QuantizedNet::tableBucket(float x){
+    float t = (x + ACTIVATION_TABLE_RANGE) * (ACTIVATION_TABLE_SIZE / (2.0f * ACTIVATION_TABLE_RANGE));
+    if(!(t >= 0.0f))
+        return 0;
+    if(t >= ACTIVATION_TABLE_SIZE)
+        return ACTIVATION_TABLE_SIZE - 1;
+    return (unsigned)t;
+}
+
+// Maps [lo, hi] onto 0..255. An empty or degenerate range (no calibration
+// samples, or a constant activation) gets a unit-wide one.
+QuantizedNet::ActivationRange QuantizedNet::rangeOf(float lo, float hi){
+    if(!(hi > lo)){
+        lo = lo > hi ? 0.0f : lo - 0.5f;
+        hi = lo + 1.0f;
+    }
+    ActivationRange range;
+    range.scale = (hi - lo) / 255.0f;
+    range.zeroPoint = (int32_t)lrintf(-lo / range.scale);
+    return range;
+}
+
+static uint8_t quantize(float x, float inverseScale, int32_t zeroPoint){
+    long q = lrintf(x * inverseScale) + zeroPoint;
+    return (uint8_t)std::min(255L, std::max(0L, q));
+}
+
+// A call through the kernel table costs more than it saves on rows shorter
+// than one vector; those are summed inline.
+static inline int32_t dotRow(const Int8KernelTable &k, const uint8_t *a, const int8_t *b, unsigned n){
+    if(n >= INT8_KERNEL_MIN_ROW)
+        return k.dot(a, b, n);
+    int32_t sum = 0;
+    for(unsigned i = 0; i < n; i++)
+        sum += (int32_t)a[i] * b[i];
+    return sum;
+}
+
+QuantizedNet::QuantizedNet(const Net &net, const float *calibrationInputs, size_t calibrationCount,
+                           QuantizationGranularity granularity){
+    std::vector<unsigned> topology;
+    std::vector<ActivationKind> kinds;
+    net.getTopology(topology);
+    net.getActivations(kinds);
+    unsigned numLayers = topology.size();
+    m_numInputs = topology[0];
+    const InputScaling &scaling = net.inputScaling();
+    if(!scaling.empty()){
+        m_inputOffset.assign(scaling.offset.begin(), scaling.offset.end());
+        m_inputScale.assign(scaling.scale.begin(), scaling.scale.end());
+    }
+
+    // Calibration: the range of every layer's outputs (layer 0 being the
+    // inputs) over the sample, computed with the original weights.
+    std::vector<float> lo(numLayers, FLT_MAX), hi(numLayers, -FLT_MAX);
+    std::vector<std::vector<double> > activations(numLayers);
+    for(size_t s = 0; s < calibrationCount; s++){
+        const float *sample = calibrationInputs + s * m_numInputs;
+        activations[0].assign(sample, sample + m_numInputs);
+        if(!scaling.empty())
+            for(unsigned i = 0; i < m_numInputs; i++)
+                activations[0][i] = (activations[0][i] - scaling.offset[i]) * scaling.scale[i];
+        const double *weights = net.parameters();
+        for(unsigned layerNum = 1; layerNum < numLayers; ++layerNum){
+            unsigned size = topology[layerNum - 1] + 1;
+            activations[layerNum].resize(topology[layerNum]);
+            for(unsigned j = 0; j < topology[layerNum]; j++){
+                const double *row = &weights[(size_t)j * size];
+                double sum = row[size - 1];
+                for(unsigned i = 0; i + 1 < size; i++)
+                    sum += activations[layerNum - 1][i] * row[i];
+                activations[layerNum][j] = sum;
+            }
+            activate(kinds[layerNum], activations[layerNum].data(), topology[layerNum]);
+            weights += (size_t)topology[layerNum] * size;
+        }
+        for(unsigned layerNum = 0; layerNum < numLayers; ++layerNum)
+            for(double value : activations[layerNum]){
+                lo[layerNum] = std::min(lo[layerNum], (float)value);
+                hi[layerNum] = std::max(hi[layerNum], (float)value);
+            }
+    }
+    std::vector<ActivationRange> ranges(numLayers);
+    for(unsigned layerNum = 0; layerNum < numLayers; ++layerNum)
+        ranges[layerNum] = rangeOf(lo[layerNum], hi[layerNum]);
+    m_input = ranges[0];
+
+    m_layers.resize(numLayers - 1);
+    const double *weights = net.parameters();
+    for(unsigned layerNum = 1; layerNum < numLayers; ++layerNum){
+        QuantizedLayer &layer = m_layers[layerNum - 1];
+        layer.numInputs = topology[layerNum - 1];
+        layer.numNeurons = topology[layerNum];
+        layer.activation = kinds[layerNum];
+        layer.inputZeroPoint = ranges[layerNum - 1].zeroPoint;
+        unsigned size = layer.numInputs + 1;
+        double layerMax = 0.0;
+        for(unsigned j = 0; j < layer.numNeurons; j++)
+            for(unsigned i = 0; i < layer.numInputs; i++)
+                layerMax = std::max(layerMax, fabs(weights[(size_t)j * size + i]));
+
+        layer.weights.resize((size_t)layer.numNeurons * layer.numInputs);
+        layer.scales.resize(layer.numNeurons);
+        layer.rowSums.resize(layer.numNeurons);
+        layer.biases.resize(layer.numNeurons);
+        for(unsigned j = 0; j < layer.numNeurons; j++){
+            const double *row = &weights[(size_t)j * size];
+            double rowMax = layerMax;
+            if(granularity == QUANTIZE_PER_ROW){
+                rowMax = 0.0;
+                for(unsigned i = 0; i < layer.numInputs; i++)
+                    rowMax = std::max(rowMax, fabs(row[i]));
+            }
+            double weightScale = rowMax > 0.0 ? rowMax / 127.0 : 1.0;
+            int32_t sum = 0;
+            for(unsigned i = 0; i < layer.numInputs; i++){
+                long q = std::min(127L, std::max(-127L, lrint(row[i] / weightScale)));
+                layer.weights[(size_t)j * layer.numInputs + i] = (int8_t)q;
+                sum += q;
+            }
+            layer.scales[j] = (float)(ranges[layerNum - 1].scale * weightScale);
+            layer.rowSums[j] = sum;
+            layer.biases[j] = (float)row[layer.numInputs];
+        }
+        layer.outputInverseScale = 1.0f / ranges[layerNum].scale;
+        layer.outputZeroPoint = ranges[layerNum].zeroPoint;
+        if(layerNum + 1 < numLayers && usesTable(layer.activation)){
+            layer.table.resize(ACTIVATION_TABLE_SIZE);
+            for(unsigned b = 0; b < ACTIVATION_TABLE_SIZE; b++)
+                layer.table[b] = quantize(activationAt(layer.activation, b), layer.outputInverseScale,
+                                          layer.outputZeroPoint);
+        }
+        weights += (size_t)layer.numNeurons * size;
+    }
+}
+
+void QuantizedNet::predictBatch(const float *inputs, size_t count, float *outputs) const{
+    static thread_local std::vector<uint8_t> current, next;
+    const Int8KernelTable &k = int8Kernels();
+    const float *outputTable = sigmoidTable().data();
+    unsigned numOut = numOutputs();
+    float inverseScale = 1.0f / m_input.scale;
+    for(size_t s = 0; s < count; s++){
+        const float *sample = inputs + s * m_numInputs;
+        current.resize(m_numInputs);
+        if(m_inputScale.empty()){
+            for(unsigned i = 0; i < m_numInputs; i++)
+                current[i] = quantize(sample[i], inverseScale, m_input.zeroPoint);
+        } else {
+            for(unsigned i = 0; i < m_numInputs; i++)
+                current[i] = quantize((sample[i] - m_inputOffset[i]) * m_inputScale[i], inverseScale, m_input.zeroPoint);
+        }
+        for(size_t layerNum = 0; layerNum < m_layers.size(); ++layerNum){
+            const QuantizedLayer &layer = m_layers[layerNum];
+            bool last = layerNum + 1 == m_layers.size();
+            bool table = usesTable(layer.activation);
+            next.resize(layer.numNeurons);
+            for(unsigned j = 0; j < layer.numNeurons; j++){
+                int64_t acc = dotRow(k, current.data(), &layer.weights[(size_t)j * layer.numInputs], layer.numInputs)
+                              - (int64_t)layer.inputZeroPoint * layer.rowSums[j];
+                float x = layer.scales[j] * (float)acc + layer.biases[j];
+                if(last)
+                    outputs[s * numOut + j] = layer.activation == ACTIVATION_SIGMOID ? outputTable[tableBucket(x)] : x;
+                else if(table)
+                    next[j] = layer.table[tableBucket(x)];
+                else
+                    next[j] = quantize(x > 0.0f ? x : layer.activation == ACTIVATION_RELU ? 0.0f : (float)LEAKY_RELU_SLOPE * x,
+                                       layer.outputInverseScale, layer.outputZeroPoint);
+            }
+            if(last && layer.activation != ACTIVATION_SIGMOID)
+                activate(layer.activation, outputs + s * numOut, numOut);
+            current.swap(next);
+        }
+    }
+}
+
+size_t QuantizedNet::weightBytes(void) const{
+    size_t bytes = 0;
+    for(const QuantizedLayer &layer : m_layers)
+        bytes += layer.weights.size() + layer.numNeurons * (sizeof(float) * 2 + sizeof(int32_t));
+    return bytes;
+}
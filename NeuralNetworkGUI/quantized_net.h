@@ -0,0 +1,76 @@
+#ifndef QUANTIZED_NET_H
+#define QUANTIZED_NET_H
+
+
+#include "all_class.h"
+
+// Sigmoid/tanh lookup: ACTIVATION_TABLE_SIZE buckets evenly over
+// [-ACTIVATION_TABLE_RANGE, ACTIVATION_TABLE_RANGE), each holding the
+// function at its centre; inputs outside the range clamp to the end buckets.
+#define ACTIVATION_TABLE_SIZE 4096
+#define ACTIVATION_TABLE_RANGE 8.0f
+// Rows with fewer inputs skip int8Kernels() for an inline loop.
+#define INT8_KERNEL_MIN_ROW 32
+
+enum QuantizationGranularity {
+    QUANTIZE_PER_LAYER, // one weight scale per layer
+    QUANTIZE_PER_ROW    // one weight scale per neuron
+};
+
+// A frozen, inference-only copy of a trained Net with 8-bit weights and
+// activations.
+//
+// Weights are symmetric int8, scaled per layer or per neuron. Activations
+// are asymmetric uint8, scale and zero point per layer, with the range of
+// every layer's outputs measured by running the calibration samples through
+// the original weights. The bias weight stays in float and is added after
+// the integer dot product (int8Kernels().dot):
+//
+//   y[j] = inScale * wScale[j] * (sum q_in * q_w[j] - inZero * sum q_w[j]) + bias[j]
+//
+// Hidden sigmoid and tanh layers look y up in a table that yields the next
+// layer's uint8 input directly, so no exp() and no float activations remain;
+// ReLU layers apply the ramp and requantize. A sigmoid output layer uses a
+// float sigmoid table, any other goes through activate<float>(). The Net's
+// input scaling is kept in float and applied before the inputs are
+// quantized, so callers pass raw samples to both.
+class QuantizedNet{
+public:
+    QuantizedNet(const Net &net, const float *calibrationInputs, size_t calibrationCount,
+                 QuantizationGranularity granularity = QUANTIZE_PER_ROW);
+    // Same contract as Net::predictBatch: const, uses thread-local scratch,
+    // safe to call from any number of threads.
+    void predictBatch(const float *inputs, size_t count, float *outputs) const;
+    unsigned numInputs(void) const { return m_numInputs; }
+    unsigned numOutputs(void) const { return m_layers.empty() ? 0 : m_layers.back().numNeurons; }
+    // Bytes of int8 weights plus the per-row float/int32 terms.
+    size_t weightBytes(void) const;
+private:
+    struct QuantizedLayer {
+        unsigned numInputs;             // previous layer's neurons, bias excluded
+        unsigned numNeurons;
+        ActivationKind activation;
+        int32_t inputZeroPoint;
+        std::vector<int8_t> weights;    // numNeurons x numInputs
+        std::vector<float> scales;      // input scale * weight scale, per row
+        std::vector<int32_t> rowSums;   // sum of each row's weights, for the input zero point
+        std::vector<float> biases;
+        std::vector<uint8_t> table;     // quantized activation feeding the next layer; hidden sigmoid/tanh only
+        float outputInverseScale;       // the next layer's input range, for hidden ReLU layers
+        int32_t outputZeroPoint;
+    };
+    struct ActivationRange {
+        float scale;
+        int32_t zeroPoint;
+    };
+    static ActivationRange rangeOf(float lo, float hi);
+    static unsigned tableBucket(float x);
+    unsigned m_numInputs;
+    std::vector<float> m_inputOffset;   // Net::inputScaling(), empty without one
+    std::vector<float> m_inputScale;
+    ActivationRange m_input;
+    std::vector<QuantizedLayer> m_layers;
+};
+
+
+#endif // QUANTIZED_NET_H
@@ -0,0 +1,24 @@
+#include "snapshots.h"
+
+NetSnapshots::NetSnapshots(const Net &net) : m_current(std::make_shared<NetSnapshot>(net)), m_version(0)
+{
+    m_current->published = std::chrono::steady_clock::now();
+}
+
+void NetSnapshots::publish(const Net &net, unsigned long long samplesSeen){
+    std::shared_ptr<NetSnapshot> next;
+    if(m_spare && m_spare.use_count() == 1){
+        // The last reader dropped it; see its reads before overwriting.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        next.swap(m_spare);
+        next->net.copyWeights(net);
+    } else {
+        m_spare.reset();
+        next = std::make_shared<NetSnapshot>(net);
+    }
+    next->version = m_version.load(std::memory_order_relaxed) + 1;
+    next->samplesSeen = samplesSeen;
+    next->published = std::chrono::steady_clock::now();
+    m_spare = std::atomic_exchange(&m_current, next);
+    m_version.store(next->version, std::memory_order_relaxed);
+}
@@ -0,0 +1,41 @@
+#ifndef SNAPSHOTS_H
+#define SNAPSHOTS_H
+
+
+#include "all_class.h"
+
+// A copy of a Net's weights as they were at one point of training.
+struct NetSnapshot {
+    Net net;
+    unsigned long long version;     // 1 for the first one published, then counting up
+    unsigned long long samplesSeen; // samples trained into net
+    std::chrono::steady_clock::time_point published;
+    explicit NetSnapshot(const Net &source) : net(source), version(0), samplesSeen(0) {}
+};
+
+// Read-copy-update publication of a Net that another thread keeps training.
+// Readers take current() and predict from it for as long as they hold it;
+// publish() copies the weights into a snapshot no reader can see and swaps
+// it in atomically, so readers never wait for the writer or see a
+// half-copied Net, and the writer never waits for readers.
+//
+// Two snapshots alternate: the one retired by a publish is reused by the
+// next once every reader has let go of it, so publishing is a weight copy
+// without allocating. If a reader still holds it, that publish builds a
+// fresh snapshot instead. publish() is for one thread; current() for any.
+class NetSnapshots{
+public:
+    explicit NetSnapshots(const Net &net);
+    NetSnapshots(const NetSnapshots &) = delete;
+    NetSnapshots &operator=(const NetSnapshots &) = delete;
+    void publish(const Net &net, unsigned long long samplesSeen);
+    std::shared_ptr<const NetSnapshot> current(void) const { return std::atomic_load(&m_current); }
+    unsigned long long version(void) const { return m_version.load(std::memory_order_relaxed); }
+private:
+    std::shared_ptr<NetSnapshot> m_current;
+    std::shared_ptr<NetSnapshot> m_spare;   // retired, only ever touched by the publisher
+    std::atomic<unsigned long long> m_version;
+};
+
+
+#endif // SNAPSHOTS_H
@@ -0,0 +1,289 @@
+#ifndef STATIC_NET_H
+#define STATIC_NET_H
+
+
+#include "all_class.h"
+
+// A network whose topology is fixed at compile time, for the small models
+// the data files describe ("topology: 2 8 1" is StaticNet<2, 8, 1>).
+//
+// Weights, momentum and the per-layer buffers are std::arrays inside the
+// object, laid out exactly as Net's parameter block, so nothing is allocated
+// after construction and every loop bound is a constant the compiler can
+// unroll. The arithmetic is Net's under NN_KERNEL=scalar, operation for
+// operation (same summation order, same update expression), so a StaticNet
+// loaded from a Net reproduces its outputs and its training bit for bit.
+//
+// Everything but load() is constexpr. Sigmoid, tanh and softmax call libm,
+// so only ReLU nets can actually be evaluated at compile time before C++26.
+//
+// There is no random initialisation; start from a Net instead:
+//   StaticNet<2, 8, 1> net;  net.load(Net(topology));
+
+// Sizes are compile-time constants, but GCC only unrolls short loops on its
+// own at -O2; ask for it explicitly where the compiler understands the hint.
+#if defined(__GNUC__)
+#define STATIC_NET_UNROLL _Pragma("GCC unroll 64")
+#else
+#define STATIC_NET_UNROLL
+#endif
+template<class T, unsigned... Sizes>
+class BasicStaticNet{
+public:
+    static constexpr unsigned numLayers = sizeof...(Sizes);
+    static_assert(numLayers >= 2, "a network needs an input and an output layer");
+
+private:
+    static constexpr unsigned s_sizes[numLayers] = {Sizes...};
+
+    // Offset of layer layerNum's weights in the parameter block (rows of
+    // numInputs + 1, bias last) and of its outputs in the layer buffers
+    // (numNeurons + 1, the bias neuron's constant 1 last).
+    static constexpr size_t weightOffset(unsigned layerNum){
+        size_t offset = 0;
+        for(unsigned l = 1; l < layerNum; l++)
+            offset += (size_t)s_sizes[l] * (s_sizes[l - 1] + 1);
+        return offset;
+    }
+    static constexpr size_t outputOffset(unsigned layerNum){
+        size_t offset = 0;
+        for(unsigned l = 0; l < layerNum; l++)
+            offset += s_sizes[l] + 1;
+        return offset;
+    }
+
+public:
+    static constexpr unsigned numInputs = s_sizes[0];
+    static constexpr unsigned numOutputs = s_sizes[numLayers - 1];
+    static constexpr size_t numParameters = weightOffset(numLayers);
+    static constexpr size_t numValues = outputOffset(numLayers);
+
+    // All-zero weights, sigmoid everywhere and eta/alpha until load().
+    constexpr BasicStaticNet()
+        : m_weights{}, m_deltaWeights{}, m_activations{}, m_outputs{}, m_gradients{},
+          m_rate(T(eta)), m_momentumRate(T(alpha)), m_loss(0.0), m_recentAverageloss(0.0)
+    {
+        for(unsigned layerNum = 0; layerNum < numLayers; ++layerNum)
+            m_activations[layerNum] = ACTIVATION_SIGMOID;
+    }
+
+    // Copies net's activations, weights, momentum, learning rate and loss
+    // state. False, leaving this net unchanged, if its topology is not
+    // Sizes..., it scales its inputs, or it trains with anything but
+    // constant-rate momentum SGD.
+    template<class U>
+    bool load(const BasicNet<U> &net){
+        std::vector<unsigned> topology;
+        std::vector<ActivationKind> activations;
+        net.getTopology(topology);
+        net.getActivations(activations);
+        const OptimizerConfig &optimizer = net.optimizer();
+        if(topology != std::vector<unsigned>{Sizes...} || !net.inputScaling().empty() || optimizer.kind != OPTIMIZER_SGD
+           || optimizer.schedule != SCHEDULE_CONSTANT || optimizer.warmupSteps > 0)
+            return false;
+        m_rate = T(optimizer.learningRate);
+        m_momentumRate = T(optimizer.momentum);
+        std::copy(activations.begin(), activations.end(), m_activations.begin());
+        for(size_t i = 0; i < numParameters; i++){
+            m_weights[i] = T(net.parameters()[i]);
+            m_deltaWeights[i] = T(net.momentum()[i]);
+        }
+        m_loss = net.getLoss();
+        m_recentAverageloss = net.getRecentAverageloss();
+        return true;
+    }
+
+    // Same contract as Net's, with the samples as plain arrays.
+    constexpr void feedForward(const double *inputVals){
+        for(unsigned i = 0; i < numInputs; i++)
+            m_outputs[i] = T(inputVals[i]);
+        forwardLayer<1>(m_outputs.data());
+    }
+    constexpr void backProp(const double *targetVals);
+    constexpr void getResults(double *resultVals) const{
+        for(unsigned i = 0; i < numOutputs; i++)
+            resultVals[i] = m_outputs[outputOffset(numLayers - 1) + i];
+    }
+    // feedForward + getResults on a stack buffer: const, so any number of
+    // threads may share one net.
+    constexpr void predict(const double *inputVals, double *resultVals) const{
+        std::array<T, numValues> values{};
+        for(unsigned i = 0; i < numInputs; i++)
+            values[i] = T(inputVals[i]);
+        forwardLayer<1>(values.data());
+        for(unsigned i = 0; i < numOutputs; i++)
+            resultVals[i] = values[outputOffset(numLayers - 1) + i];
+    }
+
+    constexpr const T *parameters(void) const { return m_weights.data(); }
+    constexpr const T *momentum(void) const { return m_deltaWeights.data(); }
+    constexpr ActivationKind activation(unsigned layerNum) const { return m_activations[layerNum]; }
+    constexpr double getLoss(void) const { return m_loss; }
+    constexpr double getRecentAverageloss(void) const { return m_recentAverageloss; }
+
+private:
+    // Inline copies of activations.cpp's scalar forms, so a whole pass
+    // inlines instead of calling through the kernel table per layer.
+    static constexpr void activateLayer(ActivationKind kind, T *values, unsigned n){
+        switch(kind){
+        case ACTIVATION_SIGMOID:
+            for(unsigned i = 0; i < n; i++)
+                values[i] = T(1) / (T(1) + std::exp(-values[i]));
+            break;
+        case ACTIVATION_TANH:
+            for(unsigned i = 0; i < n; i++)
+                values[i] = std::tanh(values[i]);
+            break;
+        case ACTIVATION_RELU:
+            for(unsigned i = 0; i < n; i++)
+                values[i] = values[i] > T(0) ? values[i] : T(0);
+            break;
+        case ACTIVATION_LEAKY_RELU:
+            for(unsigned i = 0; i < n; i++)
+                values[i] = values[i] > T(0) ? values[i] : T(LEAKY_RELU_SLOPE) * values[i];
+            break;
+        case ACTIVATION_SOFTMAX: {
+            T largest = values[0];
+            for(unsigned i = 1; i < n; i++)
+                largest = std::max(largest, values[i]);
+            T sum = T(0);
+            for(unsigned i = 0; i < n; i++){
+                values[i] = std::exp(values[i] - largest);
+                sum += values[i];
+            }
+            T scale = T(1) / sum;
+            for(unsigned i = 0; i < n; i++)
+                values[i] *= scale;
+            break;
+        }
+        }
+    }
+    static constexpr void multiplyDerivativeLayer(ActivationKind kind, const T *outputs, T *gradients, unsigned n){
+        switch(kind){
+        case ACTIVATION_SIGMOID:
+            for(unsigned i = 0; i < n; i++)
+                gradients[i] = gradients[i] * (outputs[i] * (T(1) - outputs[i]));
+            break;
+        case ACTIVATION_TANH:
+            for(unsigned i = 0; i < n; i++)
+                gradients[i] = gradients[i] * (T(1) - outputs[i] * outputs[i]);
+            break;
+        case ACTIVATION_RELU:
+            for(unsigned i = 0; i < n; i++)
+                gradients[i] = outputs[i] > T(0) ? gradients[i] : T(0);
+            break;
+        case ACTIVATION_LEAKY_RELU:
+            for(unsigned i = 0; i < n; i++)
+                gradients[i] = outputs[i] > T(0) ? gradients[i] : T(LEAKY_RELU_SLOPE) * gradients[i];
+            break;
+        case ACTIVATION_SOFTMAX:
+            // Output layer only; backProp applies its Jacobian itself.
+            break;
+        }
+    }
+
+    template<unsigned layerNum>
+    constexpr void forwardLayer(T *values) const{
+        if constexpr(layerNum < numLayers){
+            constexpr unsigned size = s_sizes[layerNum - 1] + 1, neurons = s_sizes[layerNum];
+            T *in = values + outputOffset(layerNum - 1);
+            const T *weights = m_weights.data() + weightOffset(layerNum);
+            T *out = values + outputOffset(layerNum);
+            in[size - 1] = T(1);
+            STATIC_NET_UNROLL
+            for(unsigned j = 0; j < neurons; j++){
+                T sum = T(0);
+                STATIC_NET_UNROLL
+                for(unsigned i = 0; i < size; i++)
+                    sum += in[i] * weights[j * size + i];
+                out[j] = sum;
+            }
+            activateLayer(m_activations[layerNum], out, neurons);
+            forwardLayer<layerNum + 1>(values);
+        }
+    }
+    // sumDOW for hidden layer layerNum, then its derivative, down to layer 1.
+    template<unsigned layerNum>
+    constexpr void backwardLayer(void){
+        if constexpr(layerNum > 0){
+            constexpr unsigned size = s_sizes[layerNum] + 1, nextNeurons = s_sizes[layerNum + 1];
+            const T *nextWeights = m_weights.data() + weightOffset(layerNum + 1);
+            const T *nextGradients = m_gradients.data() + outputOffset(layerNum + 1);
+            T *dow = m_gradients.data() + outputOffset(layerNum);
+            STATIC_NET_UNROLL
+            for(unsigned i = 0; i < size; i++)
+                dow[i] = T(0);
+            STATIC_NET_UNROLL
+            for(unsigned j = 0; j < nextNeurons; j++)
+                STATIC_NET_UNROLL
+                for(unsigned i = 0; i < size; i++)
+                    dow[i] += nextWeights[j * size + i] * nextGradients[j];
+            multiplyDerivativeLayer(m_activations[layerNum], m_outputs.data() + outputOffset(layerNum), dow, size);
+            backwardLayer<layerNum - 1>();
+        }
+    }
+    template<unsigned layerNum>
+    constexpr void updateLayer(void){
+        if constexpr(layerNum > 0){
+            constexpr unsigned size = s_sizes[layerNum - 1] + 1, neurons = s_sizes[layerNum];
+            const T *prevOut = m_outputs.data() + outputOffset(layerNum - 1);
+            const T *gradients = m_gradients.data() + outputOffset(layerNum);
+            T *weights = m_weights.data() + weightOffset(layerNum);
+            T *deltaWeights = m_deltaWeights.data() + weightOffset(layerNum);
+            STATIC_NET_UNROLL
+            for(unsigned j = 0; j < neurons; j++)
+                STATIC_NET_UNROLL
+                for(unsigned i = 0; i < size; i++){
+                    T newDeltaWeight = m_rate * prevOut[i] * gradients[j] + m_momentumRate * deltaWeights[j * size + i];
+                    deltaWeights[j * size + i] = newDeltaWeight;
+                    weights[j * size + i] += newDeltaWeight;
+                }
+            updateLayer<layerNum - 1>();
+        }
+    }
+
+    std::array<T, numParameters> m_weights;
+    std::array<T, numParameters> m_deltaWeights;
+    std::array<ActivationKind, numLayers> m_activations;
+    std::array<T, numValues> m_outputs;
+    std::array<T, numValues> m_gradients;
+    T m_rate;
+    T m_momentumRate;
+    double m_loss;
+    double m_recentAverageloss;
+};
+
+template<class T, unsigned... Sizes>
+constexpr void BasicStaticNet<T, Sizes...>::backProp(const double *targetVals){
+    constexpr unsigned last = numLayers - 1;
+    const T *out = m_outputs.data() + outputOffset(last);
+    T *gradients = m_gradients.data() + outputOffset(last);
+
+    double loss = 0.0;
+    for(unsigned i = 0; i < numOutputs; i++){
+        double delta = targetVals[i] - out[i];
+        loss += delta * delta;
+    }
+    m_loss = std::sqrt(loss / numOutputs);
+    m_recentAverageloss = (m_recentAverageloss * 100.0 + m_loss) / (100.0 + 1.0);
+
+    if(m_activations[last] == ACTIVATION_SOFTMAX){
+        T weighted = T(0);
+        for(unsigned i = 0; i < numOutputs; i++)
+            weighted += (T(targetVals[i]) - out[i]) * out[i];
+        for(unsigned i = 0; i < numOutputs; i++)
+            gradients[i] = out[i] * ((T(targetVals[i]) - out[i]) - weighted);
+    } else {
+        for(unsigned i = 0; i < numOutputs; i++)
+            gradients[i] = T(targetVals[i]) - out[i];
+        multiplyDerivativeLayer(m_activations[last], out, gradients, numOutputs);
+    }
+    backwardLayer<last - 1>();
+    updateLayer<last>();
+}
+
+template<unsigned... Sizes> using StaticNet = BasicStaticNet<double, Sizes...>;
+template<unsigned... Sizes> using FloatStaticNet = BasicStaticNet<float, Sizes...>;
+
+
+#endif // STATIC_NET_H
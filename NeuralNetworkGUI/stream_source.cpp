@@ -0,0 +1,81 @@
+#include "stream_source.h"
+#include "profiler.h"
+
+StreamSource::StreamSource(const std::string &filename, bool follow, const std::atomic<bool> *stop, unsigned pollMs)
+    : m_reader(filename == "-" ? "/dev/stdin" : filename), m_open(false), m_binary(false), m_haveRecord(false)
+{
+    if(!m_reader.isOpen())
+        return;
+    if(stop != NULL)
+        m_reader.setStop(stop, follow, pollMs);
+    memset(&m_header, 0, sizeof(m_header));
+
+    const char *data;
+    if(m_reader.peek(sizeof(m_header.magic), data) == sizeof(m_header.magic)
+       && memcmp(data, DATASET_MAGIC, sizeof(m_header.magic)) == 0){
+        m_binary = true;
+        if(!m_reader.readBytes(&m_header, sizeof(m_header)) || m_header.version != DATASET_VERSION
+           || (m_header.dtype != DATASET_FLOAT64 && m_header.dtype != DATASET_FLOAT32)
+           || m_header.numSamples != DATASET_STREAMING || m_header.numLayers > DATASET_MAX_LAYERS
+           || m_header.inputsOffset < sizeof(m_header))
+            return;
+        // Padding up to the first record.
+        char skip[64];
+        for(uint64_t left = m_header.inputsOffset - sizeof(m_header); left > 0; ){
+            size_t n = std::min<uint64_t>(left, sizeof(skip));
+            if(!m_reader.readBytes(skip, n))
+                return;
+            left -= n;
+        }
+        for(unsigned layerNum = 0; layerNum < m_header.numLayers; ++layerNum){
+            uint32_t entry = m_header.topology[layerNum];
+            uint32_t kind = entry >> DATASET_ACTIVATION_SHIFT;
+            m_topology.push_back(entry & DATASET_LAYER_SIZE_MASK);
+            m_activations.push_back(isValidActivation(kind) ? (ActivationKind)kind : ACTIVATION_SIGMOID);
+        }
+        size_t width = m_header.dtype == DATASET_FLOAT32 ? sizeof(float) : sizeof(double);
+        m_record.resize((size_t)(m_header.numInputs + m_header.numOutputs) * width);
+        m_open = true;
+        return;
+    }
+    m_open = m_reader.readTopology(m_topology, m_activations) && validActivations(m_activations, m_topology.size())
+             && !m_topology.empty();
+}
+
+void StreamSource::decode(const char *data, unsigned count, std::vector<double> &vals) const{
+    vals.resize(count);
+    if(m_header.dtype == DATASET_FLOAT32){
+        for(unsigned i = 0; i < count; i++){
+            float v;
+            memcpy(&v, data + i * sizeof(float), sizeof(float));
+            vals[i] = v;
+        }
+    } else {
+        memcpy(vals.data(), data, count * sizeof(double));
+    }
+}
+
+unsigned StreamSource::getNextInputs(std::vector<double> &inputVals){
+    NN_PROFILE_SCOPE(PROFILE_PARSE);
+    if(!m_binary)
+        return m_reader.readValues("in:", inputVals);
+    inputVals.clear();
+    m_haveRecord = m_open && m_reader.readBytes(m_record.data(), m_record.size());
+    if(m_haveRecord)
+        decode(m_record.data(), m_header.numInputs, inputVals);
+    return inputVals.size();
+}
+
+unsigned StreamSource::getTargetOutputs(std::vector<double> &targetOutputVals){
+    NN_PROFILE_SCOPE(PROFILE_PARSE);
+    NN_PROFILE_COUNT(PROFILE_PARSED, 1);
+    if(!m_binary)
+        return m_reader.readValues("out:", targetOutputVals);
+    targetOutputVals.clear();
+    if(m_haveRecord){
+        size_t width = m_header.dtype == DATASET_FLOAT32 ? sizeof(float) : sizeof(double);
+        decode(m_record.data() + (size_t)m_header.numInputs * width, m_header.numOutputs, targetOutputVals);
+        m_haveRecord = false;
+    }
+    return targetOutputVals.size();
+}
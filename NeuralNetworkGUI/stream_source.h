@@ -0,0 +1,51 @@
+#ifndef STREAM_SOURCE_H
+#define STREAM_SOURCE_H
+
+
+#include "all_class.h"
+
+// Samples from data that is still arriving: a file being appended to, a
+// FIFO, or stdin ("-"). The format is recognised from the first bytes:
+// either the topology:/in:/out: text format, or a binary stream (a
+// DatasetHeader with numSamples DATASET_STREAMING followed by interleaved
+// records, see dataset.h; tools/convert_dataset --stream writes one).
+//
+// Unlike TrainingData it never maps or probes the file, so it opens it once
+// and reads it front to back. Reads block until a whole sample is there.
+// With follow set, the end of a regular file only means the writer has not
+// caught up; the source then ends when *stop is set. A pipe or FIFO ends
+// when its last writer closes it, or when *stop is set while it is quiet.
+class StreamSource : public SampleSource{
+public:
+    // Opens filename and reads the topology line or header, which may
+    // block until the writer has sent it. With stop NULL reads block and
+    // follow has no effect.
+    StreamSource(const std::string &filename, bool follow, const std::atomic<bool> *stop, unsigned pollMs = 50);
+    StreamSource(const StreamSource &) = delete;
+    StreamSource &operator=(const StreamSource &) = delete;
+    // False if the file could not be opened or starts with neither a
+    // topology line nor a stream header.
+    bool isOpen(void) const { return m_open; }
+    bool isBinary(void) const { return m_binary; }
+    // Empty for a binary stream written without a topology.
+    void getTopology(std::vector<unsigned> &topology) const { topology = m_topology; }
+    void getActivations(std::vector<ActivationKind> &activations) const { activations = m_activations; }
+    bool isEof(void) { return m_reader.isEof(); }
+    unsigned getNextInputs(std::vector<double> &inputVals);
+    unsigned getTargetOutputs(std::vector<double> &targetOutputVals);
+    uint64_t bytesRead(void) const { return m_reader.bytesRead(); }
+private:
+    // Converts count stored values at data, in the stream's dtype.
+    void decode(const char *data, unsigned count, std::vector<double> &vals) const;
+    FastTextReader m_reader;
+    bool m_open;
+    bool m_binary;
+    DatasetHeader m_header;
+    std::vector<unsigned> m_topology;
+    std::vector<ActivationKind> m_activations;
+    std::vector<char> m_record; // the binary sample being read
+    bool m_haveRecord;
+};
+
+
+#endif // STREAM_SOURCE_H
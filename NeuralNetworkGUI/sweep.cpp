@@ -0,0 +1,314 @@
+#include "sweep.h"
+#include "evaluator.h"
+#include "thread_pool.h"
+#include "json_line.h"
+
+std::string SweepTrial::key(void) const{
+    std::ostringstream out;
+    out << "hidden=";
+    for(size_t l = 0; l < hidden.size(); l++)
+        out << (l > 0 ? "," : "") << hidden[l];
+    if(hidden.empty())
+        out << "none";
+    out << " activation=" << activationInfo(activation).name << " lr=" << learningRate
+        << " momentum=" << momentum;
+    return out.str();
+}
+
+std::vector<SweepTrial> SweepSpace::grid(void) const{
+    std::vector<SweepTrial> trials;
+    for(size_t h = 0; h < hidden.size(); h++)
+        for(size_t a = 0; a < activations.size(); a++)
+            for(size_t r = 0; r < learningRates.size(); r++)
+                for(size_t m = 0; m < momenta.size(); m++){
+                    SweepTrial trial;
+                    trial.hidden = hidden[h];
+                    trial.activation = activations[a];
+                    trial.learningRate = learningRates[r];
+                    trial.momentum = momenta[m];
+                    trials.push_back(trial);
+                }
+    return trials;
+}
+
+// Drawn values keep three significant digits, so a trial's key names
+// exactly the hyperparameters it was trained with.
+static double roundSignificant(double value){
+    if(value == 0.0)
+        return 0.0;
+    double scale = pow(10.0, 2 - floor(log10(fabs(value))));
+    return round(value * scale) / scale;
+}
+
+std::vector<SweepTrial> SweepSpace::random(unsigned count, unsigned seed) const{
+    std::vector<SweepTrial> trials;
+    if(hidden.empty() || activations.empty() || learningRates.empty() || momenta.empty())
+        return trials;
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    double minRate = *std::min_element(learningRates.begin(), learningRates.end());
+    double maxRate = *std::max_element(learningRates.begin(), learningRates.end());
+    double minMomentum = *std::min_element(momenta.begin(), momenta.end());
+    double maxMomentum = *std::max_element(momenta.begin(), momenta.end());
+    std::set<std::string> seen;
+    // Draws that repeat an earlier trial are skipped; a small space may give
+    // fewer than count trials.
+    for(unsigned attempt = 0; trials.size() < count && attempt < 100 * count; attempt++){
+        SweepTrial trial;
+        trial.hidden = hidden[rng() % hidden.size()];
+        trial.activation = activations[rng() % activations.size()];
+        double u = uniform(rng), v = uniform(rng);
+        trial.learningRate = minRate > 0.0 ? roundSignificant(minRate * pow(maxRate / minRate, u))
+                                           : roundSignificant(minRate + (maxRate - minRate) * u);
+        trial.momentum = round((minMomentum + (maxMomentum - minMomentum) * v) * 1000.0) / 1000.0;
+        if(seen.insert(trial.key()).second)
+            trials.push_back(trial);
+    }
+    return trials;
+}
+
+// CPU time of the calling thread; wall time where there is no per-thread
+// clock.
+static double threadCpuSeconds(void){
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+#else
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+SweepRunner::SweepRunner(const DatasetCache &data, ActivationKind outputActivation, const SweepOptions &options)
+    : m_data(data), m_outputActivation(outputActivation), m_options(options)
+{
+    m_options.folds = std::max(2u, std::min(m_options.folds, (unsigned)std::min<size_t>(data.size(), UINT_MAX)));
+    m_options.batchSize = std::max(1u, m_options.batchSize);
+    unsigned numInputs = data.numInputs(), numOutputs = data.numOutputs();
+    m_foldInputs.resize(m_options.folds);
+    m_foldTargets.resize(m_options.folds);
+    for(size_t i = 0; i < data.size(); i++){
+        unsigned fold = i % m_options.folds;
+        m_foldInputs[fold].insert(m_foldInputs[fold].end(), data.inputs(i), data.inputs(i) + numInputs);
+        m_foldTargets[fold].insert(m_foldTargets[fold].end(), data.targets(i), data.targets(i) + numOutputs);
+    }
+    if(m_options.scaling != SCALING_NONE){
+        m_foldStats.assign(m_options.folds, FeatureStats(numInputs));
+        ThreadPool pool(m_options.threads);
+        pool.parallelFor(m_options.folds, [&](unsigned fold, unsigned){
+            for(size_t i = fold; i < data.size(); i += m_options.folds)
+                m_foldStats[fold].add(data.inputs(i));
+        });
+    }
+}
+
+SweepFold SweepRunner::trainFold(unsigned trialNum, unsigned fold) const{
+    double start = threadCpuSeconds();
+    const SweepTrial &trial = m_trials[trialNum];
+    unsigned numInputs = m_data.numInputs(), numOutputs = m_data.numOutputs();
+    std::vector<unsigned> topology(1, numInputs);
+    topology.insert(topology.end(), trial.hidden.begin(), trial.hidden.end());
+    topology.push_back(numOutputs);
+    std::vector<ActivationKind> activations(topology.size(), trial.activation);
+    activations.back() = m_outputActivation;
+    Net net(topology, activations, m_options.seed);
+    OptimizerConfig config;
+    config.kind = m_options.optimizer;
+    config.learningRate = trial.learningRate;
+    config.momentum = trial.momentum;
+    net.setOptimizer(config);
+    if(m_options.scaling != SCALING_NONE){
+        FeatureStats stats(numInputs);
+        for(unsigned f = 0; f < m_options.folds; f++)
+            if(f != fold)
+                stats.merge(m_foldStats[f]);
+        net.setInputScaling(inputScaling(stats, m_options.scaling));
+    }
+
+    std::vector<size_t> order;
+    order.reserve(m_data.size());
+    for(size_t i = 0; i < m_data.size(); i++)
+        if(i % m_options.folds != fold)
+            order.push_back(i);
+    // Every trial sees the same sample order for a fold, so they differ
+    // only in their hyperparameters.
+    std::mt19937 rng(m_options.seed + fold);
+    unsigned batchSize = m_options.batchSize;
+    std::vector<double> inputVals, targetVals;
+    std::vector<double> batchInputs((size_t)batchSize * numInputs), batchTargets((size_t)batchSize * numOutputs);
+    for(unsigned epoch = 0; epoch < m_options.epochs; epoch++){
+        for(size_t i = order.size(); i > 1; i--)
+            std::swap(order[i - 1], order[rng() % i]);
+        if(batchSize == 1){
+            for(size_t i = 0; i < order.size(); i++){
+                inputVals.assign(m_data.inputs(order[i]), m_data.inputs(order[i]) + numInputs);
+                targetVals.assign(m_data.targets(order[i]), m_data.targets(order[i]) + numOutputs);
+                net.feedForward(inputVals);
+                net.backProp(targetVals);
+            }
+            continue;
+        }
+        for(size_t first = 0; first < order.size(); first += batchSize){
+            unsigned count = (unsigned)std::min<size_t>(batchSize, order.size() - first);
+            for(unsigned s = 0; s < count; s++){
+                std::copy(m_data.inputs(order[first + s]), m_data.inputs(order[first + s]) + numInputs,
+                          &batchInputs[(size_t)s * numInputs]);
+                std::copy(m_data.targets(order[first + s]), m_data.targets(order[first + s]) + numOutputs,
+                          &batchTargets[(size_t)s * numOutputs]);
+            }
+            net.trainBatch(batchInputs.data(), batchTargets.data(), count);
+        }
+    }
+
+    ThreadPool pool(1);
+    Evaluator evaluator(net, pool);
+    evaluator.evaluate(m_foldInputs[fold].data(), m_foldTargets[fold].data(), m_foldTargets[fold].size() / numOutputs);
+    SweepFold result;
+    result.trial = trialNum;
+    result.fold = fold;
+    result.accuracy = evaluator.metrics().accuracy();
+    result.loss = evaluator.metrics().meanLoss();
+    result.cpuSeconds = threadCpuSeconds() - start;
+    result.resumed = false;
+    return result;
+}
+
+std::string SweepRunner::journalLine(const SweepFold &result) const{
+    std::ostringstream out;
+    out << std::setprecision(10) << "{\"trial\": \"" << m_trials[result.trial].key() << "\", \"samples\": "
+        << m_data.size() << ", \"folds\": " << m_options.folds << ", \"epochs\": " << m_options.epochs
+        << ", \"batch\": " << m_options.batchSize << ", \"seed\": " << m_options.seed << ", \"optimizer\": \""
+        << optimizerInfo(m_options.optimizer).name << "\", ";
+    if(m_options.scaling != SCALING_NONE)
+        out << "\"scaling\": \"" << scalingName(m_options.scaling) << "\", ";
+    out << "\"fold\": " << result.fold << ", \"accuracy\": "
+        << result.accuracy << ", \"loss\": " << result.loss << ", \"cpu_seconds\": " << result.cpuSeconds
+        << "}\n";
+    return out.str();
+}
+
+// Takes the folds of journal lines written with the same options for
+// trials in m_trials; anything else, including a line cut short by an
+// interruption, is ignored.
+void SweepRunner::readJournal(const std::string &journal){
+    std::map<std::string, unsigned> byKey;
+    for(size_t t = 0; t < m_trials.size(); t++)
+        byKey.insert(std::make_pair(m_trials[t].key(), (unsigned)t));
+    SweepFold stamp;
+    stamp.fold = 0;
+    stamp.accuracy = stamp.loss = stamp.cpuSeconds = 0.0;
+    std::ifstream in(journal.c_str());
+    std::string line;
+    while(std::getline(in, line)){
+        std::string key, fold, accuracy, loss, cpuSeconds;
+        if(!jsonField(line, "trial", key) || !jsonField(line, "fold", fold)
+           || !jsonField(line, "accuracy", accuracy) || !jsonField(line, "loss", loss)
+           || !jsonField(line, "cpu_seconds", cpuSeconds))
+            continue;
+        std::map<std::string, unsigned>::const_iterator it = byKey.find(key);
+        if(it == byKey.end())
+            continue;
+        // The line this run would write for the same fold, up to the results.
+        stamp.trial = it->second;
+        stamp.fold = atoi(fold.c_str());
+        std::string expected = journalLine(stamp);
+        expected = expected.substr(0, expected.find("\"accuracy\""));
+        if(stamp.fold >= m_options.folds || line.compare(0, expected.size(), expected) != 0)
+            continue;
+        SweepFold &result = m_results[stamp.trial][stamp.fold];
+        result = stamp;
+        result.accuracy = atof(accuracy.c_str());
+        result.loss = atof(loss.c_str());
+        result.cpuSeconds = atof(cpuSeconds.c_str());
+        result.resumed = true;
+        m_done[stamp.trial][stamp.fold] = true;
+    }
+}
+
+bool SweepRunner::run(const std::vector<SweepTrial> &trials, const std::string &journal,
+                      const std::function<void(const SweepFold &)> &progress){
+    m_trials = trials;
+    m_results.assign(trials.size(), std::vector<SweepFold>(m_options.folds));
+    m_done.assign(trials.size(), std::vector<bool>(m_options.folds, false));
+    FILE *out = NULL;
+    if(!journal.empty()){
+        readJournal(journal);
+        out = fopen(journal.c_str(), "a+b");
+        if(out == NULL)
+            return false;
+        // A sweep killed mid-write leaves half a line; start a fresh one.
+        if(fseek(out, -1, SEEK_END) == 0 && fgetc(out) != '\n')
+            fputc('\n', out);
+    }
+
+    // Pending folds, the largest nets first so the last few jobs are short.
+    std::vector<std::pair<unsigned, unsigned> > jobs;
+    std::vector<size_t> cost(trials.size(), 0);
+    for(unsigned t = 0; t < trials.size(); t++){
+        unsigned previous = m_data.numInputs();
+        for(size_t l = 0; l <= trials[t].hidden.size(); l++){
+            unsigned size = l < trials[t].hidden.size() ? trials[t].hidden[l] : m_data.numOutputs();
+            cost[t] += (size_t)(previous + 1) * size;
+            previous = size;
+        }
+        for(unsigned f = 0; f < m_options.folds; f++){
+            if(m_done[t][f])
+                progress(m_results[t][f]);
+            else
+                jobs.push_back(std::make_pair(t, f));
+        }
+    }
+    std::stable_sort(jobs.begin(), jobs.end(),
+                     [&](const std::pair<unsigned, unsigned> &a, const std::pair<unsigned, unsigned> &b){
+                         return cost[a.first] > cost[b.first];
+                     });
+
+    std::mutex mutex;
+    bool failed = false;
+    ThreadPool pool(m_options.threads);
+    pool.parallelFor(jobs.size(), [&](unsigned index, unsigned){
+        SweepFold result = trainFold(jobs[index].first, jobs[index].second);
+        std::lock_guard<std::mutex> lock(mutex);
+        m_results[result.trial][result.fold] = result;
+        m_done[result.trial][result.fold] = true;
+        if(out != NULL){
+            std::string line = journalLine(result);
+            failed |= fwrite(line.data(), 1, line.size(), out) != line.size() || fflush(out) != 0;
+        }
+        progress(result);
+    });
+    if(out != NULL)
+        failed |= fclose(out) != 0;
+    return !failed;
+}
+
+std::vector<SweepResult> SweepRunner::ranked(void) const{
+    std::vector<SweepResult> results;
+    for(size_t t = 0; t < m_trials.size(); t++){
+        SweepResult r;
+        r.trial = m_trials[t];
+        r.folds = 0;
+        r.accuracy = r.accuracyStddev = r.loss = r.cpuSeconds = 0.0;
+        for(unsigned f = 0; f < m_options.folds; f++){
+            if(!m_done[t][f])
+                continue;
+            r.folds++;
+            r.accuracy += m_results[t][f].accuracy;
+            r.loss += m_results[t][f].loss;
+            r.cpuSeconds += m_results[t][f].cpuSeconds;
+        }
+        if(r.folds == 0)
+            continue;
+        r.accuracy /= r.folds;
+        r.loss /= r.folds;
+        for(unsigned f = 0; f < m_options.folds; f++)
+            if(m_done[t][f])
+                r.accuracyStddev += (m_results[t][f].accuracy - r.accuracy) * (m_results[t][f].accuracy - r.accuracy);
+        r.accuracyStddev = sqrt(r.accuracyStddev / r.folds);
+        results.push_back(r);
+    }
+    std::stable_sort(results.begin(), results.end(), [](const SweepResult &a, const SweepResult &b){
+        return a.score() > b.score();
+    });
+    return results;
+}
@@ -0,0 +1,102 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+
+#include "epoch_trainer.h"
+
+// One point of a hyperparameter sweep. The input and output layers come
+// from the data; every hidden layer uses the same activation.
+struct SweepTrial {
+    std::vector<unsigned> hidden;  // hidden layer sizes, may be empty
+    ActivationKind activation;
+    double learningRate;
+    double momentum;
+    // Canonical text ("hidden=8,8 activation=relu lr=0.15 momentum=0.5"),
+    // how the journal recognises a trial it has already run.
+    std::string key(void) const;
+};
+
+// The values each hyperparameter may take.
+struct SweepSpace {
+    std::vector<std::vector<unsigned> > hidden;
+    std::vector<ActivationKind> activations;
+    std::vector<double> learningRates;
+    std::vector<double> momenta;
+    // Every combination, topology outermost.
+    std::vector<SweepTrial> grid(void) const;
+    // count trials drawn with seed: topology and activation from the lists,
+    // the learning rate log-uniform and the momentum uniform between the
+    // smallest and largest values listed.
+    std::vector<SweepTrial> random(unsigned count, unsigned seed) const;
+};
+
+struct SweepOptions {
+    unsigned folds;           // k of the cross-validation
+    unsigned epochs;          // passes over the k - 1 training folds
+    unsigned batchSize;       // 1 = per-sample backProp, else trainBatch
+    unsigned threads;         // trials trained at once, 0 = all cores
+    unsigned seed;            // initial weights and shuffling, the same for every trial
+    OptimizerKind optimizer;  // the rule learningRate and momentum are fed to
+    ScalingKind scaling;      // input scaling, fitted to each fold's training samples
+    SweepOptions() : folds(5), epochs(10), batchSize(1), threads(0), seed(1), optimizer(OPTIMIZER_SGD),
+                     scaling(SCALING_NONE) {}
+};
+
+// One trained and scored fold.
+struct SweepFold {
+    unsigned trial;           // index into the trials passed to run()
+    unsigned fold;
+    double accuracy;          // on the held-out fold, as Evaluator counts it
+    double loss;              // mean RMS loss on the held-out fold
+    double cpuSeconds;        // CPU time of the thread that trained and scored it
+    bool resumed;             // read back from the journal, not run now
+};
+
+struct SweepResult {
+    SweepTrial trial;
+    unsigned folds;           // folds finished
+    double accuracy;          // mean over the folds
+    double accuracyStddev;
+    double loss;
+    double cpuSeconds;        // summed over the folds
+    // The ranking key: validation accuracy per CPU-second of training.
+    double score(void) const { return cpuSeconds > 0.0 ? accuracy / cpuSeconds : 0.0; }
+};
+
+// Trains every trial k times, each time holding out one fold of the data
+// (sample i is in fold i % k) and scoring the Net on it. The trial x fold
+// jobs run on a ThreadPool, one Net per job and the largest nets first, all
+// reading the same DatasetCache.
+//
+// Every finished fold is appended to the journal as a JSON line and
+// flushed. run() skips the folds the journal already has for the same
+// trial and options, so an interrupted sweep picks up where it stopped.
+class SweepRunner{
+public:
+    // outputActivation is the data file's output layer.
+    SweepRunner(const DatasetCache &data, ActivationKind outputActivation, const SweepOptions &options);
+    // Runs what the journal (empty for none) does not have yet; progress is
+    // called once per fold, resumed ones first, from one thread at a time.
+    // False if the journal cannot be written.
+    bool run(const std::vector<SweepTrial> &trials, const std::string &journal,
+             const std::function<void(const SweepFold &)> &progress);
+    // Every trial with at least one fold, best score first.
+    std::vector<SweepResult> ranked(void) const;
+private:
+    SweepFold trainFold(unsigned trial, unsigned fold) const;
+    void readJournal(const std::string &journal);
+    std::string journalLine(const SweepFold &result) const;
+    const DatasetCache &m_data;
+    ActivationKind m_outputActivation;
+    SweepOptions m_options;
+    std::vector<SweepTrial> m_trials;
+    std::vector<std::vector<SweepFold> > m_results; // per trial, indexed by fold
+    std::vector<std::vector<bool> > m_done;
+    // Each fold's held-out samples as float rows for the Evaluator.
+    std::vector<std::vector<float> > m_foldInputs, m_foldTargets;
+    // Input statistics of each fold; a fold's scaling merges all the others.
+    std::vector<FeatureStats> m_foldStats;
+};
+
+
+#endif // SWEEP_H
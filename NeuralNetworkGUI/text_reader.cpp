@@ -0,0 +1,233 @@
+#include "text_reader.h"
+
+#include<fcntl.h>
+#include<sys/stat.h>
+#ifdef _WIN32
+#include<io.h>
+#define NN_O_FLAGS (O_RDONLY | O_BINARY)
+#else
+#include<poll.h>
+#include<unistd.h>
+#define NN_O_FLAGS O_RDONLY
+#endif
+
+static inline bool isBlank(char c){
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Parses one double at p; returns the end of the number, or NULL if there is
+// none. A leading '+' is accepted, as operator>> does.
+static inline const char *parseDouble(const char *p, const char *end, double &value){
+    if(p != end && *p == '+')
+        ++p;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    std::from_chars_result r = std::from_chars(p, end, value);
+    return r.ec == std::errc() ? r.ptr : NULL;
+#else
+    // The reader keeps a '\0' after its data, so strtod cannot run past end.
+    char *stop;
+    value = strtod(p, &stop);
+    return stop == p || stop > end ? NULL : stop;
+#endif
+}
+
+FastTextReader::FastTextReader(const std::string &filename, size_t bufferSize)
+    : m_pos(0), m_len(0), m_eof(false), m_fileDone(false), m_consumed(0), m_stop(NULL), m_pollMs(50),
+      m_follow(false), m_regular(true)
+{
+    m_fd = open(filename.c_str(), NN_O_FLAGS);
+    m_buffer.resize(std::max<size_t>(bufferSize, 4096) + 1);
+    m_buffer[0] = '\0';
+    if(m_fd < 0)
+        m_fileDone = true;
+}
+
+FastTextReader::~FastTextReader(){
+    if(m_fd >= 0)
+        close(m_fd);
+}
+
+bool FastTextReader::fill(void){
+    if(m_pos > 0){
+        memmove(m_buffer.data(), m_buffer.data() + m_pos, m_len - m_pos);
+        m_len -= m_pos;
+        m_pos = 0;
+    }
+    // A line longer than the whole buffer: grow it. This is the only
+    // allocation after construction.
+    if(m_len + 1 == m_buffer.size())
+        m_buffer.resize(m_buffer.size() * 2);
+    while(true){
+#ifndef _WIN32
+        if(m_stop != NULL && !m_regular){
+            struct pollfd ready = {m_fd, POLLIN, 0};
+            if(m_stop->load()){
+                m_fileDone = true;
+                return false;
+            }
+            if(poll(&ready, 1, m_pollMs) == 0)
+                continue;
+        }
+#endif
+        long n = read(m_fd, m_buffer.data() + m_len, m_buffer.size() - 1 - m_len);
+        if(n > 0){
+            m_len += n;
+            m_buffer[m_len] = '\0';
+            return true;
+        }
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n < 0 || !waitForData()){
+            m_fileDone = true;
+            return false;
+        }
+    }
+}
+
+void FastTextReader::setStop(const std::atomic<bool> *stop, bool follow, unsigned pollMs){
+    m_stop = stop;
+    m_follow = follow;
+    m_pollMs = std::max(1u, pollMs);
+    struct stat st;
+    m_regular = m_fd >= 0 && fstat(m_fd, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+// Called when read() found nothing more. A pipe only gets there once its
+// writers are gone (with a stop flag fill() polls a pipe before reading it, so
+// that stop is seen while the writer is quiet); a followed regular file is
+// checked every pollMs until it grows.
+bool FastTextReader::waitForData(void){
+    if(m_stop == NULL || !m_follow || !m_regular)
+        return false;
+    while(!m_stop->load()){
+        std::this_thread::sleep_for(std::chrono::milliseconds(m_pollMs));
+        struct stat st;
+        if(fstat(m_fd, &st) != 0)
+            return false;
+        if(lseek(m_fd, 0, SEEK_CUR) < st.st_size)
+            return true;
+    }
+    return false;
+}
+
+size_t FastTextReader::peek(size_t count, const char *&data){
+    while(m_len - m_pos < count && !m_fileDone && m_len - m_pos + 1 < m_buffer.size())
+        fill();
+    data = m_buffer.data() + m_pos;
+    return std::min(count, m_len - m_pos);
+}
+
+bool FastTextReader::readBytes(void *out, size_t count){
+    char *dst = (char *)out;
+    while(count > 0){
+        if(m_pos == m_len && (m_fileDone || !fill())){
+            m_eof = true;
+            return false;
+        }
+        size_t n = std::min(count, m_len - m_pos);
+        memcpy(dst, m_buffer.data() + m_pos, n);
+        dst += n;
+        count -= n;
+        m_pos += n;
+        m_consumed += n;
+    }
+    return true;
+}
+
+bool FastTextReader::nextLine(const char *&begin, const char *&end){
+    while(true){
+        const char *data = m_buffer.data();
+        const char *start = data + m_pos;
+        const char *newline = (const char *)memchr(start, '\n', m_len - m_pos);
+        if(newline != NULL){
+            begin = start;
+            end = newline;
+            m_consumed += newline + 1 - start;
+            m_pos = newline + 1 - data;
+            return true;
+        }
+        if(m_fileDone){
+            // Last line without a newline, or nothing left: getline sets eof.
+            m_eof = true;
+            begin = start;
+            end = data + m_len;
+            m_consumed += m_len - m_pos;
+            m_pos = m_len;
+            return begin != end;
+        }
+        fill();
+    }
+}
+
+const char *FastTextReader::matchLabel(const char *label, const char *p, const char *end) const{
+    while(p != end && isBlank(*p))
+        ++p;
+    const char *token = p;
+    while(p != end && !isBlank(*p))
+        ++p;
+    size_t length = strlen(label);
+    if((size_t)(p - token) != length || memcmp(token, label, length) != 0)
+        return NULL;
+    return p;
+}
+
+unsigned FastTextReader::readValues(const char *label, double *vals, unsigned maxVals){
+    const char *p, *end;
+    if(!nextLine(p, end) || (p = matchLabel(label, p, end)) == NULL)
+        return 0;
+    unsigned count = 0;
+    while(count < maxVals){
+        while(p != end && isBlank(*p))
+            ++p;
+        if(p == end || (p = parseDouble(p, end, vals[count])) == NULL)
+            break;
+        count++;
+    }
+    return count;
+}
+
+unsigned FastTextReader::readValues(const char *label, std::vector<double> &vals){
+    vals.clear();
+    const char *p, *end;
+    if(!nextLine(p, end) || (p = matchLabel(label, p, end)) == NULL)
+        return 0;
+    while(true){
+        while(p != end && isBlank(*p))
+            ++p;
+        double value;
+        if(p == end || (p = parseDouble(p, end, value)) == NULL)
+            break;
+        vals.push_back(value);
+    }
+    return vals.size();
+}
+
+bool FastTextReader::readTopology(std::vector<unsigned> &topology, std::vector<ActivationKind> &activations){
+    const char *p, *end;
+    if(!nextLine(p, end) || (p = matchLabel("topology:", p, end)) == NULL)
+        return false;
+    while(true){
+        while(p != end && isBlank(*p))
+            ++p;
+        unsigned n;
+        std::from_chars_result r = std::from_chars(p, end, n);
+        if(p == end || r.ec != std::errc())
+            break;
+        topology.push_back(n);
+        activations.push_back(ACTIVATION_SIGMOID);
+        p = r.ptr;
+        if(p != end && *p == ':'){
+            const char *name = ++p;
+            while(p != end && !isBlank(*p))
+                ++p;
+            if(!activationFromName(name, p - name, activations.back()))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool FastTextReader::readTopology(std::vector<unsigned> &topology){
+    std::vector<ActivationKind> activations;
+    return readTopology(topology, activations);
+}
@@ -0,0 +1,70 @@
+#ifndef TEXT_READER_H
+#define TEXT_READER_H
+
+
+#include<bits/stdc++.h>
+#include "activations.h"
+
+// Line reader for the topology:/in:/out: text format that does no heap
+// allocation once its buffer has grown to the longest line. The file is read
+// in large chunks with read(), lines are found with memchr and numbers are
+// parsed in place with std::from_chars.
+//
+// isEof() follows std::getline: it turns true once a read reaches the end of
+// the file, so loops written against std::ifstream behave the same.
+class FastTextReader{
+public:
+    explicit FastTextReader(const std::string &filename, size_t bufferSize = 1 << 20);
+    ~FastTextReader();
+    FastTextReader(const FastTextReader &) = delete;
+    FastTextReader &operator=(const FastTextReader &) = delete;
+    bool isOpen(void) const { return m_fd >= 0; }
+    bool isEof(void) const { return m_eof; }
+    // Consumes one line. If its first token equals label, the numbers that
+    // follow are stored into vals (at most maxVals of them) and their count is
+    // returned; otherwise returns 0.
+    unsigned readValues(const char *label, double *vals, unsigned maxVals);
+    // Same, into a vector whose capacity is reused from call to call.
+    unsigned readValues(const char *label, std::vector<double> &vals);
+    // Consumes one line and parses "topology: n n n". Any size may carry an
+    // activation, "n:relu"; activations gets one entry per layer, sigmoid
+    // where none is given. False if the line is anything else or names an
+    // unknown activation.
+    bool readTopology(std::vector<unsigned> &topology, std::vector<ActivationKind> &activations);
+    bool readTopology(std::vector<unsigned> &topology);
+    // Lets *stop end the reader while it waits for data: a pipe or FIFO is
+    // polled every pollMs instead of blocking in read(), and ends when its
+    // last writer closes it or once stop is set. With follow, a regular file
+    // is followed like tail -f: at its end the reader waits for it to grow,
+    // checking every pollMs, and an incomplete last line waits for the rest
+    // of it, until stop is set.
+    void setStop(const std::atomic<bool> *stop, bool follow, unsigned pollMs = 50);
+    // Raw bytes, for binary records. peek makes up to count bytes available
+    // at data without consuming them and returns how many there are (fewer
+    // only at the end); readBytes consumes exactly count bytes into out,
+    // false if the data ends first.
+    size_t peek(size_t count, const char *&data);
+    bool readBytes(void *out, size_t count);
+    // Bytes consumed so far, for throughput reporting.
+    uint64_t bytesRead(void) const { return m_consumed; }
+private:
+    bool nextLine(const char *&begin, const char *&end);
+    const char *matchLabel(const char *label, const char *p, const char *end) const;
+    bool fill(void);
+    // Waits for the writer at the end of a followed file; false to end.
+    bool waitForData(void);
+    int m_fd;
+    std::vector<char> m_buffer;
+    size_t m_pos;
+    size_t m_len;
+    bool m_eof;
+    bool m_fileDone;
+    uint64_t m_consumed;
+    const std::atomic<bool> *m_stop; // NULL: block in read() and end at the end of the file
+    unsigned m_pollMs;
+    bool m_follow;
+    bool m_regular;
+};
+
+
+#endif // TEXT_READER_H
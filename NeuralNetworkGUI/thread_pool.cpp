@@ -0,0 +1,64 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(unsigned numThreads)
+    : m_task(NULL), m_invoke(NULL), m_next(0), m_count(0), m_busy(0), m_generation(0), m_stop(false)
+{
+    if(numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    for(unsigned t = 1; t < numThreads; t++)
+        m_workers.push_back(std::thread(&ThreadPool::workerLoop, this, t));
+}
+
+ThreadPool::~ThreadPool(){
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for(unsigned t = 0; t < m_workers.size(); t++)
+        m_workers[t].join();
+}
+
+void ThreadPool::drain(unsigned thread){
+    for(unsigned i = m_next.fetch_add(1); i < m_count; i = m_next.fetch_add(1))
+        m_invoke(m_task, i, thread);
+}
+
+void ThreadPool::workerLoop(unsigned thread){
+    unsigned seen = 0;
+    while(true){
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&]{ return m_stop || m_generation != seen; });
+            if(m_stop)
+                return;
+            seen = m_generation;
+        }
+        drain(thread);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(--m_busy == 0)
+            m_done.notify_one();
+    }
+}
+
+void ThreadPool::run(unsigned count, const void *task, Invoke invoke){
+    if(m_workers.empty() || count <= 1){
+        for(unsigned i = 0; i < count; i++)
+            invoke(task, i, 0);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_task = task;
+        m_invoke = invoke;
+        m_count = count;
+        m_next = 0;
+        m_busy = m_workers.size();
+        m_generation++;
+    }
+    m_wake.notify_all();
+    drain(0);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [&]{ return m_busy == 0; });
+    m_task = NULL;
+}
@@ -0,0 +1,43 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+
+#include<bits/stdc++.h>
+
+// Fixed set of worker threads that run blocking parallel-for loops.
+// The calling thread takes part as thread 0, so ThreadPool(1) starts no
+// threads at all.
+class ThreadPool{
+public:
+    explicit ThreadPool(unsigned numThreads);
+    ~ThreadPool();
+    unsigned size(void) const { return m_workers.size() + 1; }
+    // Runs task(index, thread) for every index in [0, count) and returns
+    // once all of them have finished. Indices are handed out dynamically.
+    // The workers call task through a plain function pointer, so a capturing
+    // lambda is never copied into a std::function and nothing is allocated.
+    template<class F> void parallelFor(unsigned count, const F &task){
+        run(count, &task, [](const void *f, unsigned index, unsigned thread){
+            (*(const F *)f)(index, thread);
+        });
+    }
+private:
+    typedef void (*Invoke)(const void *task, unsigned index, unsigned thread);
+    void run(unsigned count, const void *task, Invoke invoke);
+    void workerLoop(unsigned thread);
+    void drain(unsigned thread);
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    const void *m_task;
+    Invoke m_invoke;
+    std::atomic<unsigned> m_next;
+    unsigned m_count;
+    unsigned m_busy;
+    unsigned m_generation;
+    bool m_stop;
+};
+
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,131 @@
+#include "training_job.h"
+#include "evaluator.h"
+
+TrainingJob::~TrainingJob(){
+    cancel();
+    if(m_worker.joinable())
+        m_worker.join();
+}
+
+// Everything TrainingData and TestData would abort() on, checked without
+// aborting; returns the error to show, or an empty string. withTopology
+// also reads the topology line (or header) as TrainingData::getTopology does.
+static std::string checkDataFile(const std::string &filename, bool withTopology){
+    if(MappedDataset::isBinary(filename)){
+        MappedDataset data(filename);
+        if(!data.isOpen())
+            return filename + " is not a valid binary dataset";
+        if(withTopology && data.header().numLayers < 2)
+            return "no topology in " + filename;
+        return "";
+    }
+    FastTextReader reader(filename);
+    if(!reader.isOpen())
+        return "cannot open " + filename;
+    if(!withTopology)
+        return "";
+    std::vector<unsigned> topology;
+    std::vector<ActivationKind> activations;
+    if(!reader.readTopology(topology, activations) || reader.isEof() || topology.size() < 2)
+        return "no topology in " + filename;
+    if(!validActivations(activations, topology.size()))
+        return "invalid activations in the topology of " + filename;
+    return "";
+}
+
+bool TrainingJob::start(const std::string &trainFile, const std::string &testFile, unsigned updateEvery){
+    if(isRunning())
+        return false;
+    if(m_worker.joinable())
+        m_worker.join();
+    m_cancel = false;
+    TrainingProgress progress;
+    progress.phase = PHASE_TRAINING;
+    publish(progress);
+    m_worker = std::thread(&TrainingJob::run, this, trainFile, testFile, std::max(1u, updateEvery));
+    return true;
+}
+
+bool TrainingJob::isRunning(void) const{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_progress.phase == PHASE_TRAINING || m_progress.phase == PHASE_TESTING;
+}
+
+bool TrainingJob::poll(TrainingProgress &progress){
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_version == m_seen)
+        return false;
+    m_seen = m_version;
+    progress = m_progress;
+    return true;
+}
+
+void TrainingJob::publish(const TrainingProgress &progress){
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_progress = progress;
+    m_version++;
+}
+
+void TrainingJob::run(std::string trainFile, std::string testFile, unsigned updateEvery){
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    TrainingProgress p;
+    p.phase = PHASE_TRAINING;
+    // TrainingData and TestData abort() on a file they cannot open or
+    // parse, which would take the whole window down; check first.
+    std::string error = checkDataFile(trainFile, true);
+    if(error.empty())
+        error = checkDataFile(testFile, false);
+    if(!error.empty()){
+        p.phase = PHASE_FAILED;
+        p.error = error;
+        publish(p);
+        return;
+    }
+
+    TrainingData trainData(trainFile);
+    std::vector<unsigned> topology;
+    trainData.getTopology(topology);
+    std::vector<ActivationKind> activations;
+    trainData.getActivations(activations);
+    Net myNet(topology, activations);
+    std::vector<double> inputVals, targetVals;
+
+    while(!trainData.isEof() && !m_cancel.load(std::memory_order_relaxed)){
+        if(trainData.getNextInputs(inputVals) != topology[0])
+            break;
+        myNet.feedForward(inputVals);
+        trainData.getTargetOutputs(targetVals);
+        assert(targetVals.size() == topology.back());
+        myNet.backProp(targetVals);
+        if(++p.trained % updateEvery == 0){
+            p.recentAverageLoss = myNet.getRecentAverageloss();
+            p.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            publish(p);
+        }
+    }
+    p.recentAverageLoss = myNet.getRecentAverageloss();
+
+    p.phase = PHASE_TESTING;
+    p.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    publish(p);
+    TestData testData(testFile);
+    ThreadPool pool(0);
+    Evaluator evaluator(myNet, pool);
+    // Blocks large enough to give every core whole chunks.
+    const unsigned testBlock = 1 << 16;
+    unsigned numInputs = topology.front(), numOutputs = topology.back();
+    std::vector<float> testInputs((size_t)testBlock * numInputs), testTargets((size_t)testBlock * numOutputs);
+    unsigned n;
+    while(!m_cancel.load(std::memory_order_relaxed)
+          && (n = readSamples(testData, numInputs, numOutputs, testBlock, testInputs.data(), testTargets.data())) > 0){
+        evaluator.evaluate(testInputs.data(), testTargets.data(), n);
+        p.tested = evaluator.metrics().samples;
+        p.correct = evaluator.metrics().confusion.correct();
+        p.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        publish(p);
+    }
+    p.phase = m_cancel.load(std::memory_order_relaxed) ? PHASE_CANCELLED : PHASE_DONE;
+    p.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    publish(p);
+}
@@ -0,0 +1,63 @@
+#ifndef TRAINING_JOB_H
+#define TRAINING_JOB_H
+
+
+#include "all_class.h"
+
+enum TrainingPhase {
+    PHASE_IDLE,
+    PHASE_TRAINING,
+    PHASE_TESTING,
+    PHASE_DONE,
+    PHASE_CANCELLED,
+    PHASE_FAILED
+};
+
+// What the UI shows. A snapshot always carries the training summary once
+// training is over, so a reader that skips intermediate snapshots still sees
+// every phase's result.
+struct TrainingProgress {
+    TrainingPhase phase;
+    unsigned long long trained;    // samples trained so far
+    double recentAverageLoss;
+    unsigned long long tested;     // samples tested so far
+    unsigned long long correct;
+    double seconds;                // since start()
+    std::string error;             // set with PHASE_FAILED
+    TrainingProgress() : phase(PHASE_IDLE), trained(0), recentAverageLoss(0.0),
+                         tested(0), correct(0), seconds(0.0) {}
+};
+
+// Runs one train-then-test pass on a background thread; the test half is
+// scored with an Evaluator on every core.
+//
+// Progress is coalesced: the worker overwrites a single snapshot every
+// updateEvery samples and the UI picks up the latest one with poll() at
+// whatever rate it likes, so a slow reader never slows training down and
+// never sees a backlog. cancel() stops the run at the next sample.
+class TrainingJob{
+public:
+    TrainingJob() : m_cancel(false), m_version(0), m_seen(0) {}
+    ~TrainingJob();
+    TrainingJob(const TrainingJob &) = delete;
+    TrainingJob &operator=(const TrainingJob &) = delete;
+    // Starts a run; does nothing and returns false if one is still going.
+    bool start(const std::string &trainFile, const std::string &testFile, unsigned updateEvery = 256);
+    void cancel(void) { m_cancel.store(true, std::memory_order_relaxed); }
+    bool isRunning(void) const;
+    // Copies the newest snapshot into progress. Returns false if nothing
+    // changed since the previous call.
+    bool poll(TrainingProgress &progress);
+private:
+    void run(std::string trainFile, std::string testFile, unsigned updateEvery);
+    void publish(const TrainingProgress &progress);
+    std::thread m_worker;
+    std::atomic<bool> m_cancel;
+    mutable std::mutex m_mutex;
+    TrainingProgress m_progress;
+    unsigned long long m_version;
+    unsigned long long m_seen;
+};
+
+
+#endif // TRAINING_JOB_H
@@ -0,0 +1,161 @@
+// Per-sample backward pass of the fused Net::backProp against the three-pass
+// backPropUnfused it replaced, from 2-8-1 up to nets whose weights spill out
+// of the last-level cache, for momentum SGD and Adam.
+//
+// "model MB" is the traffic per sample modelled from the buffer sizes, not
+// measured: over weight-sized buffers, which is all that matters once a
+// layer is wide, the update reads and writes the weights and every state
+// buffer of the rule, and the unfused version also reads every weight
+// matrix above the first once more for sumDOW. "GB/s" is that modelled
+// traffic over the measured time. The backward time is the time of
+// feedForward + backProp minus that of feedForward alone.
+//
+// "LLC MB" is measured where the CPU's counters can be read (Linux,
+// perf_event_open, perf_event_paranoid <= 2): last-level cache misses of the
+// backward pass times the 64-byte line, i.e. the traffic that really went
+// to memory, which is zero while the weights fit in the cache. Without
+// counters (most VMs and containers) it prints "-".
+//
+//   g++ -O2 -o backprop_bench bench/backprop_bench.cpp NeuralNetworkGUI/all_class.cpp NeuralNetworkGUI/activations.cpp NeuralNetworkGUI/optimizer.cpp NeuralNetworkGUI/kernels.cpp NeuralNetworkGUI/gemm.cpp NeuralNetworkGUI/dataset.cpp NeuralNetworkGUI/text_reader.cpp
+//   ./backprop_bench
+#include<bits/stdc++.h>
+#ifdef __linux__
+#include<linux/perf_event.h>
+#include<sys/ioctl.h>
+#include<sys/syscall.h>
+#include<unistd.h>
+#endif
+#include "../NeuralNetworkGUI/all_class.h"
+#include "../NeuralNetworkGUI/kernels.h"
+
+typedef std::chrono::steady_clock Clock;
+
+#define CACHE_LINE 64
+
+// Last-level cache misses of this thread, counted in user space.
+class MissCounter{
+public:
+	MissCounter() : m_fd(-1) {
+#ifdef __linux__
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_CACHE_MISSES;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		m_fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+	}
+	~MissCounter() {
+#ifdef __linux__
+		if(m_fd >= 0)
+			close(m_fd);
+#endif
+	}
+	bool ok(void) const { return m_fd >= 0; }
+	unsigned long long read(void) const {
+		unsigned long long count = 0;
+#ifdef __linux__
+		if(m_fd >= 0 && ::read(m_fd, &count, sizeof(count)) != sizeof(count))
+			count = 0;
+#endif
+		return count;
+	}
+private:
+	int m_fd;
+};
+
+static MissCounter g_misses;
+
+enum Pass { PASS_FORWARD, PASS_FUSED, PASS_UNFUSED };
+
+// ns per sample of feedForward, plus the given backward pass; misses gets
+// the cache misses per sample if the counter works.
+static double timeSteps(Net &net, Pass pass, const std::vector<std::vector<double> > &inputs,
+                        const std::vector<std::vector<double> > &targets, size_t samples, double *misses = NULL){
+	unsigned long long missesBefore = g_misses.read();
+	Clock::time_point start = Clock::now();
+	for(size_t i = 0; i < samples; i++){
+		size_t s = i % inputs.size();
+		net.feedForward(inputs[s]);
+		if(pass == PASS_FUSED)
+			net.backProp(targets[s]);
+		else if(pass == PASS_UNFUSED)
+			net.backPropUnfused(targets[s]);
+	}
+	if(misses != NULL)
+		*misses = (double)(g_misses.read() - missesBefore) / samples;
+	return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / samples;
+}
+
+int main(){
+	const std::vector<std::vector<unsigned> > topologies = {
+		{2, 8, 1}, {64, 256, 256, 10}, {784, 512, 512, 10}, {1024, 2048, 2048, 10},
+	};
+	const OptimizerKind kinds[] = {OPTIMIZER_SGD, OPTIMIZER_ADAM};
+	std::cout << "kernels: " << kernels().name << ", LLC miss counter: "
+	          << (g_misses.ok() ? "yes" : "not available") << "\n\n";
+	std::cout << std::left << std::setw(22) << "topology" << std::setw(10) << "optimizer"
+	          << std::setw(14) << "unfused ns" << std::setw(10) << "model MB" << std::setw(8) << "GB/s"
+	          << std::setw(10) << "LLC MB"
+	          << std::setw(14) << "fused ns" << std::setw(10) << "model MB" << std::setw(8) << "GB/s"
+	          << std::setw(10) << "LLC MB" << "speedup\n";
+	for(const std::vector<unsigned> &topology : topologies){
+		std::ostringstream name;
+		for(size_t l = 0; l < topology.size(); l++)
+			name << (l > 0 ? "-" : "") << topology[l];
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<double> uniform(0.0, 1.0);
+		std::vector<std::vector<double> > inputs(64), targets(64);
+		for(size_t s = 0; s < inputs.size(); s++){
+			for(unsigned i = 0; i < topology.front(); i++)
+				inputs[s].push_back(uniform(rng));
+			for(unsigned i = 0; i < topology.back(); i++)
+				targets[s].push_back(uniform(rng));
+		}
+		// Weight matrices above the first: the extra sumDOW read.
+		double numWeights = 0.0, upperWeights = 0.0;
+		for(size_t l = 1; l < topology.size(); l++){
+			double w = (double)topology[l] * (topology[l - 1] + 1);
+			numWeights += w;
+			if(l > 1)
+				upperWeights += w;
+		}
+		size_t samples = std::max<size_t>(20, (size_t)(2e8 / numWeights));
+
+		for(OptimizerKind kind : kinds){
+			OptimizerConfig config;
+			config.kind = kind;
+			config.learningRate = optimizerInfo(kind).defaultRate;
+			Net fused(topology);
+			fused.setOptimizer(config);
+			Net unfused(fused);
+			double forwardMisses, unfusedMisses, fusedMisses;
+			double forward = timeSteps(fused, PASS_FORWARD, inputs, targets, samples, &forwardMisses);
+			// A warm-up pass of each, then the timed ones.
+			timeSteps(fused, PASS_FUSED, inputs, targets, samples / 10 + 1);
+			timeSteps(unfused, PASS_UNFUSED, inputs, targets, samples / 10 + 1);
+			double unfusedNs = timeSteps(unfused, PASS_UNFUSED, inputs, targets, samples, &unfusedMisses) - forward;
+			double fusedNs = timeSteps(fused, PASS_FUSED, inputs, targets, samples, &fusedMisses) - forward;
+			// Backward misses in MB per sample, or "-".
+			auto measured = [&](double misses){
+				if(!g_misses.ok())
+					return std::string("-");
+				std::ostringstream mb;
+				mb << std::max(0.0, misses - forwardMisses) * CACHE_LINE / 1e6;
+				return mb.str();
+			};
+
+			double states = optimizerInfo(kind).secondMoment ? 2 : 1;
+			double fusedBytes = 2 * (1 + states) * numWeights * sizeof(double);
+			double unfusedBytes = fusedBytes + upperWeights * sizeof(double);
+			std::cout << std::setw(22) << name.str() << std::setw(10) << optimizerInfo(kind).name
+			          << std::setw(14) << unfusedNs << std::setw(10) << unfusedBytes / 1e6
+			          << std::setw(8) << unfusedBytes / unfusedNs << std::setw(10) << measured(unfusedMisses)
+			          << std::setw(14) << fusedNs << std::setw(10) << fusedBytes / 1e6
+			          << std::setw(8) << fusedBytes / fusedNs << std::setw(10) << measured(fusedMisses)
+			          << unfusedNs / fusedNs << "x\n";
+		}
+	}
+}
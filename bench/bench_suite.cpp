@@ -0,0 +1,366 @@
+// The benchmark suite: reproducible workloads over everything a training or
+// serving run spends time on, written as one JSON file that later runs can
+// be compared against.
+//
+//   parse.*       FastTextReader through TrainingData over a text dataset
+//                 (released/trainingData.txt by default)
+//   construct.*   Net construction, per topology
+//   train.* / infer.*
+//                 per-sample feedForward + backProp / getResults latency, and
+//                 batched trainBatch / predictBatch throughput
+//   threads.*     ParallelTrainer and Evaluator throughput on 1, 2, 4 ... N
+//                 threads
+//
+// Every workload uses fixed seeds and synthetic samples, runs until it has
+// taken --min-time seconds, and reports the median of --repeat runs.
+//
+//   make bench_suite          (or the g++ line below)
+//   g++ -O2 -pthread -o bench_suite bench/bench_suite.cpp NeuralNetworkGUI/all_class.cpp NeuralNetworkGUI/activations.cpp NeuralNetworkGUI/optimizer.cpp NeuralNetworkGUI/kernels.cpp NeuralNetworkGUI/gemm.cpp NeuralNetworkGUI/dataset.cpp NeuralNetworkGUI/text_reader.cpp NeuralNetworkGUI/thread_pool.cpp NeuralNetworkGUI/parallel_trainer.cpp NeuralNetworkGUI/evaluator.cpp
+//   ./bench_suite [--out results.json] [--data FILE] [--quick] [--repeat N] [--min-time S] [--threads N]
+//   ./bench_suite --compare base.json new.json [--threshold PERCENT]
+//
+// --compare prints the change of every metric the two files share and
+// exits 1 if any got worse by more than the threshold (default 5%).
+#include<bits/stdc++.h>
+#include "../NeuralNetworkGUI/parallel_trainer.h"
+#include "../NeuralNetworkGUI/evaluator.h"
+#include "../NeuralNetworkGUI/kernels.h"
+#include "../NeuralNetworkGUI/json_line.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct Metric {
+	std::string name;
+	std::string unit;
+	bool higherIsBetter;
+	double value;
+};
+
+struct Options {
+	std::string dataFile;
+	unsigned repeat;
+	double minSeconds;
+	unsigned maxThreads;
+	bool quick;
+	Options() : dataFile("released/trainingData.txt"), repeat(3), minSeconds(0.2),
+	            maxThreads(std::max(1u, std::thread::hardware_concurrency())), quick(false) {}
+};
+
+static double g_sink;
+
+// Seconds per iteration of body(iterations): the iteration count doubles
+// until one run lasts minSeconds, then the median of repeat runs at that
+// count is returned.
+template<class F>
+static double secondsPerIteration(const Options &options, F body){
+	size_t iterations = 1;
+	while(true){
+		Clock::time_point start = Clock::now();
+		body(iterations);
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		if(seconds >= options.minSeconds || iterations >= ((size_t)1 << 40))
+			break;
+		iterations *= seconds > 0 ? std::min<size_t>(16, std::max<size_t>(2, options.minSeconds / seconds)) : 16;
+	}
+	std::vector<double> runs;
+	for(unsigned r = 0; r < options.repeat; r++){
+		Clock::time_point start = Clock::now();
+		body(iterations);
+		runs.push_back(std::chrono::duration<double>(Clock::now() - start).count() / iterations);
+	}
+	std::sort(runs.begin(), runs.end());
+	return runs[runs.size() / 2];
+}
+
+static std::string topologyName(const std::vector<unsigned> &topology){
+	std::ostringstream name;
+	for(size_t l = 0; l < topology.size(); l++)
+		name << (l > 0 ? "-" : "") << topology[l];
+	return name.str();
+}
+
+static void add(std::vector<Metric> &metrics, const std::string &name, const std::string &unit,
+                bool higherIsBetter, double value){
+	Metric metric = {name, unit, higherIsBetter, value};
+	metrics.push_back(metric);
+	std::cerr << std::left << std::setw(48) << name << std::right << std::setw(16) << value << ' ' << unit << '\n';
+}
+
+// Synthetic samples for a topology: uniform inputs, 0/1 targets.
+struct Samples {
+	std::vector<double> inputs, targets;
+	std::vector<float> floatInputs, floatTargets;
+};
+
+static Samples makeSamples(const std::vector<unsigned> &topology, size_t count){
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<double> uniform(0.0, 1.0);
+	Samples samples;
+	for(size_t i = 0; i < count * topology.front(); i++)
+		samples.inputs.push_back(uniform(rng));
+	for(size_t i = 0; i < count * topology.back(); i++)
+		samples.targets.push_back(uniform(rng) < 0.5 ? 0.0 : 1.0);
+	samples.floatInputs.assign(samples.inputs.begin(), samples.inputs.end());
+	samples.floatTargets.assign(samples.targets.begin(), samples.targets.end());
+	return samples;
+}
+
+static void benchParse(const Options &options, std::vector<Metric> &metrics){
+	std::ifstream probe(options.dataFile.c_str(), std::ios::binary | std::ios::ate);
+	if(!probe){
+		std::cerr << "cannot read " << options.dataFile << ", skipping parse.*\n";
+		return;
+	}
+	double bytes = probe.tellg();
+	size_t samples = 0;
+	double seconds = secondsPerIteration(options, [&](size_t iterations){
+		std::vector<double> inputVals, targetVals;
+		for(size_t i = 0; i < iterations; i++){
+			TrainingData data(options.dataFile);
+			std::vector<unsigned> topology;
+			data.getTopology(topology);
+			samples = 0;
+			while(!data.isEof() && data.getNextInputs(inputVals) == topology.front()){
+				data.getTargetOutputs(targetVals);
+				g_sink += targetVals[0];
+				samples++;
+			}
+		}
+	});
+	add(metrics, "parse.text.throughput", "MB/s", true, bytes / seconds / 1e6);
+	add(metrics, "parse.text.samples", "samples/s", true, samples / seconds);
+}
+
+static void benchTopology(const Options &options, const std::vector<unsigned> &topology,
+                          std::vector<Metric> &metrics){
+	std::string name = topologyName(topology);
+	const size_t count = 1024;
+	Samples samples = makeSamples(topology, count);
+	unsigned numInputs = topology.front(), numOutputs = topology.back();
+
+	double seconds = secondsPerIteration(options, [&](size_t iterations){
+		for(size_t i = 0; i < iterations; i++){
+			Net net(topology);
+			g_sink += net.parameters()[0];
+		}
+	});
+	add(metrics, "construct." + name, "us", false, seconds * 1e6);
+
+	Net net(topology);
+	std::vector<double> inputVals(numInputs), targetVals(numOutputs), resultVals;
+	seconds = secondsPerIteration(options, [&](size_t iterations){
+		for(size_t i = 0; i < iterations; i++){
+			size_t s = i % count;
+			inputVals.assign(samples.inputs.data() + s * numInputs, samples.inputs.data() + (s + 1) * numInputs);
+			net.feedForward(inputVals);
+			net.getResults(resultVals);
+			g_sink += resultVals[0];
+		}
+	});
+	add(metrics, "infer.latency." + name, "ns", false, seconds * 1e9);
+
+	seconds = secondsPerIteration(options, [&](size_t iterations){
+		for(size_t i = 0; i < iterations; i++){
+			size_t s = i % count;
+			inputVals.assign(samples.inputs.data() + s * numInputs, samples.inputs.data() + (s + 1) * numInputs);
+			targetVals.assign(samples.targets.data() + s * numOutputs, samples.targets.data() + (s + 1) * numOutputs);
+			net.feedForward(inputVals);
+			net.backProp(targetVals);
+		}
+	});
+	add(metrics, "train.latency." + name, "ns", false, seconds * 1e9);
+
+	const unsigned batchSize = 64;
+	seconds = secondsPerIteration(options, [&](size_t iterations){
+		for(size_t i = 0; i < iterations; i++){
+			size_t first = (i * batchSize) % count;
+			net.trainBatch(samples.inputs.data() + first * numInputs, samples.targets.data() + first * numOutputs, batchSize);
+		}
+	});
+	add(metrics, "train.batch64." + name, "samples/s", true, batchSize / seconds);
+
+	std::vector<float> outputs(count * numOutputs);
+	seconds = secondsPerIteration(options, [&](size_t iterations){
+		for(size_t i = 0; i < iterations; i++)
+			net.predictBatch(samples.floatInputs.data(), count, outputs.data());
+		g_sink += outputs[0];
+	});
+	add(metrics, "infer.batch." + name, "samples/s", true, count / seconds);
+}
+
+static void benchThreads(const Options &options, const std::vector<unsigned> &topology,
+                         std::vector<Metric> &metrics){
+	std::string name = topologyName(topology);
+	const size_t count = 16384;
+	const unsigned batchSize = 1024;
+	Samples samples = makeSamples(topology, count);
+	unsigned numInputs = topology.front(), numOutputs = topology.back();
+	std::vector<unsigned> threadCounts;
+	for(unsigned t = 1; t < options.maxThreads; t *= 2)
+		threadCounts.push_back(t);
+	threadCounts.push_back(options.maxThreads);
+	for(unsigned threads : threadCounts){
+		ThreadPool pool(threads);
+		Net net(topology);
+		ParallelTrainer trainer(net, pool);
+		double seconds = secondsPerIteration(options, [&](size_t iterations){
+			for(size_t i = 0; i < iterations; i++){
+				size_t first = (i * batchSize) % count;
+				trainer.trainBatch(samples.inputs.data() + first * numInputs, samples.targets.data() + first * numOutputs, batchSize);
+			}
+		});
+		std::string suffix = ".t" + std::to_string(threads) + "." + name;
+		add(metrics, "threads.train" + suffix, "samples/s", true, batchSize / seconds);
+
+		Evaluator evaluator(net, pool);
+		seconds = secondsPerIteration(options, [&](size_t iterations){
+			for(size_t i = 0; i < iterations; i++)
+				evaluator.evaluate(samples.floatInputs.data(), samples.floatTargets.data(), count);
+			g_sink += evaluator.metrics().accuracy();
+		});
+		add(metrics, "threads.infer" + suffix, "samples/s", true, count / seconds);
+	}
+}
+
+static std::string escape(const std::string &text){
+	std::string escaped;
+	for(char c : text){
+		if(c == '"' || c == '\\')
+			escaped += '\\';
+		escaped += c;
+	}
+	return escaped;
+}
+
+// One result per line, so readResults can stay a line scanner.
+static bool writeResults(const std::string &filename, const Options &options, const std::vector<Metric> &metrics){
+	std::ofstream out(filename.c_str());
+	out << std::setprecision(10);
+	out << "{\n";
+	out << "  \"kernels\": \"" << kernels().name << "\",\n";
+	out << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+	out << "  \"compiler\": \"" << escape(__VERSION__) << "\",\n";
+	out << "  \"quick\": " << (options.quick ? "true" : "false") << ",\n";
+	out << "  \"results\": [\n";
+	for(size_t i = 0; i < metrics.size(); i++){
+		const Metric &m = metrics[i];
+		out << "    {\"name\": \"" << m.name << "\", \"unit\": \"" << m.unit << "\", \"higher_is_better\": "
+		    << (m.higherIsBetter ? "true" : "false") << ", \"value\": " << m.value << "}"
+		    << (i + 1 < metrics.size() ? "," : "") << '\n';
+	}
+	out << "  ]\n}\n";
+	return (bool)out;
+}
+
+// Reads a file writeResults wrote.
+static bool readResults(const std::string &filename, std::vector<Metric> &metrics){
+	std::ifstream in(filename.c_str());
+	if(!in)
+		return false;
+	std::string line;
+	while(std::getline(in, line)){
+		Metric m;
+		std::string better, value;
+		if(!jsonField(line, "name", m.name) || !jsonField(line, "value", value)
+		   || !jsonField(line, "higher_is_better", better))
+			continue;
+		jsonField(line, "unit", m.unit);
+		m.higherIsBetter = better == "true";
+		m.value = atof(value.c_str());
+		metrics.push_back(m);
+	}
+	return true;
+}
+
+static int compare(const std::string &baseFile, const std::string &newFile, double threshold){
+	std::vector<Metric> base, current;
+	if(!readResults(baseFile, base) || !readResults(newFile, current)){
+		std::cerr << "cannot read " << baseFile << " or " << newFile << '\n';
+		return 2;
+	}
+	std::map<std::string, Metric> byName;
+	for(const Metric &m : base)
+		byName[m.name] = m;
+	unsigned regressions = 0, improvements = 0, compared = 0;
+	std::cout << std::left << std::setw(48) << "metric" << std::right << std::setw(16) << "base"
+	          << std::setw(16) << "new" << std::setw(10) << "change" << '\n';
+	for(const Metric &m : current){
+		std::map<std::string, Metric>::const_iterator it = byName.find(m.name);
+		if(it == byName.end())
+			continue;
+		compared++;
+		double change = it->second.value != 0 ? (m.value - it->second.value) / it->second.value * 100 : 0;
+		double gain = m.higherIsBetter ? change : -change;
+		const char *flag = "";
+		if(gain < -threshold){
+			flag = "  REGRESSION";
+			regressions++;
+		} else if(gain > threshold){
+			flag = "  faster";
+			improvements++;
+		}
+		std::ostringstream cell;
+		cell << std::fixed << std::setprecision(1) << std::showpos << change << '%';
+		std::cout << std::left << std::setw(48) << m.name << std::right << std::setw(16) << it->second.value
+		          << std::setw(16) << m.value << std::setw(10) << cell.str() << flag << '\n';
+		byName.erase(it);
+	}
+	for(std::map<std::string, Metric>::const_iterator it = byName.begin(); it != byName.end(); ++it)
+		std::cout << std::left << std::setw(48) << it->first << "  only in " << baseFile << '\n';
+	std::cout << '\n' << compared << " compared, " << regressions << " regressed and " << improvements
+	          << " improved by more than " << threshold << "%\n";
+	return regressions > 0 ? 1 : 0;
+}
+
+int main(int argc, char *argv[]){
+	Options options;
+	std::string outFile = "bench_results.json", baseFile, newFile;
+	double threshold = 5.0;
+	for(int i = 1; i < argc; i++){
+		if(strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+			outFile = argv[++i];
+		else if(strcmp(argv[i], "--data") == 0 && i + 1 < argc)
+			options.dataFile = argv[++i];
+		else if(strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+			options.repeat = std::max(1, atoi(argv[++i]));
+		else if(strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+			options.minSeconds = atof(argv[++i]);
+		else if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			options.maxThreads = std::max(1, atoi(argv[++i]));
+		else if(strcmp(argv[i], "--quick") == 0)
+			options.quick = true;
+		else if(strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+			threshold = atof(argv[++i]);
+		else if(strcmp(argv[i], "--compare") == 0 && i + 2 < argc){
+			baseFile = argv[++i];
+			newFile = argv[++i];
+		}
+	}
+	if(!baseFile.empty())
+		return compare(baseFile, newFile, threshold);
+
+	if(options.quick){
+		options.minSeconds = std::min(options.minSeconds, 0.05);
+		options.repeat = 1;
+	}
+	std::vector<std::vector<unsigned> > topologies = {
+		{2, 8, 1}, {16, 64, 16, 1}, {64, 256, 256, 10}, {256, 1024, 1024, 10},
+	};
+	if(options.quick)
+		topologies.pop_back();
+
+	std::vector<Metric> metrics;
+	std::cerr << "kernels: " << kernels().name << '\n';
+	benchParse(options, metrics);
+	for(const std::vector<unsigned> &topology : topologies)
+		benchTopology(options, topology, metrics);
+	benchThreads(options, {2, 8, 1}, metrics);
+	benchThreads(options, {64, 256, 256, 10}, metrics);
+
+	if(!writeResults(outFile, options, metrics)){
+		std::cerr << "cannot write " << outFile << '\n';
+		return 2;
+	}
+	std::cerr << "wrote " << outFile << " (sink " << g_sink << ")\n";
+	return 0;
+}
@@ -0,0 +1,78 @@
+// Scaling benchmark for batched inference: scores a million synthetic rows
+// with Evaluator on 1, 2, 4, ... threads and compares against the per-sample
+// feedForward + getResults loop the test code used before. The single-thread
+// float and int8 (QuantizedNet) paths are timed on the same rows.
+//
+//   g++ -O2 -pthread -o eval_bench bench/eval_bench.cpp NeuralNetworkGUI/evaluator.cpp NeuralNetworkGUI/all_class.cpp NeuralNetworkGUI/activations.cpp NeuralNetworkGUI/optimizer.cpp NeuralNetworkGUI/kernels.cpp NeuralNetworkGUI/gemm.cpp NeuralNetworkGUI/thread_pool.cpp NeuralNetworkGUI/dataset.cpp NeuralNetworkGUI/text_reader.cpp NeuralNetworkGUI/quantized_net.cpp
+//   ./eval_bench [rows]
+#include<bits/stdc++.h>
+#include "../NeuralNetworkGUI/evaluator.h"
+#include "../NeuralNetworkGUI/quantized_net.h"
+#include "../NeuralNetworkGUI/kernels.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start){
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Times one predictBatch over every row on this thread.
+template<class NetType>
+static void timePredict(const std::string &name, const NetType &net, const std::vector<float> &inputs,
+                        const std::vector<float> &targets, double baseline){
+	size_t rows = targets.size();
+	std::vector<float> outputs(rows);
+	Clock::time_point start = Clock::now();
+	net.predictBatch(inputs.data(), rows, outputs.data());
+	double seconds = secondsSince(start);
+	unsigned long long correct = 0;
+	for(size_t i = 0; i < rows; i++)
+		correct += (outputs[i] > 0.5f) == (targets[i] > 0.5f);
+	std::cout << std::setw(24) << name << std::setw(12) << seconds << std::setw(16) << rows / seconds
+	     << "accuracy " << (double)correct / rows << "  speedup " << baseline / seconds << '\n';
+}
+
+int main(int argc, char *argv[]){
+	size_t rows = argc > 1 ? atol(argv[1]) : 1000000;
+	std::vector<unsigned> topology = {2, 8, 1};
+	Net net(topology);
+	std::mt19937 rng(1);
+	std::vector<float> inputs(rows * 2), targets(rows);
+	for(size_t i = 0; i < rows; i++){
+		inputs[2 * i] = rng() % 20;
+		inputs[2 * i + 1] = rng() % 20;
+		targets[i] = inputs[2 * i] == inputs[2 * i + 1];
+	}
+
+	Clock::time_point start = Clock::now();
+	std::vector<double> inputVals(2), resultVals;
+	unsigned long long correct = 0;
+	for(size_t i = 0; i < rows; i++){
+		inputVals[0] = inputs[2 * i];
+		inputVals[1] = inputs[2 * i + 1];
+		net.feedForward(inputVals);
+		net.getResults(resultVals);
+		correct += (resultVals[0] > 0.5) == (targets[i] > 0.5);
+	}
+	double baseline = secondsSince(start);
+	std::cout << std::left << std::setw(24) << "feedForward loop" << std::setw(12) << baseline
+	     << std::setw(16) << rows / baseline << "accuracy " << (double)correct / rows << '\n';
+
+	unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	for(unsigned threads = 1; threads <= maxThreads; threads *= 2){
+		ThreadPool pool(threads);
+		Evaluator evaluator(net, pool);
+		start = Clock::now();
+		evaluator.evaluate(inputs.data(), targets.data(), rows);
+		double seconds = secondsSince(start);
+		std::cout << std::setw(24) << ("predictBatch x" + std::to_string(threads)) << std::setw(12) << seconds
+		     << std::setw(16) << rows / seconds << "accuracy " << evaluator.metrics().accuracy()
+		     << "  speedup " << baseline / seconds << '\n';
+	}
+
+	timePredict("double x1", net, inputs, targets, baseline);
+	timePredict("float x1", FloatNet(net), inputs, targets, baseline);
+	size_t calibration = std::min<size_t>(rows, 1000);
+	timePredict(std::string("int8 x1 (") + int8Kernels().name + ")",
+	            QuantizedNet(net, inputs.data(), calibration), inputs, targets, baseline);
+}
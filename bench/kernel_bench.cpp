@@ -0,0 +1,87 @@
+// Micro-benchmark for the dense-layer kernels: times every kernel table the
+// CPU supports, double and float, against the scalar loops Net used before.
+// The sigmoid and tanh rows map a layer buffer in place; scalar is libm.
+// The nesterov, rmsprop and adam rows are one fused optimizer row update.
+//
+//   g++ -O2 -o kernel_bench bench/kernel_bench.cpp NeuralNetworkGUI/kernels.cpp
+#include<bits/stdc++.h>
+#include "../NeuralNetworkGUI/kernels.h"
+
+static double g_sink;
+
+template<class F>
+double nsPerCall(F f, unsigned n){
+	unsigned reps = std::max(1000u, 20000000u / (n + 1));
+	auto start = std::chrono::steady_clock::now();
+	for(unsigned r = 0; r < reps; r++)
+		f();
+	auto stop = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(stop - start).count() / reps;
+}
+
+// One table of timings for element type T. Speedups are against the
+// double-precision scalar kernels, so the float rows show the gain from both
+// SIMD and the narrower type.
+template<class T>
+void benchTables(const char *label, const KernelTableT<T> *const *tables, unsigned count,
+                 std::map<std::pair<unsigned, unsigned>, double> &baseline){
+	const unsigned sizes[] = {9, 64, 257, 1024, 4096};
+
+	std::cout << std::left << std::setw(16) << label << std::setw(8) << "n";
+	for(unsigned t = 0; t < count; t++)
+		std::cout << std::setw(20) << (std::string(tables[t]->name) + " ns");
+	std::cout << '\n';
+
+	for(unsigned n : sizes){
+		std::vector<T> a(n), b(n), y(n), w(n), dw(n), v(n);
+		OptimizerStepT<T> step = {T(0.001), T(0.9), T(0.999), T(1e-8), T(0), T(0)};
+		for(unsigned i = 0; i < n; i++){
+			a[i] = rand() / double(RAND_MAX);
+			b[i] = rand() / double(RAND_MAX);
+		}
+		const char *names[] = {"dot", "axpy", "momentumUpdate", "sigmoid", "tanh", "nesterov", "rmsprop", "adam"};
+		for(unsigned which = 0; which < 8; which++){
+			std::cout << std::setw(16) << names[which] << std::setw(8) << n;
+			for(unsigned t = 0; t < count; t++){
+				const KernelTableT<T> &k = *tables[t];
+				double ns;
+				if(which == 0)
+					ns = nsPerCall([&]{ g_sink += k.dot(a.data(), b.data(), n); }, n);
+				else if(which == 1)
+					ns = nsPerCall([&]{ k.axpy(y.data(), a.data(), T(1e-9), n); }, n);
+				else if(which == 2)
+					ns = nsPerCall([&]{ k.momentumUpdate(w.data(), dw.data(), a.data(), T(1e-9), T(0.15), T(0.5), n); }, n);
+				else if(which == 3)
+					ns = nsPerCall([&]{ k.sigmoid(y.data(), n); }, n);
+				else if(which == 4)
+					ns = nsPerCall([&]{ k.tanh(y.data(), n); }, n);
+				else if(which == 5)
+					ns = nsPerCall([&]{ k.nesterovUpdate(w.data(), dw.data(), v.data(), NULL, a.data(), T(1e-9), step, n); }, n);
+				else if(which == 6)
+					ns = nsPerCall([&]{ k.rmspropUpdate(w.data(), dw.data(), v.data(), NULL, a.data(), T(1e-9), step, n); }, n);
+				else
+					ns = nsPerCall([&]{ k.adamUpdate(w.data(), dw.data(), v.data(), NULL, a.data(), T(1e-9), step, n); }, n);
+				std::pair<unsigned, unsigned> key(n, which);
+				if(!baseline.count(key))
+					baseline[key] = ns;
+				std::ostringstream cell;
+				cell << std::fixed << std::setprecision(1) << ns;
+				if(ns != baseline[key])
+					cell << " (" << std::setprecision(2) << baseline[key] / ns << "x)";
+				std::cout << std::setw(20) << cell.str();
+			}
+			std::cout << '\n';
+		}
+	}
+}
+
+int main(){
+	std::map<std::pair<unsigned, unsigned>, double> baseline;
+	unsigned count;
+	const KernelTable *const *tables = supportedKernels(count);
+	benchTables("double", tables, count, baseline);
+	std::cout << '\n';
+	const FloatKernelTable *const *floatTables = supportedFloatKernels(count);
+	benchTables("float", floatTables, count, baseline);
+	std::cerr << "(sink " << g_sink << ")\n";
+}
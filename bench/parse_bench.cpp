@@ -0,0 +1,112 @@
+// Parse throughput for the text dataset format: the original
+// getline + stringstream loop, TrainingData, and FastTextReader writing into
+// caller-owned buffers.
+//
+//   g++ -O2 -o parse_bench bench/parse_bench.cpp NeuralNetworkGUI/all_class.cpp NeuralNetworkGUI/activations.cpp NeuralNetworkGUI/optimizer.cpp NeuralNetworkGUI/kernels.cpp NeuralNetworkGUI/gemm.cpp NeuralNetworkGUI/dataset.cpp NeuralNetworkGUI/text_reader.cpp
+//   ./parse_bench [released/trainingData.txt] [repetitions]
+#include<bits/stdc++.h>
+#include "../NeuralNetworkGUI/all_class.h"
+
+// The reader TrainingData used before FastTextReader, kept as the baseline.
+static unsigned legacyValues(std::ifstream &file, const char *expected, std::vector<double> &vals){
+	vals.clear();
+	std::string line, label;
+	getline(file, line);
+	std::stringstream ss(line);
+	ss >> label;
+	if(label.compare(expected) == 0){
+		double oneValue;
+		while(ss >> oneValue)
+			vals.push_back(oneValue);
+	}
+	return vals.size();
+}
+
+static double g_sink;
+
+struct Result { double seconds; size_t samples; };
+
+static Result runLegacy(const std::string &filename){
+	std::ifstream file(filename.c_str());
+	std::vector<double> inputVals, targetVals;
+	std::string line;
+	getline(file, line);
+	size_t samples = 0;
+	auto start = std::chrono::steady_clock::now();
+	while(!file.eof()){
+		if(legacyValues(file, "in:", inputVals) == 0)
+			break;
+		legacyValues(file, "out:", targetVals);
+		g_sink += inputVals[0] + targetVals[0];
+		samples++;
+	}
+	auto stop = std::chrono::steady_clock::now();
+	return Result{std::chrono::duration<double>(stop - start).count(), samples};
+}
+
+static Result runTrainingData(const std::string &filename){
+	TrainingData data(filename);
+	std::vector<unsigned> topology;
+	std::vector<double> inputVals, targetVals;
+	data.getTopology(topology);
+	size_t samples = 0;
+	auto start = std::chrono::steady_clock::now();
+	while(!data.isEof()){
+		if(data.getNextInputs(inputVals) != topology[0])
+			break;
+		data.getTargetOutputs(targetVals);
+		g_sink += inputVals[0] + targetVals[0];
+		samples++;
+	}
+	auto stop = std::chrono::steady_clock::now();
+	return Result{std::chrono::duration<double>(stop - start).count(), samples};
+}
+
+static Result runFastReader(const std::string &filename){
+	FastTextReader reader(filename);
+	std::vector<unsigned> topology;
+	reader.readTopology(topology);
+	double inputs[64], targets[64];
+	size_t samples = 0;
+	auto start = std::chrono::steady_clock::now();
+	while(!reader.isEof()){
+		if(reader.readValues("in:", inputs, 64) == 0)
+			break;
+		reader.readValues("out:", targets, 64);
+		g_sink += inputs[0] + targets[0];
+		samples++;
+	}
+	auto stop = std::chrono::steady_clock::now();
+	return Result{std::chrono::duration<double>(stop - start).count(), samples};
+}
+
+int main(int argc, char *argv[]){
+	std::string filename = argc > 1 ? argv[1] : "released/trainingData.txt";
+	unsigned reps = argc > 2 ? atoi(argv[2]) : 20;
+	std::ifstream probe(filename.c_str(), std::ios::binary | std::ios::ate);
+	if(!probe){
+		std::cerr << "cannot open " << filename << '\n';
+		return 1;
+	}
+	double megabytes = probe.tellg() / 1e6;
+
+	const char *names[] = {"getline+stringstream", "TrainingData", "FastTextReader"};
+	Result (*runs[])(const std::string &) = {runLegacy, runTrainingData, runFastReader};
+	double baseline = 0.0;
+	std::cout << filename << ", " << megabytes << " MB, best of " << reps << '\n';
+	for(unsigned r = 0; r < 3; r++){
+		Result best = {1e30, 0};
+		for(unsigned i = 0; i < reps; i++){
+			Result result = runs[r](filename);
+			if(result.seconds < best.seconds)
+				best = result;
+		}
+		if(r == 0)
+			baseline = best.seconds;
+		std::cout << std::left << std::setw(22) << names[r] << std::right << std::fixed
+		          << std::setprecision(1) << std::setw(9) << megabytes / best.seconds << " MB/s"
+		          << std::setw(13) << best.samples / best.seconds / 1e6 << " M samples/s"
+		          << std::setprecision(2) << std::setw(8) << baseline / best.seconds << "x\n";
+	}
+	std::cerr << "(sink " << g_sink << ")\n";
+}
@@ -0,0 +1,193 @@
+// Load generator for the inference server: --connections clients, each
+// keeping --depth requests of --samples samples in flight, --requests
+// requests per client. Prints client-side QPS and p50/p99 latency and the
+// server's own counters.
+//
+// With --socket it drives a running tools/serve. Otherwise it starts an
+// InferenceServer in this process on a temporary socket, serving --model
+// (a checkpoint) or a fresh Net of --topology, and checks every reply
+// against a local predictBatch of the same samples; exits 1 on a mismatch.
+//
+//   make serve_bench          (or the g++ line below)
+//   g++ -O2 -pthread -o serve_bench bench/serve_bench.cpp NeuralNetworkGUI/inference_server.cpp NeuralNetworkGUI/checkpoint.cpp NeuralNetworkGUI/all_class.cpp NeuralNetworkGUI/activations.cpp NeuralNetworkGUI/optimizer.cpp NeuralNetworkGUI/kernels.cpp NeuralNetworkGUI/gemm.cpp NeuralNetworkGUI/dataset.cpp NeuralNetworkGUI/text_reader.cpp NeuralNetworkGUI/thread_pool.cpp
+//   ./serve_bench [--socket PATH | --model FILE | --topology "64 256 256 10"] [--connections C] [--depth D]
+//                 [--requests N] [--samples S] [--threads T] [--max-batch N] [--budget-us U]
+#include<bits/stdc++.h>
+#include<unistd.h>
+#include "../NeuralNetworkGUI/inference_server.h"
+#include "../NeuralNetworkGUI/checkpoint.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// Distinct request payloads each client cycles through.
+#define BLOCKS 16
+
+struct ClientResult {
+	LatencyHistogram latency;
+	unsigned long long requests, rejected, mismatches;
+	bool failed;
+	ClientResult() : requests(0), rejected(0), mismatches(0), failed(false) {}
+};
+
+static void runClient(const std::string &path, unsigned depth, unsigned requests, unsigned samples,
+                      const std::vector<std::vector<float> > &blocks,
+                      const std::vector<std::vector<float> > &expected, ClientResult &result){
+	InferenceClient client;
+	if(!client.connect(path)){
+		result.failed = true;
+		return;
+	}
+	std::vector<Clock::time_point> sent(requests);
+	std::vector<float> outputs;
+	unsigned next = 0, done = 0;
+	while(done < requests){
+		while(next < requests && next - done < depth){
+			sent[next] = Clock::now();
+			if(!client.send(next, blocks[next % BLOCKS].data(), samples)){
+				result.failed = true;
+				return;
+			}
+			next++;
+		}
+		ServeHeader header;
+		if(!client.receive(header, outputs) || header.id >= requests){
+			result.failed = true;
+			return;
+		}
+		done++;
+		if(header.type == SERVE_OVERLOADED){
+			result.rejected++;
+			continue;
+		}
+		result.latency.record(std::chrono::duration<double>(Clock::now() - sent[header.id]).count());
+		result.requests++;
+		if(expected.empty())
+			continue;
+		const std::vector<float> &want = expected[header.id % BLOCKS];
+		for(size_t i = 0; i < want.size(); i++)
+			if(fabs(outputs[i] - want[i]) > 1e-5f * std::max(1.0f, fabsf(want[i]))){
+				result.mismatches++;
+				break;
+			}
+	}
+}
+
+int main(int argc, char *argv[]){
+	std::string socketPath, modelFile;
+	std::vector<unsigned> topology = {64, 256, 256, 10};
+	unsigned connections = 4, depth = 4, requests = 2000, samples = 1;
+	ServeOptions options;
+	for(int i = 1; i < argc; i++){
+		if(strcmp(argv[i], "--socket") == 0 && i + 1 < argc)
+			socketPath = argv[++i];
+		else if(strcmp(argv[i], "--model") == 0 && i + 1 < argc)
+			modelFile = argv[++i];
+		else if(strcmp(argv[i], "--topology") == 0 && i + 1 < argc){
+			std::istringstream in(argv[++i]);
+			topology.clear();
+			for(unsigned n; in >> n; )
+				topology.push_back(n);
+		} else if(strcmp(argv[i], "--connections") == 0 && i + 1 < argc)
+			connections = std::max(1, atoi(argv[++i]));
+		else if(strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+			depth = std::max(1, atoi(argv[++i]));
+		else if(strcmp(argv[i], "--requests") == 0 && i + 1 < argc)
+			requests = std::max(1, atoi(argv[++i]));
+		else if(strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+			samples = std::max(1, atoi(argv[++i]));
+		else if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			options.threads = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--max-batch") == 0 && i + 1 < argc)
+			options.maxBatch = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--budget-us") == 0 && i + 1 < argc)
+			options.latencyBudgetUs = atoi(argv[++i]);
+	}
+
+	// The in-process server, and the Net the replies are checked against.
+	std::unique_ptr<Net> net;
+	std::unique_ptr<InferenceServer> server;
+	if(socketPath.empty()){
+		if(!modelFile.empty()){
+			net = loadCheckpoint(modelFile);
+			if(!net){
+				std::cerr << modelFile << " is not a checkpoint\n";
+				return 1;
+			}
+		} else {
+			if(topology.size() < 2){
+				std::cerr << "--topology needs at least two layers\n";
+				return 1;
+			}
+			net.reset(new Net(topology));
+		}
+		socketPath = "/tmp/serve_bench." + std::to_string(getpid()) + ".sock";
+		server.reset(new InferenceServer(*net, options));
+		if(!server->listen(socketPath)){
+			std::cerr << "cannot listen on " << socketPath << '\n';
+			return 1;
+		}
+	}
+
+	InferenceClient probe;
+	if(!probe.connect(socketPath)){
+		std::cerr << "cannot connect to " << socketPath << '\n';
+		return 1;
+	}
+	unsigned numInputs = probe.numInputs(), numOutputs = probe.numOutputs();
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+	std::vector<std::vector<float> > blocks(BLOCKS), expected;
+	for(std::vector<float> &block : blocks)
+		for(size_t i = 0; i < (size_t)samples * numInputs; i++)
+			block.push_back(uniform(rng));
+	if(net){
+		expected.resize(BLOCKS);
+		for(unsigned b = 0; b < BLOCKS; b++){
+			expected[b].resize((size_t)samples * numOutputs);
+			net->predictBatch(blocks[b].data(), samples, expected[b].data());
+		}
+	}
+
+	std::cout << "topology";
+	for(unsigned n : probe.topology())
+		std::cout << ' ' << n;
+	std::cout << ", " << connections << " connections x " << requests << " requests of " << samples
+	          << " samples, depth " << depth;
+	if(server)
+		std::cout << ", in-process server: max batch " << options.maxBatch << ", budget "
+		          << options.latencyBudgetUs << "us, " << options.threads << " threads";
+	std::cout << '\n';
+
+	std::vector<ClientResult> results(connections);
+	std::vector<std::thread> clients;
+	Clock::time_point start = Clock::now();
+	for(unsigned c = 0; c < connections; c++)
+		clients.push_back(std::thread(runClient, socketPath, depth, requests, samples,
+		                              std::cref(blocks), std::cref(expected), std::ref(results[c])));
+	for(std::thread &t : clients)
+		t.join();
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	LatencyHistogram latency;
+	unsigned long long total = 0, rejected = 0, mismatches = 0;
+	bool failed = false;
+	for(const ClientResult &r : results){
+		latency.merge(r.latency);
+		total += r.requests;
+		rejected += r.rejected;
+		mismatches += r.mismatches;
+		failed |= r.failed;
+	}
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "client: " << total / seconds << " qps, " << total * samples / seconds << " samples/s, p50 "
+	          << latency.quantile(0.5) * 1e6 << "us, p99 " << latency.quantile(0.99) * 1e6 << "us, max "
+	          << latency.max() * 1e6 << "us, rejected " << rejected << '\n';
+	std::string json;
+	if(probe.stats(json))
+		std::cout << "server: " << json << '\n';
+	if(!expected.empty())
+		std::cout << "checked against local predictBatch: " << mismatches << " mismatching replies\n";
+	if(failed)
+		std::cout << "a client lost its connection\n";
+	return failed || mismatches > 0 ? 1 : 0;
+}
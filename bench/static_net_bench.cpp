@@ -0,0 +1,117 @@
+// Per-sample latency of the compile-time StaticNet<2, 8, 1> against Net for
+// inference (feedForward + getResults, predictBatch of one row, predict) and
+// training (feedForward + backProp), with the heap allocations each loop
+// makes. Both nets start from the same weights; under NN_KERNEL=scalar the
+// StaticNet rows' "max |diff|" must be 0.
+//
+//   g++ -O2 -pthread -o static_net_bench bench/static_net_bench.cpp NeuralNetworkGUI/all_class.cpp NeuralNetworkGUI/activations.cpp NeuralNetworkGUI/optimizer.cpp NeuralNetworkGUI/kernels.cpp NeuralNetworkGUI/gemm.cpp NeuralNetworkGUI/dataset.cpp NeuralNetworkGUI/text_reader.cpp
+//   ./static_net_bench [samples]
+#include<bits/stdc++.h>
+#include "../NeuralNetworkGUI/static_net.h"
+#include "../NeuralNetworkGUI/kernels.h"
+#include "../NeuralNetworkGUI/profiler.h"
+
+typedef std::chrono::steady_clock Clock;
+
+#ifdef NN_PROFILE
+// The profiler already counts every operator new.
+static unsigned long long allocationCount(void) { return profileTotal(PROFILE_ALLOCATIONS); }
+#else
+static std::atomic<unsigned long long> g_allocations(0);
+
+void *operator new(size_t size){
+	g_allocations++;
+	if(void *p = malloc(size))
+		return p;
+	throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+static unsigned long long allocationCount(void) { return g_allocations; }
+#endif
+
+static double g_sink;
+
+// Runs body(i) for every sample and prints ns per sample, allocations per
+// sample and the largest difference between outputs and reference. Returns
+// the ns per sample.
+template<class F>
+static double row(const std::string &name, size_t samples, std::vector<double> &outputs,
+                const std::vector<double> &reference, double baseline, F body){
+	unsigned long long before = allocationCount();
+	Clock::time_point start = Clock::now();
+	for(size_t i = 0; i < samples; i++)
+		body(i);
+	double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / samples;
+	unsigned long long allocations = allocationCount() - before;
+	double diff = 0.0;
+	for(size_t i = 0; i < reference.size(); i++)
+		diff = std::max(diff, fabs(outputs[i] - reference[i]));
+	if(!outputs.empty())
+		g_sink += outputs.back();
+	std::cout << std::setw(28) << name << std::setw(12) << ns << std::setw(14) << (double)allocations / samples
+	          << std::setw(14) << diff << (baseline > 0.0 ? baseline / ns : 1.0) << "x\n";
+	return ns;
+}
+
+int main(int argc, char *argv[]){
+	size_t samples = argc > 1 ? std::max(1L, atol(argv[1])) : 1000000;
+	std::vector<unsigned> topology = {2, 8, 1};
+	std::mt19937 rng(1);
+	std::vector<double> inputs(samples * 2), targets(samples);
+	for(size_t i = 0; i < samples; i++){
+		inputs[2 * i] = rng() % 20;
+		inputs[2 * i + 1] = rng() % 20;
+		targets[i] = inputs[2 * i] == inputs[2 * i + 1];
+	}
+	Net net(topology);
+	StaticNet<2, 8, 1> fixed;
+	fixed.load(net);
+
+	std::cout << "kernels: " << kernels().name << ", " << samples << " samples\n";
+	std::cout << std::left << std::setw(28) << "" << std::setw(12) << "ns/sample" << std::setw(14) << "allocs/sample"
+	          << std::setw(14) << "max |diff|" << "speedup\n";
+
+	std::vector<double> reference(samples), outputs(samples);
+	std::vector<double> inputVals(2), resultVals;
+	double baseline = row("Net feedForward", samples, reference, reference, 0.0, [&](size_t i){
+		inputVals.assign(&inputs[2 * i], &inputs[2 * i + 2]);
+		net.feedForward(inputVals);
+		net.getResults(resultVals);
+		reference[i] = resultVals[0];
+	});
+	std::vector<float> row32(2);
+	float out32;
+	row("Net predictBatch(1)", samples, outputs, reference, baseline, [&](size_t i){
+		row32[0] = inputs[2 * i];
+		row32[1] = inputs[2 * i + 1];
+		net.predictBatch(row32.data(), 1, &out32);
+		outputs[i] = out32;
+	});
+	row("StaticNet feedForward", samples, outputs, reference, baseline, [&](size_t i){
+		fixed.feedForward(&inputs[2 * i]);
+		fixed.getResults(&outputs[i]);
+	});
+	row("StaticNet predict", samples, outputs, reference, baseline, [&](size_t i){
+		fixed.predict(&inputs[2 * i], &outputs[i]);
+	});
+
+	// Training: the same sample sequence through both; the diff column
+	// compares the final weights.
+	std::vector<double> targetVals(1), netWeights, fixedWeights(fixed.numParameters);
+	baseline = row("Net train", samples, netWeights, netWeights, 0.0, [&](size_t i){
+		inputVals.assign(&inputs[2 * i], &inputs[2 * i + 2]);
+		targetVals[0] = targets[i];
+		net.feedForward(inputVals);
+		net.backProp(targetVals);
+	});
+	netWeights.assign(net.parameters(), net.parameters() + fixed.numParameters);
+	row("StaticNet train", samples, fixedWeights, netWeights, baseline, [&](size_t i){
+		fixed.feedForward(&inputs[2 * i]);
+		fixed.backProp(&targets[i]);
+		if(i + 1 == samples)
+			std::copy(fixed.parameters(), fixed.parameters() + fixed.numParameters, fixedWeights.begin());
+	});
+	std::cerr << "(sink " << g_sink << ")\n";
+}
@@ -1,332 +1,376 @@
-#include<bits/stdc++.h>
-
-class TrainingData{
-public:
-	TrainingData(const std::string filename);
-	bool isEof(void) {
-		return m_trainingDataFile.eof();
-	}
-	void getTopology(std::vector<unsigned> &topology);
-	unsigned getNextInputs(std::vector<double> &inputVals);
-	unsigned getTargetOutputs(std::vector<double> &targetOutputVals);
-private:
-	std::ifstream m_trainingDataFile;
-};
-
-void TrainingData::getTopology(std::vector<unsigned> &topology){
-	std::string line, label;
-
-	getline(m_trainingDataFile, line);
-	std::stringstream ss(line);
-	ss >> label;
-	if(this->isEof() || label.compare("topology:") != 0)
-		abort();
-	while(!ss.eof()){
-		unsigned n;
-		ss >> n;
-		topology.push_back(n);
-	}
-	return;
-}
-
-TrainingData::TrainingData(const std::string filename){
-	m_trainingDataFile.open(filename.c_str());
-}
-
-
-unsigned TrainingData::getNextInputs(std::vector<double> &inputVals){
-    inputVals.clear();
-    std::string line, label;
-    getline(m_trainingDataFile, line);
-    std::stringstream ss(line);
-    ss >> label;
-    if (label.compare("in:") == 0) {
-        double oneValue;
-        while (ss >> oneValue) 
-            inputVals.push_back(oneValue);
-    }
-    return inputVals.size();
-}
-
-unsigned TrainingData::getTargetOutputs(std::vector<double> &targetOutputVals){
-    targetOutputVals.clear();
-    std::string line, label;
-    getline(m_trainingDataFile, line);
-    std::stringstream ss(line);
-    ss>> label;
-    if (label.compare("out:") == 0) {
-        double oneValue;
-        while (ss >> oneValue) 
-            targetOutputVals.push_back(oneValue);
-    }
-    return targetOutputVals.size();
-}
-
-struct Connection {double weight, deltaWeight;};
-class Neuron;
-typedef std::vector<Neuron> Layer;
-class Neuron {
-public:
-	Neuron(unsigned numOutputs, unsigned myIndex);
-	void setOutputVal(double val) { m_outputVal = val; }
-	double getOutputVal(void) const { return m_outputVal; }
-	void feedForward(const Layer &prevLayer, int layernum, int totalLayer);
-	void calcOutputGradients(double targetVals);
-	void calcHiddenGradients(const Layer &nextLayer);
-	void updateInputWeights(Layer &prevLayer);
-	
-private:
-	static double sigmoid(double x);
-	static double sigmoidDerivative(double x);
-	static double transferFunction(double x);
-	static double transferFunctionDerivative(double x);
-	static double randomWeight(void) { return rand() / double(RAND_MAX); }
-	double sumDOW(const Layer &nextLayer) const;
-	double m_outputVal;
-	std::vector<Connection> m_outputWeights;
-	unsigned m_myIndex;
-	double m_gradient;
-};
-
-#define eta 0.15
-#define alpha 0.5
-
-void Neuron::updateInputWeights(Layer &prevLayer){
-	unsigned size = prevLayer.size();
-	for(unsigned i = 0; i < size; i++){
-		Neuron &neuron = prevLayer[i];
-		double oldDeltaWeight = neuron.m_outputWeights[m_myIndex].deltaWeight;
-		double newDeltaWeight = eta * neuron.getOutputVal() * m_gradient + alpha * oldDeltaWeight;
-		neuron.m_outputWeights[m_myIndex].deltaWeight = newDeltaWeight;
-		neuron.m_outputWeights[m_myIndex].weight += newDeltaWeight;
-	}
-}
-
-double Neuron::sumDOW(const Layer &nextLayer) const{
-	double sum = 0.0;
-	unsigned size = nextLayer.size();
-	for (unsigned i = 0; i < size - 1; i++)
-		sum += m_outputWeights[i].weight * nextLayer[i].m_gradient;
-	return sum;
-}
-
-void Neuron::calcHiddenGradients(const Layer &nextLayer){
-	double dow = sumDOW(nextLayer);
-	m_gradient = dow * Neuron::transferFunctionDerivative(m_outputVal);
-}
-
-double Neuron::sigmoid(double x){return 1.0 / (1.0 + exp(-x));}
-double Neuron::sigmoidDerivative(double x){return x * (1.0 - x);}
-
-void Neuron::calcOutputGradients(double targetVals){
-	double delta = targetVals - m_outputVal;
-	m_gradient = delta * Neuron::transferFunctionDerivative(m_outputVal);
-}
-
-double Neuron::transferFunction(double x){return sigmoid(x);}
-double Neuron::transferFunctionDerivative(double x){return sigmoidDerivative(x);}
-
-void Neuron::feedForward(const Layer &prevLayer, int layernum, int totalLayer){
-	double sum = 0.0;
-	for(unsigned i = 0 ; i < prevLayer.size(); i++){
-		sum += prevLayer[i].getOutputVal() * 
-				 prevLayer[i].m_outputWeights[m_myIndex].weight;
-	}
-	m_outputVal = Neuron::transferFunction(sum);
+#include "NeuralNetworkGUI/all_class.h"
+#include "NeuralNetworkGUI/parallel_trainer.h"
+#include "NeuralNetworkGUI/prefetch_loader.h"
+#include "NeuralNetworkGUI/epoch_trainer.h"
+#include "NeuralNetworkGUI/logger.h"
+#include "NeuralNetworkGUI/evaluator.h"
+#include "NeuralNetworkGUI/checkpoint.h"
+#include "NeuralNetworkGUI/profiler.h"
+#include "NeuralNetworkGUI/normalizer.h"
+
+void showPipelineStats(Logger &log, std::string label, const PipelineStats &stats){
+	std::ostringstream line;
+	line << label << " loader: " << stats.samples << " samples in " << stats.batches << " batches, "
+	     << "parsing " << stats.producerBusySeconds << "s, "
+	     << "loader waited " << stats.producerStallSeconds << "s, "
+	     << "trainer waited " << stats.consumerStallSeconds << "s ("
+	     << (stats.consumerStallSeconds > stats.producerStallSeconds ? "input-bound" : "compute-bound")
+	     << ")";
+	log.text(LOG_INFO, line.str());
 }
 
-Neuron::Neuron(unsigned numOutputs, unsigned myIndex)
-{
-	for(unsigned c = 0; c < numOutputs; ++c){
-		m_outputWeights.push_back(Connection());
-		m_outputWeights.back().weight = randomWeight();
+// One record per row, so a matrix of any size fits the logger's records.
+void showConfusionMatrix(Logger &log, const ConfusionMatrix &confusion){
+	log.text(LOG_INFO, "Confusion matrix (rows: target, columns: prediction)");
+	for(unsigned t = 0; t < confusion.numClasses; t++){
+		std::ostringstream row;
+		for(unsigned p = 0; p < confusion.numClasses; p++)
+			row << std::setw(10) << confusion.at(t, p);
+		log.text(LOG_INFO, row.str());
 	}
-
-	m_myIndex = myIndex;
 }
-// ****************** class Net ******************
-class Net{
-public:
-	Net(const std::vector<unsigned> &topology);
-	void feedForward(const std::vector<double> &inputVals);
-	void backProp(const std::vector<double> &targetVals);
-	void getResults(std::vector<double> &resultVals) const;
-	double getRecentAverageloss(void) const { return m_recentAverageloss; }
-private:
-	std::vector<Layer> m_layers; 
-	double m_loss;
-	double m_recentAverageloss;
-	static double m_recentAverageSmoothingFactor;
-};
 
-double Net::m_recentAverageSmoothingFactor = 100.0; 
-void Net::getResults(std::vector<double> &resultVals) const{
-	resultVals.clear();
-	unsigned size = m_layers.back().size();
-	for(unsigned i = 0; i < size - 1; i++)
-		resultVals.push_back(m_layers.back()[i].getOutputVal());
+// Progress (and a periodic checkpoint) after a batch of count samples
+// ending at sample.
+void logBatch(Logger &log, unsigned long long sample, unsigned count, int batchNum, const Net &net,
+              CheckpointWriter *checkpoints, unsigned checkpointEvery){
+	if(checkpoints != NULL && sample / checkpointEvery != (sample - count) / checkpointEvery)
+		checkpoints->save(net, sample);
+	if(!log.sampled(sample, count))
+		return;
+	double loss = net.getRecentAverageloss();
+	log.values(LOG_INFO, "Batch%llu Net recent average loss", batchNum, &loss, 1);
+	log.metric("train", sample, loss, NAN);
 }
 
-void Net::backProp(const std::vector<double> &targetVals){
-	Layer &outputLayer = m_layers.back();
-	m_loss = 0.0;
-	unsigned size = outputLayer.size();
-	for(unsigned i = 0; i < size - 1; i++){
-		double delta = targetVals[i] - outputLayer[i].getOutputVal();
-		m_loss += delta *delta;
-	}
-	m_loss /= outputLayer.size() - 1; 
-	m_loss = sqrt(m_loss); 
-	m_recentAverageloss = 
-			(m_recentAverageloss * m_recentAverageSmoothingFactor + m_loss)
-			/ (m_recentAverageSmoothingFactor + 1.0);
-	for(unsigned i = 0; i < size - 1; i++)
-		outputLayer[i].calcOutputGradients(targetVals[i]);
-	for(unsigned layerNum = m_layers.size() - 2; layerNum > 0; layerNum--){
-		Layer &hiddenLayer = m_layers[layerNum];
-		Layer &nextLayer = m_layers[layerNum + 1];
-		unsigned size = hiddenLayer.size();
-		for(unsigned i = 0; i < size; i++)
-			hiddenLayer[i].calcHiddenGradients(nextLayer);
-	}
-
-	for(unsigned layerNum = m_layers.size() - 1; layerNum > 0; --layerNum){
-		Layer &layer = m_layers[layerNum];
-		Layer &prevLayer = m_layers[layerNum - 1];
-		unsigned size = layer.size();
-		for(unsigned i = 0; i < size - 1; i++)
-			layer[i].updateInputWeights(prevLayer);
-	}
-}
-
-void Net::feedForward(const std::vector<double> &inputVals){
-	assert(inputVals.size() == m_layers[0].size() - 1);
-	unsigned size = inputVals.size();
-	for(unsigned i = 0; i < size; i++)
-		m_layers[0][i].setOutputVal(inputVals[i]); 
-	for(unsigned layerNum = 1; layerNum < m_layers.size(); ++layerNum){
-		Layer &prevLayer = m_layers[layerNum - 1];
-		unsigned size = m_layers[layerNum].size();
-		for(unsigned i = 0; i < size - 1; i++){
-			m_layers[layerNum][i].feedForward(prevLayer, layerNum, m_layers.size() - 1);
+int main(int argc, char *argv[]){
+	// --batch N trains on mini-batches of N samples instead of one at a time
+	// --threads T shards every mini-batch across T threads (0 = all cores)
+	// --hogwild lets those threads update the weights without synchronising
+	// --prefetch D reads and parses ahead on a background thread, D batches deep
+	// --epochs N trains N shuffled epochs from an in-memory copy of the data,
+	//   with --holdout F, --patience P and --memory-budget MB (see EpochOptions)
+	// --verbose L: 0 results only, 1 progress (default), 2 per-sample values
+	// --log-every N prints progress once every N samples (default 1000)
+	// --metrics FILE writes loss/accuracy curves as JSON lines, or CSV for *.csv
+	// --save FILE writes the trained model as a checkpoint (see checkpoint.h),
+	//   and every N samples in the background with --checkpoint-every N
+	// --resume FILE continues training from a checkpoint, skipping the samples
+	//   it had already seen; --load FILE only tests the model, no training
+	// --optimizer sgd|nesterov|adam|adamw|rmsprop picks the update rule, with
+	//   --lr, --momentum, --beta1, --beta2, --rms-decay, --epsilon and
+	//   --weight-decay; --lr-schedule constant|step|exponential|cosine with
+	//   --decay-steps, --decay-rate, --min-lr and --warmup (see optimizer.h).
+	//   A resumed checkpoint keeps its own optimizer unless one of these is given.
+	// --normalize standard|minmax rescales every input with statistics from one
+	//   pass over the training file before training (see normalizer.h); the
+	//   scaling is part of the model, saved with it and applied when testing.
+	//   A resumed checkpoint keeps the scaling it was trained with.
+	// --profile prints per-phase and per-layer times, sample rates and
+	//   allocation counts at the end; --profile-trace FILE also writes every
+	//   timed scope as Chrome trace JSON. Both need a -DNN_PROFILE build.
+	unsigned batchSize = 0, numThreads = 1, prefetchDepth = 0;
+	unsigned verbosity = LOG_INFO, logEvery = 1000, checkpointEvery = 0;
+	const char *metricsFile = NULL, *saveFile = NULL, *resumeFile = NULL, *traceFile = NULL;
+	bool loadOnly = false, profile = false;
+	ScalingKind scalingKind = SCALING_NONE;
+	EpochOptions epochOptions;
+	epochOptions.maxEpochs = 0;
+	bool hogwild = false;
+	OptimizerConfig optimizer;
+	bool optimizerGiven = false, rateGiven = false;
+	for(int i = 1; i < argc; i++){
+		bool optimizerFlag = true;
+		if(strcmp(argv[i], "--optimizer") == 0 && i + 1 < argc){
+			if(!optimizerFromName(argv[++i], optimizer.kind)){
+				std::cerr << "unknown optimizer " << argv[i] << '\n';
+				return 1;
+			}
+		} else if(strcmp(argv[i], "--lr-schedule") == 0 && i + 1 < argc){
+			if(!scheduleFromName(argv[++i], optimizer.schedule)){
+				std::cerr << "unknown learning rate schedule " << argv[i] << '\n';
+				return 1;
+			}
+		} else if(strcmp(argv[i], "--lr") == 0 && i + 1 < argc){
+			optimizer.learningRate = atof(argv[++i]);
+			rateGiven = true;
+		} else if(strcmp(argv[i], "--momentum") == 0 && i + 1 < argc)
+			optimizer.momentum = atof(argv[++i]);
+		else if(strcmp(argv[i], "--beta1") == 0 && i + 1 < argc)
+			optimizer.beta1 = atof(argv[++i]);
+		else if(strcmp(argv[i], "--beta2") == 0 && i + 1 < argc)
+			optimizer.beta2 = atof(argv[++i]);
+		else if(strcmp(argv[i], "--rms-decay") == 0 && i + 1 < argc)
+			optimizer.rmsDecay = atof(argv[++i]);
+		else if(strcmp(argv[i], "--epsilon") == 0 && i + 1 < argc)
+			optimizer.epsilon = atof(argv[++i]);
+		else if(strcmp(argv[i], "--weight-decay") == 0 && i + 1 < argc)
+			optimizer.weightDecay = atof(argv[++i]);
+		else if(strcmp(argv[i], "--decay-steps") == 0 && i + 1 < argc)
+			optimizer.decaySteps = strtoull(argv[++i], NULL, 10);
+		else if(strcmp(argv[i], "--decay-rate") == 0 && i + 1 < argc)
+			optimizer.decayRate = atof(argv[++i]);
+		else if(strcmp(argv[i], "--min-lr") == 0 && i + 1 < argc)
+			optimizer.minLearningRate = atof(argv[++i]);
+		else if(strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+			optimizer.warmupSteps = strtoull(argv[++i], NULL, 10);
+		else
+			optimizerFlag = false;
+		if(optimizerFlag){
+			optimizerGiven = true;
+			continue;
 		}
-	}
-}
 
-Net::Net(const std::vector<unsigned> &topology){
-	unsigned numLayers = topology.size();
-	for(unsigned layerNum = 0; layerNum < numLayers; ++layerNum){
-		m_layers.push_back(Layer());
-		unsigned numOutputs = layerNum == topology.size() - 1 ? 0 :topology[layerNum + 1];
-		for(unsigned neuronNum = 0; neuronNum <= topology[layerNum]; ++neuronNum){
-			m_layers.back().push_back(Neuron(numOutputs, neuronNum));
-			std::cout << "Mad a Neuron!" << '\n';
+		if(strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+			batchSize = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			numThreads = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--hogwild") == 0)
+			hogwild = true;
+		else if(strcmp(argv[i], "--prefetch") == 0 && i + 1 < argc)
+			prefetchDepth = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--epochs") == 0 && i + 1 < argc)
+			epochOptions.maxEpochs = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--holdout") == 0 && i + 1 < argc)
+			epochOptions.holdoutFraction = atof(argv[++i]);
+		else if(strcmp(argv[i], "--patience") == 0 && i + 1 < argc)
+			epochOptions.patience = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--memory-budget") == 0 && i + 1 < argc)
+			epochOptions.memoryBudget = (size_t)(atof(argv[++i]) * 1024 * 1024);
+		else if(strcmp(argv[i], "--verbose") == 0 && i + 1 < argc)
+			verbosity = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--log-every") == 0 && i + 1 < argc)
+			logEvery = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--metrics") == 0 && i + 1 < argc)
+			metricsFile = argv[++i];
+		else if(strcmp(argv[i], "--save") == 0 && i + 1 < argc)
+			saveFile = argv[++i];
+		else if(strcmp(argv[i], "--checkpoint-every") == 0 && i + 1 < argc)
+			checkpointEvery = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--normalize") == 0 && i + 1 < argc){
+			if(!scalingFromName(argv[++i], scalingKind)){
+				std::cerr << "unknown scaling " << argv[i] << '\n';
+				return 1;
+			}
+		} else if(strcmp(argv[i], "--profile") == 0)
+			profile = true;
+		else if(strcmp(argv[i], "--profile-trace") == 0 && i + 1 < argc){
+			profile = true;
+			traceFile = argv[++i];
+		} else if((strcmp(argv[i], "--resume") == 0 || strcmp(argv[i], "--load") == 0) && i + 1 < argc){
+			loadOnly = strcmp(argv[i], "--load") == 0;
+			resumeFile = argv[++i];
 		}
-		m_layers.back().back().setOutputVal(1.0);
-	}
-}
-
-void showVectorVals(std::string label, std::vector<double> &v){
-	std::cout << label << " ";
-	unsigned size = v.size();
-	for(unsigned i = 0; i < size; i++)
-		std::cout << v[i] << " ";
-	std::cout << '\n';
-}
-
-class TestData{
-public:
-	TestData(const std::string filename);
-	bool isEof(void) { return testfile.eof(); }
-	unsigned getNextInputs(std::vector<double> &inputVals);
-	unsigned getTargetOutputs(std::vector<double> &targetOutputVals);
-	std::ifstream testfile;
-};
-
-TestData::TestData(const std::string filename){
-	testfile.open(filename.c_str());
-}
-
-unsigned TestData::getNextInputs(std::vector<double> &inputVals){
-	inputVals.clear();
-	std::string line, label;
-	getline(testfile, line);
-	std::stringstream ss(line);
-	ss >> label;
-	if(label.compare("in:") == 0){
-		double oneValue;
-		while(ss >> oneValue)
-			inputVals.push_back(oneValue);
 	}
-	return inputVals.size();
-}
+	if(profile && !profileEnabled())
+		std::cerr << "--profile: this build has no profiling, rebuild with -DNN_PROFILE (make PROFILE=1)\n";
+	if(traceFile != NULL)
+		profileStartTrace();
+	Logger log((LogLevel)std::min(verbosity, (unsigned)LOG_DEBUG), logEvery);
+	if(metricsFile != NULL && !log.openMetrics(metricsFile))
+		std::cerr << "cannot write " << metricsFile << '\n';
+	if((numThreads != 1 || hogwild) && batchSize == 0)
+		batchSize = 256;
+	if(!rateGiven)
+		optimizer.learningRate = optimizerInfo(optimizer.kind).defaultRate;
 
-unsigned TestData::getTargetOutputs(std::vector<double> &targetOutputVals){
-	targetOutputVals.clear();
-	std::string line, label;
-	getline(testfile, line);
-	std::stringstream ss(line);
-	ss >> label;
-	if(label.compare("out:") == 0){
-		double oneValue;
-		while(ss >> oneValue)
-			targetOutputVals.push_back(oneValue);
-	}
-	return targetOutputVals.size();
-}
-
-int main(){
 	TrainingData trainData("trainingData.txt");
 	std::vector<unsigned> topology;
+	std::vector<ActivationKind> activations;
 
 	trainData.getTopology(topology);
-	Net myNet(topology);
+	trainData.getActivations(activations);
+	CheckpointHeader resumed;
+	memset(&resumed, 0, sizeof(resumed));
+	std::unique_ptr<Net> loaded;
+	if(resumeFile != NULL){
+		loaded = loadCheckpoint(resumeFile, &resumed);
+		std::vector<unsigned> loadedTopology;
+		std::vector<ActivationKind> loadedActivations;
+		if(loaded){
+			loaded->getTopology(loadedTopology);
+			loaded->getActivations(loadedActivations);
+		}
+		if(!loaded || loadedTopology != topology || loadedActivations != activations){
+			std::cerr << resumeFile << " is not a checkpoint for this topology\n";
+			return 1;
+		}
+		if(loadOnly)
+			log.text(LOG_INFO, std::string("Loaded ") + resumeFile);
+		else
+			log.text(LOG_INFO, std::string("Resuming from ") + resumeFile + " after "
+			         + std::to_string(resumed.samplesSeen) + " samples");
+	}
+	Net myNet = loaded ? std::move(*loaded) : Net(topology, activations);
+	loaded.reset();
+	if(optimizerGiven || !resumeFile)
+		myNet.setOptimizer(optimizer);
+	std::unique_ptr<CheckpointWriter> checkpoints;
+	if(saveFile != NULL && checkpointEvery > 0)
+		checkpoints.reset(new CheckpointWriter(saveFile));
+	ThreadPool pool(numThreads);
+	if(scalingKind != SCALING_NONE && resumeFile == NULL){
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		FeatureStats stats;
+		computeFeatureStats("trainingData.txt", pool, stats);
+		myNet.setInputScaling(inputScaling(stats, scalingKind));
+		std::ostringstream line;
+		line << "Input scaling: " << scalingName(scalingKind) << " over " << stats.count << " samples in "
+		     << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << "s";
+		log.text(LOG_INFO, line.str());
+	}
+	ParallelTrainer trainer(myNet, pool);
+	trainer.setHogwild(hogwild);
 
 	std::vector<double> inputVals, targetVals, resultVals;
-	int trainingPass = 0;
-	while(!trainData.isEof()){
+	if(loadOnly)
+		batchSize = 0;
+	const MappedDataset *binary = trainData.binaryData();
+	bool zeroCopy = batchSize > 0 && binary != NULL && binary->header().dtype == DATASET_FLOAT64;
+	bool epochs = epochOptions.maxEpochs > 0 && !loadOnly;
+	// Skip what the checkpoint was trained on; the mapped binary path just
+	// starts further in.
+	unsigned long long samplesDone = loadOnly || epochs ? 0 : resumed.samplesSeen;
+	for(unsigned long long i = 0; i < samplesDone && !zeroCopy && !trainData.isEof(); i++){
+		trainData.getNextInputs(inputVals);
+		trainData.getTargetOutputs(targetVals);
+	}
+	std::unique_ptr<PrefetchLoader> trainLoader;
+	if(prefetchDepth > 0 && !zeroCopy && !epochs && !loadOnly)
+		trainLoader.reset(new PrefetchLoader(trainData, topology.front(), topology.back(),
+		                                     batchSize > 0 ? batchSize : 64, prefetchDepth));
+	SampleSource &trainSource = trainLoader ? (SampleSource &)*trainLoader : (SampleSource &)trainData;
+	if(epochs){
+		epochOptions.batchSize = std::max(1u, batchSize);
+		EpochTrainer epochTrainer(myNet, trainer, epochOptions);
+		epochTrainer.train("trainingData.txt", [&log](const EpochReport &r){
+			std::ostringstream line;
+			line << "Epoch" << r.epoch << (r.streaming ? " (streamed)" : "")
+			     << " Net recent average loss: " << r.recentAverageLoss
+			     << " validation loss: " << r.validationLoss
+			     << " validation accuracy: " << r.validationAccuracy
+			     << (r.improved ? " *" : "") << " " << r.seconds << "s";
+			log.text(LOG_INFO, line.str());
+			log.metric("epoch", r.epoch, r.recentAverageLoss, NAN);
+			log.metric("validation", r.epoch, r.validationLoss, r.validationAccuracy);
+		});
+	} else if(zeroCopy){
+		// binary input: every batch is a view straight into the mapped file
+		int batchNum = 0;
+		for(size_t first = samplesDone; first < binary->size(); first += batchSize){
+			unsigned inBatch = std::min<size_t>(batchSize, binary->size() - first);
+			trainer.trainBatch(binary->inputs(first), binary->targets(first), inBatch);
+			samplesDone = first + inBatch;
+			logBatch(log, samplesDone, inBatch, ++batchNum, myNet, checkpoints.get(), checkpointEvery);
+		}
+	} else if(batchSize > 0 && trainLoader){
+		int batchNum = 0;
+		const MiniBatch *batch;
+		while((batch = trainLoader->nextBatch()) != NULL){
+			trainer.trainBatch(batch->inputs.data(), batch->targets.data(), batch->size);
+			samplesDone += batch->size;
+			logBatch(log, samplesDone, batch->size, ++batchNum, myNet, checkpoints.get(), checkpointEvery);
+		}
+	} else if(batchSize > 0){
+		std::vector<double> batchInputs, batchTargets;
+		unsigned inBatch = 0;
+		int batchNum = 0;
+		while(true){
+			bool more = !trainData.isEof() && trainData.getNextInputs(inputVals) == topology[0];
+			if(more){
+				trainData.getTargetOutputs(targetVals);
+				assert(targetVals.size() == topology.back());
+				batchInputs.insert(batchInputs.end(), inputVals.begin(), inputVals.end());
+				batchTargets.insert(batchTargets.end(), targetVals.begin(), targetVals.end());
+				inBatch++;
+			}
+			if(inBatch == batchSize || (!more && inBatch > 0)){
+				trainer.trainBatch(batchInputs, batchTargets, inBatch);
+				samplesDone += inBatch;
+				logBatch(log, samplesDone, inBatch, ++batchNum, myNet, checkpoints.get(), checkpointEvery);
+				batchInputs.clear();
+				batchTargets.clear();
+				inBatch = 0;
+			}
+			if(!more)
+				break;
+		}
+	}
+	unsigned long long trainingPass = samplesDone;
+	while(batchSize == 0 && !epochs && !loadOnly && !trainSource.isEof()){
 		++trainingPass;
-		std::cout << '\n' << "Pass" << trainingPass;
-		if(trainData.getNextInputs(inputVals) != topology[0])
+		if(trainSource.getNextInputs(inputVals) != topology[0])
 			break;
-		showVectorVals(": Inputs :", inputVals);
 		myNet.feedForward(inputVals);
 		myNet.getResults(resultVals);
-		showVectorVals("Outputs:", resultVals);
-
-		trainData.getTargetOutputs(targetVals);
-		showVectorVals("Targets:", targetVals);
+		trainSource.getTargetOutputs(targetVals);
 		assert(targetVals.size() == topology.back());
 
 		myNet.backProp(targetVals);
-
-		std::cout << "Net recent average loss: "
-		     << myNet.getRecentAverageloss() << '\n';
+		samplesDone = trainingPass;
+
+		if(checkpoints && trainingPass % checkpointEvery == 0)
+			checkpoints->save(myNet, trainingPass);
+		if(log.sampled(trainingPass)){
+			double loss = myNet.getRecentAverageloss();
+			log.values(LOG_DEBUG, "Pass%llu Inputs", trainingPass, inputVals);
+			log.values(LOG_DEBUG, "Pass%llu Outputs", trainingPass, resultVals);
+			log.values(LOG_DEBUG, "Pass%llu Targets", trainingPass, targetVals);
+			log.values(LOG_INFO, "Pass%llu Net recent average loss", trainingPass, &loss, 1);
+			log.metric("train", trainingPass, loss, NAN);
+		}
 	}
 
-	std::cout << '\n' << "Done" << '\n';
+	if(saveFile != NULL && !loadOnly){
+		// The background writer owns the file while it runs, so the final
+		// save goes through it too.
+		if(checkpoints)
+			checkpoints->save(myNet, samplesDone);
+		bool saved = checkpoints ? checkpoints->wait() : saveCheckpoint(myNet, saveFile, samplesDone);
+		if(!saved)
+			std::cerr << "cannot write " << saveFile << '\n';
+	}
+	log.text(LOG_INFO, "Done");
+	if(trainLoader)
+		showPipelineStats(log, "Training", trainLoader->stats());
 
 	TestData testData("testData.txt");
-	int cnt = 0;
-	double totac = 0;
-	while(!testData.isEof()){
-		cnt++;
-		std::cout << cnt << '\n';
-		if(testData.getNextInputs(inputVals) != topology[0])
-			break;
-		myNet.feedForward(inputVals);
-
-		myNet.getResults(resultVals);
-
-		testData.getTargetOutputs(targetVals);
-		if(resultVals[0] > 0.5)
-			resultVals[0] = 1;
-		else 
-			resultVals[0] = 0;
-		showVectorVals("Target", targetVals);
-		showVectorVals("Results:", resultVals);
-		if(resultVals[0] == targetVals[0])
-			totac++;
+	std::unique_ptr<PrefetchLoader> testLoader;
+	if(prefetchDepth > 0)
+		testLoader.reset(new PrefetchLoader(testData, topology.front(), topology.back(), 256, prefetchDepth));
+	SampleSource &testSource = testLoader ? (SampleSource &)*testLoader : (SampleSource &)testData;
+	// Scored in blocks: predictBatch spreads each block across the pool and
+	// accumulates accuracy and the confusion matrix as it goes.
+	const unsigned testBlock = 1 << 16;
+	unsigned numInputs = topology.front(), numOutputs = topology.back();
+	std::vector<float> testInputs((size_t)testBlock * numInputs), testTargets((size_t)testBlock * numOutputs);
+	std::vector<float> predictions((size_t)testBlock * numOutputs);
+	Evaluator evaluator(myNet, pool);
+	unsigned long long tested = 0;
+	unsigned n;
+	while((n = readSamples(testSource, numInputs, numOutputs, testBlock, testInputs.data(), testTargets.data())) > 0){
+		evaluator.evaluate(testInputs.data(), testTargets.data(), n, predictions.data());
+		for(unsigned b = 0; log.enabled(LOG_DEBUG) && b < n; b++){
+			if(!log.sampled(tested + b + 1))
+				continue;
+			resultVals.assign(&predictions[(size_t)b * numOutputs], &predictions[(size_t)(b + 1) * numOutputs]);
+			targetVals.assign(&testTargets[(size_t)b * numOutputs], &testTargets[(size_t)(b + 1) * numOutputs]);
+			log.values(LOG_DEBUG, "Test%llu Target", tested + b + 1, targetVals);
+			log.values(LOG_DEBUG, "Test%llu Results", tested + b + 1, resultVals);
+		}
+		tested += n;
+	}
+	const EvalMetrics &metrics = evaluator.metrics();
+	double accuracy = metrics.accuracy();
+	log.values(LOG_QUIET, "Accuracy", 0, &accuracy, 1);
+	showConfusionMatrix(log, metrics.confusion);
+	log.metric("test", metrics.samples, metrics.meanLoss(), accuracy);
+	if(testLoader)
+		showPipelineStats(log, "Test", testLoader->stats());
+	if(profile && profileEnabled()){
+		log.flush();
+		writeProfileSummary(std::cerr);
+		if(traceFile != NULL && !writeProfileTrace(traceFile))
+			std::cerr << "cannot write " << traceFile << '\n';
 	}
-	std::cout << "Accuracy: " << totac / cnt << '\n';
 }
\ No newline at end of file
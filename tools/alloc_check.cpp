@@ -0,0 +1,220 @@
+// Checks that the steady-state training and inference loops make no heap
+// allocations. Every loop runs a few warm-up iterations (where workspaces
+// may still grow), then the counted ones; any operator new among those is
+// a failure:
+//
+//   per-sample   feedForward + getResults + backProp, Net and FloatNet,
+//                SGD and Adam, as the command line's default loop runs them
+//   parse        TrainingData reading in:/out: pairs from a text file
+//   batch        Net::trainBatch and ParallelTrainer, synchronous and hogwild
+//   inference    predictBatch (thread-local and caller workspace), Evaluator
+//
+// It also builds a small and a large topology: both must take the same,
+// small number of allocations (the layer table and the arena), so
+// construction costs one zero fill however many neurons there are. Moving
+// a built Net to Adam adds exactly one (the arena, re-laid out with the
+// second moment in it), and copying an Adam Net takes no more than building
+// a plain one. Exits 1 if any check fails.
+//
+//   make alloc_check          (or the g++ line below)
+//   g++ -O2 -pthread -o alloc_check tools/alloc_check.cpp NeuralNetworkGUI/parallel_trainer.cpp NeuralNetworkGUI/evaluator.cpp NeuralNetworkGUI/all_class.cpp NeuralNetworkGUI/activations.cpp NeuralNetworkGUI/optimizer.cpp NeuralNetworkGUI/kernels.cpp NeuralNetworkGUI/gemm.cpp NeuralNetworkGUI/dataset.cpp NeuralNetworkGUI/text_reader.cpp NeuralNetworkGUI/thread_pool.cpp NeuralNetworkGUI/normalizer.cpp
+//   ./alloc_check [--iterations N]
+#include<bits/stdc++.h>
+#include<unistd.h>
+#include "../NeuralNetworkGUI/all_class.h"
+#include "../NeuralNetworkGUI/parallel_trainer.h"
+#include "../NeuralNetworkGUI/evaluator.h"
+#include "../NeuralNetworkGUI/kernels.h"
+#include "../NeuralNetworkGUI/profiler.h"
+
+// Allocations a Net may make while being built, whatever its size.
+#define CONSTRUCTION_ALLOCATIONS 2
+// Iterations each loop runs before counting starts.
+#define WARMUP 3
+
+#ifdef NN_PROFILE
+// The profiler already counts every operator new.
+static unsigned long long allocationCount(void) { return profileTotal(PROFILE_ALLOCATIONS); }
+#else
+static std::atomic<unsigned long long> g_allocations(0);
+
+void *operator new(size_t size){
+	g_allocations++;
+	if(void *p = malloc(size))
+		return p;
+	throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+static unsigned long long allocationCount(void) { return g_allocations; }
+#endif
+
+static bool g_ok = true;
+
+// Runs body WARMUP times, then iterations times counting allocations, and
+// prints the result.
+template<class F>
+static void check(const char *name, unsigned iterations, F body){
+	for(unsigned i = 0; i < WARMUP; i++)
+		body(i);
+	unsigned long long before = allocationCount();
+	for(unsigned i = 0; i < iterations; i++)
+		body(WARMUP + i);
+	unsigned long long allocations = allocationCount() - before;
+	std::cout << std::setw(36) << name << std::setw(14) << allocations
+	          << (allocations == 0 ? "ok" : "ALLOCATES") << '\n';
+	if(allocations != 0)
+		g_ok = false;
+}
+
+// Allocations and milliseconds build takes to make a Net.
+template<class F>
+static unsigned long long construct(F build, double &ms){
+	unsigned long long before = allocationCount();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	{
+		Net net = build();
+		ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		before = allocationCount() - before;
+	}
+	return before;
+}
+
+int main(int argc, char *argv[]){
+	unsigned iterations = 1000;
+	for(int i = 1; i < argc; i++)
+		if(strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+			iterations = std::max(1, atoi(argv[++i]));
+
+	std::vector<unsigned> topology = {16, 32, 16, 4};
+	std::vector<ActivationKind> activations = {ACTIVATION_SIGMOID, ACTIVATION_RELU, ACTIVATION_TANH, ACTIVATION_SIGMOID};
+	unsigned numInputs = topology.front(), numOutputs = topology.back();
+	const unsigned samples = 1024, batchSize = 32;
+	std::mt19937 rng(1);
+	std::vector<double> inputs((size_t)samples * numInputs), targets((size_t)samples * numOutputs);
+	for(size_t i = 0; i < inputs.size(); i++)
+		inputs[i] = rng() % 1000 / 1000.0;
+	for(size_t i = 0; i < targets.size(); i++)
+		targets[i] = rng() % 2;
+	std::vector<float> inputs32(inputs.begin(), inputs.end()), targets32(targets.begin(), targets.end());
+	std::vector<float> outputs32((size_t)samples * numOutputs);
+
+	std::cout << "kernels: " << kernels().name << ", " << iterations << " iterations per loop\n\n";
+	std::cout << std::left << std::setw(36) << "construction" << std::setw(14) << "allocations" << "ms\n";
+	std::vector<std::vector<unsigned> > sizes = {{2, 8, 1}, {512, 1024, 1024, 10}};
+	OptimizerConfig adamConfig;
+	adamConfig.kind = OPTIMIZER_ADAM;
+	// Plain, moved to Adam, and a copy of an Adam Net; the most each may take.
+	const char *builds[] = {"", ", adam", ", adam copy"};
+	const unsigned long long limits[] = {CONSTRUCTION_ALLOCATIONS, CONSTRUCTION_ALLOCATIONS + 1, CONSTRUCTION_ALLOCATIONS};
+	for(unsigned b = 0; b < 3; b++){
+		std::vector<unsigned long long> counts;
+		for(size_t s = 0; s < sizes.size(); s++){
+			const std::vector<unsigned> &topology = sizes[s];
+			Net adamNet(topology);
+			adamNet.setOptimizer(adamConfig);
+			double ms;
+			if(b == 0)
+				counts.push_back(construct([&]{ return Net(topology); }, ms));
+			else if(b == 1)
+				counts.push_back(construct([&]{ Net net(topology); net.setOptimizer(adamConfig); return net; }, ms));
+			else
+				counts.push_back(construct([&]{ return Net(adamNet); }, ms));
+			std::ostringstream name;
+			for(size_t l = 0; l < topology.size(); l++)
+				name << (l > 0 ? " " : "") << topology[l];
+			name << builds[b];
+			std::cout << std::setw(36) << name.str() << std::setw(14) << counts.back() << ms << '\n';
+		}
+		if(counts.front() != counts.back() || counts.back() > limits[b]){
+			std::cout << "construction allocations depend on the topology or exceed " << limits[b] << '\n';
+			g_ok = false;
+		}
+	}
+
+	std::cout << '\n' << std::setw(36) << "steady-state loop" << "allocations\n";
+	std::vector<double> inputVals(numInputs), targetVals(numOutputs), resultVals(numOutputs);
+	auto perSample = [&](auto &net){
+		return [&](unsigned i){
+			size_t s = i % samples;
+			inputVals.assign(&inputs[s * numInputs], &inputs[(s + 1) * numInputs]);
+			targetVals.assign(&targets[s * numOutputs], &targets[(s + 1) * numOutputs]);
+			net.feedForward(inputVals);
+			net.getResults(resultVals);
+			net.backProp(targetVals);
+		};
+	};
+	Net net(topology, activations);
+	FloatNet floatNet(net);
+	check("Net per-sample sgd", iterations, perSample(net));
+	check("FloatNet per-sample sgd", iterations, perSample(floatNet));
+	OptimizerConfig adam;
+	adam.kind = OPTIMIZER_ADAM;
+	adam.learningRate = optimizerInfo(OPTIMIZER_ADAM).defaultRate;
+	Net adamNet(topology, activations);
+	adamNet.setOptimizer(adam);
+	check("Net per-sample adam", iterations, perSample(adamNet));
+
+	char path[] = "/tmp/alloc_check_XXXXXX";
+	int fd = mkstemp(path);
+	if(fd >= 0){
+		close(fd);
+		std::ofstream file(path);
+		file << "topology:";
+		for(size_t l = 0; l < topology.size(); l++)
+			file << ' ' << topology[l];
+		file << '\n';
+		for(unsigned n = 0; n < WARMUP + iterations; n++){
+			size_t i = n % samples;
+			file << "in:";
+			for(unsigned j = 0; j < numInputs; j++)
+				file << ' ' << inputs[i * numInputs + j];
+			file << "\nout:";
+			for(unsigned j = 0; j < numOutputs; j++)
+				file << ' ' << targets[i * numOutputs + j];
+			file << '\n';
+		}
+		file.close();
+		TrainingData data(path);
+		std::vector<unsigned> fileTopology;
+		data.getTopology(fileTopology);
+		check("parse + per-sample sgd", iterations, [&](unsigned){
+			data.getNextInputs(inputVals);
+			data.getTargetOutputs(targetVals);
+			net.feedForward(inputVals);
+			net.getResults(resultVals);
+			net.backProp(targetVals);
+		});
+		unlink(path);
+	}
+
+	auto batch = [&](unsigned i){ return (size_t)(i * batchSize % (samples - batchSize + 1)); };
+	check("Net trainBatch", iterations, [&](unsigned i){
+		net.trainBatch(&inputs[batch(i) * numInputs], &targets[batch(i) * numOutputs], batchSize);
+	});
+	ThreadPool pool(2);
+	ParallelTrainer trainer(net, pool, 8);
+	check("ParallelTrainer synchronous", iterations, [&](unsigned i){
+		trainer.trainBatch(&inputs[batch(i) * numInputs], &targets[batch(i) * numOutputs], batchSize);
+	});
+	trainer.setHogwild(true);
+	check("ParallelTrainer hogwild", iterations, [&](unsigned i){
+		trainer.trainBatch(&inputs[batch(i) * numInputs], &targets[batch(i) * numOutputs], batchSize);
+	});
+
+	check("predictBatch", iterations, [&](unsigned i){
+		net.predictBatch(&inputs32[batch(i) * numInputs], batchSize, outputs32.data());
+	});
+	PredictWorkspace ws;
+	check("predictBatch, caller workspace", iterations, [&](unsigned){
+		net.predictBatch(inputs32.data(), samples, outputs32.data(), ws);
+	});
+	Evaluator evaluator(net, pool, 256);
+	check("Evaluator", iterations, [&](unsigned){
+		evaluator.evaluate(inputs32.data(), targets32.data(), samples);
+	});
+
+	std::cout << '\n' << (g_ok ? "all checks passed" : "FAILED") << '\n';
+	return g_ok ? 0 : 1;
+}
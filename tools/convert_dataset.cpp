@@ -0,0 +1,117 @@
+// Converts a topology:/in:/out: text file (training or test) into the binary
+// dataset format read by TrainingData/TestData (see NeuralNetworkGUI/dataset.h).
+// --stream writes the interleaved stream layout that tools/online_train
+// reads instead, to a file, a FIFO or stdout (output "-"), flushing every
+// --flush-every samples.
+//
+//   g++ -O2 -o convert_dataset tools/convert_dataset.cpp NeuralNetworkGUI/dataset.cpp
+//   ./convert_dataset trainingData.txt trainingData.bin [--float] [--stream] [--flush-every N]
+#include<bits/stdc++.h>
+#include "../NeuralNetworkGUI/dataset.h"
+
+static bool readValues(const std::string &line, const char *expected, std::vector<double> &vals){
+	vals.clear();
+	std::stringstream ss(line);
+	std::string label;
+	ss >> label;
+	if(label.compare(expected) != 0)
+		return false;
+	double oneValue;
+	while(ss >> oneValue)
+		vals.push_back(oneValue);
+	return true;
+}
+
+int main(int argc, char *argv[]){
+	if(argc < 3){
+		std::cerr << "usage: " << argv[0] << " input.txt output.bin [--float] [--stream] [--flush-every N]\n";
+		return 1;
+	}
+	DatasetType dtype = DATASET_FLOAT64;
+	bool stream = false;
+	unsigned flushEvery = 0;
+	for(int i = 3; i < argc; i++){
+		if(strcmp(argv[i], "--float") == 0)
+			dtype = DATASET_FLOAT32;
+		else if(strcmp(argv[i], "--stream") == 0)
+			stream = true;
+		else if(strcmp(argv[i], "--flush-every") == 0 && i + 1 < argc)
+			flushEvery = atoi(argv[++i]);
+	}
+	std::string output = strcmp(argv[2], "-") == 0 ? "/dev/stdout" : argv[2];
+	// Progress goes to stderr when the samples go to stdout.
+	std::ostream &report = output == "/dev/stdout" ? std::cerr : std::cout;
+	std::ifstream in(argv[1]);
+	if(!in){
+		std::cerr << "cannot open " << argv[1] << '\n';
+		return 1;
+	}
+
+	std::vector<unsigned> topology;
+	std::vector<ActivationKind> activations;
+	std::vector<double> inputVals, targetVals;
+	std::string line, outLine;
+	size_t lineNum = 1;
+	bool haveLine = (bool)getline(in, line);
+	if(haveLine && line.compare(0, 9, "topology:") == 0){
+		// Sizes with an optional ":activation" suffix.
+		std::stringstream ss(line.substr(9));
+		std::string field;
+		while(ss >> field){
+			size_t colon = field.find(':');
+			ActivationKind kind = ACTIVATION_SIGMOID;
+			if(colon != std::string::npos && !activationFromName(field.c_str() + colon + 1, field.size() - colon - 1, kind)){
+				std::cerr << "unknown activation in " << field << '\n';
+				return 1;
+			}
+			topology.push_back(atoi(field.c_str()));
+			activations.push_back(kind);
+		}
+		haveLine = (bool)getline(in, line);
+		lineNum++;
+	}
+
+	std::unique_ptr<DatasetWriter> writer;
+	for(; haveLine; haveLine = (bool)getline(in, line), lineNum++){
+		if(line.find_first_not_of(" \t\r") == std::string::npos)
+			continue;
+		if(!readValues(line, "in:", inputVals) || !getline(in, outLine)
+		   || !readValues(outLine, "out:", targetVals)){
+			std::cerr << argv[1] << ":" << lineNum << ": expected an in:/out: pair\n";
+			return 1;
+		}
+		if(!writer){
+			if(!topology.empty() && (topology.front() != inputVals.size() || topology.back() != targetVals.size())){
+				std::cerr << "sample width does not match the topology line\n";
+				return 1;
+			}
+			writer.reset(new DatasetWriter(output, topology, inputVals.size(), targetVals.size(), dtype, activations,
+			                               stream));
+			if(!writer->isOpen()){
+				std::cerr << "cannot create " << argv[2] << '\n';
+				return 1;
+			}
+			report << "inputs " << inputVals.size() << ", outputs " << targetVals.size() << std::endl;
+		} else if(inputVals.size() != writer->numInputs() || targetVals.size() != writer->numOutputs()){
+			std::cerr << argv[1] << ":" << lineNum << ": sample width changed\n";
+			return 1;
+		}
+		writer->append(inputVals.data(), targetVals.data());
+		if(flushEvery > 0 && writer->size() % flushEvery == 0 && !writer->flush()){
+			std::cerr << "error writing " << argv[2] << '\n';
+			return 1;
+		}
+		lineNum++;
+	}
+
+	if(!writer){
+		std::cerr << argv[1] << ": no samples\n";
+		return 1;
+	}
+	if(!writer->close()){
+		std::cerr << "error writing " << argv[2] << '\n';
+		return 1;
+	}
+	report << "wrote " << writer->size() << " samples to " << argv[2] << '\n';
+	return 0;
+}
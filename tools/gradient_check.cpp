@@ -0,0 +1,161 @@
+// Checks Net::backProp, the fused backward sweep, two ways:
+//
+//   numeric   the gradient it applies against central differences of the
+//             squared error 0.5 * sum (target - output)^2, for every weight
+//             of a few topologies covering each activation kind
+//   unfused   several training steps of backProp against backPropUnfused,
+//             the three-pass version it replaced, for every optimizer; the
+//             parameters and optimizer state must match bit for bit
+//
+// With plain SGD (rate 1, no momentum) one backProp leaves exactly -dE/dw in
+// the momentum buffer, which is what the numeric check reads. Exits 1 if any
+// check fails.
+//
+//   g++ -O2 -o gradient_check tools/gradient_check.cpp NeuralNetworkGUI/all_class.cpp NeuralNetworkGUI/activations.cpp NeuralNetworkGUI/optimizer.cpp NeuralNetworkGUI/kernels.cpp NeuralNetworkGUI/gemm.cpp NeuralNetworkGUI/dataset.cpp NeuralNetworkGUI/text_reader.cpp
+//   ./gradient_check [--samples N]
+#include<bits/stdc++.h>
+#include "../NeuralNetworkGUI/all_class.h"
+#include "../NeuralNetworkGUI/kernels.h"
+
+// Relative error at which a weight's numeric and analytic gradients are
+// taken to disagree (absolute below gradients of 1e-3).
+#define GRADIENT_TOLERANCE 1e-6
+
+struct Case {
+	const char *name;
+	std::vector<unsigned> topology;
+	std::vector<ActivationKind> activations;
+};
+
+static std::vector<Case> cases(void){
+	return {
+		{"2 8 1", {2, 8, 1}, {}},
+		{"3 16:tanh 8:relu 4:softmax", {3, 16, 8, 4},
+		 {ACTIVATION_SIGMOID, ACTIVATION_TANH, ACTIVATION_RELU, ACTIVATION_SOFTMAX}},
+		{"5 12:leaky_relu 7:sigmoid 3:tanh", {5, 12, 7, 3},
+		 {ACTIVATION_SIGMOID, ACTIVATION_LEAKY_RELU, ACTIVATION_SIGMOID, ACTIVATION_TANH}},
+		{"17 33:relu 9:tanh 2:sigmoid", {17, 33, 9, 2},
+		 {ACTIVATION_SIGMOID, ACTIVATION_RELU, ACTIVATION_TANH, ACTIVATION_SIGMOID}},
+	};
+}
+
+static double squaredError(Net &net, const std::vector<double> &inputs, const std::vector<double> &targets){
+	std::vector<double> outputs;
+	net.feedForward(inputs);
+	net.getResults(outputs);
+	double error = 0.0;
+	for(size_t i = 0; i < outputs.size(); i++)
+		error += 0.5 * (targets[i] - outputs[i]) * (targets[i] - outputs[i]);
+	return error;
+}
+
+static void randomSample(std::mt19937 &rng, const Case &c, std::vector<double> &inputs, std::vector<double> &targets){
+	std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+	inputs.resize(c.topology.front());
+	targets.resize(c.topology.back());
+	for(double &x : inputs)
+		x = uniform(rng);
+	double sum = 0.0;
+	for(double &t : targets)
+		sum += (t = 0.5 + 0.5 * uniform(rng));
+	if(!c.activations.empty() && c.activations.back() == ACTIVATION_SOFTMAX)
+		for(double &t : targets)
+			t /= sum;
+}
+
+// Largest relative error between backProp's gradient and central
+// differences over every weight, for one sample.
+static double numericCheck(const Case &c, const std::vector<double> &inputs, const std::vector<double> &targets,
+                           unsigned seed){
+	Net initial(c.topology, c.activations, seed);
+	size_t count = initial.numParameters();
+	// The perturbed net reads its weights from here, so they can be nudged
+	// one at a time without copying the net.
+	std::vector<double> weights(initial.parameters(), initial.parameters() + count);
+	Net probe(c.topology, weights.data(), NULL, std::shared_ptr<void>(), c.activations);
+
+	OptimizerConfig plain;
+	plain.learningRate = 1.0;
+	plain.momentum = 0.0;
+	Net analytic(initial);
+	analytic.setOptimizer(plain);
+	analytic.feedForward(inputs);
+	analytic.backProp(targets);
+
+	const double h = 1e-5;
+	double worst = 0.0;
+	for(size_t i = 0; i < count; i++){
+		double saved = weights[i];
+		weights[i] = saved + h;
+		double above = squaredError(probe, inputs, targets);
+		weights[i] = saved - h;
+		double below = squaredError(probe, inputs, targets);
+		weights[i] = saved;
+		double numeric = (above - below) / (2 * h);
+		double computed = -analytic.momentum()[i];
+		// Gradients near zero are judged on their absolute error instead:
+		// central differences of an O(1) error carry ~1e-11 of rounding.
+		double scale = std::max(std::fabs(numeric) + std::fabs(computed), 1e-3);
+		worst = std::max(worst, std::fabs(numeric - computed) / scale);
+	}
+	return worst;
+}
+
+// Trains two copies of one net on the same samples, one with each backProp.
+// True if they end with identical parameters and optimizer state.
+static bool unfusedCheck(const Case &c, OptimizerKind kind, unsigned samples, unsigned seed){
+	OptimizerConfig config;
+	config.kind = kind;
+	config.learningRate = optimizerInfo(kind).defaultRate;
+	config.weightDecay = 1e-3;
+	Net fused(c.topology, c.activations, seed);
+	fused.setOptimizer(config);
+	Net unfused(fused);
+	std::mt19937 rng(seed);
+	std::vector<double> inputs, targets;
+	for(unsigned s = 0; s < samples; s++){
+		randomSample(rng, c, inputs, targets);
+		fused.feedForward(inputs);
+		fused.backProp(targets);
+		unfused.feedForward(inputs);
+		unfused.backPropUnfused(targets);
+	}
+	size_t bytes = fused.numParameters() * sizeof(double);
+	return memcmp(fused.parameters(), unfused.parameters(), bytes) == 0
+	       && memcmp(fused.momentum(), unfused.momentum(), bytes) == 0
+	       && (fused.secondMoment() == NULL
+	           || memcmp(fused.secondMoment(), unfused.secondMoment(), bytes) == 0);
+}
+
+int main(int argc, char *argv[]){
+	unsigned samples = 200;
+	for(int i = 1; i < argc; i++)
+		if(strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+			samples = atoi(argv[++i]);
+	std::cout << "kernels: " << kernels().name << "\n\n";
+
+	bool ok = true;
+	std::cout << std::left << std::setw(36) << "topology" << std::setw(16) << "max rel error";
+	for(unsigned kind = 0; kind < OPTIMIZER_COUNT; kind++)
+		std::cout << std::setw(10) << optimizerInfo((OptimizerKind)kind).name;
+	std::cout << '\n';
+	for(const Case &c : cases()){
+		std::mt19937 rng(7);
+		std::vector<double> inputs, targets;
+		double worst = 0.0;
+		for(unsigned trial = 0; trial < 5; trial++){
+			randomSample(rng, c, inputs, targets);
+			worst = std::max(worst, numericCheck(c, inputs, targets, trial + 1));
+		}
+		ok &= worst < GRADIENT_TOLERANCE;
+		std::cout << std::setw(36) << c.name << std::setw(16) << worst;
+		for(unsigned kind = 0; kind < OPTIMIZER_COUNT; kind++){
+			bool same = unfusedCheck(c, (OptimizerKind)kind, samples, kind + 1);
+			ok &= same;
+			std::cout << std::setw(10) << (same ? "same" : "DIFFERS");
+		}
+		std::cout << '\n';
+	}
+	std::cout << '\n' << (ok ? "all checks passed" : "FAILED") << '\n';
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,180 @@
+// Online training: trains a Net on samples as they are appended to a file,
+// written to a FIFO or piped to stdin, and keeps publishing the weights.
+// The stream is the topology:/in:/out: text format or the binary stream
+// written by convert_dataset --stream (see NeuralNetworkGUI/stream_source.h);
+// training runs in mini-batches as data arrives (see online_trainer.h), and
+// no sample goes more than --max-staleness-ms from being read to being in
+// the published weights while the trainer keeps up.
+//
+// With --socket the published weights are served as they improve (protocol
+// in NeuralNetworkGUI/inference_server.h, same options as tools/serve).
+// With --save the latest snapshot is checkpointed every --save-every
+// seconds and the final Net, with its optimizer state, when the stream ends.
+// --follow keeps reading a regular file as it grows, like tail -f; a pipe
+// or FIFO ends when its writer closes it. SIGINT or SIGTERM ends the stream
+// either way, and the samples already read are still trained and saved.
+//
+//   make online_train         (or the g++ line below)
+//   g++ -O2 -pthread -o online_train tools/online_train.cpp NeuralNetworkGUI/online_trainer.cpp NeuralNetworkGUI/snapshots.cpp NeuralNetworkGUI/stream_source.cpp NeuralNetworkGUI/inference_server.cpp NeuralNetworkGUI/checkpoint.cpp NeuralNetworkGUI/parallel_trainer.cpp NeuralNetworkGUI/all_class.cpp NeuralNetworkGUI/activations.cpp NeuralNetworkGUI/optimizer.cpp NeuralNetworkGUI/normalizer.cpp NeuralNetworkGUI/kernels.cpp NeuralNetworkGUI/gemm.cpp NeuralNetworkGUI/dataset.cpp NeuralNetworkGUI/text_reader.cpp NeuralNetworkGUI/thread_pool.cpp NeuralNetworkGUI/profiler.cpp
+//   ./online_train SOURCE|- [--follow] [--model FILE] [--batch B] [--max-staleness-ms MS] [--max-pending N]
+//                  [--threads T] [--optimizer NAME] [--lr X] [--socket PATH] [--save FILE] [--save-every S]
+//                  [--report-every S]
+//
+//   convert_dataset trainingData.txt - --stream | ./online_train - --socket /tmp/nn.sock
+#include<bits/stdc++.h>
+#include<signal.h>
+#include "../NeuralNetworkGUI/online_trainer.h"
+#include "../NeuralNetworkGUI/stream_source.h"
+#include "../NeuralNetworkGUI/inference_server.h"
+#include "../NeuralNetworkGUI/checkpoint.h"
+
+// Lock-free, so the handler may set it; the source polls it while waiting.
+static std::atomic<bool> g_stop(false);
+
+static void onSignal(int){
+	g_stop = true;
+}
+
+static void printStats(const OnlineStats &s, unsigned long long version){
+	std::cout << std::fixed << std::setprecision(1) << s.seconds << "s: " << s.ingested << " read, " << s.trained
+	          << " trained (" << (s.seconds > 0 ? s.trained / s.seconds : 0.0) << "/s), " << s.pending
+	          << " pending, snapshot " << version << ", staleness mean " << s.meanStaleness * 1e3 << "ms max "
+	          << s.maxStaleness * 1e3 << "ms, " << s.lateSamples << " late, loss " << std::setprecision(4)
+	          << s.recentAverageLoss << std::endl;
+	std::cout.unsetf(std::ios::floatfield);
+}
+
+int main(int argc, char *argv[]){
+	if(argc < 2){
+		std::cerr << "usage: " << argv[0] << " SOURCE|- [--follow] [--model FILE] [--batch B]"
+		          << " [--max-staleness-ms MS] [--max-pending N] [--threads T] [--optimizer NAME] [--lr X]"
+		          << " [--socket PATH] [--save FILE] [--save-every S] [--report-every S]\n";
+		return 1;
+	}
+	OnlineOptions options;
+	ServeOptions serveOptions;
+	OptimizerConfig optimizer;
+	bool follow = false, optimizerGiven = false, rateGiven = false;
+	const char *modelFile = NULL, *socketPath = NULL, *saveFile = NULL;
+	double reportEvery = 5.0, saveEvery = 60.0;
+	for(int i = 2; i < argc; i++){
+		if(strcmp(argv[i], "--follow") == 0)
+			follow = true;
+		else if(strcmp(argv[i], "--model") == 0 && i + 1 < argc)
+			modelFile = argv[++i];
+		else if(strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+			options.batchSize = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--max-staleness-ms") == 0 && i + 1 < argc)
+			options.maxStaleness = atof(argv[++i]) / 1000;
+		else if(strcmp(argv[i], "--max-pending") == 0 && i + 1 < argc)
+			options.maxPending = strtoull(argv[++i], NULL, 10);
+		else if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			options.threads = serveOptions.threads = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--lr") == 0 && i + 1 < argc){
+			optimizer.learningRate = atof(argv[++i]);
+			optimizerGiven = rateGiven = true;
+		} else if(strcmp(argv[i], "--socket") == 0 && i + 1 < argc)
+			socketPath = argv[++i];
+		else if(strcmp(argv[i], "--save") == 0 && i + 1 < argc)
+			saveFile = argv[++i];
+		else if(strcmp(argv[i], "--save-every") == 0 && i + 1 < argc)
+			saveEvery = atof(argv[++i]);
+		else if(strcmp(argv[i], "--report-every") == 0 && i + 1 < argc)
+			reportEvery = atof(argv[++i]);
+		else if(strcmp(argv[i], "--optimizer") == 0 && i + 1 < argc){
+			if(!optimizerFromName(argv[++i], optimizer.kind)){
+				std::cerr << "unknown optimizer " << argv[i] << '\n';
+				return 1;
+			}
+			optimizerGiven = true;
+		} else {
+			std::cerr << "unknown option " << argv[i] << '\n';
+			return 1;
+		}
+	}
+	if(!rateGiven)
+		optimizer.learningRate = optimizerInfo(optimizer.kind).defaultRate;
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+
+	StreamSource source(argv[1], follow, &g_stop);
+	if(!source.isOpen()){
+		std::cerr << "cannot read a topology or stream header from " << argv[1] << '\n';
+		return 1;
+	}
+	std::vector<unsigned> topology;
+	std::vector<ActivationKind> activations;
+	source.getTopology(topology);
+	source.getActivations(activations);
+	std::unique_ptr<Net> loaded;
+	if(modelFile != NULL){
+		loaded = loadCheckpoint(modelFile);
+		std::vector<unsigned> loadedTopology;
+		if(loaded)
+			loaded->getTopology(loadedTopology);
+		if(!loaded || (!topology.empty() && loadedTopology != topology)){
+			std::cerr << modelFile << " is not a checkpoint for this topology\n";
+			return 1;
+		}
+	} else if(topology.size() < 2){
+		std::cerr << argv[1] << " has no topology, give a --model\n";
+		return 1;
+	}
+	Net net = loaded ? std::move(*loaded) : Net(topology, activations);
+	loaded.reset();
+	if(optimizerGiven || modelFile == NULL)
+		net.setOptimizer(optimizer);
+	net.getTopology(topology);
+
+	NetSnapshots snapshots(net);
+	std::unique_ptr<InferenceServer> server;
+	if(socketPath != NULL){
+		server.reset(new InferenceServer(snapshots, serveOptions));
+		if(!server->listen(socketPath)){
+			std::cerr << "cannot listen on " << socketPath << '\n';
+			return 1;
+		}
+	}
+	std::cout << "training (";
+	for(size_t l = 0; l < topology.size(); l++)
+		std::cout << (l > 0 ? " " : "") << topology[l];
+	std::cout << ") from " << argv[1] << (source.isBinary() ? " (binary)" : "") << ", batch " << options.batchSize
+	          << ", max staleness " << options.maxStaleness * 1e3 << "ms";
+	if(socketPath != NULL)
+		std::cout << ", serving on " << socketPath;
+	std::cout << std::endl;
+
+	typedef std::chrono::steady_clock Clock;
+	OnlineTrainer trainer(net, source, snapshots, options);
+	std::future<void> done = std::async(std::launch::async, [&]{ trainer.wait(); });
+	Clock::time_point nextReport = Clock::now(), nextSave = Clock::now();
+	unsigned long long savedVersion = 0;
+	while(done.wait_for(std::chrono::milliseconds(50)) != std::future_status::ready){
+		Clock::time_point now = Clock::now();
+		if(reportEvery > 0 && now >= nextReport + std::chrono::duration_cast<Clock::duration>(
+		        std::chrono::duration<double>(reportEvery))){
+			nextReport = now;
+			printStats(trainer.stats(), snapshots.version());
+		}
+		if(saveFile != NULL && saveEvery > 0 && now >= nextSave + std::chrono::duration_cast<Clock::duration>(
+		        std::chrono::duration<double>(saveEvery))){
+			nextSave = now;
+			// The published copy, so training goes on while the file is written.
+			std::shared_ptr<const NetSnapshot> snapshot = snapshots.current();
+			if(snapshot->version != savedVersion && saveCheckpoint(snapshot->net, saveFile, snapshot->samplesSeen, false))
+				savedVersion = snapshot->version;
+		}
+	}
+	OnlineStats stats = trainer.stats();
+	printStats(stats, snapshots.version());
+	if(server)
+		server->stop();
+	if(saveFile != NULL){
+		if(!saveCheckpoint(net, saveFile, stats.trained)){
+			std::cerr << "cannot write " << saveFile << '\n';
+			return 1;
+		}
+		std::cout << "saved " << saveFile << " after " << stats.trained << " samples" << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,196 @@
+// Trains the same network (same seed, same sample order) in double, float,
+// and float with bf16/fp16 activation storage, then scores each on the test
+// set and reports its accuracy and outputs against the double baseline.
+// The double net is also quantized to int8 (per-row and per-layer weight
+// scales), calibrated on every k-th test sample, up to --calibrate N.
+//
+//   g++ -O2 -pthread -o precision_report tools/precision_report.cpp NeuralNetworkGUI/all_class.cpp NeuralNetworkGUI/activations.cpp NeuralNetworkGUI/optimizer.cpp NeuralNetworkGUI/kernels.cpp NeuralNetworkGUI/gemm.cpp NeuralNetworkGUI/dataset.cpp NeuralNetworkGUI/text_reader.cpp NeuralNetworkGUI/evaluator.cpp NeuralNetworkGUI/thread_pool.cpp NeuralNetworkGUI/quantized_net.cpp
+//   ./precision_report [trainingData.txt] [testData.txt] [--batch N] [--passes N] [--calibrate N]
+#include<bits/stdc++.h>
+#include "../NeuralNetworkGUI/evaluator.h"
+#include "../NeuralNetworkGUI/quantized_net.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct Samples {
+	unsigned numInputs, numOutputs;
+	std::vector<double> inputs, targets;
+	size_t size(void) const { return numOutputs > 0 ? targets.size() / numOutputs : 0; }
+};
+
+struct Report {
+	std::string name;
+	double trainSeconds;          // negative when the net was not trained in this mode
+	double predictSeconds;
+	std::vector<float> predictions;
+};
+
+static bool loadTraining(const std::string &filename, std::vector<unsigned> &topology,
+                         std::vector<ActivationKind> &activations, Samples &samples){
+	std::ifstream probe(filename);
+	if(!probe)
+		return false;
+	TrainingData data(filename);
+	data.getTopology(topology);
+	data.getActivations(activations);
+	samples.numInputs = topology.front();
+	samples.numOutputs = topology.back();
+	std::vector<double> inputVals, targetVals;
+	while(!data.isEof()){
+		if(data.getNextInputs(inputVals) != samples.numInputs
+		   || data.getTargetOutputs(targetVals) != samples.numOutputs)
+			break;
+		samples.inputs.insert(samples.inputs.end(), inputVals.begin(), inputVals.end());
+		samples.targets.insert(samples.targets.end(), targetVals.begin(), targetVals.end());
+	}
+	return true;
+}
+
+template<class NetType>
+static void predict(Report &report, const NetType &net, unsigned numOutputs,
+                    const std::vector<float> &testInputs, size_t testCount){
+	report.predictions.resize(testCount * numOutputs);
+	Clock::time_point start = Clock::now();
+	net.predictBatch(testInputs.data(), testCount, report.predictions.data());
+	report.predictSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+template<class NetType>
+static Report run(const std::string &name, NetType &net, const Samples &train, unsigned batchSize,
+                  unsigned passes, const std::vector<float> &testInputs, size_t testCount){
+	Report report;
+	report.name = name;
+	Clock::time_point start = Clock::now();
+	std::vector<double> inputVals(train.numInputs), targetVals(train.numOutputs);
+	for(unsigned pass = 0; pass < passes; pass++){
+		if(batchSize > 0){
+			for(size_t first = 0; first + batchSize <= train.size(); first += batchSize)
+				net.trainBatch(&train.inputs[first * train.numInputs],
+				               &train.targets[first * train.numOutputs], batchSize);
+			continue;
+		}
+		for(size_t i = 0; i < train.size(); i++){
+			inputVals.assign(&train.inputs[i * train.numInputs], &train.inputs[(i + 1) * train.numInputs]);
+			targetVals.assign(&train.targets[i * train.numOutputs], &train.targets[(i + 1) * train.numOutputs]);
+			net.feedForward(inputVals);
+			net.backProp(targetVals);
+		}
+	}
+	report.trainSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	predict(report, net, train.numOutputs, testInputs, testCount);
+	return report;
+}
+
+static unsigned classOf(const float *values, unsigned numOutputs){
+	if(numOutputs == 1)
+		return values[0] > 0.5f ? 1 : 0;
+	return std::max_element(values, values + numOutputs) - values;
+}
+
+int main(int argc, char *argv[]){
+	std::string trainFile = "trainingData.txt", testFile = "testData.txt";
+	unsigned batchSize = 0, passes = 1, calibrate = 1000, files = 0;
+	for(int i = 1; i < argc; i++){
+		if(strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+			batchSize = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--passes") == 0 && i + 1 < argc)
+			passes = std::max(1, atoi(argv[++i]));
+		else if(strcmp(argv[i], "--calibrate") == 0 && i + 1 < argc)
+			calibrate = std::max(1, atoi(argv[++i]));
+		else if(files++ == 0)
+			trainFile = argv[i];
+		else
+			testFile = argv[i];
+	}
+
+	std::vector<unsigned> topology;
+	std::vector<ActivationKind> activations;
+	Samples train;
+	if(!loadTraining(trainFile, topology, activations, train)){
+		std::cerr << "cannot open " << trainFile << '\n';
+		return 1;
+	}
+	std::ifstream probe(testFile);
+	if(!probe){
+		std::cerr << "cannot open " << testFile << '\n';
+		return 1;
+	}
+	TestData test(testFile);
+	std::vector<float> testInputs, testTargets;
+	size_t testCount = 0;
+	const unsigned block = 1 << 16;
+	while(true){
+		testInputs.resize((testCount + block) * train.numInputs);
+		testTargets.resize((testCount + block) * train.numOutputs);
+		unsigned got = readSamples(test, train.numInputs, train.numOutputs, block,
+		                           &testInputs[testCount * train.numInputs],
+		                           &testTargets[testCount * train.numOutputs]);
+		testCount += got;
+		if(got < block)
+			break;
+	}
+
+	std::vector<Report> reports;
+	Net baseline(topology, activations);
+	reports.push_back(run("double", baseline, train, batchSize, passes, testInputs, testCount));
+	const char *names[] = {"float", "float + bf16", "float + fp16"};
+	const ActivationStorage storage[] = {ACTIVATIONS_NATIVE, ACTIVATIONS_BF16, ACTIVATIONS_FP16};
+	for(unsigned mode = 0; mode < 3; mode++){
+		FloatNet net(topology, activations);
+		net.setActivationStorage(storage[mode]);
+		reports.push_back(run(names[mode], net, train, batchSize, passes, testInputs, testCount));
+	}
+	std::vector<float> calibration;
+	size_t stride = std::max<size_t>(1, testCount / calibrate);
+	for(size_t i = 0; i < testCount; i += stride)
+		calibration.insert(calibration.end(), &testInputs[i * train.numInputs], &testInputs[(i + 1) * train.numInputs]);
+	const char *quantizedNames[] = {"int8 per-layer", "int8 per-row"};
+	const QuantizationGranularity granularity[] = {QUANTIZE_PER_LAYER, QUANTIZE_PER_ROW};
+	for(unsigned mode = 0; mode < 2; mode++){
+		QuantizedNet net(baseline, calibration.data(), calibration.size() / train.numInputs, granularity[mode]);
+		Report report;
+		report.name = quantizedNames[mode];
+		report.trainSeconds = -1.0;
+		predict(report, net, train.numOutputs, testInputs, testCount);
+		reports.push_back(report);
+	}
+
+	std::cout << train.size() << " training samples x " << passes << " pass(es), "
+	          << (batchSize > 0 ? "batch " + std::to_string(batchSize) : std::string("per sample"))
+	          << "; " << testCount << " test samples\n";
+	std::cout << std::left << std::setw(16) << "mode" << std::setw(12) << "accuracy" << std::setw(12) << "delta"
+	          << std::setw(14) << "mean |diff|" << std::setw(14) << "max |diff|"
+	          << std::setw(12) << "train s" << "predict s\n";
+	const std::vector<float> &reference = reports[0].predictions;
+	unsigned numOutputs = train.numOutputs;
+	double baselineAccuracy = 0.0;
+	for(size_t r = 0; r < reports.size(); r++){
+		const Report &report = reports[r];
+		unsigned long long correct = 0;
+		double diffSum = 0.0, diffMax = 0.0;
+		for(size_t i = 0; i < testCount; i++){
+			const float *out = &report.predictions[i * numOutputs];
+			correct += classOf(out, numOutputs) == classOf(&testTargets[i * numOutputs], numOutputs);
+			for(unsigned j = 0; j < numOutputs; j++){
+				double diff = fabs((double)out[j] - reference[i * numOutputs + j]);
+				diffSum += diff;
+				diffMax = std::max(diffMax, diff);
+			}
+		}
+		double accuracy = testCount > 0 ? (double)correct / testCount : 0.0;
+		if(r == 0)
+			baselineAccuracy = accuracy;
+		std::ostringstream delta;
+		delta << std::showpos << accuracy - baselineAccuracy;
+		std::ostringstream trainSeconds;
+		if(report.trainSeconds >= 0.0)
+			trainSeconds << report.trainSeconds;
+		else
+			trainSeconds << "-";
+		std::cout << std::setw(16) << report.name << std::setw(12) << accuracy << std::setw(12) << delta.str()
+		          << std::setw(14) << (testCount > 0 ? diffSum / (testCount * numOutputs) : 0.0)
+		          << std::setw(14) << diffMax << std::setw(12) << trainSeconds.str()
+		          << report.predictSeconds << '\n';
+	}
+}
@@ -0,0 +1,84 @@
+// Inference daemon: loads a checkpoint once and answers predictions over a
+// Unix domain socket (protocol in NeuralNetworkGUI/inference_server.h)
+// until SIGINT or SIGTERM. Every --stats-every seconds it prints the QPS
+// and p50/p99 latency of that interval; clients can also ask for the
+// running totals with a SERVE_STATS request. bench/serve_bench.cpp is the
+// matching load generator.
+//
+//   make serve                (or the g++ line below)
+//   g++ -O2 -pthread -o serve tools/serve.cpp NeuralNetworkGUI/inference_server.cpp NeuralNetworkGUI/checkpoint.cpp NeuralNetworkGUI/all_class.cpp NeuralNetworkGUI/activations.cpp NeuralNetworkGUI/optimizer.cpp NeuralNetworkGUI/kernels.cpp NeuralNetworkGUI/gemm.cpp NeuralNetworkGUI/dataset.cpp NeuralNetworkGUI/text_reader.cpp NeuralNetworkGUI/thread_pool.cpp
+//   ./serve model.ckpt [--socket PATH] [--threads T] [--max-batch N] [--budget-us U] [--max-queued N] [--stats-every S]
+#include<bits/stdc++.h>
+#include<signal.h>
+#include "../NeuralNetworkGUI/inference_server.h"
+#include "../NeuralNetworkGUI/checkpoint.h"
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void onSignal(int){
+	g_stop = 1;
+}
+
+int main(int argc, char *argv[]){
+	if(argc < 2){
+		std::cerr << "usage: " << argv[0] << " model.ckpt [--socket PATH] [--threads T] [--max-batch N]"
+		          << " [--budget-us U] [--max-queued N] [--stats-every S]\n";
+		return 1;
+	}
+	std::string socketPath = "/tmp/nn.sock";
+	ServeOptions options;
+	double statsEvery = 10.0;
+	for(int i = 2; i < argc; i++){
+		if(strcmp(argv[i], "--socket") == 0 && i + 1 < argc)
+			socketPath = argv[++i];
+		else if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			options.threads = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--max-batch") == 0 && i + 1 < argc)
+			options.maxBatch = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--budget-us") == 0 && i + 1 < argc)
+			options.latencyBudgetUs = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--max-queued") == 0 && i + 1 < argc)
+			options.maxQueued = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--stats-every") == 0 && i + 1 < argc)
+			statsEvery = atof(argv[++i]);
+	}
+
+	std::unique_ptr<Net> net = loadCheckpoint(argv[1]);
+	if(!net){
+		std::cerr << argv[1] << " is not a checkpoint\n";
+		return 1;
+	}
+	InferenceServer server(*net, options);
+	if(!server.listen(socketPath)){
+		std::cerr << "cannot listen on " << socketPath << '\n';
+		return 1;
+	}
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+	std::vector<unsigned> topology;
+	net->getTopology(topology);
+	std::cout << "serving " << argv[1] << " (";
+	for(size_t l = 0; l < topology.size(); l++)
+		std::cout << (l > 0 ? " " : "") << topology[l];
+	std::cout << ") on " << socketPath << ", max batch " << options.maxBatch << ", budget "
+	          << options.latencyBudgetUs << "us" << std::endl;
+
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point next = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+	        std::chrono::duration<double>(statsEvery));
+	while(!g_stop){
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		if(statsEvery <= 0 || Clock::now() < next)
+			continue;
+		next += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(statsEvery));
+		ServeStats s = server.intervalStats();
+		if(s.requests == 0 && s.rejected == 0)
+			continue;
+		std::cout << std::fixed << std::setprecision(1) << s.qps << " qps, " << s.samples / s.seconds
+		          << " samples/s, p50 " << s.p50 * 1e6 << "us, p99 " << s.p99 * 1e6 << "us, max "
+		          << s.maxLatency * 1e6 << "us, mean batch " << s.meanBatch << ", rejected " << s.rejected
+		          << std::endl;
+	}
+	server.stop();
+	std::cout << "stopped: " << server.statsJson() << std::endl;
+}
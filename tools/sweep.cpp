@@ -0,0 +1,209 @@
+// Hyperparameter sweep with k-fold cross-validation: trains a Net for every
+// combination of --hidden, --activation, --lr and --momentum (or --random N
+// draws from them) on every fold of the training file, many at once across
+// --threads cores, and ranks the trials by mean validation accuracy per
+// CPU-second. Whatever is not given stays as in the data file (hidden
+// layers and their activation) or at the eta/alpha defaults.
+//
+// Finished folds go to the --journal file as they complete; running the
+// same command again skips them, so an interrupted sweep resumes, and a
+// widened grid only trains the new trials.
+//
+//   make sweep                (or the g++ line below)
+//   g++ -O2 -pthread -o sweep tools/sweep.cpp NeuralNetworkGUI/sweep.cpp NeuralNetworkGUI/normalizer.cpp NeuralNetworkGUI/epoch_trainer.cpp NeuralNetworkGUI/parallel_trainer.cpp NeuralNetworkGUI/evaluator.cpp NeuralNetworkGUI/all_class.cpp NeuralNetworkGUI/activations.cpp NeuralNetworkGUI/optimizer.cpp NeuralNetworkGUI/kernels.cpp NeuralNetworkGUI/gemm.cpp NeuralNetworkGUI/dataset.cpp NeuralNetworkGUI/text_reader.cpp NeuralNetworkGUI/thread_pool.cpp
+//   ./sweep trainingData.txt [--hidden "8;16;16,8"] [--activation sigmoid,tanh,relu] [--lr 0.05,0.15,0.5]
+//           [--momentum 0,0.5,0.9] [--random N] [--seed S] [--folds K] [--epochs E] [--batch B]
+//           [--optimizer NAME] [--normalize standard|minmax] [--threads T] [--journal FILE] [--top N]
+//           [--memory-budget MB]
+//
+// --normalize fits the input scaling to each fold's training samples by
+// merging the other folds' statistics, so the held-out fold stays unseen.
+// With --random the --lr and --momentum lists only give the range: the
+// learning rate is drawn log-uniformly and the momentum uniformly between
+// their smallest and largest values.
+#include<bits/stdc++.h>
+#include "../NeuralNetworkGUI/sweep.h"
+
+// Comma-separated numbers.
+static std::vector<double> parseList(const char *text){
+	std::vector<double> values;
+	std::string item;
+	std::istringstream in(text);
+	while(std::getline(in, item, ','))
+		if(!item.empty())
+			values.push_back(atof(item.c_str()));
+	return values;
+}
+
+// Topologies separated by ';', layers by ',' or spaces; "none" for no
+// hidden layer.
+static std::vector<std::vector<unsigned> > parseHidden(const char *text){
+	std::vector<std::vector<unsigned> > hidden;
+	std::string item;
+	std::istringstream in(text);
+	while(std::getline(in, item, ';')){
+		std::replace(item.begin(), item.end(), ',', ' ');
+		std::istringstream layers(item);
+		std::vector<unsigned> sizes;
+		std::string word;
+		bool any = false;
+		while(layers >> word){
+			any = true;
+			if(word != "none" && atoi(word.c_str()) > 0)
+				sizes.push_back(atoi(word.c_str()));
+		}
+		if(any)
+			hidden.push_back(sizes);
+	}
+	return hidden;
+}
+
+static bool parseActivations(const char *text, std::vector<ActivationKind> &activations){
+	std::string item;
+	std::istringstream in(text);
+	activations.clear();
+	while(std::getline(in, item, ',')){
+		ActivationKind kind;
+		if(item.empty())
+			continue;
+		if(!activationFromName(item.data(), item.size(), kind) || activationInfo(kind).outputOnly){
+			std::cerr << item << " is not a hidden layer activation\n";
+			return false;
+		}
+		activations.push_back(kind);
+	}
+	return !activations.empty();
+}
+
+int main(int argc, char *argv[]){
+	if(argc < 2 || argv[1][0] == '-'){
+		std::cerr << "usage: " << argv[0] << " trainingData.txt [--hidden \"8;16;16,8\"] [--activation LIST]"
+		          << " [--lr LIST] [--momentum LIST] [--random N] [--seed S] [--folds K] [--epochs E]"
+		          << " [--batch B] [--optimizer NAME] [--normalize KIND] [--threads T] [--journal FILE] [--top N]"
+		          << " [--memory-budget MB]\n";
+		return 1;
+	}
+	std::string dataFile = argv[1], journal = "sweep.jsonl";
+	std::ifstream probe(dataFile.c_str());
+	if(!probe){
+		std::cerr << "cannot read " << dataFile << '\n';
+		return 1;
+	}
+	probe.close();
+	std::vector<unsigned> topology;
+	std::vector<ActivationKind> fileActivations;
+	{
+		TrainingData data(dataFile);
+		data.getTopology(topology);
+		data.getActivations(fileActivations);
+	}
+
+	SweepSpace space;
+	space.hidden.push_back(std::vector<unsigned>(topology.begin() + 1, topology.end() - 1));
+	space.activations.push_back(fileActivations.size() > 2 ? fileActivations[1] : ACTIVATION_SIGMOID);
+	space.learningRates.push_back(eta);
+	space.momenta.push_back(alpha);
+	ActivationKind outputActivation = fileActivations.empty() ? ACTIVATION_SIGMOID : fileActivations.back();
+	SweepOptions options;
+	unsigned randomTrials = 0, top = 10;
+	size_t memoryBudget = (size_t)1 << 30;
+	for(int i = 2; i < argc; i++){
+		if(strcmp(argv[i], "--hidden") == 0 && i + 1 < argc)
+			space.hidden = parseHidden(argv[++i]);
+		else if(strcmp(argv[i], "--activation") == 0 && i + 1 < argc){
+			if(!parseActivations(argv[++i], space.activations))
+				return 1;
+		} else if(strcmp(argv[i], "--lr") == 0 && i + 1 < argc)
+			space.learningRates = parseList(argv[++i]);
+		else if(strcmp(argv[i], "--momentum") == 0 && i + 1 < argc)
+			space.momenta = parseList(argv[++i]);
+		else if(strcmp(argv[i], "--random") == 0 && i + 1 < argc)
+			randomTrials = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			options.seed = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--folds") == 0 && i + 1 < argc)
+			options.folds = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--epochs") == 0 && i + 1 < argc)
+			options.epochs = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+			options.batchSize = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			options.threads = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--journal") == 0 && i + 1 < argc)
+			journal = argv[++i];
+		else if(strcmp(argv[i], "--top") == 0 && i + 1 < argc)
+			top = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--memory-budget") == 0 && i + 1 < argc)
+			memoryBudget = (size_t)(atof(argv[++i]) * 1024 * 1024);
+		else if(strcmp(argv[i], "--optimizer") == 0 && i + 1 < argc){
+			if(!optimizerFromName(argv[++i], options.optimizer)){
+				std::cerr << "unknown optimizer " << argv[i] << '\n';
+				return 1;
+			}
+		} else if(strcmp(argv[i], "--normalize") == 0 && i + 1 < argc){
+			if(!scalingFromName(argv[++i], options.scaling)){
+				std::cerr << "unknown scaling " << argv[i] << '\n';
+				return 1;
+			}
+		} else {
+			std::cerr << "unknown option " << argv[i] << '\n';
+			return 1;
+		}
+	}
+	if(space.hidden.empty() || space.learningRates.empty() || space.momenta.empty()){
+		std::cerr << "--hidden, --lr and --momentum need at least one value\n";
+		return 1;
+	}
+
+	DatasetCache cache;
+	if(!cache.load(dataFile, memoryBudget) || cache.size() < 2){
+		std::cerr << dataFile << " does not fit in --memory-budget or has fewer than two samples\n";
+		return 1;
+	}
+	std::vector<SweepTrial> trials = randomTrials > 0 ? space.random(randomTrials, options.seed) : space.grid();
+	SweepRunner runner(cache, outputActivation, options);
+	unsigned folds = std::max(2u, std::min<unsigned>(options.folds, cache.size()));
+	size_t total = trials.size() * folds, finished = 0, resumed = 0;
+	std::cout << trials.size() << " trials x " << folds << " folds on " << cache.size() << " samples, "
+	          << options.epochs << " epochs each, journal " << journal << std::endl;
+
+	bool ok = runner.run(trials, journal, [&](const SweepFold &fold){
+		finished++;
+		if(fold.resumed){
+			resumed++;
+			return;
+		}
+		if(resumed > 0){
+			std::cout << resumed << " folds already in " << journal << '\n';
+			resumed = 0;
+		}
+		std::cout << '[' << finished << '/' << total << "] " << trials[fold.trial].key() << " fold " << fold.fold
+		          << ": accuracy " << std::fixed << std::setprecision(4) << fold.accuracy << ", loss "
+		          << fold.loss << ", " << std::setprecision(2) << fold.cpuSeconds << " cpu-s" << std::endl;
+		std::cout.unsetf(std::ios::floatfield);
+	});
+	if(resumed > 0)
+		std::cout << "all " << resumed << " folds already in " << journal << '\n';
+	if(!ok)
+		std::cerr << "cannot write " << journal << '\n';
+
+	std::vector<SweepResult> results = runner.ranked();
+	std::cout << '\n' << std::setw(4) << "rank" << std::setw(12) << "acc/cpu-s" << std::setw(10) << "accuracy"
+	          << std::setw(9) << "stddev" << std::setw(9) << "loss" << std::setw(9) << "cpu-s" << "  trial\n";
+	std::cout << std::fixed;
+	for(size_t r = 0; r < results.size() && r < top; r++){
+		const SweepResult &s = results[r];
+		std::cout << std::setw(4) << r + 1 << std::setw(12) << std::setprecision(4) << s.score()
+		          << std::setw(10) << s.accuracy << std::setw(9) << s.accuracyStddev << std::setw(9) << s.loss
+		          << std::setw(9) << std::setprecision(2) << s.cpuSeconds << "  " << s.trial.key() << '\n';
+	}
+	if(!results.empty()){
+		const SweepResult *best = &results[0];
+		for(size_t r = 1; r < results.size(); r++)
+			if(results[r].accuracy > best->accuracy)
+				best = &results[r];
+		std::cout << "most accurate: " << best->trial.key() << ", " << std::setprecision(4) << best->accuracy
+		          << " +- " << best->accuracyStddev << '\n';
+	}
+	return ok ? 0 : 1;
+}